@@ -0,0 +1,404 @@
+/*
+ * Edge Alert Engine - Threshold rules evaluated on every sample
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <cJSON.h>
+#include "nvs.h"
+#include "alert_engine.h"
+#include "mqtt_client_manager.h"
+#include "env_config.h"
+
+static const char *TAG = "alert_engine";
+
+// NVS storage for rules
+#define NVS_NAMESPACE           "alerts"
+#define NVS_KEY_RULES           "rules"
+#define RULES_BLOB_VERSION      1
+
+// Defaults mirror the Grafana rules ("for: 2m")
+#define DEFAULT_MIN_DURATION_S  120
+#define DEFAULT_TEMP_HYSTERESIS     0.5f
+#define DEFAULT_HUMIDITY_HYSTERESIS 2.0f
+
+typedef enum {
+    RULE_STATE_NORMAL = 0,
+    RULE_STATE_PENDING,     // Condition true, waiting for min_duration_s
+    RULE_STATE_FIRING,
+} rule_state_t;
+
+typedef struct {
+    rule_state_t state;
+    int64_t pending_since_ms;
+} rule_runtime_t;
+
+typedef struct {
+    uint8_t version;
+    uint8_t count;
+    alert_rule_t rules[ALERT_ENGINE_MAX_RULES];
+} rules_blob_t;
+
+static const char *metric_names[ALERT_METRIC_COUNT] = {
+    [ALERT_METRIC_TEMPERATURE] = "temperature",
+    [ALERT_METRIC_HUMIDITY] = "humidity",
+    [ALERT_METRIC_PRESSURE] = "pressure",
+    [ALERT_METRIC_GAS_RESISTANCE] = "gas_resistance",
+    [ALERT_METRIC_SOIL_MOISTURE] = "soil_moisture",
+    [ALERT_METRIC_VPD] = "vpd",
+    [ALERT_METRIC_DEW_POINT] = "dew_point",
+    [ALERT_METRIC_IAQ] = "iaq",
+};
+
+// Global state
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+static SemaphoreHandle_t rules_mutex = NULL;
+static alert_rule_t rules[ALERT_ENGINE_MAX_RULES];
+static rule_runtime_t runtime[ALERT_ENGINE_MAX_RULES];
+static int rule_count = 0;
+static char alert_topic[96];
+static alert_fired_cb_t fired_cb = NULL;
+
+static void add_rule(alert_rule_t *set, int *count, const char *name, alert_metric_t metric,
+                     alert_op_t op, float threshold, float hysteresis)
+{
+    alert_rule_t *rule = &set[(*count)++];
+    memset(rule, 0, sizeof(*rule));
+    strlcpy(rule->name, name, sizeof(rule->name));
+    rule->metric = metric;
+    rule->op = op;
+    rule->threshold = threshold;
+    rule->hysteresis = hysteresis;
+    rule->min_duration_s = DEFAULT_MIN_DURATION_S;
+    rule->enabled = true;
+}
+
+/**
+ * Build the default rule set from the ALERT_* values in .env
+ */
+static void load_default_rules(void)
+{
+    rule_count = 0;
+    add_rule(rules, &rule_count, "temp_high", ALERT_METRIC_TEMPERATURE, ALERT_OP_ABOVE,
+             atof(ENV_ALERT_TEMP_HIGH), DEFAULT_TEMP_HYSTERESIS);
+    add_rule(rules, &rule_count, "temp_low", ALERT_METRIC_TEMPERATURE, ALERT_OP_BELOW,
+             atof(ENV_ALERT_TEMP_LOW), DEFAULT_TEMP_HYSTERESIS);
+    add_rule(rules, &rule_count, "humidity_high", ALERT_METRIC_HUMIDITY, ALERT_OP_ABOVE,
+             atof(ENV_ALERT_HUMIDITY_HIGH), DEFAULT_HUMIDITY_HYSTERESIS);
+    add_rule(rules, &rule_count, "humidity_low", ALERT_METRIC_HUMIDITY, ALERT_OP_BELOW,
+             atof(ENV_ALERT_HUMIDITY_LOW), DEFAULT_HUMIDITY_HYSTERESIS);
+}
+
+/**
+ * Load rules from NVS
+ * Returns true if a stored rule set was found
+ */
+static bool load_rules(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        return false;
+    }
+
+    rules_blob_t *blob = calloc(1, sizeof(rules_blob_t));
+    if (blob == NULL) {
+        nvs_close(nvs_handle);
+        return false;
+    }
+
+    size_t len = sizeof(rules_blob_t);
+    err = nvs_get_blob(nvs_handle, NVS_KEY_RULES, blob, &len);
+    nvs_close(nvs_handle);
+
+    bool loaded = false;
+    if (err == ESP_OK && len == sizeof(rules_blob_t) &&
+        blob->version == RULES_BLOB_VERSION && blob->count <= ALERT_ENGINE_MAX_RULES) {
+        // Metric indexes metric_names and the sample; a corrupt rule is dropped
+        rule_count = 0;
+        for (int i = 0; i < blob->count; i++) {
+            alert_rule_t *rule = &blob->rules[i];
+            rule->name[sizeof(rule->name) - 1] = '\0';
+            if ((unsigned)rule->metric >= ALERT_METRIC_COUNT ||
+                (rule->op != ALERT_OP_ABOVE && rule->op != ALERT_OP_BELOW)) {
+                ESP_LOGW(TAG, "[NVS] Dropping stored rule %d with invalid metric or op", i);
+                continue;
+            }
+            rules[rule_count++] = *rule;
+        }
+        loaded = true;
+    } else if (err == ESP_OK) {
+        ESP_LOGW(TAG, "[NVS] Stored rules have unexpected format, ignoring");
+    }
+
+    free(blob);
+    return loaded;
+}
+
+/**
+ * Save the current rules to NVS
+ */
+static esp_err_t save_rules(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to open NVS for writing: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    rules_blob_t *blob = calloc(1, sizeof(rules_blob_t));
+    if (blob == NULL) {
+        nvs_close(nvs_handle);
+        return ESP_ERR_NO_MEM;
+    }
+    blob->version = RULES_BLOB_VERSION;
+    blob->count = rule_count;
+    memcpy(blob->rules, rules, sizeof(rules));
+
+    err = nvs_set_blob(nvs_handle, NVS_KEY_RULES, blob, sizeof(rules_blob_t));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    free(blob);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to save rules: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+/**
+ * Queue an alert event for publishing at QoS 1
+ *
+ * Uses the outbox so the sensor task never blocks on the network. Events
+ * raised while disconnected are delivered after reconnect, unless the outage
+ * outlasts the outbox expiry (a day) or its 32 KB limit.
+ */
+static void publish_event(const alert_rule_t *rule, const char *state, float value, int64_t now_ms)
+{
+    if (mqtt_client == NULL) {
+        return;
+    }
+
+    char payload[256];
+    snprintf(payload, sizeof(payload),
+             "{\"device_id\":\"%s\",\"rule\":\"%s\",\"metric\":\"%s\",\"state\":\"%s\","
+             "\"value\":%.2f,\"threshold\":%.2f,\"uptime_ms\":%lld}",
+             CONFIG_DEVICE_ID, rule->name, metric_names[rule->metric], state,
+             value, rule->threshold, (long long)now_ms);
+
+    int msg_id = mqtt_client_manager_publish(alert_topic, payload, 0, 1, false);
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "[ALERT] Failed to queue %s event for %s", state, rule->name);
+    }
+}
+
+static bool condition_active(const alert_rule_t *rule, float value)
+{
+    return rule->op == ALERT_OP_ABOVE ? value > rule->threshold : value < rule->threshold;
+}
+
+static bool condition_cleared(const alert_rule_t *rule, float value)
+{
+    return rule->op == ALERT_OP_ABOVE ? value < rule->threshold - rule->hysteresis
+                                      : value > rule->threshold + rule->hysteresis;
+}
+
+/**
+ * Initialize alert engine
+ */
+void alert_engine_init(esp_mqtt_client_handle_t client)
+{
+    mqtt_client = client;
+    snprintf(alert_topic, sizeof(alert_topic), "greenhouse/alerts/device/%s", CONFIG_DEVICE_ID);
+
+    if (rules_mutex == NULL) {
+        rules_mutex = xSemaphoreCreateMutex();
+    }
+
+    if (load_rules()) {
+        ESP_LOGI(TAG, "[NVS] Loaded %d alert rule(s) from storage", rule_count);
+    } else {
+        load_default_rules();
+        ESP_LOGI(TAG, "[ALERT] Using %d default rule(s) from .env", rule_count);
+    }
+    memset(runtime, 0, sizeof(runtime));
+
+    for (int i = 0; i < rule_count; i++) {
+        ESP_LOGI(TAG, "[ALERT] %s: %s %s %.2f (hyst %.2f, for %lus)%s",
+                 rules[i].name, metric_names[rules[i].metric],
+                 rules[i].op == ALERT_OP_ABOVE ? ">" : "<",
+                 rules[i].threshold, rules[i].hysteresis,
+                 (unsigned long)rules[i].min_duration_s,
+                 rules[i].enabled ? "" : " [disabled]");
+    }
+    ESP_LOGI(TAG, "[ALERT] Publishing events to %s", alert_topic);
+}
+
+/**
+ * Evaluate rules against a sample
+ */
+void alert_engine_evaluate(const alert_sample_t *sample, int64_t now_ms)
+{
+    if (rules_mutex == NULL || sample == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(rules_mutex, portMAX_DELAY);
+
+    for (int i = 0; i < rule_count; i++) {
+        const alert_rule_t *rule = &rules[i];
+        rule_runtime_t *rt = &runtime[i];
+
+        if (!rule->enabled || !(sample->valid_mask & (1u << rule->metric))) {
+            continue;
+        }
+
+        float value = sample->values[rule->metric];
+
+        switch (rt->state) {
+        case RULE_STATE_NORMAL:
+            if (!condition_active(rule, value)) {
+                break;
+            }
+            rt->pending_since_ms = now_ms;
+            rt->state = RULE_STATE_PENDING;
+            // fall through - a zero duration fires on this sample
+        case RULE_STATE_PENDING:
+            if (!condition_active(rule, value)) {
+                rt->state = RULE_STATE_NORMAL;
+            } else if (now_ms - rt->pending_since_ms >= (int64_t)rule->min_duration_s * 1000) {
+                rt->state = RULE_STATE_FIRING;
+                ESP_LOGW(TAG, "[ALERT] %s firing (%s=%.2f)", rule->name,
+                         metric_names[rule->metric], value);
+                publish_event(rule, "firing", value, now_ms);
+                if (fired_cb != NULL) {
+                    fired_cb(rule->name);
+                }
+            }
+            break;
+
+        case RULE_STATE_FIRING:
+            if (condition_cleared(rule, value)) {
+                rt->state = RULE_STATE_NORMAL;
+                ESP_LOGI(TAG, "[ALERT] %s resolved (%s=%.2f)", rule->name,
+                         metric_names[rule->metric], value);
+                publish_event(rule, "resolved", value, now_ms);
+            }
+            break;
+        }
+    }
+
+    xSemaphoreGive(rules_mutex);
+}
+
+/**
+ * Set the rule-fired callback
+ */
+void alert_engine_set_fired_callback(alert_fired_cb_t cb)
+{
+    fired_cb = cb;
+}
+
+static bool parse_metric(const char *name, alert_metric_t *metric)
+{
+    for (int i = 0; i < ALERT_METRIC_COUNT; i++) {
+        if (strcmp(name, metric_names[i]) == 0) {
+            *metric = (alert_metric_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Parse one rule object; returns false if required fields are missing
+ */
+static bool parse_rule(const cJSON *item, alert_rule_t *rule)
+{
+    const cJSON *name = cJSON_GetObjectItem(item, "name");
+    const cJSON *metric = cJSON_GetObjectItem(item, "metric");
+    const cJSON *op = cJSON_GetObjectItem(item, "op");
+    const cJSON *threshold = cJSON_GetObjectItem(item, "threshold");
+
+    if (!cJSON_IsString(name) || !cJSON_IsString(metric) || !cJSON_IsNumber(threshold)) {
+        return false;
+    }
+
+    memset(rule, 0, sizeof(*rule));
+    strlcpy(rule->name, name->valuestring, sizeof(rule->name));
+    if (!parse_metric(metric->valuestring, &rule->metric)) {
+        ESP_LOGW(TAG, "[MQTT] Unknown metric '%s' in rule %s", metric->valuestring, rule->name);
+        return false;
+    }
+
+    rule->op = ALERT_OP_ABOVE;
+    if (cJSON_IsString(op) && strcmp(op->valuestring, "below") == 0) {
+        rule->op = ALERT_OP_BELOW;
+    }
+    rule->threshold = (float)threshold->valuedouble;
+
+    const cJSON *hysteresis = cJSON_GetObjectItem(item, "hysteresis");
+    rule->hysteresis = cJSON_IsNumber(hysteresis) ? (float)hysteresis->valuedouble : 0.0f;
+    if (rule->hysteresis < 0) {
+        rule->hysteresis = 0;
+    }
+
+    const cJSON *duration = cJSON_GetObjectItem(item, "min_duration_s");
+    rule->min_duration_s = (cJSON_IsNumber(duration) && duration->valueint > 0) ? duration->valueint : 0;
+
+    const cJSON *enabled = cJSON_GetObjectItem(item, "enabled");
+    rule->enabled = cJSON_IsBool(enabled) ? cJSON_IsTrue(enabled) : true;
+    return true;
+}
+
+/**
+ * Replace rule set from config
+ */
+bool alert_engine_apply_config(const cJSON *config)
+{
+    if (!cJSON_IsArray(config) || rules_mutex == NULL) {
+        ESP_LOGW(TAG, "[MQTT] \"alerts\" must be an array of rules");
+        return false;
+    }
+
+    alert_rule_t parsed[ALERT_ENGINE_MAX_RULES];
+    int parsed_count = 0;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, config) {
+        if (parsed_count >= ALERT_ENGINE_MAX_RULES) {
+            ESP_LOGW(TAG, "[MQTT] Too many rules, keeping first %d", ALERT_ENGINE_MAX_RULES);
+            break;
+        }
+        if (parse_rule(item, &parsed[parsed_count])) {
+            parsed_count++;
+        } else {
+            ESP_LOGW(TAG, "[MQTT] Skipping invalid alert rule");
+        }
+    }
+
+    // An empty array clears the rules; one with only invalid entries is a mistake
+    if (parsed_count == 0 && cJSON_GetArraySize(config) > 0) {
+        ESP_LOGE(TAG, "[MQTT] No valid rule in \"alerts\", keeping the current %d rule(s)", rule_count);
+        return false;
+    }
+
+    xSemaphoreTake(rules_mutex, portMAX_DELAY);
+    memcpy(rules, parsed, sizeof(alert_rule_t) * parsed_count);
+    rule_count = parsed_count;
+    memset(runtime, 0, sizeof(runtime));
+    esp_err_t err = save_rules();
+    xSemaphoreGive(rules_mutex);
+
+    ESP_LOGI(TAG, "[MQTT] Applied %d alert rule(s)%s", parsed_count,
+             err == ESP_OK ? ", saved to NVS" : "");
+    return true;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mqtt_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ALERT_ENGINE_MAX_RULES      8
+#define ALERT_RULE_NAME_LEN         24
+
+/**
+ * @brief Metrics that alert rules can be evaluated against
+ */
+typedef enum {
+    ALERT_METRIC_TEMPERATURE = 0,
+    ALERT_METRIC_HUMIDITY,
+    ALERT_METRIC_PRESSURE,
+    ALERT_METRIC_GAS_RESISTANCE,
+    ALERT_METRIC_SOIL_MOISTURE,
+    ALERT_METRIC_VPD,               // kPa
+    ALERT_METRIC_DEW_POINT,         // °C
+    ALERT_METRIC_IAQ,               // 0-500 index
+    ALERT_METRIC_COUNT
+} alert_metric_t;
+
+/**
+ * @brief Direction of a threshold comparison
+ */
+typedef enum {
+    ALERT_OP_ABOVE = 0,     // Fires when value > threshold, clears below threshold - hysteresis
+    ALERT_OP_BELOW,         // Fires when value < threshold, clears above threshold + hysteresis
+} alert_op_t;
+
+/**
+ * @brief A single threshold rule
+ */
+typedef struct {
+    char name[ALERT_RULE_NAME_LEN];
+    alert_metric_t metric;
+    alert_op_t op;
+    float threshold;
+    float hysteresis;           // Dead band applied when clearing
+    uint32_t min_duration_s;    // Condition must hold this long before firing
+    bool enabled;
+} alert_rule_t;
+
+/**
+ * @brief One sample of all metrics, as seen by the rule engine
+ *
+ * Only metrics whose bit is set in valid_mask are evaluated; rules on
+ * missing metrics keep their current state.
+ */
+typedef struct {
+    float values[ALERT_METRIC_COUNT];
+    uint32_t valid_mask;
+} alert_sample_t;
+
+/**
+ * @brief Mark a metric as present in a sample
+ */
+static inline void alert_sample_set(alert_sample_t *sample, alert_metric_t metric, float value)
+{
+    sample->values[metric] = value;
+    sample->valid_mask |= (1u << metric);
+}
+
+/**
+ * @brief Called when a rule starts firing
+ *
+ * Runs on the task calling alert_engine_evaluate() with the rule set
+ * locked: keep it short and do not call back into the engine.
+ */
+typedef void (*alert_fired_cb_t)(const char *rule_name);
+
+/**
+ * @brief Initialize the alert engine
+ *
+ * Loads rules from NVS, falling back to the ALERT_* thresholds from .env.
+ * Alert events are published to greenhouse/alerts/device/{device_id}.
+ *
+ * @param client MQTT client handle from mqtt_client_manager
+ */
+void alert_engine_init(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Evaluate all rules against a new sample
+ *
+ * Called from the sensor task on every reading. Firing and resolved
+ * transitions are queued for publishing at QoS 1 immediately.
+ *
+ * @param sample  Latest readings
+ * @param now_ms  Monotonic time of the sample in milliseconds
+ */
+void alert_engine_evaluate(const alert_sample_t *sample, int64_t now_ms);
+
+/**
+ * @brief Replace the rule set from a config message
+ *
+ * Expects the "alerts" array of a config document, e.g.
+ * [{"name":"temp_high","metric":"temperature","op":"above","threshold":28,
+ *   "hysteresis":0.5,"min_duration_s":120}]
+ * The new rules are persisted to NVS and all rule state is reset. Invalid
+ * entries are skipped; if none is valid the current rules are kept ([]
+ * clears them).
+ *
+ * @param rules cJSON array of rule objects
+ * @return true if the rule set was replaced
+ */
+bool alert_engine_apply_config(const struct cJSON *rules);
+
+/**
+ * @brief Register a callback for rules that start firing (NULL to remove)
+ */
+void alert_engine_set_fired_callback(alert_fired_cb_t cb);
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,22 +4,44 @@
  * Dual Licensed under MIT and Apache 2.0
  */
 
+#include <math.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <sys/time.h>
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "esp_adc/adc_oneshot.h"
-#include "esp_adc/adc_cali.h"
-#include "esp_adc/adc_cali_scheme.h"
 #include <bme680.h>
+#if CONFIG_CLIMATE_I2C_MUX
+#include <tca9548.h>
+#endif
 #include <cJSON.h>
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "climate_monitor.h"
+#include "psychrometrics.h"
+#include "iaq.h"
+#include "sensor_filter.h"
+#include "pipeline/pipeline.h"
+#include "pipeline/pipeline_stages.h"
+#if CONFIG_CLIMATE_LIGHT_SENSOR
+#include "light_sensor.h"
+#endif
+#if CONFIG_CLIMATE_FLIGHT_RECORDER
+#include "flight_recorder.h"
+#endif
+#if CONFIG_CLIMATE_HISTORY
+#include "history.h"
+#endif
+#include "soil_moisture/soil_moisture.h"
+#include "alert_engine/alert_engine.h"
 #include "mqtt_client_manager.h"
+#include "time_sync.h"
+#include "rpc/rpc_server.h"
 #include "env_config.h"
 
 #define BME680_I2C_ADDR_1       0x77
@@ -27,321 +49,284 @@
 #define BME680_I2C_SCL_PIN      5
 #define BME680_I2C_FREQ_HZ     100000
 
-// LM393 Soil Moisture Sensor (Analog Output)
-// GPIO mapping is chip-specific due to different ADC channel layouts
-#if CONFIG_IDF_TARGET_ESP32C3
-    // ESP32-C3: ADC1_CHANNEL_1 = GPIO 1
-    #define SOIL_MOISTURE_ADC_CHANNEL   ADC_CHANNEL_1
-    #define SOIL_MOISTURE_GPIO_PIN      1
-#elif CONFIG_IDF_TARGET_ESP32S3
-    // ESP32-S3: ADC1_CHANNEL_0 = GPIO 1 (same physical pin!)
-    #define SOIL_MOISTURE_ADC_CHANNEL   ADC_CHANNEL_0
-    #define SOIL_MOISTURE_GPIO_PIN      1
+// Oversampling and on-chip IIR (menuconfig -> Climate Monitor)
+#if CONFIG_CLIMATE_BME680_OSR_1X
+    #define BME680_OSR              BME680_OSR_1X
+#elif CONFIG_CLIMATE_BME680_OSR_2X
+    #define BME680_OSR              BME680_OSR_2X
+#elif CONFIG_CLIMATE_BME680_OSR_8X
+    #define BME680_OSR              BME680_OSR_8X
+#elif CONFIG_CLIMATE_BME680_OSR_16X
+    #define BME680_OSR              BME680_OSR_16X
+#else
+    #define BME680_OSR              BME680_OSR_4X
+#endif
+
+#if CONFIG_CLIMATE_BME680_IIR_0
+    #define BME680_IIR              BME680_IIR_SIZE_0
+#elif CONFIG_CLIMATE_BME680_IIR_15
+    #define BME680_IIR              BME680_IIR_SIZE_15
+#elif CONFIG_CLIMATE_BME680_IIR_127
+    #define BME680_IIR              BME680_IIR_SIZE_127
 #else
-    #error "Unsupported target for soil moisture sensor"
+    #define BME680_IIR              BME680_IIR_SIZE_3
 #endif
 
-#define SOIL_MOISTURE_ADC_ATTEN     ADC_ATTEN_DB_12  // 0-3100mV range
-#define SOIL_MOISTURE_DRY_DEFAULT   2800  // Default ADC value when completely dry
-#define SOIL_MOISTURE_WET_DEFAULT   1200  // Default ADC value when fully wet
+// Alpha-beta filter tracking indices (tuned with scripts/evaluate_sensor_filter.py).
+// Against OSR 16X + IIR 127 the error against the true signal drops (T 0.078 ->
+// 0.005 °C, P 0.75 -> 0.40 Pa) because the IIR's 2 min lag is gone, but noise
+// on a flat signal rises (T 0 -> 0.003 °C, P 0 -> 0.2-0.3 Pa): the long IIR held
+// the quantised reading still. Both stay below one driver step (0.01 °C, 1 Pa).
+// Humidity has no on-chip IIR to remove, so at 4X it ends up with the same
+// noise (0.020 %RH) and slightly more tracking error (0.020 -> 0.024 %RH).
+#define FILTER_LAMBDA_TEMPERATURE   0.02f
+#define FILTER_LAMBDA_HUMIDITY      0.05f
+#define FILTER_LAMBDA_PRESSURE      0.001f
 
-static const char *TAG = "climate_monitor";
+#define SAMPLE_PERIOD_MS            1000
 
-// Global state
-static volatile bool sensor_running = false;
-static TaskHandle_t sensor_task_handle = NULL;
-static esp_mqtt_client_handle_t mqtt_client = NULL;
-static bool sensor_initialized = false;
-bme680_t sensor;  // BME680 sensor descriptor
+// Burst mode: fast T/RH/P profile (1X, no IIR, heater off), batched once a second
+#define BURST_TOPIC                 "sensor/climate/burst"
+#define BURST_MAX_HZ                10
+#define BURST_MAX_S                 600         // Per request
+#define BURST_BUDGET_S              1800        // Per rolling hour, so a forgotten burst can't hog the uplink
+#define BURST_BUDGET_WINDOW_MS      (60 * 60 * 1000)
+#define BURST_SPANS                 16          // Bursts remembered for the budget
 
-// ADC for soil moisture
-static adc_oneshot_unit_handle_t adc_handle = NULL;
-static adc_cali_handle_t adc_cali_handle = NULL;
+// Log per-stage pipeline cost about once an hour
+#define PIPELINE_STATS_INTERVAL     3600
 
-// NVS storage for calibration
-#define NVS_NAMESPACE "soil_cal"
-#define NVS_KEY_DRY_VALUE "dry_value"
-#define NVS_KEY_WET_VALUE "wet_value"
+static const char *TAG = "climate_monitor";
 
-// Soil moisture calibration values (can be updated via MQTT and persisted to NVS)
-static int soil_moisture_dry_value = SOIL_MOISTURE_DRY_DEFAULT;
-static int soil_moisture_wet_value = SOIL_MOISTURE_WET_DEFAULT;
+// Sensors behind the optional TCA9548A; without a mux there is one on the root bus
+#if CONFIG_CLIMATE_I2C_MUX
+    #define CLIMATE_MUX_ADDR        CONFIG_CLIMATE_I2C_MUX_ADDR
+    #define CLIMATE_MUX_CHANNELS    CONFIG_CLIMATE_I2C_MUX_CHANNELS
+    #define CLIMATE_SENSOR_MAX      8
+#else
+    #define CLIMATE_SENSOR_MAX      1
+#endif
+#define NO_MUX_CHANNEL              0xFF
 
-// Forward declarations
-static void sensor_task(void *pvParameters);
-static void bme680_init(void);
-static void bme680_cleanup(void);
-static void bme680_read_and_publish(void);
-static void soil_moisture_init(void);
-static int soil_moisture_read_percent(void);
+#define MAX_CONSECUTIVE_ERRORS      3
+#define MAX_REINIT_ATTEMPTS         5
+#define REINIT_DELAY_MS             3000
+#define REINIT_BACKOFF_MS           10000
 
 /**
- * Load soil moisture calibration values from NVS
- * Returns true if values were loaded, false if defaults are used
+ * One BME680 and its per-channel state
  */
-static bool load_soil_calibration(void)
-{
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
+typedef struct {
+    bme680_t dev;
+    uint8_t channel;                // Mux channel, NO_MUX_CHANNEL on the root bus
+    bool initialized;
+    bool triggered;                 // Measurement started this cycle
+    bool valid;                     // values holds this cycle's reading
+    int consecutive_errors;
+    int reinit_attempts;
+    int64_t retry_at_ms;
+    uint32_t duration;              // Measurement duration in ticks
+    float ambient_temperature;      // Fed back for heater compensation
+    bme680_values_float_t raw;      // This cycle's reading
+    bme680_values_float_t values;   // Filtered, updated at the 1 Hz pipeline rate
+#if CONFIG_CLIMATE_SENSOR_FILTER
+    // Per-channel noise filters, in 0.01 °C / 0.01 %RH / Pa
+    sensor_filter_t filter_temperature;
+    sensor_filter_t filter_humidity;
+    sensor_filter_t filter_pressure;
+#endif
+} climate_sensor_t;
 
-    // Open NVS
-    err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "[NVS] No calibration found, using defaults (dry=%d, wet=%d)", 
-                 SOIL_MOISTURE_DRY_DEFAULT, SOIL_MOISTURE_WET_DEFAULT);
-        soil_moisture_dry_value = SOIL_MOISTURE_DRY_DEFAULT;
-        soil_moisture_wet_value = SOIL_MOISTURE_WET_DEFAULT;
-        return false;
-    }
+// Global state
+static volatile bool sensor_running = false;
+static TaskHandle_t sensor_task_handle = NULL;
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+static climate_sensor_t sensors[CLIMATE_SENSOR_MAX];
+static int sensor_count = 0;
+#if CONFIG_CLIMATE_I2C_MUX
+static i2c_dev_t mux;
+#endif
 
-    // Read dry value
-    int32_t dry_val = SOIL_MOISTURE_DRY_DEFAULT;
-    err = nvs_get_i32(nvs_handle, NVS_KEY_DRY_VALUE, &dry_val);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "[NVS] Failed to read dry_value, using default");
-        dry_val = SOIL_MOISTURE_DRY_DEFAULT;
-    }
+// New-sample callback for co-located modules
+static climate_reading_cb_t reading_cb = NULL;
+static void *reading_cb_ctx = NULL;
+static portMUX_TYPE reading_cb_lock = portMUX_INITIALIZER_UNLOCKED;
 
-    // Read wet value
-    int32_t wet_val = SOIL_MOISTURE_WET_DEFAULT;
-    err = nvs_get_i32(nvs_handle, NVS_KEY_WET_VALUE, &wet_val);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "[NVS] Failed to read wet_value, using default");
-        wet_val = SOIL_MOISTURE_WET_DEFAULT;
-    }
+// Burst request, written by command/RPC handlers
+static int burst_hz = 0;                    // 0 when off
+static int64_t burst_until_ms = 0;
+static struct {
+    int64_t start_ms;
+    int64_t end_ms;                         // 0 if free
+} burst_spans[BURST_SPANS];                 // Granted bursts, for the rolling budget
+static int burst_span = -1;                 // Span of the current burst
+static portMUX_TYPE burst_lock = portMUX_INITIALIZER_UNLOCKED;
 
-    nvs_close(nvs_handle);
+// Mux channel of the sensor feeding the pipeline, owned by the sensor task
+static uint8_t primary_channel = NO_MUX_CHANNEL;
 
-    soil_moisture_dry_value = dry_val;
-    soil_moisture_wet_value = wet_val;
+// Burst in effect and its pending batch, owned by the sensor task
+static int burst_active_hz = 0;
+static struct {
+    int64_t t0_ms;
+    int count;
+    int16_t temperature[BURST_MAX_HZ];      // 0.01 °C
+    int16_t humidity[BURST_MAX_HZ];         // 0.01 %RH
+    int32_t pressure[BURST_MAX_HZ];         // Pa
+} burst_batch;
 
-    ESP_LOGI(TAG, "[NVS] Loaded calibration from storage (dry=%d, wet=%d)", 
-             soil_moisture_dry_value, soil_moisture_wet_value);
-    return true;
-}
+// Forward declarations
+static void sensor_task(void *pvParameters);
+static void bme680_init(climate_sensor_t *s);
+static void bme680_cleanup(climate_sensor_t *s);
+static void bme680_read_and_publish(void);
 
 /**
- * Save soil moisture calibration values to NVS
+ * Route the bus to a sensor's mux channel (no-op without a mux)
  */
-static esp_err_t save_soil_calibration(void)
+static esp_err_t select_sensor(const climate_sensor_t *s)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
-
-    // Open NVS in read-write mode
-    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "[NVS] Failed to open NVS for writing: %s", esp_err_to_name(err));
-        return err;
-    }
-
-    // Write dry value
-    err = nvs_set_i32(nvs_handle, NVS_KEY_DRY_VALUE, soil_moisture_dry_value);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "[NVS] Failed to write dry_value: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
-    }
-
-    // Write wet value
-    err = nvs_set_i32(nvs_handle, NVS_KEY_WET_VALUE, soil_moisture_wet_value);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "[NVS] Failed to write wet_value: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
-    }
-
-    // Commit changes
-    err = nvs_commit(nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "[NVS] Failed to commit: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
-    }
-
-    nvs_close(nvs_handle);
-
-    ESP_LOGI(TAG, "[NVS] Saved calibration to storage (dry=%d, wet=%d)", 
-             soil_moisture_dry_value, soil_moisture_wet_value);
+#if CONFIG_CLIMATE_I2C_MUX
+    return tca9548_set_channels(&mux, BIT(s->channel));
+#else
     return ESP_OK;
+#endif
 }
 
 /**
- * Initialize LM393 soil moisture sensor (Analog mode)
+ * Build the sensor table from the mux channel mask
  */
-static void soil_moisture_init(void)
+static void sensors_setup(void)
 {
-    ESP_LOGI(TAG, "[LM393] Initializing soil moisture sensor in ANALOG mode");
-    ESP_LOGI(TAG, "[LM393] Connect sensor A0 pin to GPIO %d", SOIL_MOISTURE_GPIO_PIN);
-    
-    // Configure ADC
-    adc_oneshot_unit_init_cfg_t init_config = {
-        .unit_id = ADC_UNIT_1,
-    };
-    
-    esp_err_t err = adc_oneshot_new_unit(&init_config, &adc_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "[LM393] Failed to initialize ADC unit: %s", esp_err_to_name(err));
-        return;
-    }
-    
-    // Configure ADC channel
-    adc_oneshot_chan_cfg_t config = {
-        .bitwidth = ADC_BITWIDTH_DEFAULT,
-        .atten = SOIL_MOISTURE_ADC_ATTEN,
-    };
-    
-    err = adc_oneshot_config_channel(adc_handle, SOIL_MOISTURE_ADC_CHANNEL, &config);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "[LM393] Failed to configure ADC channel: %s", esp_err_to_name(err));
-        return;
+    memset(sensors, 0, sizeof(sensors));
+    sensor_count = 0;
+
+#if CONFIG_CLIMATE_I2C_MUX
+    memset(&mux, 0, sizeof(mux));
+    ESP_ERROR_CHECK(tca9548_init_desc(&mux, CLIMATE_MUX_ADDR, I2C_NUM_0, BME680_I2C_SDA_PIN, BME680_I2C_SCL_PIN));
+    mux.cfg.sda_pullup_en = 1;
+    mux.cfg.scl_pullup_en = 1;
+    for (int ch = 0; ch < 8; ch++) {
+        if (CLIMATE_MUX_CHANNELS & BIT(ch)) {
+            sensors[sensor_count++].channel = ch;
+        }
     }
-    
-    // Set up ADC calibration for voltage reading (chip-specific)
-#if CONFIG_IDF_TARGET_ESP32C3
-    adc_cali_curve_fitting_config_t cali_config = {
-        .unit_id = ADC_UNIT_1,
-        .atten = SOIL_MOISTURE_ADC_ATTEN,
-        .bitwidth = ADC_BITWIDTH_DEFAULT,
-    };
-    
-    err = adc_cali_create_scheme_curve_fitting(&cali_config, &adc_cali_handle);
-#elif CONFIG_IDF_TARGET_ESP32S3
-    adc_cali_line_fitting_config_t cali_config = {
-        .unit_id = ADC_UNIT_1,
-        .atten = SOIL_MOISTURE_ADC_ATTEN,
-        .bitwidth = ADC_BITWIDTH_DEFAULT,
-    };
-    
-    err = adc_cali_create_scheme_line_fitting(&cali_config, &adc_cali_handle);
+    ESP_LOGI(TAG, "[MUX] TCA9548A at 0x%02x, %d BME680 channel(s)", CLIMATE_MUX_ADDR, sensor_count);
 #else
-    #error "Unsupported target for ADC calibration"
+    sensors[sensor_count++].channel = NO_MUX_CHANNEL;
+#endif
+
+    for (int i = 0; i < sensor_count; i++) {
+        sensors[i].ambient_temperature = 10;
+#if CONFIG_CLIMATE_SENSOR_FILTER
+        sensor_filter_init(&sensors[i].filter_temperature, FILTER_LAMBDA_TEMPERATURE);
+        sensor_filter_init(&sensors[i].filter_humidity, FILTER_LAMBDA_HUMIDITY);
+        sensor_filter_init(&sensors[i].filter_pressure, FILTER_LAMBDA_PRESSURE);
 #endif
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "[LM393] ADC calibration failed, will use raw values: %s", esp_err_to_name(err));
-        adc_cali_handle = NULL;
     }
-    
-    // Load calibration from NVS (or use defaults)
-    load_soil_calibration();
-    
-    ESP_LOGI(TAG, "[LM393] Soil moisture sensor initialized successfully");
-    ESP_LOGI(TAG, "[LM393] Calibration: Dry=%d, Wet=%d", 
-             soil_moisture_dry_value, soil_moisture_wet_value);
 }
 
 /**
- * Read soil moisture sensor as percentage
- * @return Moisture percentage (0-100): 0=dry, 100=wet
+ * Apply the measurement profile; the sensor must be selected
  */
-static int soil_moisture_read_percent(void)
+static void bme680_configure(climate_sensor_t *s)
 {
-    if (adc_handle == NULL) {
-        ESP_LOGW(TAG, "[LM393] ADC not initialized");
-        return -1;
-    }
-    
-    int adc_raw = 0;
-    esp_err_t err = adc_oneshot_read(adc_handle, SOIL_MOISTURE_ADC_CHANNEL, &adc_raw);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "[LM393] Failed to read ADC: %s", esp_err_to_name(err));
-        return -1;
-    }
-    
-    // Convert to voltage if calibration available
-    int voltage = 0;
-    if (adc_cali_handle != NULL) {
-        adc_cali_raw_to_voltage(adc_cali_handle, adc_raw, &voltage);
-        ESP_LOGD(TAG, "[LM393] ADC Raw: %d, Voltage: %d mV", adc_raw, voltage);
-    }
-    
-    // Map ADC value to percentage (higher ADC = drier soil, so we invert)
-    // Clamp values to calibration range
-    if (adc_raw >= soil_moisture_dry_value) {
-        return 0;  // Completely dry
-    }
-    if (adc_raw <= soil_moisture_wet_value) {
-        return 100;  // Fully wet
+    if (burst_active_hz > 0) {
+        // Shortest conversion and no on-chip smoothing, so fast swings stay visible
+        bme680_set_oversampling_rates(&s->dev, BME680_OSR_1X, BME680_OSR_1X, BME680_OSR_1X);
+        bme680_set_filter_size(&s->dev, BME680_IIR_SIZE_0);
+        bme680_use_heater_profile(&s->dev, BME680_HEATER_NOT_USED);
+    } else {
+        // Configure oversampling and on-chip IIR from menuconfig
+        // Noise is reduced further by the alpha-beta filter, so a low OSR keeps the
+        // conversion short without raising the published noise floor
+        bme680_set_oversampling_rates(&s->dev, BME680_OSR, BME680_OSR, BME680_OSR);
+        bme680_set_filter_size(&s->dev, BME680_IIR);
+        bme680_set_heater_profile(&s->dev, 0, 200, 100);
+        bme680_use_heater_profile(&s->dev, 0);
     }
-    
-    // Linear interpolation: higher ADC value = drier soil = lower percentage
-    int moisture_percent = 100 - ((adc_raw - soil_moisture_wet_value) * 100 / 
-                                   (soil_moisture_dry_value - soil_moisture_wet_value));
-    
-    return moisture_percent;
+    bme680_get_measurement_duration(&s->dev, &s->duration);
 }
 
 /**
  * Initialize BME680 sensor
  */
-static void bme680_init(void)
+static void bme680_init(climate_sensor_t *s)
 {
     ESP_LOGI(TAG, "[BME680] Initializing...");
     ESP_LOGI(TAG, "[BME680] Using I2C pins: SDA=GPIO%d, SCL=GPIO%d", BME680_I2C_SDA_PIN, BME680_I2C_SCL_PIN);
+    if (s->channel != NO_MUX_CHANNEL) {
+        ESP_LOGI(TAG, "[BME680] Behind mux channel %d", s->channel);
+    }
     ESP_LOGW(TAG, "[BME680] ⚠️  Check your wiring:");
     ESP_LOGW(TAG, "[BME680]    BME680 VCC → ESP32-C3 3.3V");
     ESP_LOGW(TAG, "[BME680]    BME680 GND → ESP32-C3 GND");
     ESP_LOGW(TAG, "[BME680]    BME680 SDA → ESP32-C3 GPIO %d", BME680_I2C_SDA_PIN);
     ESP_LOGW(TAG, "[BME680]    BME680 SCL → ESP32-C3 GPIO %d", BME680_I2C_SCL_PIN);
     
-    memset(&sensor, 0, sizeof(bme680_t));
+    memset(&s->dev, 0, sizeof(bme680_t));
     int i2c_master_port = I2C_NUM_0;
     
     // Try address 0x77 first
     ESP_LOGI(TAG, "[BME680] Trying address 0x77...");
-    esp_err_t err = bme680_init_desc(&sensor, BME680_I2C_ADDR_1, i2c_master_port, BME680_I2C_SDA_PIN, BME680_I2C_SCL_PIN);
+    esp_err_t err = bme680_init_desc(&s->dev, BME680_I2C_ADDR_1, i2c_master_port, BME680_I2C_SDA_PIN, BME680_I2C_SCL_PIN);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "[BME680] Failed to init descriptor at 0x77: %s", esp_err_to_name(err));
         
         // Try address 0x76
         ESP_LOGI(TAG, "[BME680] Trying address 0x76...");
-        memset(&sensor, 0, sizeof(bme680_t));
-        err = bme680_init_desc(&sensor, 0x76, i2c_master_port, BME680_I2C_SDA_PIN, BME680_I2C_SCL_PIN);
+        memset(&s->dev, 0, sizeof(bme680_t));
+        err = bme680_init_desc(&s->dev, 0x76, i2c_master_port, BME680_I2C_SDA_PIN, BME680_I2C_SCL_PIN);
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "[BME680] Failed to init descriptor at 0x76: %s", esp_err_to_name(err));
             return;
         }
     }
     
-    sensor.i2c_dev.cfg.scl_pullup_en = 1; // Enable internal pull-up for SCL
-    sensor.i2c_dev.cfg.sda_pullup_en = 1; // Enable internal pull-up for SDA
-    sensor.i2c_dev.cfg.master.clk_speed = BME680_I2C_FREQ_HZ;
+    s->dev.i2c_dev.cfg.scl_pullup_en = 1; // Enable internal pull-up for SCL
+    s->dev.i2c_dev.cfg.sda_pullup_en = 1; // Enable internal pull-up for SDA
+    s->dev.i2c_dev.cfg.master.clk_speed = BME680_I2C_FREQ_HZ;
     
     // Perform a soft reset to ensure sensor is in a known state
-    err = bme680_init_sensor(&sensor);
+    err = select_sensor(s);
+    if (err == ESP_OK) {
+        err = bme680_init_sensor(&s->dev);
+    }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "[BME680] Failed to init sensor: %s", esp_err_to_name(err));
         // Clean up the descriptor
-        i2c_dev_delete_mutex(&sensor.i2c_dev);
+        i2c_dev_delete_mutex(&s->dev.i2c_dev);
         return;
     }
     
     // Wait a bit for sensor to stabilize after reset
     vTaskDelay(pdMS_TO_TICKS(100));
     
-    // Configure sensor settings for maximum precision
-    // OSR_16X = 16× oversampling (maximum) for temperature, humidity, and pressure
-    // IIR_SIZE_127 = heaviest filtering for temporal smoothing
-    // Expected precision: ±0.25°C temp, ±1.5% RH, ±0.3 hPa pressure
-    bme680_set_oversampling_rates(&sensor, BME680_OSR_16X, BME680_OSR_16X, BME680_OSR_16X);
-    bme680_set_filter_size(&sensor, BME680_IIR_SIZE_127);
-    bme680_set_heater_profile(&sensor, 0, 200, 100);
-    bme680_use_heater_profile(&sensor, 0);
+    bme680_configure(s);
+    
+#if CONFIG_CLIMATE_SENSOR_FILTER
+    // Restart filters so no estimate is extrapolated across the re-init gap
+    sensor_filter_reset(&s->filter_temperature);
+    sensor_filter_reset(&s->filter_humidity);
+    sensor_filter_reset(&s->filter_pressure);
+#endif
     
-    sensor_initialized = true;
-    ESP_LOGI(TAG, "[BME680] Initialization successful (OSR_16X + IIR_127)");
+    s->initialized = true;
+    s->consecutive_errors = 0;
+    s->reinit_attempts = 0;
+    ESP_LOGI(TAG, "[BME680] Initialization successful (OSR %d, IIR %d)", BME680_OSR, BME680_IIR);
 }
 
 /**
  * Cleanup BME680 sensor
  */
-static void bme680_cleanup(void)
+static void bme680_cleanup(climate_sensor_t *s)
 {
     ESP_LOGI(TAG, "[BME680] Cleaning up I2C connection...");
     
     // Always try to delete the mutex if it exists
-    if (sensor.i2c_dev.mutex != NULL) {
-        esp_err_t err = i2c_dev_delete_mutex(&sensor.i2c_dev);
+    if (s->dev.i2c_dev.mutex != NULL) {
+        esp_err_t err = i2c_dev_delete_mutex(&s->dev.i2c_dev);
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "[BME680] Failed to cleanup I2C device: %s", esp_err_to_name(err));
         } else {
@@ -349,134 +334,617 @@ static void bme680_cleanup(void)
         }
     }
     
-    sensor_initialized = false;
-    memset(&sensor, 0, sizeof(bme680_t));
+    s->initialized = false;
+    memset(&s->dev, 0, sizeof(bme680_t));
 }
 
 /**
- * Read sensor and publish to MQTT if connected
+ * Count a failed transfer; reinitialize the sensor after repeated errors
  */
-static void bme680_read_and_publish(void)
+static void sensor_error(climate_sensor_t *s, const char *what, esp_err_t err)
 {
-    // Get measurement duration
-    uint32_t duration;
-    bme680_get_measurement_duration(&sensor, &duration);
-
-    TickType_t last_wakeup = xTaskGetTickCount();
-    float temperature = 10;
-    bme680_values_float_t values;
-    int consecutive_errors = 0;
-    const int MAX_CONSECUTIVE_ERRORS = 3;
-    int reinit_attempts = 0;
-    const int MAX_REINIT_ATTEMPTS = 5;
+    ESP_LOGW(TAG, "Failed to %s: %s", what, esp_err_to_name(err));
+    s->consecutive_errors++;
+#if CONFIG_CLIMATE_FLIGHT_RECORDER
+    flight_recorder_record_error(s->channel, esp_timer_get_time() / 1000);
+#endif
     
-    ESP_LOGI(TAG, "Starting sensor reading loop");
+    if (s->consecutive_errors >= MAX_CONSECUTIVE_ERRORS) {
+        ESP_LOGE(TAG, "Too many consecutive errors (%d), reinitializing sensor...", s->consecutive_errors);
+        bme680_cleanup(s);
+        s->consecutive_errors = 0;
+    }
+}
+
+/**
+ * Retry sensors that are down, each on its own backoff so one dead channel
+ * does not stall the others
+ */
+static int sensors_recover(int64_t now_ms)
+{
+    int ready = 0;
     
-    while (sensor_running) {
-        // Check if sensor is properly initialized
-        if (!sensor_initialized) {
+    for (int i = 0; i < sensor_count; i++) {
+        climate_sensor_t *s = &sensors[i];
+        if (!s->initialized && now_ms >= s->retry_at_ms) {
             ESP_LOGW(TAG, "Sensor not initialized, attempting initialization...");
-            bme680_cleanup(); // Clean up any partial state
-            vTaskDelay(pdMS_TO_TICKS(2000));
-            bme680_init();
+            bme680_cleanup(s); // Clean up any partial state
+            bme680_init(s);
             
-            if (!sensor_initialized) {
-                reinit_attempts++;
-                if (reinit_attempts >= MAX_REINIT_ATTEMPTS) {
-                    ESP_LOGE(TAG, "Failed to initialize sensor after %d attempts, waiting longer...", reinit_attempts);
-                    vTaskDelay(pdMS_TO_TICKS(10000));
-                    reinit_attempts = 0;
+            if (!s->initialized) {
+                s->reinit_attempts++;
+                if (s->reinit_attempts >= MAX_REINIT_ATTEMPTS) {
+                    ESP_LOGE(TAG, "Failed to initialize sensor after %d attempts, waiting longer...", s->reinit_attempts);
+                    s->retry_at_ms = now_ms + REINIT_BACKOFF_MS;
+                    s->reinit_attempts = 0;
                 } else {
-                    vTaskDelay(pdMS_TO_TICKS(3000));
+                    s->retry_at_ms = now_ms + REINIT_DELAY_MS;
                 }
-                continue;
+            } else {
+                ESP_LOGI(TAG, "Sensor initialized successfully, resuming measurements");
             }
-            
-            consecutive_errors = 0;
-            reinit_attempts = 0;
-            bme680_get_measurement_duration(&sensor, &duration);
-            ESP_LOGI(TAG, "Sensor initialized successfully, resuming measurements");
+        }
+        if (s->initialized) {
+            ready++;
+        }
+    }
+    
+    return ready;
+}
+
+/**
+ * Start a forced measurement on every sensor back-to-back, wait once for the
+ * slowest, then collect all results so conversions run in parallel
+ *
+ * @param filter_tick Feed the filters and the flight recorder: every reading
+ *                    normally, only the 1 Hz pipeline tick during a burst
+ */
+static void sensors_measure(bool filter_tick)
+{
+    uint32_t duration = 0;
+    
+    for (int i = 0; i < sensor_count; i++) {
+        climate_sensor_t *s = &sensors[i];
+        s->triggered = false;
+        s->valid = false;
+        if (!s->initialized) {
+            continue;
         }
         
-        bme680_set_ambient_temperature(&sensor, temperature);
+        esp_err_t err = select_sensor(s);
+        if (err == ESP_OK) {
+            bme680_set_ambient_temperature(&s->dev, s->ambient_temperature);
+            err = bme680_force_measurement(&s->dev);
+        }
+        if (err != ESP_OK) {
+            sensor_error(s, "force measurement", err);
+            continue;
+        }
+        s->triggered = true;
+        if (s->duration > duration) {
+            duration = s->duration;
+        }
+    }
+    
+    // Wait for measurement
+    vTaskDelay(duration);
+    
+    // Get results
+    for (int i = 0; i < sensor_count; i++) {
+        climate_sensor_t *s = &sensors[i];
+        if (!s->triggered) {
+            continue;
+        }
         
-        // Trigger measurement
-        esp_err_t err = bme680_force_measurement(&sensor);
+        esp_err_t err = select_sensor(s);
+        if (err == ESP_OK) {
+            err = bme680_get_results_float(&s->dev, &s->raw);
+        }
         if (err != ESP_OK) {
-            ESP_LOGW(TAG, "Failed to force measurement: %s", esp_err_to_name(err));
-            consecutive_errors++;
-            
-            if (consecutive_errors >= MAX_CONSECUTIVE_ERRORS) {
-                ESP_LOGE(TAG, "Too many consecutive errors (%d), reinitializing sensor...", consecutive_errors);
-                bme680_cleanup();
-                consecutive_errors = 0;
-            } else {
-                vTaskDelay(pdMS_TO_TICKS(500));
-            }
+            sensor_error(s, "get results", err);
+            continue;
+        }
+        
+        // Success - reset error counters
+        s->consecutive_errors = 0;
+        s->valid = true;
+        
+        // Use temperature for next measurement
+        s->ambient_temperature = s->raw.temperature;
+        
+        if (!filter_tick) {
+            // Burst sample between pipeline ticks: only the batch sees it
             continue;
         }
+        
+#if CONFIG_CLIMATE_FLIGHT_RECORDER
+        flight_recorder_record(s->channel, &s->raw, burst_active_hz == 0, esp_timer_get_time() / 1000);
+#endif
+        if (burst_active_hz == 0) {
+            printf("BME680 Sensor: %.4f °C, %.4f %%, %.4f hPa, %.4f Ohm\n",
+                   s->raw.temperature, s->raw.humidity, s->raw.pressure, s->raw.gas_resistance);
+        }
+        
+        s->values = s->raw;
+#if CONFIG_CLIMATE_SENSOR_FILTER
+        // Smooth T/RH/P at 1 Hz, bursts included; everything downstream (payload, derived
+        // metrics, alerts, the humidifier) uses the filtered values, the burst batch the raw ones
+        s->values.temperature = sensor_filter_update(&s->filter_temperature, (int32_t)lroundf(s->raw.temperature * 100)) / 100.0f;
+        s->values.humidity = sensor_filter_update(&s->filter_humidity, (int32_t)lroundf(s->raw.humidity * 100)) / 100.0f;
+        s->values.pressure = sensor_filter_update(&s->filter_pressure, (int32_t)lroundf(s->raw.pressure * 100)) / 100.0f;
+#endif
+    }
+}
 
-        // Wait for measurement
-        vTaskDelay(duration);
+/**
+ * Burst time granted within the last BURST_BUDGET_WINDOW_MS (burst_lock held);
+ * frees spans that have left the window
+ */
+static int64_t burst_budget_used_ms(int64_t now_ms)
+{
+    int64_t window_start_ms = now_ms - BURST_BUDGET_WINDOW_MS;
+    int64_t used_ms = 0;
+    for (int i = 0; i < BURST_SPANS; i++) {
+        if (burst_spans[i].end_ms == 0) {
+            continue;
+        }
+        if (burst_spans[i].end_ms <= window_start_ms) {
+            burst_spans[i].end_ms = 0;
+            continue;
+        }
+        int64_t start_ms = burst_spans[i].start_ms > window_start_ms ? burst_spans[i].start_ms : window_start_ms;
+        int64_t end_ms = burst_spans[i].end_ms < now_ms ? burst_spans[i].end_ms : now_ms;
+        used_ms += end_ms - start_ms;
+    }
+    return used_ms;
+}
 
-        // Get results
-        err = bme680_get_results_float(&sensor, &values);
-        if (err != ESP_OK) {
-            ESP_LOGW(TAG, "Failed to get results: %s", esp_err_to_name(err));
-            consecutive_errors++;
-            
-            if (consecutive_errors >= MAX_CONSECUTIVE_ERRORS) {
-                ESP_LOGE(TAG, "Too many consecutive errors (%d), reinitializing sensor...", consecutive_errors);
-                bme680_cleanup();
-                consecutive_errors = 0;
-            } else {
-                vTaskDelay(pdMS_TO_TICKS(500));
+/**
+ * Grant, replace or stop a burst (any task)
+ *
+ * Each request is capped at BURST_MAX_S and all bursts together at
+ * BURST_BUDGET_S in any hour: a grant never exceeds the budget minus the
+ * burst time of the hour before it. Time left of a replaced or stopped
+ * burst is refunded. At most BURST_SPANS separate bursts count per hour;
+ * beyond that requests are refused until the oldest leaves the window.
+ *
+ * @param hz          Requested rate, capped at BURST_MAX_HZ
+ * @param seconds     Requested duration, 0 to stop
+ * @param budget_left Set to the budget left afterwards (s), may be NULL
+ * @return Seconds granted
+ */
+static int burst_request(int hz, int seconds, int *budget_left)
+{
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    int granted = 0;
+    
+    portENTER_CRITICAL(&burst_lock);
+    // Refund the rest of a running burst; a replacement continues its span
+    bool running = burst_hz > 0 && burst_until_ms > now_ms && burst_span >= 0;
+    if (running) {
+        burst_spans[burst_span].end_ms = now_ms;
+    }
+    
+    int left_s = (int)((BURST_BUDGET_S * 1000LL - burst_budget_used_ms(now_ms)) / 1000);
+    if (hz > 0 && seconds > 0) {
+        granted = seconds < BURST_MAX_S ? seconds : BURST_MAX_S;
+        granted = granted < left_s ? granted : left_s;
+    }
+    if (granted > 0 && !running) {
+        burst_span = -1;
+        for (int i = 0; i < BURST_SPANS && burst_span < 0; i++) {
+            if (burst_spans[i].end_ms == 0) {
+                burst_span = i;
+                burst_spans[i].start_ms = now_ms;
             }
-            continue;
+        }
+        if (burst_span < 0) {
+            granted = 0;
+        }
+    }
+    if (granted > 0) {
+        burst_hz = hz < BURST_MAX_HZ ? hz : BURST_MAX_HZ;
+        burst_until_ms = now_ms + granted * 1000LL;
+        burst_spans[burst_span].end_ms = burst_until_ms;
+        left_s -= granted;
+    } else {
+        burst_hz = 0;
+        burst_until_ms = 0;
+    }
+    portEXIT_CRITICAL(&burst_lock);
+    
+    if (budget_left != NULL) {
+        *budget_left = left_s;
+    }
+    
+    // Switch profile now rather than at the end of the current period
+    TaskHandle_t task = sensor_task_handle;
+    if (task != NULL) {
+        xTaskNotifyGive(task);
+    }
+    return granted;
+}
+
+/**
+ * Publish the pending burst batch (columnar, integers, QoS 0)
+ *
+ * {"device_id", "t0": epoch ms of the first sample, "dt_ms", "synced",
+ *  "t": [0.01 °C], "rh": [0.01 %RH], "p": [Pa]}
+ * Short keys keep batches small. Telegraf stores them in their own
+ * climate_burst table (t_0, t_1, ... per row), outside the 30 s means.
+ */
+static void burst_flush(void)
+{
+    if (burst_batch.count == 0) {
+        return;
+    }
+    
+    if (mqtt_client_manager_is_connected() && mqtt_client) {
+        char payload[160 + BURST_MAX_HZ * 24];
+        int len = snprintf(payload, sizeof(payload),
+                "{\"device_id\":\"%s\",\"t0\":%lld,\"dt_ms\":%d,\"synced\":%s,\"t\":[",
+                CONFIG_DEVICE_ID, (long long)burst_batch.t0_ms, 1000 / burst_active_hz,
+                time_sync_is_valid() ? "true" : "false");
+        for (int i = 0; i < burst_batch.count && len < (int)sizeof(payload); i++) {
+            len += snprintf(payload + len, sizeof(payload) - len, "%s%d", i ? "," : "", burst_batch.temperature[i]);
+        }
+        if (len < (int)sizeof(payload)) {
+            len += snprintf(payload + len, sizeof(payload) - len, "],\"rh\":[");
+        }
+        for (int i = 0; i < burst_batch.count && len < (int)sizeof(payload); i++) {
+            len += snprintf(payload + len, sizeof(payload) - len, "%s%d", i ? "," : "", burst_batch.humidity[i]);
+        }
+        if (len < (int)sizeof(payload)) {
+            len += snprintf(payload + len, sizeof(payload) - len, "],\"p\":[");
+        }
+        for (int i = 0; i < burst_batch.count && len < (int)sizeof(payload); i++) {
+            len += snprintf(payload + len, sizeof(payload) - len, "%s%ld", i ? "," : "", (long)burst_batch.pressure[i]);
         }
         
-        // Success - reset error counters
-        consecutive_errors = 0;
-        reinit_attempts = 0;
+        // A truncated batch is not valid JSON; drop it rather than send it
+        if (len + 2 < (int)sizeof(payload)) {
+            snprintf(payload + len, sizeof(payload) - len, "]}");
+            
+            // Queued for the MQTT task so the sensor task keeps its rate
+            mqtt_client_manager_publish(BURST_TOPIC, payload, 0, 0, false);
+        } else {
+            ESP_LOGW(TAG, "Burst batch does not fit %d bytes, dropping it", (int)sizeof(payload));
+        }
+    }
+    burst_batch.count = 0;
+}
+
+/**
+ * Add the primary sensor's raw reading to the burst batch; flushes once a second
+ */
+static void burst_add(const climate_sensor_t *s)
+{
+    if (burst_batch.count == 0) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        burst_batch.t0_ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    }
+    
+    int i = burst_batch.count++;
+    burst_batch.temperature[i] = (int16_t)lroundf(s->raw.temperature * 100);
+    burst_batch.humidity[i] = (int16_t)lroundf(s->raw.humidity * 100);
+    burst_batch.pressure[i] = lroundf(s->raw.pressure * 100);
+    
+    if (burst_batch.count >= burst_active_hz) {
+        burst_flush();
+    }
+}
+
+/**
+ * Apply a started, changed, expired or stopped burst (sensor task only)
+ */
+static void burst_update(int64_t now_ms)
+{
+    portENTER_CRITICAL(&burst_lock);
+    if (burst_hz > 0 && now_ms >= burst_until_ms) {
+        burst_hz = 0;
+    }
+    int hz = burst_hz;
+    int64_t until_ms = burst_until_ms;
+    portEXIT_CRITICAL(&burst_lock);
+    
+    if (hz == burst_active_hz) {
+        return;
+    }
+    
+    // A batch has a single sample spacing
+    burst_flush();
+    
+    bool profile_change = (hz > 0) != (burst_active_hz > 0);
+    burst_active_hz = hz;
+    if (hz > 0) {
+        ESP_LOGI(TAG, "[BURST] %d Hz for %lld s", hz, (long long)(until_ms - now_ms) / 1000);
+    } else {
+        ESP_LOGI(TAG, "[BURST] Ended, back to the normal profile");
+    }
+    
+    if (!profile_change) {
+        return;
+    }
+    for (int i = 0; i < sensor_count; i++) {
+        climate_sensor_t *s = &sensors[i];
+        if (!s->initialized) {
+            continue;
+        }
+        if (select_sensor(s) == ESP_OK) {
+            bme680_configure(s);
+        }
+    }
+}
+
+/**
+ * Pipeline stage: VPD, dew point, absolute humidity and IAQ
+ */
+static pipeline_result_t derive_stage(void *ctx, pipeline_sample_t *sample)
+{
+    // Derived humidity metrics (integer-only, cheap on FPU-less targets)
+    psychro_values_t psychro;
+    psychro_compute((int32_t)(sample->value[PIPELINE_FIELD_TEMPERATURE] * 100),
+                    (int32_t)(sample->value[PIPELINE_FIELD_HUMIDITY] * 100), &psychro);
+    pipeline_sample_set(sample, PIPELINE_FIELD_VPD, psychro.vpd_pa / 1000.0f);
+    pipeline_sample_set(sample, PIPELINE_FIELD_DEW_POINT, psychro.dew_point_centi_c / 100.0f);
+    pipeline_sample_set(sample, PIPELINE_FIELD_ABS_HUMIDITY, psychro.abs_humidity_mg_m3 / 1000.0f);
+    
+    // Air quality index from gas resistance against that sensor's learned
+    // baseline (no gas reading while a burst has the heater off)
+    if (pipeline_sample_has(sample, PIPELINE_FIELD_GAS_RESISTANCE)) {
+        iaq_result_t iaq;
+        iaq_update(primary_channel, sample->value[PIPELINE_FIELD_GAS_RESISTANCE],
+                   sample->value[PIPELINE_FIELD_HUMIDITY], psychro.abs_humidity_mg_m3, sample->timestamp_ms, &iaq);
+        pipeline_sample_set(sample, PIPELINE_FIELD_IAQ, iaq.iaq);
+        pipeline_sample_set(sample, PIPELINE_FIELD_IAQ_ACCURACY, iaq.accuracy);
+    }
+    return PIPELINE_PASS;
+}
+
+/**
+ * Pipeline stage: evaluate edge alert rules on every sample, independent of MQTT state
+ */
+static pipeline_result_t alert_stage(void *ctx, pipeline_sample_t *sample)
+{
+    static const struct {
+        pipeline_field_t field;
+        alert_metric_t metric;
+    } ALERT_FIELDS[] = {
+        { PIPELINE_FIELD_TEMPERATURE, ALERT_METRIC_TEMPERATURE },
+        { PIPELINE_FIELD_HUMIDITY, ALERT_METRIC_HUMIDITY },
+        { PIPELINE_FIELD_PRESSURE, ALERT_METRIC_PRESSURE },
+        { PIPELINE_FIELD_GAS_RESISTANCE, ALERT_METRIC_GAS_RESISTANCE },
+        { PIPELINE_FIELD_VPD, ALERT_METRIC_VPD },
+        { PIPELINE_FIELD_DEW_POINT, ALERT_METRIC_DEW_POINT },
+        { PIPELINE_FIELD_SOIL_MOISTURE, ALERT_METRIC_SOIL_MOISTURE },
+    };
+    
+    alert_sample_t alert_sample = {0};
+    for (size_t i = 0; i < sizeof(ALERT_FIELDS) / sizeof(ALERT_FIELDS[0]); i++) {
+        if (pipeline_sample_has(sample, ALERT_FIELDS[i].field)) {
+            alert_sample_set(&alert_sample, ALERT_FIELDS[i].metric, sample->value[ALERT_FIELDS[i].field]);
+        }
+    }
+    if (pipeline_sample_has(sample, PIPELINE_FIELD_IAQ) &&
+        sample->value[PIPELINE_FIELD_IAQ_ACCURACY] >= IAQ_ACCURACY_MEDIUM) {
+        alert_sample_set(&alert_sample, ALERT_METRIC_IAQ, sample->value[PIPELINE_FIELD_IAQ]);
+    }
+    alert_engine_evaluate(&alert_sample, sample->timestamp_ms);
+    return PIPELINE_PASS;
+}
 
-        printf("BME680 Sensor: %.4f °C, %.4f %%, %.4f hPa, %.4f Ohm\n",
-               values.temperature, values.humidity, values.pressure, values.gas_resistance);
+/**
+ * Convert a pipeline sample to the public reading type
+ */
+static void reading_from_sample(const pipeline_sample_t *sample, climate_reading_t *reading)
+{
+    reading->temperature = sample->value[PIPELINE_FIELD_TEMPERATURE];
+    reading->humidity = sample->value[PIPELINE_FIELD_HUMIDITY];
+    reading->pressure = sample->value[PIPELINE_FIELD_PRESSURE];
+    reading->gas_resistance = sample->value[PIPELINE_FIELD_GAS_RESISTANCE];
+    reading->vpd_pa = lroundf(sample->value[PIPELINE_FIELD_VPD] * 1000);
+    reading->dew_point_centi_c = lroundf(sample->value[PIPELINE_FIELD_DEW_POINT] * 100);
+    reading->abs_humidity_mg_m3 = lroundf(sample->value[PIPELINE_FIELD_ABS_HUMIDITY] * 1000);
+    reading->iaq = sample->value[PIPELINE_FIELD_IAQ];
+    reading->iaq_accuracy = sample->value[PIPELINE_FIELD_IAQ_ACCURACY];
+    reading->soil_moisture = pipeline_sample_has(sample, PIPELINE_FIELD_SOIL_MOISTURE)
+                             ? (int8_t)sample->value[PIPELINE_FIELD_SOIL_MOISTURE] : -1;
+    reading->timestamp_ms = sample->timestamp_ms;
+}
+
+/**
+ * Pipeline stage: tell a registered co-located module about the new sample
+ */
+static pipeline_result_t notify_stage(void *ctx, pipeline_sample_t *sample)
+{
+    portENTER_CRITICAL(&reading_cb_lock);
+    climate_reading_cb_t cb = reading_cb;
+    void *cb_ctx = reading_cb_ctx;
+    portEXIT_CRITICAL(&reading_cb_lock);
+    
+    if (cb != NULL) {
+        climate_reading_t reading;
+        reading_from_sample(sample, &reading);
+        cb(&reading, cb_ctx);
+    }
+    return PIPELINE_PASS;
+}
+
+/**
+ * MQTT sink extension: every channel's reading as one vertical profile
+ *
+ * Always one entry per configured sensor, in channel order, so the array
+ * position (profile_N_* after Telegraf flattens it) keeps meaning the same
+ * channel. A channel without a valid reading only carries its number.
+ */
+static int append_profile(char *buf, size_t size)
+{
+    if (sensor_count <= 1) {
+        return 0;
+    }
+    
+    int len = snprintf(buf, size, "\"profile\":[");
+    for (int i = 0; i < sensor_count && len < (int)size; i++) {
+        const climate_sensor_t *s = &sensors[i];
+        if (!s->valid) {
+            len += snprintf(buf + len, size - len, "%s{\"channel\":%d}", i == 0 ? "" : ",", s->channel);
+            continue;
+        }
+        len += snprintf(buf + len, size - len,
+                "%s{\"channel\":%d,\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f,\"gas_resistance\":%.2f}",
+                i == 0 ? "" : ",", s->channel,
+                s->values.temperature, s->values.humidity, s->values.pressure, s->values.gas_resistance);
+    }
+    if (len < (int)size) {
+        len += snprintf(buf + len, size - len, "],");
+    }
+    return len;
+}
+
+/**
+ * Pipeline stage: heartbeat alongside each published reading
+ */
+static pipeline_result_t heartbeat_stage(void *ctx, pipeline_sample_t *sample)
+{
+    if (mqtt_client_manager_is_connected() && mqtt_client) {
+        char heartbeat_payload[128];
+        snprintf(heartbeat_payload, sizeof(heartbeat_payload),
+                "{\"device_id\":\"%s\",\"status\":\"alive\"}",
+                CONFIG_DEVICE_ID);
+        mqtt_client_manager_publish("sensor/heartbeat", heartbeat_payload, 0, 1, false);
+    }
+    return PIPELINE_PASS;
+}
+
+/**
+ * Pipeline stage: retained last value for consumers that just subscribed
+ * (no profile, rate-limited by the MQTT manager)
+ */
+static pipeline_result_t state_stage(void *ctx, pipeline_sample_t *sample)
+{
+    char payload[320];
+    int len = snprintf(payload, sizeof(payload), "{\"device_id\":\"%s\"", CONFIG_DEVICE_ID);
+    for (int f = 0; f < PIPELINE_FIELD_COUNT && len < (int)sizeof(payload); f++) {
+        if (pipeline_sample_has(sample, f)) {
+            len += snprintf(payload + len, sizeof(payload) - len, ",\"%s\":%.*f",
+                            pipeline_field_name(f), pipeline_field_decimals(f), sample->value[f]);
+        }
+    }
+    if (len + 1 < (int)sizeof(payload)) {
+        snprintf(payload + len, sizeof(payload) - len, "}");
+        mqtt_client_manager_publish_state(ctx, payload);
+    }
+    return PIPELINE_PASS;
+}
+
+// Stage state, all statically allocated
+static pipeline_median_t soil_median = PIPELINE_MEDIAN_INIT(PIPELINE_FIELD_SOIL_MOISTURE, 5);
+static pipeline_snapshot_t latest_snapshot;
+static char climate_payload[512 + CLIMATE_SENSOR_MAX * 128];
+static pipeline_mqtt_sink_t climate_sink = {
+    .topic = "sensor/climate",
+    .qos = 1,
+    .buf = climate_payload,
+    .buf_size = sizeof(climate_payload),
+    .append = append_profile,
+};
+static mqtt_state_t climate_state = MQTT_STATE_INIT("climate");
+
+// Everything after acquisition; T/RH/P are already filtered per channel
+static const pipeline_stage_t CLIMATE_STAGES[] = {
+    { "soil_median", pipeline_median_process, &soil_median },     // ADC spikes
+    { "derive", derive_stage, NULL },
+    { "alerts", alert_stage, NULL },
+    { "snapshot", pipeline_snapshot_process, &latest_snapshot },
+#if CONFIG_CLIMATE_HISTORY
+    { "history", history_process, NULL },                         // 1-minute aggregates
+#endif
+    { "notify", notify_stage, NULL },
+    { "mqtt", pipeline_mqtt_sink_process, &climate_sink },
+    { "state", state_stage, &climate_state },
+    { "heartbeat", heartbeat_stage, NULL },
+};
+PIPELINE_DEFINE(climate_pipeline, CLIMATE_STAGES);
+
+/**
+ * Read sensor and publish to MQTT if connected
+ */
+static void bme680_read_and_publish(void)
+{
+    TickType_t last_wakeup = xTaskGetTickCount();
+    int64_t last_run_ms = 0;
+    uint32_t runs = 0;
+    
+    ESP_LOGI(TAG, "Starting sensor reading loop");
+    
+    while (sensor_running) {
+        // Bring up any sensors that are not initialized
+        if (sensors_recover(esp_timer_get_time() / 1000) == 0) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
+        }
+        
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        burst_update(now_ms);
+#if CONFIG_CLIMATE_FLIGHT_RECORDER
+        flight_recorder_poll(now_ms);
+#endif
+        
+        // The regular pipeline keeps its 1 Hz cadence during a burst
+        bool pipeline_tick = burst_active_hz == 0 || now_ms - last_run_ms >= SAMPLE_PERIOD_MS;
+        sensors_measure(pipeline_tick);
+        
+        // The lowest channel with a reading drives derived metrics, IAQ and alerts
+        const climate_sensor_t *primary = NULL;
+        for (int i = 0; i < sensor_count && primary == NULL; i++) {
+            if (sensors[i].valid) {
+                primary = &sensors[i];
+            }
+        }
+        if (primary == NULL) {
+            vTaskDelay(pdMS_TO_TICKS(500));
+            continue;
+        }
         
-        // Read soil moisture sensor (0-100%)
-        int soil_moisture_percent = soil_moisture_read_percent();
+        if (burst_active_hz > 0) {
+            burst_add(primary);
+        }
         
-        // Only publish if MQTT is connected
-        if (mqtt_client_manager_is_connected() && mqtt_client) {
-            // Create JSON payload with all sensor readings, soil moisture percentage, and device ID
-            char json_payload[512];
-            snprintf(json_payload, sizeof(json_payload),
-                    "{\"device_id\":\"%s\",\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f,\"gas_resistance\":%.2f,\"soil_moisture\":%d,\"location_x\":%d,\"location_y\":%d}",
-                    CONFIG_DEVICE_ID,
-                    values.temperature, values.humidity, values.pressure, values.gas_resistance,
-                    soil_moisture_percent,
-                    CONFIG_DEVICE_LOCATION_X, CONFIG_DEVICE_LOCATION_Y);
+        if (pipeline_tick) {
+            last_run_ms = now_ms;
+            primary_channel = primary->channel;
             
-            // Publish climate data
-            int msg_id = esp_mqtt_client_publish(mqtt_client, "sensor/climate", json_payload, 0, 1, 0);
-            if (msg_id < 0) {
-                ESP_LOGW(TAG, "Failed to publish climate data, will retry on next reading");
+            pipeline_sample_t sample = { .timestamp_ms = esp_timer_get_time() / 1000 };
+            pipeline_sample_set(&sample, PIPELINE_FIELD_TEMPERATURE, primary->values.temperature);
+            pipeline_sample_set(&sample, PIPELINE_FIELD_HUMIDITY, primary->values.humidity);
+            pipeline_sample_set(&sample, PIPELINE_FIELD_PRESSURE, primary->values.pressure);
+            if (burst_active_hz == 0) {
+                pipeline_sample_set(&sample, PIPELINE_FIELD_GAS_RESISTANCE, primary->values.gas_resistance);
             }
             
-            // Publish heartbeat
-            char heartbeat_payload[128];
-            snprintf(heartbeat_payload, sizeof(heartbeat_payload),
-                    "{\"device_id\":\"%s\",\"status\":\"alive\"}",
-                    CONFIG_DEVICE_ID);
-            esp_mqtt_client_publish(mqtt_client, "sensor/heartbeat", heartbeat_payload, 0, 1, 0);
-        } else {
-            ESP_LOGD(TAG, "MQTT not connected, dropping reading (temp: %.2f °C)", values.temperature);
+            // Read soil moisture sensor (0-100%)
+            int soil_moisture_percent = soil_moisture_read_percent();
+            if (soil_moisture_percent >= 0) {
+                pipeline_sample_set(&sample, PIPELINE_FIELD_SOIL_MOISTURE, soil_moisture_percent);
+            }
+            
+            pipeline_run(&climate_pipeline, &sample);
+            
+            if (++runs % PIPELINE_STATS_INTERVAL == 0) {
+                pipeline_log_stats(&climate_pipeline);
+            }
         }
         
-        // Use temperature for next measurement
-        temperature = values.temperature;
-        
-        // Wait 1 second between readings
-        vTaskDelayUntil(&last_wakeup, pdMS_TO_TICKS(1000));
+        // Wait 1 second between readings (shorter during a burst), or less if
+        // a request asks for a fresh one
+        TickType_t period = pdMS_TO_TICKS(burst_active_hz > 0 ? 1000 / burst_active_hz : SAMPLE_PERIOD_MS);
+        TickType_t elapsed = xTaskGetTickCount() - last_wakeup;
+        if (elapsed < period && ulTaskNotifyTake(pdTRUE, period - elapsed) > 0) {
+            last_wakeup = xTaskGetTickCount();
+        } else {
+            last_wakeup += period;
+        }
     }
     
     ESP_LOGI(TAG, "Sensor reading loop stopped");
@@ -495,61 +963,157 @@ static void sensor_task(void *pvParameters)
 /**
  * Handle MQTT config message to update calibration values
  */
-static void handle_config_message(const char *data, int data_len)
+void climate_monitor_apply_config(const char *data, int data_len)
 {
     ESP_LOGI(TAG, "[MQTT] Received config message: %.*s", data_len, data);
     
-    // Parse JSON: {"dry_value": 2800, "wet_value": 1200}
+    // Parse JSON: {"dry_value": 2800, "wet_value": 1200, "alerts": [...]}
     cJSON *json = cJSON_ParseWithLength(data, data_len);
     if (json == NULL) {
         ESP_LOGW(TAG, "[MQTT] Failed to parse config JSON");
         return;
     }
     
-    bool updated = false;
+    // Soil calibration is persisted by the soil moisture module
+    soil_moisture_apply_config(json);
     
-    cJSON *dry_item = cJSON_GetObjectItem(json, "dry_value");
-    if (cJSON_IsNumber(dry_item)) {
-        soil_moisture_dry_value = dry_item->valueint;
-        ESP_LOGI(TAG, "[MQTT] Updated dry_value=%d", soil_moisture_dry_value);
-        updated = true;
+    // Alert rules are persisted by the alert engine itself
+    cJSON *alerts_item = cJSON_GetObjectItem(json, "alerts");
+    if (alerts_item != NULL) {
+        alert_engine_apply_config(alerts_item);
     }
     
-    cJSON *wet_item = cJSON_GetObjectItem(json, "wet_value");
-    if (cJSON_IsNumber(wet_item)) {
-        soil_moisture_wet_value = wet_item->valueint;
-        ESP_LOGI(TAG, "[MQTT] Updated wet_value=%d", soil_moisture_wet_value);
-        updated = true;
+    cJSON_Delete(json);
+}
+
+/**
+ * Handle a command: {"burst_hz": 10, "burst_s": 120} starts a burst,
+ * {"burst_s": 0} ends it, {"record_dump": true} triggers the flight recorder
+ */
+void climate_monitor_handle_command(const char *data, int data_len)
+{
+    cJSON *json = cJSON_ParseWithLength(data, data_len);
+    if (json == NULL) {
+        ESP_LOGW(TAG, "[CMD] Failed to parse command JSON");
+        return;
     }
     
-    cJSON_Delete(json);
+#if CONFIG_CLIMATE_FLIGHT_RECORDER
+    if (cJSON_IsTrue(cJSON_GetObjectItem(json, "record_dump"))) {
+        flight_recorder_trigger("command");
+    }
+#endif
     
-    // Save to NVS if values were updated
-    if (updated) {
-        esp_err_t err = save_soil_calibration();
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "[MQTT] Calibration saved to NVS");
+    cJSON *seconds_item = cJSON_GetObjectItem(json, "burst_s");
+    cJSON *hz_item = cJSON_GetObjectItem(json, "burst_hz");
+    if (cJSON_IsNumber(seconds_item)) {
+        int hz = cJSON_IsNumber(hz_item) ? hz_item->valueint : BURST_MAX_HZ;
+        int budget_left;
+        int granted = burst_request(hz, seconds_item->valueint, &budget_left);
+        if (seconds_item->valueint > 0 && granted == 0) {
+            ESP_LOGW(TAG, "[CMD] Burst refused, hourly budget used up");
         } else {
-            ESP_LOGE(TAG, "[MQTT] Failed to save calibration to NVS");
+            ESP_LOGI(TAG, "[CMD] Burst %d s granted, %d s of budget left", granted, budget_left);
+        }
+    }
+    
+    cJSON_Delete(json);
+}
+
+/**
+ * Fill an RPC result with the fields of a sample and its age
+ */
+static void sample_to_json(const pipeline_sample_t *sample, cJSON *result)
+{
+    for (int f = 0; f < PIPELINE_FIELD_COUNT; f++) {
+        if (pipeline_sample_has(sample, f)) {
+            cJSON_AddNumberToObject(result, pipeline_field_name(f), sample->value[f]);
+        }
+    }
+    cJSON_AddNumberToObject(result, "age_ms", esp_timer_get_time() / 1000 - sample->timestamp_ms);
+}
+
+/**
+ * RPC "read_now": the latest sample, answered from the snapshot without
+ * touching the bus
+ */
+static esp_err_t rpc_read_now(const cJSON *params, cJSON *result, int64_t deadline_us)
+{
+    pipeline_sample_t sample;
+    if (!pipeline_snapshot_read(&latest_snapshot, &sample)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sample_to_json(&sample, result);
+    return ESP_OK;
+}
+
+/**
+ * RPC "trigger_measurement": wake the sensor task early and wait for the
+ * sample it produces (needs a budget above the BME680 measurement time)
+ */
+static esp_err_t rpc_trigger_measurement(const cJSON *params, cJSON *result, int64_t deadline_us)
+{
+    TaskHandle_t task = sensor_task_handle;
+    if (!sensor_running || task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    unsigned seq = atomic_load_explicit(&latest_snapshot.seq, memory_order_acquire);
+    xTaskNotifyGive(task);
+    
+    while (atomic_load_explicit(&latest_snapshot.seq, memory_order_acquire) == seq) {
+        if (esp_timer_get_time() >= deadline_us) {
+            return ESP_ERR_TIMEOUT;
         }
+        vTaskDelay(pdMS_TO_TICKS(10));
     }
+    
+    return rpc_read_now(params, result, deadline_us);
 }
 
 /**
- * MQTT data received callback
+ * RPC "burst": {"rate_hz": 10, "duration_s": 120}; duration 0 ends a burst
  */
-static void on_data_received(esp_mqtt_event_handle_t event)
+static esp_err_t rpc_burst(const cJSON *params, cJSON *result, int64_t deadline_us)
 {
-    // Check if this is a config message for our device
-    char topic[128];
-    snprintf(topic, sizeof(topic), "sensor/config/%s", CONFIG_DEVICE_ID);
+    cJSON *seconds_item = cJSON_GetObjectItem(params, "duration_s");
+    cJSON *hz_item = cJSON_GetObjectItem(params, "rate_hz");
+    if (!cJSON_IsNumber(seconds_item)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    int hz = cJSON_IsNumber(hz_item) ? hz_item->valueint : BURST_MAX_HZ;
+    int budget_left;
+    int granted = burst_request(hz, seconds_item->valueint, &budget_left);
     
-    if (event->topic_len == strlen(topic) && 
-        strncmp(event->topic, topic, event->topic_len) == 0) {
-        handle_config_message(event->data, event->data_len);
+    cJSON_AddNumberToObject(result, "rate_hz", granted > 0 ? (hz < BURST_MAX_HZ ? hz : BURST_MAX_HZ) : 0);
+    cJSON_AddNumberToObject(result, "duration_s", granted);
+    cJSON_AddNumberToObject(result, "budget_left_s", budget_left);
+    return ESP_OK;
+}
+
+#if CONFIG_CLIMATE_FLIGHT_RECORDER
+/**
+ * RPC "record_dump": trigger the flight recorder
+ */
+static esp_err_t rpc_record_dump(const cJSON *params, cJSON *result, int64_t deadline_us)
+{
+    if (!flight_recorder_trigger("rpc")) {
+        return ESP_ERR_INVALID_STATE;
     }
+    cJSON_AddNumberToObject(result, "dump_in_s", CONFIG_CLIMATE_RECORDER_POST_S);
+    return ESP_OK;
 }
 
+/**
+ * Alert rules firing are incidents worth full-rate context
+ */
+static void on_alert_fired(const char *rule_name)
+{
+    flight_recorder_trigger(rule_name);
+}
+#endif
+
 /**
  * Initialize climate monitor
  */
@@ -560,15 +1124,43 @@ void climate_monitor_init(esp_mqtt_client_handle_t client)
     ESP_LOGI(TAG, "Location: (%d, %d)", CONFIG_DEVICE_LOCATION_X, CONFIG_DEVICE_LOCATION_Y);
     
     mqtt_client = client;
+    climate_sink.client = client;
     
-    // Initialize I2C device library
-    ESP_ERROR_CHECK(i2cdev_init());
+    // I2C device library is initialized once by the device registry
     
     // Initialize soil moisture sensor
     soil_moisture_init();
     
-    // Initialize BME680 sensor
-    bme680_init();
+#if CONFIG_CLIMATE_LIGHT_SENSOR
+    // Light integration runs continuously on the shared I2C bus
+    light_sensor_init(client, I2C_NUM_0, BME680_I2C_SDA_PIN, BME680_I2C_SCL_PIN);
+#endif
+    
+    // Initialize BME680 sensors
+    sensors_setup();
+    for (int i = 0; i < sensor_count; i++) {
+        bme680_init(&sensors[i]);
+    }
+    
+    // Restore IAQ baseline so a reboot doesn't repeat the burn-in
+    iaq_init();
+    
+    // Load edge alert rules
+    alert_engine_init(client);
+    
+#if CONFIG_CLIMATE_FLIGHT_RECORDER
+    flight_recorder_init(client);
+    alert_engine_set_fired_callback(on_alert_fired);
+    rpc_server_register("record_dump", rpc_record_dump);
+#endif
+    
+#if CONFIG_CLIMATE_HISTORY
+    history_init();
+#endif
+    
+    rpc_server_register("read_now", rpc_read_now);
+    rpc_server_register("trigger_measurement", rpc_trigger_measurement);
+    rpc_server_register("burst", rpc_burst);
 }
 
 /**
@@ -606,31 +1198,39 @@ void climate_monitor_stop(void)
         }
     }
     
-    // Cleanup I2C connection
-    bme680_cleanup();
+    // Persist the IAQ baseline learned since the last checkpoint
+    iaq_checkpoint();
+#if CONFIG_CLIMATE_LIGHT_SENSOR
+    light_sensor_checkpoint();
+#endif
+    
+    // Cleanup I2C connections
+    for (int i = 0; i < sensor_count; i++) {
+        bme680_cleanup(&sensors[i]);
+    }
 }
 
 /**
- * Subscribe to config topic for this device
+ * Copy the latest sample, retrying if the sensor task wrote it meanwhile
  */
-void climate_monitor_subscribe_config(void)
+bool climate_monitor_get_latest(climate_reading_t *out)
 {
-    if (mqtt_client == NULL) {
-        ESP_LOGW(TAG, "[MQTT] Cannot subscribe - MQTT client not initialized");
-        return;
+    pipeline_sample_t sample;
+    if (!pipeline_snapshot_read(&latest_snapshot, &sample)) {
+        return false;
     }
     
-    char topic[128];
-    snprintf(topic, sizeof(topic), "sensor/config/%s", CONFIG_DEVICE_ID);
-    
-    esp_mqtt_client_subscribe(mqtt_client, topic, 1);
-    ESP_LOGI(TAG, "[MQTT] Subscribed to config topic: %s", topic);
+    reading_from_sample(&sample, out);
+    return true;
 }
 
 /**
- * Get the MQTT data received callback
+ * Register the new-sample callback
  */
-void* climate_monitor_get_data_callback(void)
+void climate_monitor_set_reading_callback(climate_reading_cb_t cb, void *ctx)
 {
-    return (void*)on_data_received;
+    portENTER_CRITICAL(&reading_cb_lock);
+    reading_cb = cb;
+    reading_cb_ctx = ctx;
+    portEXIT_CRITICAL(&reading_cb_lock);
 }
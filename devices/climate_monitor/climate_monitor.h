@@ -1,11 +1,37 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "mqtt_client.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Last filtered sample, as published on sensor/climate
+ */
+typedef struct {
+    float temperature;              // °C
+    float humidity;                 // %RH
+    float pressure;                 // hPa
+    float gas_resistance;           // Ohm
+    int32_t vpd_pa;
+    int32_t dew_point_centi_c;
+    int32_t abs_humidity_mg_m3;
+    uint16_t iaq;
+    uint8_t iaq_accuracy;           // iaq_accuracy_t
+    int8_t soil_moisture;           // %, -1 if unavailable
+    int64_t timestamp_ms;           // esp_timer time of the sample
+} climate_reading_t;
+
+/**
+ * @brief Called from the sensor task after each new sample
+ *
+ * Runs on the sensor task: keep it short and never block.
+ */
+typedef void (*climate_reading_cb_t)(const climate_reading_t *reading, void *ctx);
+
 /**
  * @brief Initialize the climate monitor device
  * 
@@ -18,19 +44,23 @@ extern "C" {
 void climate_monitor_init(esp_mqtt_client_handle_t client);
 
 /**
- * @brief Subscribe to config topic for calibration updates
- * 
- * Should be called after MQTT connection is established.
- * Subscribes to: sensor/config/{device_id}
+ * @brief Handle a command from greenhouse/command/{device_id}
+ *
+ * {"burst_hz": 10, "burst_s": 120} samples T/RH/P at up to 10 Hz with a
+ * fast profile (gas heater off) and publishes one batch a second to
+ * sensor/climate/burst, then reverts on its own. {"burst_s": 0} ends a
+ * burst early. Bursts are capped per request and per hour.
+ * {"record_dump": true} sends the flight recorder window around now.
  */
-void climate_monitor_subscribe_config(void);
+void climate_monitor_handle_command(const char *data, int data_len);
 
 /**
- * @brief Get the MQTT data received callback
- * 
- * @return Function pointer to on_data_received callback
+ * @brief Apply a config message (same JSON as sensor/config/{device_id})
+ *
+ * Used by the config topics (see fleet_config.h) and the "set_config"
+ * request.
  */
-void* climate_monitor_get_data_callback(void);
+void climate_monitor_apply_config(const char *data, int data_len);
 
 /**
  * @brief Start the climate monitor sensor reading task
@@ -47,6 +77,27 @@ void climate_monitor_start(void);
  */
 void climate_monitor_stop(void);
 
+/**
+ * @brief Copy the latest sample for modules in the same firmware
+ *
+ * O(1) and lock-free (sequence-locked snapshot written only by the sensor
+ * task), so it is safe from any task without going through the broker.
+ * The sensor task pauses while MQTT is disconnected; check timestamp_ms
+ * for staleness.
+ *
+ * @param out Latest sample
+ * @return false if no sample has been taken yet
+ */
+bool climate_monitor_get_latest(climate_reading_t *out);
+
+/**
+ * @brief Register a callback for new samples (NULL to remove)
+ *
+ * @param cb  Callback, invoked after the snapshot is updated
+ * @param ctx Passed through to the callback
+ */
+void climate_monitor_set_reading_callback(climate_reading_cb_t cb, void *ctx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,300 @@
+/*
+ * Climate Monitor - Pre/post-trigger flight recorder
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Keeps the last few minutes of raw readings in a RAM ring (packed fixed
+ * point). On a trigger (alert rule, temperature jump, I2C error burst,
+ * broker reconnect or command) it keeps recording for the post-trigger
+ * window, then sends the whole ring as delta/varint-compressed batches.
+ * Regular telemetry is unchanged; full-rate context is only sent around
+ * incidents.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "flight_recorder.h"
+#include "mqtt_client_manager.h"
+#include "time_sync.h"
+
+// One record per sensor per second (the sensor task records on its 1 Hz tick,
+// bursts included), so the ring covers the configured minutes for every channel
+#if CONFIG_CLIMATE_I2C_MUX
+#define MUX_CH(n)                   ((CONFIG_CLIMATE_I2C_MUX_CHANNELS >> (n)) & 1)
+#define RECORDER_SENSORS            (MUX_CH(0) + MUX_CH(1) + MUX_CH(2) + MUX_CH(3) + \
+                                     MUX_CH(4) + MUX_CH(5) + MUX_CH(6) + MUX_CH(7))
+#else
+#define RECORDER_SENSORS            1
+#endif
+#define RECORDER_CAPACITY           (CONFIG_CLIMATE_RECORDER_MINUTES * 60 * RECORDER_SENSORS)
+#define RECORDER_POST_MS            (CONFIG_CLIMATE_RECORDER_POST_S * 1000)
+#define RECORDER_COOLDOWN_MS        60000       // Between dumps, so an error storm sends one
+
+#define JUMP_CENTI_C                100         // Between consecutive readings of a channel
+#define ERROR_BURST_COUNT           3
+#define ERROR_BURST_WINDOW_MS       10000
+
+#define REASON_LEN                  16
+#define BATCH_MAX_BYTES             768
+#define RECORD_MAX_BYTES            35          // 7 varints of at most 5 bytes
+#define BATCH_FORMAT_VERSION        1
+#define BATCH_FLAG_LAST             0x01
+
+#define RECORD_FLAG_ERROR           0x01
+#define RECORD_FLAG_NO_GAS          0x02
+
+#define PRESSURE_OFFSET_PA          50000
+#define CHANNEL_SLOTS               9           // 8 mux channels + root bus
+
+static const char *TAG = "flight_recorder";
+
+typedef struct __attribute__((packed)) {
+    uint32_t time_ms;               // esp_timer ms, low 32 bits
+    int16_t temperature;            // 0.01 °C
+    uint16_t humidity;              // 0.01 %RH
+    uint16_t pressure;              // Pa above PRESSURE_OFFSET_PA
+    uint16_t gas;                   // 100 Ohm, 0 without a gas reading
+    uint8_t channel;
+    uint8_t flags;                  // RECORD_FLAG_*
+} flight_record_t;
+
+typedef struct __attribute__((packed)) {
+    char magic[2];                  // "FR"
+    uint8_t version;
+    uint8_t flags;                  // BATCH_FLAG_*
+    uint16_t dump_id;
+    uint16_t batch;
+    uint16_t records;
+    uint32_t trigger_ms;            // Same clock as flight_record_t.time_ms
+    int64_t trigger_epoch_ms;       // 0 if the clock was not set
+    char reason[REASON_LEN];
+} batch_header_t;
+
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+static char recorder_topic[64];
+
+// Owned by the sensor task
+static flight_record_t ring[RECORDER_CAPACITY];
+static int ring_head = 0;
+static int ring_count = 0;
+static int16_t last_temperature[CHANNEL_SLOTS];
+static bool last_valid[CHANNEL_SLOTS];
+static int64_t error_window_start_ms = 0;
+static int error_count = 0;
+static uint32_t last_connect_count = 0;
+static uint16_t dump_id = 0;
+static uint8_t batch_buf[BATCH_MAX_BYTES];
+
+// Trigger state, shared with other tasks
+static bool dump_pending = false;
+static int64_t trigger_at_ms = 0;
+static int64_t cooldown_until_ms = 0;
+static char trigger_reason[REASON_LEN];
+static portMUX_TYPE trigger_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int32_t clamp_i32(int32_t v, int32_t lo, int32_t hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static int put_varint(uint8_t *buf, uint32_t v)
+{
+    int n = 0;
+    while (v >= 0x80) {
+        buf[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (uint8_t)v;
+    return n;
+}
+
+static uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static flight_record_t *ring_next(void)
+{
+    flight_record_t *r = &ring[ring_head];
+    ring_head = (ring_head + 1) % RECORDER_CAPACITY;
+    if (ring_count < RECORDER_CAPACITY) {
+        ring_count++;
+    }
+    return r;
+}
+
+void flight_recorder_init(esp_mqtt_client_handle_t client)
+{
+    mqtt_client = client;
+    snprintf(recorder_topic, sizeof(recorder_topic), "greenhouse/recorder/%s", CONFIG_DEVICE_ID);
+
+    ESP_LOGI(TAG, "[RECORDER] %d records (%d bytes), %d s after a trigger, dumps to %s",
+             RECORDER_CAPACITY, (int)sizeof(ring), CONFIG_CLIMATE_RECORDER_POST_S, recorder_topic);
+}
+
+bool flight_recorder_trigger(const char *reason)
+{
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    bool accepted = false;
+
+    portENTER_CRITICAL(&trigger_lock);
+    if (!dump_pending && now_ms >= cooldown_until_ms) {
+        dump_pending = true;
+        trigger_at_ms = now_ms;
+        strlcpy(trigger_reason, reason, sizeof(trigger_reason));
+        accepted = true;
+    }
+    portEXIT_CRITICAL(&trigger_lock);
+
+    if (accepted) {
+        ESP_LOGW(TAG, "[RECORDER] Triggered by %s, dumping in %d s", reason, CONFIG_CLIMATE_RECORDER_POST_S);
+    } else {
+        ESP_LOGD(TAG, "[RECORDER] Ignoring trigger %s (dump pending or cooling down)", reason);
+    }
+    return accepted;
+}
+
+void flight_recorder_record(uint8_t channel, const bme680_values_float_t *values, bool gas_valid, int64_t now_ms)
+{
+    flight_record_t *r = ring_next();
+    r->time_ms = (uint32_t)now_ms;
+    r->temperature = (int16_t)clamp_i32(lroundf(values->temperature * 100), INT16_MIN, INT16_MAX);
+    r->humidity = (uint16_t)clamp_i32(lroundf(values->humidity * 100), 0, UINT16_MAX);
+    r->pressure = (uint16_t)clamp_i32(lroundf(values->pressure * 100) - PRESSURE_OFFSET_PA, 0, UINT16_MAX);
+    r->gas = gas_valid ? (uint16_t)clamp_i32(lroundf(values->gas_resistance / 100), 0, UINT16_MAX) : 0;
+    r->channel = channel;
+    r->flags = gas_valid ? 0 : RECORD_FLAG_NO_GAS;
+
+    int slot = channel < CHANNEL_SLOTS - 1 ? channel : CHANNEL_SLOTS - 1;
+    if (last_valid[slot] && abs(r->temperature - last_temperature[slot]) >= JUMP_CENTI_C) {
+        flight_recorder_trigger("temp_jump");
+    }
+    last_temperature[slot] = r->temperature;
+    last_valid[slot] = true;
+}
+
+void flight_recorder_record_error(uint8_t channel, int64_t now_ms)
+{
+    flight_record_t *r = ring_next();
+    memset(r, 0, sizeof(*r));
+    r->time_ms = (uint32_t)now_ms;
+    r->channel = channel;
+    r->flags = RECORD_FLAG_ERROR;
+
+    if (now_ms - error_window_start_ms > ERROR_BURST_WINDOW_MS) {
+        error_window_start_ms = now_ms;
+        error_count = 0;
+    }
+    if (++error_count == ERROR_BURST_COUNT) {
+        flight_recorder_trigger("i2c_errors");
+    }
+}
+
+/**
+ * Queue one batch; the first record of each batch is absolute so batches
+ * decode on their own
+ */
+static void send_batch(batch_header_t *header, size_t len)
+{
+    memcpy(batch_buf, header, sizeof(*header));
+    int msg_id = mqtt_client_manager_publish(recorder_topic, (const char *)batch_buf, len, 1, false);
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "[RECORDER] Failed to queue batch %d", header->batch);
+    }
+}
+
+/**
+ * Send the whole ring, oldest first
+ */
+static void dump(const char *reason, int64_t trigger_ms)
+{
+    if (mqtt_client == NULL || ring_count == 0) {
+        return;
+    }
+
+    batch_header_t header = {
+        .magic = { 'F', 'R' },
+        .version = BATCH_FORMAT_VERSION,
+        .dump_id = ++dump_id,
+        .trigger_ms = (uint32_t)trigger_ms,
+    };
+    strncpy(header.reason, reason, sizeof(header.reason));
+    if (time_sync_is_valid()) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        int64_t now_epoch_ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+        header.trigger_epoch_ms = now_epoch_ms - (esp_timer_get_time() / 1000 - trigger_ms);
+    }
+
+    int start = (ring_head - ring_count + RECORDER_CAPACITY) % RECORDER_CAPACITY;
+    size_t len = sizeof(header);
+    flight_record_t prev = {0};
+    int batches = 0;
+
+    for (int i = 0; i < ring_count; i++) {
+        const flight_record_t *r = &ring[(start + i) % RECORDER_CAPACITY];
+
+        if (len + RECORD_MAX_BYTES > sizeof(batch_buf)) {
+            send_batch(&header, len);
+            batches++;
+            header.batch++;
+            header.records = 0;
+            len = sizeof(header);
+            memset(&prev, 0, sizeof(prev));
+        }
+
+        uint8_t *out = batch_buf + len;
+        int n = 0;
+        n += put_varint(out + n, r->time_ms - prev.time_ms);
+        n += put_varint(out + n, zigzag(r->temperature - prev.temperature));
+        n += put_varint(out + n, zigzag(r->humidity - prev.humidity));
+        n += put_varint(out + n, zigzag(r->pressure - prev.pressure));
+        n += put_varint(out + n, zigzag(r->gas - prev.gas));
+        n += put_varint(out + n, zigzag(r->channel - prev.channel));
+        n += put_varint(out + n, r->flags);
+        len += n;
+        header.records++;
+        prev = *r;
+    }
+
+    header.flags = BATCH_FLAG_LAST;
+    send_batch(&header, len);
+    batches++;
+
+    ESP_LOGI(TAG, "[RECORDER] Dump %u (%s): %d records in %d batch(es)",
+             (unsigned)dump_id, reason, ring_count, batches);
+}
+
+void flight_recorder_poll(int64_t now_ms)
+{
+    // A changed count means the session dropped and came back
+    uint32_t connects = mqtt_client_manager_get_connect_count();
+    if (last_connect_count != 0 && connects != last_connect_count) {
+        flight_recorder_trigger("reconnect");
+    }
+    last_connect_count = connects;
+
+    char reason[REASON_LEN];
+    int64_t trigger_ms = 0;
+    bool due = false;
+
+    portENTER_CRITICAL(&trigger_lock);
+    if (dump_pending && now_ms - trigger_at_ms >= RECORDER_POST_MS) {
+        due = true;
+        trigger_ms = trigger_at_ms;
+        memcpy(reason, trigger_reason, sizeof(reason));
+        dump_pending = false;
+        cooldown_until_ms = now_ms + RECORDER_COOLDOWN_MS;
+    }
+    portEXIT_CRITICAL(&trigger_lock);
+
+    if (due) {
+        dump(reason, trigger_ms);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mqtt_client.h"
+#include <bme680.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Set up the ring and the dump topic
+ *
+ * Dumps go to greenhouse/recorder/{device_id} as binary batches; see
+ * scripts/decode_flight_recorder.py for the format.
+ *
+ * @param client MQTT client handle from mqtt_client_manager
+ */
+void flight_recorder_init(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Record one raw (unfiltered) reading
+ *
+ * Sensor task only, once a second per sensor: the ring is sized for that
+ * rate. Triggers a dump on a temperature jump between consecutive readings
+ * of the same channel.
+ *
+ * @param channel   Mux channel (0xFF on the root bus)
+ * @param values    Raw reading
+ * @param gas_valid false when the gas heater was off
+ * @param now_ms    esp_timer time of the reading
+ */
+void flight_recorder_record(uint8_t channel, const bme680_values_float_t *values, bool gas_valid, int64_t now_ms);
+
+/**
+ * @brief Record a failed transfer
+ *
+ * Sensor task only. Triggers a dump on a burst of errors.
+ */
+void flight_recorder_record_error(uint8_t channel, int64_t now_ms);
+
+/**
+ * @brief Request a dump of the window around now
+ *
+ * Safe from any task. The dump is sent once the post-trigger window has
+ * been recorded; triggers during a pending dump or its cooldown are
+ * ignored.
+ *
+ * @param reason Short tag sent with the dump (e.g. an alert rule name)
+ * @return false if the trigger was ignored
+ */
+bool flight_recorder_trigger(const char *reason);
+
+/**
+ * @brief Check reconnect and dump timing; sends a due dump
+ *
+ * Sensor task only, once per loop.
+ */
+void flight_recorder_poll(int64_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,545 @@
+/*
+ * Climate Monitor - On-device history of 1-minute aggregates
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Readings are folded into one 20 byte entry per minute (means, temperature
+ * min/max) in a RAM ring, and optionally appended to a flash partition that
+ * outlives reboots. The "history" RPC method answers a time range,
+ * downsampled to a step, in a single reply, so a node's recent past can be
+ * read while the backend is down and backfilled into the DB afterwards.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#if CONFIG_CLIMATE_HISTORY_FLASH
+#include "esp_partition.h"
+#endif
+#include "history.h"
+#include "rpc/rpc_server.h"
+#include "time_sync.h"
+
+#define HISTORY_CAPACITY            (CONFIG_CLIMATE_HISTORY_HOURS * 60)
+#define MINUTE_UPTIME               0x80000000u     // Minute since boot, recorded before the clock was set
+#define PRESSURE_OFFSET_PA          50000
+#define IAQ_NONE                    UINT16_MAX
+#define SOIL_NONE                   (-1)
+
+#define DEFAULT_RANGE_MIN           (24 * 60)
+#define DEFAULT_POINTS              48          // Step chosen for queries without "step_min"
+#define MAX_STEP_MIN                (7 * 24 * 60)
+#define REPLY_OVERHEAD              384         // RPC envelope and fields around the rows
+#define ROW_MAX                     128
+
+#define FLASH_LABEL                 "history"
+#define FLASH_MAGIC                 0x54534948  // "HIST"
+#define FLASH_SECTOR_SIZE           4096
+#define FLASH_READ_CHUNK            16
+
+static const char *TAG = "history";
+
+typedef struct __attribute__((packed)) {
+    uint32_t minute;                // Unix minute, or MINUTE_UPTIME | minute since boot
+    int16_t temperature;            // 0.01 °C, mean
+    int16_t temperature_min;
+    int16_t temperature_max;
+    uint16_t humidity;              // 0.01 %RH, mean
+    uint16_t pressure;              // Pa above PRESSURE_OFFSET_PA, mean
+    uint16_t vpd;                   // Pa, mean
+    uint16_t iaq;                   // 0.1 index, mean; IAQ_NONE without gas readings
+    int8_t soil_moisture;           // %, SOIL_NONE without a reading
+    uint8_t samples;
+} history_entry_t;
+
+/* Weighted sums over a minute, or over a query bucket, in entry units */
+typedef struct {
+    uint32_t minute;                // Start of the minute or bucket
+    uint32_t samples;
+    int64_t temperature;
+    int64_t humidity;
+    int64_t pressure;
+    int64_t vpd;
+    int32_t temperature_min;
+    int32_t temperature_max;
+    int64_t iaq;
+    uint32_t iaq_samples;
+    int64_t soil_moisture;
+    uint32_t soil_samples;
+} history_acc_t;
+
+typedef struct {
+    uint32_t from;                  // Minutes, to exclusive
+    uint32_t to;
+    uint32_t step;
+    history_acc_t bucket;           // Open bucket, empty if samples == 0
+    char *buf;                      // Rows as a JSON array
+    size_t size;
+    size_t len;
+    int rows;
+    uint32_t next;                  // First minute not returned, 0 if complete
+} history_query_t;
+
+// Ring, shared with RPC workers under history_lock
+static history_entry_t ring[HISTORY_CAPACITY];
+static int ring_head = 0;
+static int ring_count = 0;
+static SemaphoreHandle_t history_lock = NULL;
+
+// Minute being collected, owned by the sensor task
+static history_acc_t current;
+
+#if CONFIG_CLIMATE_HISTORY_FLASH
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;                   // Increases with every sector started
+} flash_header_t;
+
+#define FLASH_SECTOR_ENTRIES        ((int)((FLASH_SECTOR_SIZE - sizeof(flash_header_t)) / sizeof(history_entry_t)))
+
+// Under history_lock
+static const esp_partition_t *flash_part = NULL;
+static int flash_sectors = 0;
+static int flash_sector = -1;       // Sector being appended to
+static int flash_slot = 0;
+static uint32_t flash_seq = 0;
+#endif
+
+static int32_t clamp_i32(int32_t v, int32_t lo, int32_t hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static int32_t div_round(int64_t sum, uint32_t n)
+{
+    return (int32_t)((sum >= 0 ? sum + n / 2 : sum - n / 2) / (int64_t)n);
+}
+
+static void acc_reset(history_acc_t *acc, uint32_t minute)
+{
+    memset(acc, 0, sizeof(*acc));
+    acc->minute = minute;
+    acc->temperature_min = INT16_MAX;
+    acc->temperature_max = INT16_MIN;
+}
+
+static void acc_add(history_acc_t *acc, const history_entry_t *e)
+{
+    acc->samples += e->samples;
+    acc->temperature += (int64_t)e->temperature * e->samples;
+    acc->humidity += (int64_t)e->humidity * e->samples;
+    acc->pressure += (int64_t)e->pressure * e->samples;
+    acc->vpd += (int64_t)e->vpd * e->samples;
+    if (e->temperature_min < acc->temperature_min) {
+        acc->temperature_min = e->temperature_min;
+    }
+    if (e->temperature_max > acc->temperature_max) {
+        acc->temperature_max = e->temperature_max;
+    }
+    if (e->iaq != IAQ_NONE) {
+        acc->iaq += (int64_t)e->iaq * e->samples;
+        acc->iaq_samples += e->samples;
+    }
+    if (e->soil_moisture != SOIL_NONE) {
+        acc->soil_moisture += (int64_t)e->soil_moisture * e->samples;
+        acc->soil_samples += e->samples;
+    }
+}
+
+static void acc_to_entry(const history_acc_t *acc, history_entry_t *e)
+{
+    e->minute = acc->minute;
+    e->temperature = (int16_t)div_round(acc->temperature, acc->samples);
+    e->temperature_min = (int16_t)acc->temperature_min;
+    e->temperature_max = (int16_t)acc->temperature_max;
+    e->humidity = (uint16_t)div_round(acc->humidity, acc->samples);
+    e->pressure = (uint16_t)div_round(acc->pressure, acc->samples);
+    e->vpd = (uint16_t)div_round(acc->vpd, acc->samples);
+    e->iaq = acc->iaq_samples > 0 ? (uint16_t)div_round(acc->iaq, acc->iaq_samples) : IAQ_NONE;
+    e->soil_moisture = acc->soil_samples > 0 ? (int8_t)div_round(acc->soil_moisture, acc->soil_samples) : SOIL_NONE;
+    e->samples = acc->samples < UINT8_MAX ? acc->samples : UINT8_MAX;
+}
+
+static void entry_from_sample(const pipeline_sample_t *sample, history_entry_t *e)
+{
+    e->temperature = (int16_t)clamp_i32(lroundf(sample->value[PIPELINE_FIELD_TEMPERATURE] * 100), INT16_MIN, INT16_MAX);
+    e->temperature_min = e->temperature;
+    e->temperature_max = e->temperature;
+    e->humidity = (uint16_t)clamp_i32(lroundf(sample->value[PIPELINE_FIELD_HUMIDITY] * 100), 0, UINT16_MAX);
+    e->pressure = (uint16_t)clamp_i32(lroundf(sample->value[PIPELINE_FIELD_PRESSURE] * 100) - PRESSURE_OFFSET_PA,
+                                      0, UINT16_MAX);
+    e->vpd = pipeline_sample_has(sample, PIPELINE_FIELD_VPD)
+             ? (uint16_t)clamp_i32(lroundf(sample->value[PIPELINE_FIELD_VPD] * 1000), 0, UINT16_MAX) : 0;
+    e->iaq = pipeline_sample_has(sample, PIPELINE_FIELD_IAQ)
+             ? (uint16_t)clamp_i32(lroundf(sample->value[PIPELINE_FIELD_IAQ] * 10), 0, IAQ_NONE - 1) : IAQ_NONE;
+    e->soil_moisture = pipeline_sample_has(sample, PIPELINE_FIELD_SOIL_MOISTURE)
+                       ? (int8_t)clamp_i32(lroundf(sample->value[PIPELINE_FIELD_SOIL_MOISTURE]), 0, 100) : SOIL_NONE;
+    e->samples = 1;
+}
+
+static uint32_t minute_now(int64_t uptime_ms)
+{
+    if (time_sync_is_valid()) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (uint32_t)(tv.tv_sec / 60);
+    }
+    return MINUTE_UPTIME | (uint32_t)(uptime_ms / 60000);
+}
+
+#if CONFIG_CLIMATE_HISTORY_FLASH
+static size_t entry_offset(int sector, int slot)
+{
+    return (size_t)sector * FLASH_SECTOR_SIZE + sizeof(flash_header_t) + (size_t)slot * sizeof(history_entry_t);
+}
+
+/**
+ * Find the newest sector and its first free slot (erased flash reads 0xFF)
+ */
+static void flash_open(void)
+{
+    flash_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FLASH_LABEL);
+    if (flash_part == NULL) {
+        ESP_LOGW(TAG, "[FLASH] No \"%s\" partition, history stays in RAM", FLASH_LABEL);
+        return;
+    }
+    flash_sectors = flash_part->size / FLASH_SECTOR_SIZE;
+
+    for (int s = 0; s < flash_sectors; s++) {
+        flash_header_t header;
+        if (esp_partition_read(flash_part, (size_t)s * FLASH_SECTOR_SIZE, &header, sizeof(header)) == ESP_OK &&
+            header.magic == FLASH_MAGIC && (flash_sector < 0 || header.seq > flash_seq)) {
+            flash_sector = s;
+            flash_seq = header.seq;
+        }
+    }
+
+    if (flash_sector >= 0) {
+        for (flash_slot = 0; flash_slot < FLASH_SECTOR_ENTRIES; flash_slot++) {
+            uint32_t minute;
+            if (esp_partition_read(flash_part, entry_offset(flash_sector, flash_slot), &minute, sizeof(minute)) != ESP_OK ||
+                minute == UINT32_MAX) {
+                break;
+            }
+        }
+    }
+
+    ESP_LOGI(TAG, "[FLASH] %d sectors of %d minutes, appending at sector %d slot %d",
+             flash_sectors, FLASH_SECTOR_ENTRIES, flash_sector, flash_slot);
+}
+
+/**
+ * Append one entry, starting (erasing) the next sector when this one is full
+ *
+ * One small write a minute; each sector is erased once per lap of the
+ * partition.
+ */
+static void flash_append(const history_entry_t *e)
+{
+    if (flash_part == NULL) {
+        return;
+    }
+
+    if (flash_sector < 0 || flash_slot >= FLASH_SECTOR_ENTRIES) {
+        int next = (flash_sector + 1) % flash_sectors;
+        flash_header_t header = { .magic = FLASH_MAGIC, .seq = flash_seq + 1 };
+        if (esp_partition_erase_range(flash_part, (size_t)next * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE) != ESP_OK ||
+            esp_partition_write(flash_part, (size_t)next * FLASH_SECTOR_SIZE, &header, sizeof(header)) != ESP_OK) {
+            ESP_LOGW(TAG, "[FLASH] Failed to start sector %d", next);
+            return;
+        }
+        flash_sector = next;
+        flash_seq = header.seq;
+        flash_slot = 0;
+    }
+
+    if (esp_partition_write(flash_part, entry_offset(flash_sector, flash_slot), e, sizeof(*e)) != ESP_OK) {
+        ESP_LOGW(TAG, "[FLASH] Failed to write sector %d slot %d", flash_sector, flash_slot);
+    }
+    flash_slot++;
+}
+#endif
+
+static void ring_push(const history_entry_t *e)
+{
+    ring[ring_head] = *e;
+    ring_head = (ring_head + 1) % HISTORY_CAPACITY;
+    if (ring_count < HISTORY_CAPACITY) {
+        ring_count++;
+    }
+}
+
+/**
+ * Move minutes recorded before the clock was set onto Unix time
+ */
+static void rebase_uptime_entries(uint32_t unix_minute, int64_t uptime_ms)
+{
+    uint32_t uptime_minute = (uint32_t)(uptime_ms / 60000);
+    int start = (ring_head - ring_count + HISTORY_CAPACITY) % HISTORY_CAPACITY;
+    int rebased = 0;
+
+    for (int i = 0; i < ring_count; i++) {
+        history_entry_t *e = &ring[(start + i) % HISTORY_CAPACITY];
+        if (e->minute & MINUTE_UPTIME) {
+            e->minute = unix_minute - (uptime_minute - (e->minute & ~MINUTE_UPTIME));
+#if CONFIG_CLIMATE_HISTORY_FLASH
+            flash_append(e);
+#endif
+            rebased++;
+        }
+    }
+
+    if (rebased > 0) {
+        ESP_LOGI(TAG, "Clock set, %d minutes from before moved onto Unix time", rebased);
+    }
+}
+
+pipeline_result_t history_process(void *ctx, pipeline_sample_t *sample)
+{
+    uint32_t minute = minute_now(sample->timestamp_ms);
+
+    if (current.samples > 0 && minute != current.minute) {
+        history_entry_t entry;
+        acc_to_entry(&current, &entry);
+
+        xSemaphoreTake(history_lock, portMAX_DELAY);
+        ring_push(&entry);
+        if ((entry.minute & MINUTE_UPTIME) && !(minute & MINUTE_UPTIME)) {
+            rebase_uptime_entries(minute, sample->timestamp_ms);
+        }
+#if CONFIG_CLIMATE_HISTORY_FLASH
+        else if (!(entry.minute & MINUTE_UPTIME)) {
+            flash_append(&entry);
+        }
+#endif
+        xSemaphoreGive(history_lock);
+
+        current.samples = 0;
+    }
+
+    if (current.samples == 0) {
+        acc_reset(&current, minute);
+    }
+    history_entry_t e;
+    entry_from_sample(sample, &e);
+    acc_add(&current, &e);
+    return PIPELINE_PASS;
+}
+
+/**
+ * Append the open bucket as a row; false (and next set) if the reply is full
+ */
+static bool query_emit(history_query_t *q)
+{
+    const history_acc_t *b = &q->bucket;
+    char iaq[16] = "null";
+    char soil[8] = "null";
+    if (b->iaq_samples > 0) {
+        snprintf(iaq, sizeof(iaq), "%.1f", div_round(b->iaq, b->iaq_samples) / 10.0);
+    }
+    if (b->soil_samples > 0) {
+        snprintf(soil, sizeof(soil), "%d", (int)div_round(b->soil_moisture, b->soil_samples));
+    }
+
+    char row[ROW_MAX];
+    int len = snprintf(row, sizeof(row), "%s[%lu,%.2f,%.2f,%.2f,%.2f,%.2f,%.3f,%s,%s,%lu]",
+                       q->rows > 0 ? "," : "", (unsigned long)(b->minute - q->from),
+                       div_round(b->temperature, b->samples) / 100.0,
+                       b->temperature_min / 100.0, b->temperature_max / 100.0,
+                       div_round(b->humidity, b->samples) / 100.0,
+                       (div_round(b->pressure, b->samples) + PRESSURE_OFFSET_PA) / 100.0,
+                       div_round(b->vpd, b->samples) / 1000.0,
+                       iaq, soil, (unsigned long)b->samples);
+
+    if (q->len + len >= q->size) {
+        q->next = b->minute;
+        return false;
+    }
+    memcpy(q->buf + q->len, row, len + 1);
+    q->len += len;
+    q->rows++;
+    return true;
+}
+
+/**
+ * Fold one entry (oldest first) into the open bucket; false once the reply is full
+ */
+static bool query_feed(history_query_t *q, const history_entry_t *e)
+{
+    if ((e->minute & MINUTE_UPTIME) || e->minute < q->from || e->minute >= q->to) {
+        return true;
+    }
+
+    uint32_t bucket = q->from + (e->minute - q->from) / q->step * q->step;
+    if (q->bucket.samples > 0 && bucket != q->bucket.minute) {
+        if (bucket < q->bucket.minute) {
+            return true;            // Clock stepped back; keep the order
+        }
+        if (!query_emit(q)) {
+            return false;
+        }
+        q->bucket.samples = 0;
+    }
+
+    if (q->bucket.samples == 0) {
+        acc_reset(&q->bucket, bucket);
+    }
+    acc_add(&q->bucket, e);
+    return true;
+}
+
+#if CONFIG_CLIMATE_HISTORY_FLASH
+/**
+ * Feed flash entries older than before, oldest sector first
+ */
+static bool query_flash(history_query_t *q, uint32_t before)
+{
+    if (flash_part == NULL || flash_sector < 0) {
+        return true;
+    }
+
+    history_entry_t chunk[FLASH_READ_CHUNK];
+    for (int i = 1; i <= flash_sectors; i++) {
+        int sector = (flash_sector + i) % flash_sectors;
+        flash_header_t header;
+        if (esp_partition_read(flash_part, (size_t)sector * FLASH_SECTOR_SIZE, &header, sizeof(header)) != ESP_OK ||
+            header.magic != FLASH_MAGIC) {
+            continue;
+        }
+
+        bool sector_done = false;
+        for (int slot = 0; slot < FLASH_SECTOR_ENTRIES && !sector_done; slot += FLASH_READ_CHUNK) {
+            int n = FLASH_SECTOR_ENTRIES - slot < FLASH_READ_CHUNK ? FLASH_SECTOR_ENTRIES - slot : FLASH_READ_CHUNK;
+            if (esp_partition_read(flash_part, entry_offset(sector, slot), chunk, n * sizeof(chunk[0])) != ESP_OK) {
+                break;
+            }
+            for (int k = 0; k < n; k++) {
+                if (chunk[k].minute == UINT32_MAX) {
+                    sector_done = true;
+                    break;
+                }
+                if (chunk[k].minute >= before || chunk[k].minute >= q->to) {
+                    return true;
+                }
+                if (!query_feed(q, &chunk[k])) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+#endif
+
+/**
+ * RPC "history": {"from": s, "to": s, "step_min": n}, see history.h
+ */
+static esp_err_t rpc_history(const cJSON *params, cJSON *result, int64_t deadline_us)
+{
+    // Only minutes on Unix time are queryable
+    if (!time_sync_is_valid()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    cJSON *from_item = cJSON_GetObjectItem(params, "from");
+    cJSON *to_item = cJSON_GetObjectItem(params, "to");
+    cJSON *step_item = cJSON_GetObjectItem(params, "step_min");
+
+    uint32_t to = (uint32_t)(tv.tv_sec / 60) + 1;
+    if (cJSON_IsNumber(to_item)) {
+        if (to_item->valuedouble <= 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        to = (uint32_t)((to_item->valuedouble + 59) / 60);
+    }
+    uint32_t from = to > DEFAULT_RANGE_MIN ? to - DEFAULT_RANGE_MIN : 0;
+    if (cJSON_IsNumber(from_item)) {
+        if (from_item->valuedouble < 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        from = (uint32_t)(from_item->valuedouble / 60);
+    }
+    if (from >= to) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t step = (to - from + DEFAULT_POINTS - 1) / DEFAULT_POINTS;
+    if (cJSON_IsNumber(step_item)) {
+        if (step_item->valueint < 1 || step_item->valueint > MAX_STEP_MIN) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        step = step_item->valueint;
+    }
+
+    history_query_t q = {
+        .from = from,
+        .to = to,
+        .step = step,
+        .size = CONFIG_RPC_MAX_REPLY - REPLY_OVERHEAD - 1,      // Room for the closing bracket
+        .len = 1,
+    };
+    q.buf = malloc(q.size + 1);
+    if (q.buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    q.buf[0] = '[';
+
+    xSemaphoreTake(history_lock, portMAX_DELAY);
+    int start = (ring_head - ring_count + HISTORY_CAPACITY) % HISTORY_CAPACITY;
+    bool more = true;
+#if CONFIG_CLIMATE_HISTORY_FLASH
+    // Flash holds everything on Unix time; take from it only what RAM no longer has
+    uint32_t ram_oldest = UINT32_MAX;
+    for (int i = 0; i < ring_count && ram_oldest == UINT32_MAX; i++) {
+        uint32_t minute = ring[(start + i) % HISTORY_CAPACITY].minute;
+        if (!(minute & MINUTE_UPTIME)) {
+            ram_oldest = minute;
+        }
+    }
+    if (from < ram_oldest) {
+        more = query_flash(&q, ram_oldest);
+    }
+#endif
+    for (int i = 0; i < ring_count && more; i++) {
+        more = query_feed(&q, &ring[(start + i) % HISTORY_CAPACITY]);
+    }
+    xSemaphoreGive(history_lock);
+
+    if (more && q.bucket.samples > 0) {
+        query_emit(&q);
+    }
+    q.buf[q.len++] = ']';
+    q.buf[q.len] = '\0';
+
+    cJSON_AddNumberToObject(result, "from", (double)from * 60);
+    cJSON_AddNumberToObject(result, "step_s", step * 60);
+    cJSON_AddRawToObject(result, "columns",
+            "[\"minute\",\"temperature\",\"temperature_min\",\"temperature_max\",\"humidity\","
+            "\"pressure\",\"vpd\",\"iaq\",\"soil_moisture\",\"samples\"]");
+    cJSON_AddRawToObject(result, "rows", q.buf);
+    if (q.next != 0) {
+        cJSON_AddNumberToObject(result, "next", (double)q.next * 60);
+    }
+    free(q.buf);
+    return ESP_OK;
+}
+
+void history_init(void)
+{
+    if (history_lock == NULL) {
+        history_lock = xSemaphoreCreateMutex();
+    }
+#if CONFIG_CLIMATE_HISTORY_FLASH
+    flash_open();
+#endif
+    rpc_server_register("history", rpc_history);
+
+    ESP_LOGI(TAG, "%d minutes of 1-minute aggregates in RAM (%d bytes)",
+             HISTORY_CAPACITY, (int)sizeof(ring));
+}
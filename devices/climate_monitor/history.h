@@ -0,0 +1,31 @@
+#pragma once
+
+#include "pipeline/pipeline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Set up the ring (and the flash spill, if enabled)
+ *
+ * Registers the "history" RPC method:
+ *   {"from": 1735689600, "to": 1735776000, "step_min": 15}
+ * All parameters are optional (default: the last 24 h, downsampled to
+ * fit one reply). Times are Unix seconds; the reply holds rows of
+ *   [minutes after "from", temperature, min, max, humidity, pressure, vpd, iaq, soil, samples]
+ * and "next" when the range did not fit, to continue from.
+ */
+void history_init(void);
+
+/**
+ * @brief Pipeline stage: add a sample to the current minute
+ *
+ * Sensor task only. Minutes before the clock was first set are kept and
+ * moved onto Unix time once it is; until then they are not queryable.
+ */
+pipeline_result_t history_process(void *ctx, pipeline_sample_t *sample);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,243 @@
+/*
+ * Climate Monitor Device - Indoor air quality estimate
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Turns raw BME680 gas resistance into a stable 0-500 IAQ index by tracking a
+ * humidity-compensated clean-air baseline per sensor. The baseline is an
+ * asymmetric EMA: it rises quickly toward clean air and decays slowly, so
+ * sensor drift is followed while pollution events are not learned away.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "iaq.h"
+
+static const char *TAG = "iaq";
+
+// NVS storage for the baseline checkpoints, one key per mux channel
+#define NVS_NAMESPACE               "iaq"
+#define NVS_KEY_STATE               "state"                 // Root bus (no mux)
+#define IAQ_STATE_VERSION           1
+#define CHANNEL_SLOTS               9                       // 8 mux channels + root bus
+
+// Timing
+#define IAQ_WARMUP_MS               (5 * 60 * 1000)         // Heater settle after power-on
+#define IAQ_BURN_IN_S               (4 * 3600)              // Baseline usable after this
+#define IAQ_FULL_CONFIDENCE_S       (24 * 3600)             // ...and trusted after this
+#define IAQ_CHECKPOINT_INTERVAL_MS  (2 * 3600 * 1000LL)     // NVS write at most every 2 h
+#define IAQ_MAX_STEP_S              10.0f                   // Cap dt across gaps in sampling
+
+// Baseline tracking time constants
+#define BASELINE_TAU_UP_S           (10 * 60.0f)
+#define BASELINE_TAU_DOWN_S         (12 * 3600.0f)
+
+// Humidity compensation: MOX resistance falls as absolute humidity rises
+#define HUM_COMP_REF_G_M3           10.0f
+#define HUM_COMP_SLOPE              0.03f                   // per g/m³
+#define HUM_COMP_MIN                0.5f
+#define HUM_COMP_MAX                2.0f
+
+// Index weighting: 25 % humidity, 75 % gas
+#define HUM_OPTIMUM_PCT             40.0f
+#define HUM_WEIGHT                  25.0f
+#define GAS_WEIGHT                  75.0f
+
+typedef struct {
+    uint8_t version;
+    float baseline_ohm;
+    uint32_t learned_s;
+} iaq_checkpoint_t;
+
+/**
+ * Baseline of one sensor; each BME680 has its own clean-air resistance
+ */
+typedef struct {
+    float baseline_ohm;
+    float learned_s;
+    int64_t last_update_ms;
+} iaq_channel_t;
+
+// Estimator state
+static iaq_channel_t channels[CHANNEL_SLOTS];
+static int64_t boot_ms = -1;
+static int64_t last_checkpoint_ms = 0;
+
+static int channel_slot(uint8_t channel)
+{
+    return channel < CHANNEL_SLOTS - 1 ? channel : CHANNEL_SLOTS - 1;
+}
+
+/**
+ * NVS key of a slot: "state" on the root bus (as before the mux), "state_chN" behind it
+ */
+static void channel_key(int slot, char *key, size_t size)
+{
+    if (slot == CHANNEL_SLOTS - 1) {
+        snprintf(key, size, "%s", NVS_KEY_STATE);
+    } else {
+        snprintf(key, size, "%s_ch%d", NVS_KEY_STATE, slot);
+    }
+}
+
+static bool load_checkpoint(nvs_handle_t nvs_handle, int slot)
+{
+    char key[16];
+    channel_key(slot, key, sizeof(key));
+
+    iaq_checkpoint_t cp = {0};
+    size_t len = sizeof(cp);
+    esp_err_t err = nvs_get_blob(nvs_handle, key, &cp, &len);
+    if (err != ESP_OK || len != sizeof(cp) || cp.version != IAQ_STATE_VERSION || !(cp.baseline_ohm > 0)) {
+        return false;
+    }
+
+    channels[slot].baseline_ohm = cp.baseline_ohm;
+    channels[slot].learned_s = cp.learned_s;
+    return true;
+}
+
+void iaq_checkpoint(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to open NVS for writing: %s", esp_err_to_name(err));
+        return;
+    }
+
+    int saved = 0;
+    for (int slot = 0; slot < CHANNEL_SLOTS && err == ESP_OK; slot++) {
+        const iaq_channel_t *ch = &channels[slot];
+        if (!(ch->baseline_ohm > 0)) {
+            continue;
+        }
+        char key[16];
+        channel_key(slot, key, sizeof(key));
+        iaq_checkpoint_t cp = {
+            .version = IAQ_STATE_VERSION,
+            .baseline_ohm = ch->baseline_ohm,
+            .learned_s = (uint32_t)ch->learned_s,
+        };
+        err = nvs_set_blob(nvs_handle, key, &cp, sizeof(cp));
+        saved++;
+    }
+    if (err == ESP_OK && saved > 0) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err == ESP_OK) {
+        if (saved > 0) {
+            ESP_LOGI(TAG, "[NVS] Checkpointed %d IAQ baseline(s)", saved);
+        }
+    } else {
+        ESP_LOGE(TAG, "[NVS] Failed to checkpoint IAQ baselines: %s", esp_err_to_name(err));
+    }
+}
+
+void iaq_init(void)
+{
+    boot_ms = -1;
+    memset(channels, 0, sizeof(channels));
+    for (int slot = 0; slot < CHANNEL_SLOTS; slot++) {
+        channels[slot].last_update_ms = -1;
+    }
+
+    int restored = 0;
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        for (int slot = 0; slot < CHANNEL_SLOTS; slot++) {
+            if (load_checkpoint(nvs_handle, slot)) {
+                ESP_LOGI(TAG, "[NVS] Restored IAQ baseline %.0f Ohm (%lus learned) for %s%d",
+                         channels[slot].baseline_ohm, (unsigned long)channels[slot].learned_s,
+                         slot == CHANNEL_SLOTS - 1 ? "root bus" : "channel ",
+                         slot == CHANNEL_SLOTS - 1 ? 0 : slot);
+                restored++;
+            }
+        }
+        nvs_close(nvs_handle);
+    }
+    if (restored == 0) {
+        ESP_LOGI(TAG, "No IAQ baseline stored, starting %d h burn-in", IAQ_BURN_IN_S / 3600);
+    }
+}
+
+static float humidity_score(float humidity_pct)
+{
+    float offset = humidity_pct - HUM_OPTIMUM_PCT;
+    float score = offset > 0 ? (100.0f - HUM_OPTIMUM_PCT - offset) / (100.0f - HUM_OPTIMUM_PCT)
+                             : (HUM_OPTIMUM_PCT + offset) / HUM_OPTIMUM_PCT;
+    if (score < 0) {
+        score = 0;
+    }
+    return score * HUM_WEIGHT;
+}
+
+void iaq_update(uint8_t channel, float gas_ohm, float humidity_pct, int32_t abs_humidity_mg_m3,
+                int64_t now_ms, iaq_result_t *out)
+{
+    iaq_channel_t *ch = &channels[channel_slot(channel)];
+    if (boot_ms < 0) {
+        boot_ms = now_ms;
+        last_checkpoint_ms = now_ms;
+    }
+
+    float dt_s = ch->last_update_ms < 0 ? 0 : (now_ms - ch->last_update_ms) / 1000.0f;
+    if (dt_s > IAQ_MAX_STEP_S) {
+        dt_s = IAQ_MAX_STEP_S;
+    }
+    ch->last_update_ms = now_ms;
+
+    float comp = 1.0f + HUM_COMP_SLOPE * (abs_humidity_mg_m3 / 1000.0f - HUM_COMP_REF_G_M3);
+    if (comp < HUM_COMP_MIN) {
+        comp = HUM_COMP_MIN;
+    } else if (comp > HUM_COMP_MAX) {
+        comp = HUM_COMP_MAX;
+    }
+    float compensated = gas_ohm * comp;
+
+    out->compensated_ohm = compensated;
+    out->baseline_ohm = ch->baseline_ohm;
+
+    // Heater still settling: readings drift upward and must not enter the baseline
+    if (now_ms - boot_ms < IAQ_WARMUP_MS || !(gas_ohm > 0)) {
+        out->iaq = 0;
+        out->accuracy = IAQ_ACCURACY_UNRELIABLE;
+        return;
+    }
+
+    if (!(ch->baseline_ohm > 0)) {
+        ch->baseline_ohm = compensated;
+    } else {
+        float tau = compensated > ch->baseline_ohm ? BASELINE_TAU_UP_S : BASELINE_TAU_DOWN_S;
+        ch->baseline_ohm += (compensated - ch->baseline_ohm) * (dt_s / tau);
+    }
+    ch->learned_s += dt_s;
+
+    float ratio = compensated / ch->baseline_ohm;
+    if (ratio > 1.0f) {
+        ratio = 1.0f;
+    }
+    float air_quality = humidity_score(humidity_pct) + ratio * GAS_WEIGHT;    // 0..100, higher is better
+    int iaq = (int)((100.0f - air_quality) * 5.0f + 0.5f);
+
+    out->iaq = iaq < 0 ? 0 : (iaq > 500 ? 500 : iaq);
+    out->baseline_ohm = ch->baseline_ohm;
+    if (ch->learned_s >= IAQ_FULL_CONFIDENCE_S) {
+        out->accuracy = IAQ_ACCURACY_HIGH;
+    } else if (ch->learned_s >= IAQ_BURN_IN_S) {
+        out->accuracy = IAQ_ACCURACY_MEDIUM;
+    } else {
+        out->accuracy = IAQ_ACCURACY_LOW;
+    }
+
+    // Infrequent checkpoints keep flash wear negligible
+    if (now_ms - last_checkpoint_ms >= IAQ_CHECKPOINT_INTERVAL_MS) {
+        last_checkpoint_ms = now_ms;
+        iaq_checkpoint();
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief IAQ estimate accuracy, following the BSEC convention
+ */
+typedef enum {
+    IAQ_ACCURACY_UNRELIABLE = 0,    // Heater warming up, index not meaningful
+    IAQ_ACCURACY_LOW,               // Baseline still being learned (burn-in)
+    IAQ_ACCURACY_MEDIUM,            // Baseline learned this boot or restored
+    IAQ_ACCURACY_HIGH,              // Baseline has tracked a full day of samples
+} iaq_accuracy_t;
+
+/**
+ * @brief Result of one IAQ update
+ */
+typedef struct {
+    uint16_t iaq;               // 0 (excellent) .. 500 (hazardous)
+    iaq_accuracy_t accuracy;
+    float baseline_ohm;         // Clean-air, humidity-compensated gas resistance
+    float compensated_ohm;      // Current humidity-compensated gas resistance
+} iaq_result_t;
+
+/**
+ * @brief Initialize the estimator and restore the baselines from NVS
+ *
+ * Each sensor has its own baseline, kept per mux channel, so a dropout that
+ * makes another sensor primary does not score it against the wrong one. A
+ * restored baseline skips the multi-hour burn-in; only the short heater
+ * warm-up after power-on is repeated.
+ */
+void iaq_init(void);
+
+/**
+ * @brief Feed one gas measurement (O(1))
+ *
+ * @param channel             Mux channel of the sensor, 0xFF on the root bus
+ * @param gas_ohm             Raw gas resistance
+ * @param humidity_pct        Relative humidity
+ * @param abs_humidity_mg_m3  Absolute humidity (from psychro_compute)
+ * @param now_ms              Monotonic time in milliseconds
+ * @param out                 Current estimate
+ */
+void iaq_update(uint8_t channel, float gas_ohm, float humidity_pct, int32_t abs_humidity_mg_m3,
+                int64_t now_ms, iaq_result_t *out);
+
+/**
+ * @brief Write the baselines to NVS now (also done periodically by iaq_update)
+ */
+void iaq_checkpoint(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,293 @@
+/*
+ * Climate Monitor - BH1750 light sensor with on-device DLI
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Samples illuminance at 4 Hz, converts it to PPFD and integrates the Daily
+ * Light Integral locally, so only the current value and the running and
+ * final daily integrals go over MQTT. Integration uses the trapezoid rule
+ * in 64-bit fixed point (picomol/m²) and resets at local midnight.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <bh1750.h>
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "light_sensor.h"
+#include "mqtt_client_manager.h"
+#include "time_sync.h"
+
+#define BH1750_I2C_ADDR             BH1750_ADDR_LO
+// Shortest measurement time extends the range from 65 klx to ~146 klx for
+// direct sun; the driver assumes the default of 69, so readings are rescaled
+#define BH1750_MTREG_DEFAULT        69
+#define BH1750_MTREG                31
+
+#define SAMPLE_PERIOD_MS            250
+#define MAX_INTEGRATION_GAP_MS      2000        // Don't extrapolate across read failures
+#define PUBLISH_INTERVAL_MS         60000
+#define CHECKPOINT_INTERVAL_MS      (10 * 60 * 1000)
+#define SETUP_RETRY_MS              5000
+
+// PPFD per 1000 lux depends on the light source's spectrum
+#define PPFD_PER_KLUX               CONFIG_CLIMATE_LIGHT_PPFD_PER_KLUX
+
+// Integral units: lux * (PPFD/klux) * ms = 1e-12 mol/m²
+#define PMOL_PER_MOL                1000000000000ULL
+
+// NVS storage for the running integral
+#define NVS_NAMESPACE               "light"
+#define NVS_KEY_STATE               "dli"
+#define LIGHT_STATE_VERSION         1
+
+static const char *TAG = "light_sensor";
+
+typedef struct {
+    uint8_t version;
+    int32_t day;                    // year * 1000 + day of year, 0 = clock unknown
+    uint64_t integral_pmol;
+} light_state_t;
+
+static i2c_dev_t dev;
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+static TaskHandle_t light_task_handle = NULL;
+
+// Shared with readers on other tasks
+static light_sensor_values_t latest;
+static light_state_t state;
+static uint64_t saved_integral_pmol = 0;
+static portMUX_TYPE state_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Local calendar day, or 0 before the clock is set
+ */
+static int32_t current_day(void)
+{
+    if (!time_sync_is_valid()) {
+        return 0;
+    }
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    return (local.tm_year + 1900) * 1000 + local.tm_yday;
+}
+
+static void load_state(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "[NVS] No stored light integral, starting from zero");
+        return;
+    }
+
+    light_state_t stored;
+    size_t len = sizeof(stored);
+    err = nvs_get_blob(nvs_handle, NVS_KEY_STATE, &stored, &len);
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK || len != sizeof(stored) || stored.version != LIGHT_STATE_VERSION) {
+        ESP_LOGW(TAG, "[NVS] Stored light integral missing or outdated");
+        return;
+    }
+
+    state = stored;
+    saved_integral_pmol = stored.integral_pmol;
+    ESP_LOGI(TAG, "[NVS] Restored DLI %.2f mol/m² for day %ld",
+             (double)stored.integral_pmol / PMOL_PER_MOL, (long)stored.day);
+}
+
+void light_sensor_checkpoint(void)
+{
+    light_state_t snapshot;
+    portENTER_CRITICAL(&state_lock);
+    snapshot = state;
+    portEXIT_CRITICAL(&state_lock);
+
+    if (snapshot.integral_pmol == saved_integral_pmol) {
+        return;
+    }
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to open NVS for writing: %s", esp_err_to_name(err));
+        return;
+    }
+
+    err = nvs_set_blob(nvs_handle, NVS_KEY_STATE, &snapshot, sizeof(snapshot));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err == ESP_OK) {
+        saved_integral_pmol = snapshot.integral_pmol;
+    } else {
+        ESP_LOGE(TAG, "[NVS] Failed to save light integral: %s", esp_err_to_name(err));
+    }
+}
+
+static esp_err_t bh1750_configure(void)
+{
+    esp_err_t err = bh1750_setup(&dev, BH1750_MODE_CONTINUOUS, BH1750_RES_HIGH);
+    if (err == ESP_OK) {
+        err = bh1750_set_measurement_time(&dev, BH1750_MTREG);
+    }
+    return err;
+}
+
+/**
+ * Publish the final integral of a finished day (queued at QoS 1)
+ */
+static void publish_day_total(int32_t day, uint64_t integral_pmol)
+{
+    if (mqtt_client == NULL) {
+        return;
+    }
+
+    char json_payload[160];
+    snprintf(json_payload, sizeof(json_payload),
+             "{\"device_id\":\"%s\",\"dli_day\":%.3f,\"day\":%ld,\"location_x\":%d,\"location_y\":%d}",
+             CONFIG_DEVICE_ID, (double)integral_pmol / PMOL_PER_MOL, (long)day,
+             CONFIG_DEVICE_LOCATION_X, CONFIG_DEVICE_LOCATION_Y);
+    mqtt_client_manager_publish("sensor/par", json_payload, 0, 1, false);
+}
+
+static void publish_current(const light_sensor_values_t *values)
+{
+    if (!mqtt_client_manager_is_connected() || mqtt_client == NULL) {
+        return;
+    }
+
+    char json_payload[192];
+    snprintf(json_payload, sizeof(json_payload),
+             "{\"device_id\":\"%s\",\"lux\":%lu,\"ppfd\":%.1f,\"dli\":%.3f,\"location_x\":%d,\"location_y\":%d}",
+             CONFIG_DEVICE_ID, (unsigned long)values->lux, values->ppfd, values->dli,
+             CONFIG_DEVICE_LOCATION_X, CONFIG_DEVICE_LOCATION_Y);
+    mqtt_client_manager_publish("sensor/par", json_payload, 0, 0, false);
+}
+
+/**
+ * Sample, integrate and publish; runs for the lifetime of the device
+ */
+static void light_task(void *pvParameters)
+{
+    TickType_t last_wakeup = xTaskGetTickCount();
+    int64_t last_sample_ms = -1;
+    int64_t last_publish_ms = 0;
+    int64_t last_checkpoint_ms = esp_timer_get_time() / 1000;
+    int64_t last_setup_ms = 0;
+    uint32_t last_lux = 0;
+    bool configured = bh1750_configure() == ESP_OK;
+
+    while (1) {
+        vTaskDelayUntil(&last_wakeup, pdMS_TO_TICKS(SAMPLE_PERIOD_MS));
+        int64_t now_ms = esp_timer_get_time() / 1000;
+
+        if (!configured) {
+            if (now_ms - last_setup_ms >= SETUP_RETRY_MS) {
+                last_setup_ms = now_ms;
+                configured = bh1750_configure() == ESP_OK;
+                if (!configured) {
+                    ESP_LOGW(TAG, "[BH1750] Sensor not responding, retrying");
+                }
+            }
+            continue;
+        }
+
+        uint16_t raw;
+        if (bh1750_read(&dev, &raw) != ESP_OK) {
+            configured = false;
+            last_sample_ms = -1;
+            continue;
+        }
+        uint32_t lux = (uint32_t)raw * BH1750_MTREG_DEFAULT / BH1750_MTREG;
+
+        // Trapezoid between consecutive samples; a gap restarts integration
+        uint64_t increment = 0;
+        if (last_sample_ms >= 0 && now_ms - last_sample_ms <= MAX_INTEGRATION_GAP_MS) {
+            increment = (uint64_t)(last_lux + lux) * PPFD_PER_KLUX * (now_ms - last_sample_ms) / 2;
+        }
+        last_sample_ms = now_ms;
+        last_lux = lux;
+
+        int32_t day = current_day();
+        int32_t finished_day = 0;
+        uint64_t finished_integral = 0;
+
+        portENTER_CRITICAL(&state_lock);
+        if (day != 0 && day != state.day) {
+            if (state.day == 0) {
+                // First sync: the integral so far belongs to today
+                state.day = day;
+            } else {
+                finished_day = state.day;
+                finished_integral = state.integral_pmol;
+                state.day = day;
+                state.integral_pmol = 0;
+            }
+        }
+        state.integral_pmol += increment;
+        latest.lux = lux;
+        latest.ppfd = lux * PPFD_PER_KLUX / 1000.0f;
+        latest.dli = (double)state.integral_pmol / PMOL_PER_MOL;
+        light_sensor_values_t values = latest;
+        portEXIT_CRITICAL(&state_lock);
+
+        if (finished_day != 0) {
+            ESP_LOGI(TAG, "DLI for day %ld: %.2f mol/m²", (long)finished_day,
+                     (double)finished_integral / PMOL_PER_MOL);
+            publish_day_total(finished_day, finished_integral);
+            light_sensor_checkpoint();
+            last_checkpoint_ms = now_ms;
+        }
+
+        if (now_ms - last_publish_ms >= PUBLISH_INTERVAL_MS) {
+            last_publish_ms = now_ms;
+            publish_current(&values);
+        }
+
+        if (now_ms - last_checkpoint_ms >= CHECKPOINT_INTERVAL_MS) {
+            last_checkpoint_ms = now_ms;
+            light_sensor_checkpoint();
+        }
+    }
+}
+
+void light_sensor_init(esp_mqtt_client_handle_t client, int port, int sda, int scl)
+{
+    mqtt_client = client;
+
+    memset(&state, 0, sizeof(state));
+    state.version = LIGHT_STATE_VERSION;
+    load_state();
+
+    memset(&dev, 0, sizeof(dev));
+    esp_err_t err = bh1750_init_desc(&dev, BH1750_I2C_ADDR, port, sda, scl);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[BH1750] Failed to create device descriptor: %s", esp_err_to_name(err));
+        return;
+    }
+    dev.cfg.sda_pullup_en = 1;
+    dev.cfg.scl_pullup_en = 1;
+
+    ESP_LOGI(TAG, "[BH1750] Light sensor at 0x%02x, %d µmol/m²/s per klx", BH1750_I2C_ADDR, PPFD_PER_KLUX);
+
+    if (light_task_handle == NULL) {
+        xTaskCreate(light_task, "light_sensor", 3072, NULL, 4, &light_task_handle);
+    }
+}
+
+void light_sensor_get(light_sensor_values_t *out)
+{
+    portENTER_CRITICAL(&state_lock);
+    *out = latest;
+    portEXIT_CRITICAL(&state_lock);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include "mqtt_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Current light reading and running daily integral
+ */
+typedef struct {
+    uint32_t lux;
+    float ppfd;                 // µmol/m²/s
+    float dli;                  // mol/m²/day, integrated since local midnight
+} light_sensor_values_t;
+
+/**
+ * @brief Initialize the BH1750 and start the integration task
+ *
+ * The sensor shares the BME680's I2C bus. Integration runs in its own task
+ * at a few Hz and does not stop when MQTT disconnects; the running integral
+ * is restored from NVS so a reboot does not lose the day's light.
+ *
+ * @param client MQTT client handle from mqtt_client_manager
+ * @param port   I2C port already used by the BME680
+ * @param sda    SDA GPIO
+ * @param scl    SCL GPIO
+ */
+void light_sensor_init(esp_mqtt_client_handle_t client, int port, int sda, int scl);
+
+/**
+ * @brief Snapshot of the latest reading and integral
+ *
+ * @param out Values; zeroed before the first successful read
+ */
+void light_sensor_get(light_sensor_values_t *out);
+
+/**
+ * @brief Write the running integral to NVS now (also done periodically)
+ */
+void light_sensor_checkpoint(void);
+
+#ifdef __cplusplus
+}
+#endif
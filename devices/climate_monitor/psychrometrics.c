@@ -0,0 +1,109 @@
+/*
+ * Climate Monitor Device - Fixed-point psychrometrics
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Integer-only VPD, dew point and absolute humidity for FPU-less targets
+ * (ESP32-C3). Kept free of ESP-IDF dependencies so it can be built and
+ * validated on the host.
+ */
+
+#include "psychrometrics.h"
+
+#define SVP_TABLE_MIN_C     (-40)
+#define SVP_TABLE_MAX_C     60
+#define SVP_TABLE_SIZE      (SVP_TABLE_MAX_C - SVP_TABLE_MIN_C + 1)
+
+// 0.6108 kPa * exp(17.27 * T / (T + 237.3)) in 0.001 Pa, T = -40..60 °C
+static const int32_t svp_table_milli_pa[SVP_TABLE_SIZE] = {
+    18421, 20455, 22690, 25143, 27833, 30779, 34004, 37531,
+    41383, 45587, 50172, 55167, 60604, 66518, 72945, 79923,
+    87493, 95700, 104589, 114210, 124615, 135860, 148002, 161105,
+    175233, 190456, 206847, 224483, 243446, 263822, 285702, 309180,
+    334356, 361338, 390234, 421163, 454245, 489610, 527393, 567733,
+    610780, 656688, 705618, 757742, 813234, 872282, 935079, 1001826,
+    1072734, 1148023, 1227922, 1312671, 1402518, 1497722, 1598553, 1705290,
+    1818227, 1937666, 2063922, 2197321, 2338205, 2486924, 2643845, 2809346,
+    2983820, 3167674, 3361330, 3565223, 3779807, 4005546, 4242926, 4492445,
+    4754620, 5029983, 5319086, 5622497, 5940803, 6274610, 6624541, 6991240,
+    7375372, 7777620, 8198687, 8639300, 9100204, 9582169, 10085984, 10612463,
+    11162441, 11736777, 12336356, 12962083, 13614890, 14295735, 15005598, 15745489,
+    16516440, 17319512, 18155793, 19026397, 19932466,
+};
+
+static inline int32_t clamp_i32(int32_t v, int32_t lo, int32_t hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+/**
+ * Saturation vapour pressure in 0.001 Pa
+ */
+int32_t psychro_svp_milli_pa(int32_t temp_centi_c)
+{
+    temp_centi_c = clamp_i32(temp_centi_c, SVP_TABLE_MIN_C * 100, SVP_TABLE_MAX_C * 100);
+
+    int32_t offset = temp_centi_c - SVP_TABLE_MIN_C * 100;     // >= 0
+    int32_t idx = offset / 100;
+    int32_t frac = offset % 100;                                // 0.01 °C into the segment
+
+    if (idx >= SVP_TABLE_SIZE - 1) {
+        return svp_table_milli_pa[SVP_TABLE_SIZE - 1];
+    }
+
+    int32_t lo = svp_table_milli_pa[idx];
+    int32_t hi = svp_table_milli_pa[idx + 1];
+    return lo + ((hi - lo) * frac + 50) / 100;
+}
+
+/**
+ * Invert the SVP table: temperature (0.01 °C) at which SVP equals pressure
+ */
+static int32_t svp_inverse_centi_c(int32_t pressure_milli_pa)
+{
+    if (pressure_milli_pa <= svp_table_milli_pa[0]) {
+        return SVP_TABLE_MIN_C * 100;
+    }
+    if (pressure_milli_pa >= svp_table_milli_pa[SVP_TABLE_SIZE - 1]) {
+        return SVP_TABLE_MAX_C * 100;
+    }
+
+    // Binary search for the segment containing the pressure
+    int32_t lo_idx = 0;
+    int32_t hi_idx = SVP_TABLE_SIZE - 1;
+    while (hi_idx - lo_idx > 1) {
+        int32_t mid = (lo_idx + hi_idx) / 2;
+        if (svp_table_milli_pa[mid] <= pressure_milli_pa) {
+            lo_idx = mid;
+        } else {
+            hi_idx = mid;
+        }
+    }
+
+    int32_t lo = svp_table_milli_pa[lo_idx];
+    int32_t hi = svp_table_milli_pa[hi_idx];
+    int32_t frac = (int32_t)(((int64_t)(pressure_milli_pa - lo) * 100 + (hi - lo) / 2) / (hi - lo));
+    return (SVP_TABLE_MIN_C + lo_idx) * 100 + frac;
+}
+
+/**
+ * Compute derived humidity metrics
+ */
+void psychro_compute(int32_t temp_centi_c, int32_t rh_centi_pct, psychro_values_t *out)
+{
+    temp_centi_c = clamp_i32(temp_centi_c, SVP_TABLE_MIN_C * 100, SVP_TABLE_MAX_C * 100);
+    rh_centi_pct = clamp_i32(rh_centi_pct, 0, 10000);
+
+    int32_t svp = psychro_svp_milli_pa(temp_centi_c);
+    int32_t vapour = (int32_t)(((int64_t)svp * rh_centi_pct + 5000) / 10000);
+
+    out->svp_pa = (svp + 500) / 1000;
+    out->vapour_pressure_pa = (vapour + 500) / 1000;
+    out->vpd_pa = (svp - vapour + 500) / 1000;
+    out->dew_point_centi_c = svp_inverse_centi_c(vapour);
+
+    // AH = e / (Rv * T), Rv = 461.5 J/(kg K): mg/m³ = e[0.001 Pa] * 2e5 / (923 * T[0.01 K])
+    int64_t temp_centi_k = (int64_t)temp_centi_c + 27315;
+    out->abs_humidity_mg_m3 = (int32_t)(((int64_t)vapour * 200000 + (923 * temp_centi_k) / 2) /
+                                        (923 * temp_centi_k));
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed-point psychrometrics (no floating point, no exp/log)
+ *
+ * Saturation vapour pressure follows the same Tetens/Magnus form used by the
+ * analysis code (visualization/data_generator.py):
+ *
+ *     SVP(T) = 0.6108 kPa * exp(17.27 * T / (T + 237.3))
+ *
+ * evaluated as a 1 °C lookup table with linear interpolation. Dew point is the
+ * inverse of the same table. Valid for -40..60 °C; inputs outside are clamped.
+ *
+ * Worst-case error against the reference formula over the valid range
+ * (checked on the host by scripts/validate_psychrometrics.py):
+ *     SVP / VPD       < 0.1 % relative (+1 Pa rounding)
+ *     Dew point       < 0.02 °C
+ *     Abs. humidity   < 0.1 % relative (+1 mg/m³ rounding)
+ */
+
+/**
+ * @brief Derived humidity metrics
+ */
+typedef struct {
+    int32_t svp_pa;                 // Saturation vapour pressure (Pa)
+    int32_t vapour_pressure_pa;     // Actual vapour pressure (Pa)
+    int32_t vpd_pa;                 // Vapour pressure deficit (Pa)
+    int32_t dew_point_centi_c;      // Dew point (0.01 °C)
+    int32_t abs_humidity_mg_m3;     // Absolute humidity (mg/m³)
+} psychro_values_t;
+
+/**
+ * @brief Saturation vapour pressure
+ *
+ * @param temp_centi_c Temperature in 0.01 °C
+ * @return SVP in 0.001 Pa
+ */
+int32_t psychro_svp_milli_pa(int32_t temp_centi_c);
+
+/**
+ * @brief Compute VPD, dew point and absolute humidity
+ *
+ * @param temp_centi_c  Temperature in 0.01 °C
+ * @param rh_centi_pct  Relative humidity in 0.01 % (clamped to 0..100 %)
+ * @param out           Result
+ */
+void psychro_compute(int32_t temp_centi_c, int32_t rh_centi_pct, psychro_values_t *out);
+
+#ifdef __cplusplus
+}
+#endif
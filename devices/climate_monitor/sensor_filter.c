@@ -0,0 +1,74 @@
+/*
+ * Climate Monitor Device - Alpha-beta sensor filter
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ */
+
+#include <math.h>
+#include "sensor_filter.h"
+
+#define Q_STATE     12
+#define Q_GAIN      16
+
+void sensor_filter_init(sensor_filter_t *filter, float tracking_index)
+{
+    // Steady-state gains for a constant-velocity model (Kalata, 1984)
+    float lambda = tracking_index > 0 ? tracking_index : 1e-6f;
+    float r = (4.0f + lambda - sqrtf(8.0f * lambda + lambda * lambda)) / 4.0f;
+    float alpha = 1.0f - r * r;
+    float beta = 2.0f * (2.0f - alpha) - 4.0f * sqrtf(1.0f - alpha);
+
+#if CONFIG_CLIMATE_SENSOR_FILTER_FIXED_POINT
+    filter->alpha = (int32_t)(alpha * (1 << Q_GAIN) + 0.5f);
+    filter->beta = (int32_t)(beta * (1 << Q_GAIN) + 0.5f);
+    if (filter->alpha < 1) {
+        filter->alpha = 1;
+    }
+#else
+    filter->alpha = alpha;
+    filter->beta = beta;
+#endif
+    sensor_filter_reset(filter);
+}
+
+void sensor_filter_reset(sensor_filter_t *filter)
+{
+    filter->x = 0;
+    filter->v = 0;
+    filter->primed = false;
+}
+
+int32_t sensor_filter_update(sensor_filter_t *filter, int32_t measurement)
+{
+#if CONFIG_CLIMATE_SENSOR_FILTER_FIXED_POINT
+    int32_t z = measurement * (1 << Q_STATE);
+    if (!filter->primed) {
+        filter->x = z;
+        filter->v = 0;
+        filter->primed = true;
+        return measurement;
+    }
+
+    int32_t predicted = filter->x + filter->v;
+    int64_t residual = (int64_t)z - predicted;
+    filter->x = predicted + (int32_t)((residual * filter->alpha) >> Q_GAIN);
+    filter->v += (int32_t)((residual * filter->beta) >> Q_GAIN);
+
+    return (filter->x + (1 << (Q_STATE - 1))) >> Q_STATE;
+#else
+    float z = (float)measurement;
+    if (!filter->primed) {
+        filter->x = z;
+        filter->v = 0;
+        filter->primed = true;
+        return measurement;
+    }
+
+    float predicted = filter->x + filter->v;
+    float residual = z - predicted;
+    filter->x = predicted + filter->alpha * residual;
+    filter->v += filter->beta * residual;
+
+    return (int32_t)lroundf(filter->x);
+#endif
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Per-channel alpha-beta filter (steady-state constant-velocity Kalman filter)
+ *
+ * Replaces the BME680's heavy oversampling and on-chip IIR as the noise
+ * reduction stage. Unlike the on-chip IIR, which is a first-order low-pass
+ * with a group delay of roughly its size in samples, the velocity term lets
+ * the filter follow ramps without a steady-state lag.
+ *
+ * Gains are derived from the tracking index
+ *
+ *     lambda = sigma_process * T^2 / sigma_measurement
+ *
+ * (Kalata), with T = one sample. Smaller lambda means more smoothing.
+ * Measurements are integers in the caller's fixed units (e.g. 0.01 °C).
+ *
+ * With CONFIG_CLIMATE_SENSOR_FILTER_FIXED_POINT the update uses only integer
+ * arithmetic (Q12 state, Q16 gains), for targets without an FPU.
+ * The trade-off is evaluated on the host by scripts/evaluate_sensor_filter.py.
+ */
+
+/**
+ * @brief Filter state for one channel
+ */
+typedef struct {
+#if CONFIG_CLIMATE_SENSOR_FILTER_FIXED_POINT
+    int32_t x;          // Position estimate (Q12, caller units)
+    int32_t v;          // Velocity estimate (Q12, caller units per sample)
+    int32_t alpha;      // Q16
+    int32_t beta;       // Q16
+#else
+    float x;
+    float v;
+    float alpha;
+    float beta;
+#endif
+    bool primed;        // First measurement seen
+} sensor_filter_t;
+
+/**
+ * @brief Initialize a channel from its tracking index
+ *
+ * @param filter          Filter state
+ * @param tracking_index  lambda, > 0
+ */
+void sensor_filter_init(sensor_filter_t *filter, float tracking_index);
+
+/**
+ * @brief Forget the estimate; the next measurement is passed through
+ *
+ * Call after a sampling gap (e.g. sensor re-initialization) so a stale
+ * velocity is not extrapolated across it.
+ */
+void sensor_filter_reset(sensor_filter_t *filter);
+
+/**
+ * @brief Feed one measurement taken one sample period after the previous one
+ *
+ * @param filter       Filter state
+ * @param measurement  Raw value in fixed units
+ * @return Filtered value in the same units
+ */
+int32_t sensor_filter_update(sensor_filter_t *filter, int32_t measurement);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,302 @@
+/*
+ * Greenhouse Devices - Device Registry
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Static table of the device modules enabled in menuconfig. Several modules
+ * can run in one image and share the Wi-Fi connection, the MQTT session
+ * and the I2C bus; app_main only talks to the registry.
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include <i2cdev.h>
+#include <cJSON.h>
+#include "device_registry.h"
+#include "mqtt_client_manager.h"
+#include "rpc/rpc_server.h"
+#include "fleet_config/fleet_config.h"
+#include "climate_monitor/climate_monitor.h"
+#include "humidifier/humidifier.h"
+#include "light_controller/light_controller.h"
+#include "irrigation/irrigation.h"
+
+static const char *TAG = "device_registry";
+
+static const device_ops_t DEVICES[] = {
+#if CONFIG_DEVICE_CLIMATE_MONITOR
+    {
+        .name = "climate",
+        .init = climate_monitor_init,
+        .start = climate_monitor_start,
+        .apply_config = climate_monitor_apply_config,
+        .handle_command = climate_monitor_handle_command,
+    },
+#endif
+#if CONFIG_DEVICE_HUMIDIFIER
+    {
+        .name = "humidifier",
+        .init = humidifier_init,
+        .start = humidifier_start,
+        .apply_config = humidifier_apply_config,
+    },
+#endif
+#if CONFIG_DEVICE_LIGHT_CONTROLLER
+    {
+        .name = "lights",
+        .init = light_controller_init,
+        .start = light_controller_start,
+        .apply_config = light_controller_apply_config,
+        .handle_command = light_controller_handle_command,
+    },
+#endif
+#if CONFIG_DEVICE_IRRIGATION
+    {
+        .name = "irrigation",
+        .init = irrigation_init,
+        .start = irrigation_start,
+        .apply_config = irrigation_apply_config,
+        .handle_command = irrigation_handle_command,
+    },
+#endif
+};
+
+#define DEVICE_COUNT (sizeof(DEVICES) / sizeof(DEVICES[0]))
+
+_Static_assert(DEVICE_COUNT > 0, "No device module enabled! Run 'idf.py menuconfig' and enable at least one.");
+
+// Every module name, built or not, so a section for a module missing from
+// this image is not mistaken for a config key
+static const char *const MODULE_NAMES[] = {"climate", "humidifier", "lights", "irrigation"};
+
+// Keys more than one module reads; with several modules built they are only
+// taken from the module's section
+static const char *const SHARED_KEYS[] = {"enabled", "kp", "ki", "kd"};
+
+static bool in_list(const char *key, const char *const *list, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(key, list[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Module section a key belongs to: "irrigation" for {"irrigation": {...}}
+ * or "irrigation.kp", NULL for a flat key. *sub_key is the key inside it.
+ */
+static bool section_key(const char *key, char *section, size_t size, const char **sub_key)
+{
+    const char *dot = strchr(key, '.');
+    size_t len = dot != NULL ? (size_t)(dot - key) : strlen(key);
+    if (len >= size) {
+        return false;
+    }
+    memcpy(section, key, len);
+    section[len] = '\0';
+    if (!in_list(section, MODULE_NAMES, sizeof(MODULE_NAMES) / sizeof(MODULE_NAMES[0]))) {
+        return false;
+    }
+    *sub_key = dot != NULL ? dot + 1 : NULL;
+    return true;
+}
+
+static void view_set(cJSON *view, const char *key, const cJSON *value)
+{
+    cJSON *copy = cJSON_Duplicate(value, true);
+    if (cJSON_GetObjectItemCaseSensitive(view, key) != NULL) {
+        cJSON_ReplaceItemInObjectCaseSensitive(view, key, copy);
+    } else {
+        cJSON_AddItemToObject(view, key, copy);
+    }
+}
+
+/**
+ * Config as one module sees it: the flat keys, overridden by its own
+ * section ({"irrigation": {"kp": 2}} or {"irrigation.kp": 2}). Shared keys
+ * are taken flat only when the module is the only one built.
+ */
+static cJSON *module_view(const cJSON *config, const char *name)
+{
+    cJSON *view = cJSON_CreateObject();
+    if (view == NULL) {
+        return NULL;
+    }
+    bool shared_ok = DEVICE_COUNT == 1;
+    char section[16];
+    const char *sub_key;
+
+    const cJSON *item;
+    cJSON_ArrayForEach(item, config) {
+        if (section_key(item->string, section, sizeof(section), &sub_key)) {
+            continue;
+        }
+        if (!shared_ok && in_list(item->string, SHARED_KEYS, sizeof(SHARED_KEYS) / sizeof(SHARED_KEYS[0]))) {
+            continue;
+        }
+        view_set(view, item->string, item);
+    }
+
+    cJSON_ArrayForEach(item, config) {
+        if (!section_key(item->string, section, sizeof(section), &sub_key) || strcmp(section, name) != 0) {
+            continue;
+        }
+        if (sub_key != NULL) {
+            view_set(view, sub_key, item);
+        } else if (cJSON_IsObject(item)) {
+            const cJSON *entry;
+            cJSON_ArrayForEach(entry, item) {
+                view_set(view, entry->string, entry);
+            }
+        }
+    }
+    return view;
+}
+
+/**
+ * Hand each module its view of the config
+ */
+static void apply_config_json(const cJSON *config)
+{
+    if (DEVICE_COUNT > 1) {
+        const cJSON *item;
+        cJSON_ArrayForEach(item, config) {
+            if (in_list(item->string, SHARED_KEYS, sizeof(SHARED_KEYS) / sizeof(SHARED_KEYS[0]))) {
+                ESP_LOGW(TAG, "Ignoring \"%s\": several modules read it, set it in a module section",
+                         item->string);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < DEVICE_COUNT; i++) {
+        const device_ops_t *dev = &DEVICES[i];
+        cJSON *view = module_view(config, dev->name);
+        char *data = cJSON_GetArraySize(view) > 0 ? cJSON_PrintUnformatted(view) : NULL;
+        cJSON_Delete(view);
+        if (data == NULL) {
+            continue;
+        }
+        dev->apply_config(data, strlen(data));
+        cJSON_free(data);
+    }
+}
+
+/**
+ * RPC "set_config": {"device": "irrigation", "config": {...}} sets the keys
+ * in that module's section; without "device" they are taken like the config
+ * topics take them. Either way they go into this node's config layer.
+ */
+static esp_err_t rpc_set_config(const cJSON *params, cJSON *result, int64_t deadline_us)
+{
+    cJSON *config = cJSON_GetObjectItem(params, "config");
+    if (!cJSON_IsObject(config)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    cJSON *device_item = cJSON_GetObjectItem(params, "device");
+    const char *target = cJSON_IsString(device_item) ? device_item->valuestring : NULL;
+    if (target != NULL) {
+        size_t i = 0;
+        while (i < DEVICE_COUNT && strcmp(target, DEVICES[i].name) != 0) {
+            i++;
+        }
+        if (i == DEVICE_COUNT) {
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+
+    int changed;
+    if (target != NULL) {
+        // As {"irrigation": {...}}, so shared keys only reach that module
+        cJSON *doc = cJSON_CreateObject();
+        if (doc == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        cJSON_AddItemToObject(doc, target, cJSON_Duplicate(config, true));
+        changed = fleet_config_set_device(doc);
+        cJSON_Delete(doc);
+    } else {
+        changed = fleet_config_set_device(config);
+    }
+    if (changed < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    cJSON_AddNumberToObject(result, "changed", changed);
+    return ESP_OK;
+}
+
+/**
+ * Merged config from the fleet, zone and device topics
+ */
+static void apply_config_all(const char *data, int data_len)
+{
+    cJSON *config = cJSON_ParseWithLength(data, data_len);
+    if (config == NULL) {
+        return;
+    }
+    apply_config_json(config);
+    cJSON_Delete(config);
+}
+
+void device_registry_init(esp_mqtt_client_handle_t client)
+{
+    // Shared bus, brought up once for every module that uses it
+    ESP_ERROR_CHECK(i2cdev_init());
+
+    // Before the modules, which register their own methods
+    rpc_server_init();
+    rpc_server_register("set_config", rpc_set_config);
+    fleet_config_init(apply_config_all);
+
+    for (size_t i = 0; i < DEVICE_COUNT; i++) {
+        const device_ops_t *dev = &DEVICES[i];
+        ESP_LOGI(TAG, "Initializing %s module", dev->name);
+        dev->init(client);
+
+        // Control, alerts and history run on local readings; only publishing
+        // waits for the broker
+        dev->start();
+    }
+    ESP_LOGI(TAG, "%d device module(s) initialized", (int)DEVICE_COUNT);
+}
+
+void device_registry_on_connected(esp_mqtt_client_handle_t client)
+{
+    fleet_config_subscribe(client);
+}
+
+void device_registry_on_data(esp_mqtt_event_handle_t event)
+{
+    fleet_config_on_data(event);
+}
+
+void device_registry_on_command(const char *data, int data_len)
+{
+    char target[16] = "";
+    cJSON *json = cJSON_ParseWithLength(data, data_len);
+    if (json != NULL) {
+        cJSON *device_item = cJSON_GetObjectItem(json, "device");
+        if (cJSON_IsString(device_item)) {
+            strlcpy(target, device_item->valuestring, sizeof(target));
+        }
+        cJSON_Delete(json);
+    }
+
+    for (size_t i = 0; i < DEVICE_COUNT; i++) {
+        const device_ops_t *dev = &DEVICES[i];
+        if (dev->handle_command != NULL && (target[0] == '\0' || strcmp(target, dev->name) == 0)) {
+            dev->handle_command(data, data_len);
+        }
+    }
+}
+
+bool device_registry_has_commands(void)
+{
+    for (size_t i = 0; i < DEVICE_COUNT; i++) {
+        if (DEVICES[i].handle_command != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
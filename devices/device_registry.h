@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include "mqtt_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Operations every device module provides to the registry
+ */
+typedef struct {
+    const char *name;                                   // Command routing key
+    void (*init)(esp_mqtt_client_handle_t client);
+    void (*start)(void);
+    void (*apply_config)(const char *data, int data_len);     // Keys from the config topics
+    void (*handle_command)(const char *data, int data_len);    // Optional
+} device_ops_t;
+
+/**
+ * @brief Initialize every enabled device module
+ *
+ * Modules start immediately and keep running without the broker. Also
+ * brings up the RPC server, with a "set_config" method that merges config
+ * JSON into this node's layer like sensor/config/{device_id} does, and loads
+ * the stored fleet/zone/device config layers. Each module gets the flat keys
+ * plus its own section, e.g. {"humidifier": {"kp": 2}}.
+ *
+ * @param client MQTT client handle shared by all modules
+ */
+void device_registry_init(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Broker connected: subscribe to the config topics
+ */
+void device_registry_on_connected(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Handle an incoming message on the config topics
+ */
+void device_registry_on_data(esp_mqtt_event_handle_t event);
+
+/**
+ * @brief Dispatch a command from greenhouse/command/{device_id}
+ *
+ * A "device" field (e.g. {"device": "irrigation", "water_s": 60}) routes
+ * the command to that module only; without it every module that accepts
+ * commands receives it.
+ */
+void device_registry_on_command(const char *data, int data_len);
+
+/**
+ * @brief Whether any enabled module accepts commands
+ */
+bool device_registry_has_commands(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,442 @@
+/*
+ * Greenhouse Devices - Fleet Config
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Layers fleet, zone and per-device config documents so one retained
+ * publish can change a policy for every node while per-device overrides
+ * keep precedence. Each layer is kept in NVS, so a node that reboots
+ * or misses an update still merges against all three, and only the keys
+ * whose effective value changed reach the modules.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <cJSON.h>
+#include "fleet_config.h"
+#include "mqtt_client_manager.h"
+
+#define NVS_NAMESPACE               "fleet_cfg"
+#define NVS_KEY_ZONE_NAME           "zone_name"
+#define VERSION_KEY                 "version"
+
+typedef enum {
+    LAYER_FLEET = 0,
+    LAYER_ZONE,
+    LAYER_DEVICE,
+    LAYER_COUNT
+} layer_id_t;
+
+typedef struct {
+    const char *name;           // NVS key and log name
+    char topic[96];             // Empty if the layer is not used
+    cJSON *doc;                 // Current document, "version" included
+    uint32_t version;           // Last versioned document applied, 0 if none
+} layer_t;
+
+static const char *TAG = "fleet_config";
+
+// Set up by fleet_config_init(), then changed on the MQTT task (topics) and
+// the RPC workers (set_config) under layers_mutex
+static SemaphoreHandle_t layers_mutex = NULL;
+static layer_t layers[LAYER_COUNT] = {
+    [LAYER_FLEET] = { .name = "fleet" },
+    [LAYER_ZONE] = { .name = "zone" },
+    [LAYER_DEVICE] = { .name = "device" },
+};
+static fleet_config_apply_cb_t apply_cb = NULL;
+static mqtt_state_t ack_state = MQTT_STATE_INIT("config");
+static uint32_t rejected_count = 0;
+
+/**
+ * "version" of a document: 0 without one, -1 if it is not a positive integer
+ */
+static int64_t doc_version(const cJSON *doc)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(doc, VERSION_KEY);
+    if (item == NULL) {
+        return 0;
+    }
+    if (!cJSON_IsNumber(item) || item->valuedouble < 1 || item->valuedouble > UINT32_MAX ||
+        item->valuedouble != (double)(uint32_t)item->valuedouble) {
+        return -1;
+    }
+    return (int64_t)item->valuedouble;
+}
+
+/**
+ * Turn module sections ({"irrigation": {"kp": 2}}) into "irrigation.kp" keys,
+ * so a higher layer can override one key of a section without replacing it
+ */
+static void flatten_sections(cJSON *doc)
+{
+    cJSON *item = doc->child;
+    while (item != NULL) {
+        cJSON *next = item->next;
+        if (cJSON_IsObject(item)) {
+            const cJSON *entry;
+            cJSON_ArrayForEach(entry, item) {
+                char key[64];
+                snprintf(key, sizeof(key), "%s.%s", item->string, entry->string);
+                if (cJSON_GetObjectItemCaseSensitive(doc, key) == NULL) {
+                    cJSON_AddItemToObject(doc, key, cJSON_Duplicate(entry, true));
+                }
+            }
+            cJSON_Delete(cJSON_DetachItemViaPointer(doc, item));
+        }
+        item = next;
+    }
+}
+
+/**
+ * Whether a layer above this one sets the key
+ */
+static bool overridden(layer_id_t id, const char *key)
+{
+    for (int l = id + 1; l < LAYER_COUNT; l++) {
+        if (layers[l].doc != NULL && cJSON_GetObjectItemCaseSensitive(layers[l].doc, key) != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Value of a key in the highest layer below this one, NULL if none sets it
+ */
+static const cJSON *lower_value(layer_id_t id, const char *key)
+{
+    for (int l = id - 1; l >= 0; l--) {
+        const cJSON *item = layers[l].doc != NULL ? cJSON_GetObjectItemCaseSensitive(layers[l].doc, key) : NULL;
+        if (item != NULL) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Keys whose effective value changes when a layer goes from old_doc to new_doc
+ */
+static cJSON *layer_delta(layer_id_t id, const cJSON *old_doc, const cJSON *new_doc)
+{
+    cJSON *delta = cJSON_CreateObject();
+    if (delta == NULL) {
+        return NULL;
+    }
+
+    const cJSON *item;
+    cJSON_ArrayForEach(item, new_doc) {
+        if (strcmp(item->string, VERSION_KEY) == 0 || overridden(id, item->string)) {
+            continue;
+        }
+        const cJSON *old = old_doc != NULL ? cJSON_GetObjectItemCaseSensitive(old_doc, item->string) : NULL;
+        if (old == NULL || !cJSON_Compare(old, item, true)) {
+            cJSON_AddItemToObject(delta, item->string, cJSON_Duplicate(item, true));
+        }
+    }
+
+    // Keys dropped from this layer fall back to the layer below
+    if (old_doc != NULL) {
+        cJSON_ArrayForEach(item, old_doc) {
+            if (strcmp(item->string, VERSION_KEY) == 0 ||
+                cJSON_GetObjectItemCaseSensitive(new_doc, item->string) != NULL ||
+                overridden(id, item->string)) {
+                continue;
+            }
+            const cJSON *lower = lower_value(id, item->string);
+            if (lower == NULL) {
+                ESP_LOGW(TAG, "%s no longer sets \"%s\" and no layer below does, keeping it",
+                         layers[id].name, item->string);
+            } else if (!cJSON_Compare(lower, item, true)) {
+                cJSON_AddItemToObject(delta, item->string, cJSON_Duplicate(lower, true));
+            }
+        }
+    }
+    return delta;
+}
+
+/**
+ * Store a layer's document (and the zone it belongs to) in NVS
+ */
+static void save_layer(layer_id_t id)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to open NVS for writing: %s", esp_err_to_name(err));
+        return;
+    }
+
+    char *text = cJSON_PrintUnformatted(layers[id].doc);
+    err = text != NULL ? nvs_set_str(nvs_handle, layers[id].name, text) : ESP_ERR_NO_MEM;
+    cJSON_free(text);
+    if (err == ESP_OK && id == LAYER_ZONE) {
+        err = nvs_set_str(nvs_handle, NVS_KEY_ZONE_NAME, CONFIG_DEVICE_ZONE);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to save %s config: %s", layers[id].name, esp_err_to_name(err));
+    }
+}
+
+/**
+ * Read a string from NVS into a malloc'd buffer, NULL if missing
+ */
+static char *load_str(nvs_handle_t nvs_handle, const char *key)
+{
+    size_t len = 0;
+    if (nvs_get_str(nvs_handle, key, NULL, &len) != ESP_OK || len == 0) {
+        return NULL;
+    }
+    char *text = malloc(len);
+    if (text != NULL && nvs_get_str(nvs_handle, key, text, &len) != ESP_OK) {
+        free(text);
+        text = NULL;
+    }
+    return text;
+}
+
+static void load_layers(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        ESP_LOGI(TAG, "[NVS] No stored config layers");
+        return;
+    }
+
+    // A zone document only counts for the zone it was received for
+    char *zone_name = load_str(nvs_handle, NVS_KEY_ZONE_NAME);
+    bool same_zone = zone_name != NULL && strcmp(zone_name, CONFIG_DEVICE_ZONE) == 0;
+    free(zone_name);
+
+    for (int l = 0; l < LAYER_COUNT; l++) {
+        layer_t *layer = &layers[l];
+        if (layer->topic[0] == '\0' || (l == LAYER_ZONE && !same_zone)) {
+            continue;
+        }
+        char *text = load_str(nvs_handle, layer->name);
+        if (text == NULL) {
+            continue;
+        }
+        layer->doc = cJSON_Parse(text);
+        free(text);
+        if (!cJSON_IsObject(layer->doc)) {
+            cJSON_Delete(layer->doc);
+            layer->doc = NULL;
+            continue;
+        }
+        int64_t version = doc_version(layer->doc);
+        layer->version = version > 0 ? (uint32_t)version : 0;
+        ESP_LOGI(TAG, "[NVS] Loaded %s config v%" PRIu32, layer->name, layer->version);
+    }
+    nvs_close(nvs_handle);
+}
+
+/**
+ * Acknowledge the applied versions; sent on every change, not rate limited
+ */
+static void publish_ack(void)
+{
+    char json[160];
+    snprintf(json, sizeof(json),
+             "{\"fleet\":%" PRIu32 ",\"zone\":\"%s\",\"zone_version\":%" PRIu32 ",\"device\":%" PRIu32
+             ",\"rejected\":%" PRIu32 "}",
+             layers[LAYER_FLEET].version, CONFIG_DEVICE_ZONE, layers[LAYER_ZONE].version,
+             layers[LAYER_DEVICE].version, rejected_count);
+    ack_state.last_publish_ms = 0;
+    mqtt_client_manager_publish_state(&ack_state, json);
+}
+
+static void reject(layer_id_t id, const char *reason)
+{
+    rejected_count++;
+    ESP_LOGW(TAG, "Rejected %s config: %s", layers[id].name, reason);
+    publish_ack();
+}
+
+/**
+ * Put a checked, flattened document into its layer and apply what changed
+ *
+ * @return Number of keys whose effective value changed, -1 on failure
+ */
+static int apply_document(layer_id_t id, cJSON *doc, int64_t version)
+{
+    layer_t *layer = &layers[id];
+
+    // Unversioned documents patch the layer instead of replacing it
+    if (version == 0 && layer->doc != NULL) {
+        cJSON *merged = cJSON_Duplicate(layer->doc, true);
+        cJSON *item = doc->child;
+        while (merged != NULL && item != NULL) {
+            cJSON *next = item->next;
+            cJSON_DetachItemViaPointer(doc, item);
+            cJSON *existing = cJSON_GetObjectItemCaseSensitive(merged, item->string);
+            if (existing != NULL) {
+                cJSON_ReplaceItemViaPointer(merged, existing, item);
+            } else {
+                cJSON_AddItemToObject(merged, item->string, item);
+            }
+            item = next;
+        }
+        cJSON_Delete(doc);
+        doc = merged;
+        if (doc == NULL) {
+            reject(id, "out of memory");
+            return -1;
+        }
+    }
+
+    // Retained documents come back on every reconnect
+    if (layer->doc != NULL && cJSON_Compare(layer->doc, doc, true)) {
+        cJSON_Delete(doc);
+        return 0;
+    }
+
+    // Merges can grow a layer past what NVS stores
+    char *text = cJSON_PrintUnformatted(doc);
+    size_t text_len = text != NULL ? strlen(text) : 0;
+    cJSON_free(text);
+    if (text == NULL || text_len > FLEET_CONFIG_MAX_LAYER) {
+        cJSON_Delete(doc);
+        reject(id, text == NULL ? "out of memory" : "layer would exceed FLEET_CONFIG_MAX_LAYER");
+        return -1;
+    }
+
+    cJSON *delta = layer_delta(id, layer->doc, doc);
+    cJSON_Delete(layer->doc);
+    layer->doc = doc;
+    if (version > 0) {
+        layer->version = (uint32_t)version;
+    }
+    save_layer(id);
+
+    int changed = cJSON_GetArraySize(delta);
+    if (changed > 0 && apply_cb != NULL) {
+        char *text = cJSON_PrintUnformatted(delta);
+        if (text != NULL) {
+            apply_cb(text, strlen(text));
+            cJSON_free(text);
+        }
+    }
+    cJSON_Delete(delta);
+
+    ESP_LOGI(TAG, "Applied %s config v%" PRIu32 ": %d key(s) changed", layer->name, layer->version, changed);
+    publish_ack();
+    return changed;
+}
+
+static void handle_document(layer_id_t id, const char *data, int data_len, int total_len)
+{
+    layer_t *layer = &layers[id];
+    if (total_len == 0) {
+        // Retained message cleared: keep the layer as applied
+        return;
+    }
+    if (data_len != total_len || data_len > FLEET_CONFIG_MAX_DOC) {
+        reject(id, "document too large");
+        return;
+    }
+
+    cJSON *doc = cJSON_ParseWithLength(data, data_len);
+    if (!cJSON_IsObject(doc)) {
+        cJSON_Delete(doc);
+        reject(id, "not a JSON object");
+        return;
+    }
+    int64_t version = doc_version(doc);
+    if (version < 0) {
+        cJSON_Delete(doc);
+        reject(id, "\"version\" must be a positive integer");
+        return;
+    }
+    flatten_sections(doc);
+    if (version > 0 && version <= layer->version) {
+        if (version < layer->version) {
+            ESP_LOGW(TAG, "Ignoring %s config v%" PRId64 ", v%" PRIu32 " already applied",
+                     layer->name, version, layer->version);
+        }
+        cJSON_Delete(doc);
+        return;
+    }
+    apply_document(id, doc, version);
+}
+
+void fleet_config_init(fleet_config_apply_cb_t apply)
+{
+    apply_cb = apply;
+    if (layers_mutex == NULL) {
+        layers_mutex = xSemaphoreCreateMutex();
+    }
+
+    snprintf(layers[LAYER_FLEET].topic, sizeof(layers[LAYER_FLEET].topic), "sensor/config/all");
+    if (CONFIG_DEVICE_ZONE[0] != '\0') {
+        snprintf(layers[LAYER_ZONE].topic, sizeof(layers[LAYER_ZONE].topic), "sensor/config/zone/%s",
+                 CONFIG_DEVICE_ZONE);
+    }
+    snprintf(layers[LAYER_DEVICE].topic, sizeof(layers[LAYER_DEVICE].topic), "sensor/config/%s",
+             CONFIG_DEVICE_ID);
+
+    load_layers();
+}
+
+void fleet_config_subscribe(esp_mqtt_client_handle_t client)
+{
+    for (int l = 0; l < LAYER_COUNT; l++) {
+        if (layers[l].topic[0] != '\0') {
+            esp_mqtt_client_subscribe(client, layers[l].topic, 1);
+            ESP_LOGI(TAG, "[MQTT] Subscribed to config topic: %s", layers[l].topic);
+        }
+    }
+    xSemaphoreTake(layers_mutex, portMAX_DELAY);
+    publish_ack();
+    xSemaphoreGive(layers_mutex);
+}
+
+bool fleet_config_on_data(esp_mqtt_event_handle_t event)
+{
+    for (int l = 0; l < LAYER_COUNT; l++) {
+        const char *topic = layers[l].topic;
+        if (topic[0] != '\0' && event->topic_len == (int)strlen(topic) &&
+            strncmp(event->topic, topic, event->topic_len) == 0) {
+            xSemaphoreTake(layers_mutex, portMAX_DELAY);
+            handle_document((layer_id_t)l, event->data, event->data_len, event->total_data_len);
+            xSemaphoreGive(layers_mutex);
+            return true;
+        }
+    }
+    return false;
+}
+
+int fleet_config_set_device(const cJSON *doc)
+{
+    if (!cJSON_IsObject(doc)) {
+        return -1;
+    }
+    cJSON *copy = cJSON_Duplicate(doc, true);
+    if (copy == NULL) {
+        return -1;
+    }
+    // The layer keeps the version of the last device document
+    cJSON *version = cJSON_GetObjectItemCaseSensitive(copy, VERSION_KEY);
+    if (version != NULL) {
+        cJSON_Delete(cJSON_DetachItemViaPointer(copy, version));
+    }
+    flatten_sections(copy);
+
+    xSemaphoreTake(layers_mutex, portMAX_DELAY);
+    int changed = apply_document(LAYER_DEVICE, copy, 0);
+    xSemaphoreGive(layers_mutex);
+    return changed;
+}
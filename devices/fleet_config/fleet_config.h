@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include "mqtt_client.h"
+#include <cJSON.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest config document accepted from a topic; the MQTT client's buffer
+// (main/mqtt_client_manager.c) is sized to receive it whole
+#define FLEET_CONFIG_MAX_DOC        2048
+
+// Largest layer kept after merging, under NVS's 4000-byte string limit
+#define FLEET_CONFIG_MAX_LAYER      3072
+
+/**
+ * @brief Applies config JSON to the device modules
+ */
+typedef void (*fleet_config_apply_cb_t)(const char *data, int data_len);
+
+/**
+ * @brief Load the stored layers from NVS
+ *
+ * Config comes from three layers, lowest precedence first:
+ *   sensor/config/all               every node
+ *   sensor/config/zone/{zone}       nodes in CONFIG_DEVICE_ZONE (if set)
+ *   sensor/config/{device_id}       this node
+ *
+ * A key set in a higher layer overrides the lower ones; removing it there
+ * brings the lower layer's value back. Documents with an integer "version"
+ * replace their layer and are applied once: a version at or below the one
+ * already applied is skipped. Documents without one are merged into the
+ * layer and always applied, as per-device config was before.
+ *
+ * Keys for one module go in its section, {"irrigation": {"kp": 2}}, which
+ * is stored as "irrigation.kp" so layers override it key by key. Keys
+ * several modules read (kp, ki, kd, enabled) must be set this way when more
+ * than one module is built; the registry gives each module its own view.
+ *
+ * @param apply Called with the keys whose effective value changed
+ */
+void fleet_config_init(fleet_config_apply_cb_t apply);
+
+/**
+ * @brief Subscribe to the config topics and publish the applied versions
+ *
+ * The versions are acknowledged as retained state under
+ * greenhouse/state/{device_id}/config, e.g.
+ * {"fleet":3,"zone":"north","zone_version":2,"device":5}, so a rollout can
+ * be tracked by watching greenhouse/state/+/config.
+ */
+void fleet_config_subscribe(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Handle a message if it is on one of the config topics
+ *
+ * Runs on the MQTT task, like fleet_config_subscribe().
+ *
+ * @return true if the topic was a config topic
+ */
+bool fleet_config_on_data(esp_mqtt_event_handle_t event);
+
+/**
+ * @brief Merge keys into this node's layer, like an unversioned document on
+ * sensor/config/{device_id}
+ *
+ * Used by the "set_config" RPC, so the keys are stored and a later change in
+ * a lower layer does not undo them. A "version" in the document is ignored.
+ *
+ * @return Number of keys whose effective value changed, -1 on failure
+ */
+int fleet_config_set_device(const cJSON *doc);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,177 @@
+/*
+ * Greenhouse Devices - Pulse output flow meter
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Counts meter pulses with the PCNT peripheral so a few hundred Hz of input
+ * costs no interrupts; the owner samples the counter once per control period.
+ * Volumes are kept as a pulse count and converted in integer arithmetic.
+ */
+
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/pulse_cnt.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "flow_meter.h"
+
+#define PCNT_HIGH_LIMIT             32767
+#define PCNT_LOW_LIMIT              -1
+#define PCNT_GLITCH_NS              10000       // Reject contact bounce shorter than 10 µs
+
+// NVS storage for the cumulative count
+#define NVS_NAMESPACE               "flow_meter"
+#define NVS_KEY_PULSES              "pulses"
+#define CHECKPOINT_INTERVAL_MS      (10 * 60 * 1000)    // Bounds flash wear while flowing
+
+static const char *TAG = "flow_meter";
+
+static pcnt_unit_handle_t pcnt_unit = NULL;
+static uint32_t k_factor = 0;
+
+// Counter state, only touched from the sampling task
+static int last_count = 0;
+static int64_t last_sample_us = 0;
+static uint64_t total_pulses = 0;
+static uint64_t saved_pulses = 0;
+static int64_t last_checkpoint_ms = 0;
+static bool was_flowing = false;
+
+/**
+ * Load the cumulative pulse count from NVS
+ */
+static void load_total(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "[NVS] No stored total, starting from zero");
+        return;
+    }
+
+    uint64_t pulses = 0;
+    err = nvs_get_u64(nvs_handle, NVS_KEY_PULSES, &pulses);
+    nvs_close(nvs_handle);
+
+    if (err == ESP_OK) {
+        total_pulses = pulses;
+        saved_pulses = pulses;
+    }
+}
+
+void flow_meter_checkpoint(void)
+{
+    if (pcnt_unit == NULL || total_pulses == saved_pulses) {
+        return;
+    }
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to open NVS for writing: %s", esp_err_to_name(err));
+        return;
+    }
+
+    err = nvs_set_u64(nvs_handle, NVS_KEY_PULSES, total_pulses);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err == ESP_OK) {
+        saved_pulses = total_pulses;
+        ESP_LOGD(TAG, "[NVS] Checkpointed %llu pulses", (unsigned long long)total_pulses);
+    } else {
+        ESP_LOGE(TAG, "[NVS] Failed to save total: %s", esp_err_to_name(err));
+    }
+}
+
+esp_err_t flow_meter_init(int gpio, uint32_t pulses_per_litre)
+{
+    if (pulses_per_litre == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    k_factor = pulses_per_litre;
+
+    // Accumulate across the 16-bit hardware limit so reads never lose wraps
+    pcnt_unit_config_t unit_config = {
+        .high_limit = PCNT_HIGH_LIMIT,
+        .low_limit = PCNT_LOW_LIMIT,
+        .flags.accum_count = true,
+    };
+    pcnt_unit_handle_t unit = NULL;
+    esp_err_t err = pcnt_new_unit(&unit_config, &unit);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[PCNT] Failed to create unit: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    pcnt_glitch_filter_config_t filter_config = {
+        .max_glitch_ns = PCNT_GLITCH_NS,
+    };
+    ESP_ERROR_CHECK(pcnt_unit_set_glitch_filter(unit, &filter_config));
+
+    pcnt_chan_config_t chan_config = {
+        .edge_gpio_num = gpio,
+        .level_gpio_num = -1,
+    };
+    pcnt_channel_handle_t chan = NULL;
+    ESP_ERROR_CHECK(pcnt_new_channel(unit, &chan_config, &chan));
+    ESP_ERROR_CHECK(pcnt_channel_set_edge_action(chan, PCNT_CHANNEL_EDGE_ACTION_INCREASE,
+                                                 PCNT_CHANNEL_EDGE_ACTION_HOLD));
+    ESP_ERROR_CHECK(pcnt_unit_add_watch_point(unit, PCNT_HIGH_LIMIT));
+
+    ESP_ERROR_CHECK(pcnt_unit_enable(unit));
+    ESP_ERROR_CHECK(pcnt_unit_clear_count(unit));
+    ESP_ERROR_CHECK(pcnt_unit_start(unit));
+
+    load_total();
+    last_count = 0;
+    last_sample_us = esp_timer_get_time();
+    last_checkpoint_ms = last_sample_us / 1000;
+    pcnt_unit = unit;
+
+    unsigned long long total_ml = total_pulses * 1000 / k_factor;
+    ESP_LOGI(TAG, "[PCNT] Flow meter on GPIO %d, %lu pulses/L, total %llu.%03llu L",
+             gpio, (unsigned long)k_factor, total_ml / 1000, total_ml % 1000);
+    return ESP_OK;
+}
+
+void flow_meter_sample(flow_meter_reading_t *out)
+{
+    out->pulses = 0;
+    out->flow_ml_min = 0;
+    out->total_ml = 0;
+    if (pcnt_unit == NULL) {
+        return;
+    }
+
+    int count = 0;
+    if (pcnt_unit_get_count(pcnt_unit, &count) != ESP_OK) {
+        return;
+    }
+    int64_t now_us = esp_timer_get_time();
+
+    // Unsigned difference stays correct if the accumulated count wraps
+    uint32_t delta = (uint32_t)count - (uint32_t)last_count;
+    int64_t elapsed_us = now_us - last_sample_us;
+    last_count = count;
+    last_sample_us = now_us;
+    total_pulses += delta;
+
+    out->pulses = delta;
+    if (elapsed_us > 0) {
+        out->flow_ml_min = (uint64_t)delta * 60000000ULL * 1000 / ((uint64_t)k_factor * elapsed_us);
+    }
+    out->total_ml = total_pulses * 1000 / k_factor;
+
+    // Checkpoint periodically while flowing and once when flow stops
+    bool flowing = delta > 0;
+    int64_t now_ms = now_us / 1000;
+    if ((was_flowing && !flowing) || now_ms - last_checkpoint_ms >= CHECKPOINT_INTERVAL_MS) {
+        flow_meter_checkpoint();
+        last_checkpoint_ms = now_ms;
+    }
+    was_flowing = flowing;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One flow meter sample
+ */
+typedef struct {
+    uint32_t pulses;            // Pulses counted since the previous sample
+    uint32_t flow_ml_min;       // Flow rate over the sample period, mL/min
+    uint64_t total_ml;          // Cumulative volume since first boot, mL
+} flow_meter_reading_t;
+
+/**
+ * @brief Initialize a hall-effect flow meter on the PCNT peripheral
+ *
+ * Pulses are counted in hardware with the glitch filter enabled, so the
+ * CPU only reads the counter once per sample. The cumulative count is
+ * restored from NVS.
+ *
+ * @param gpio              Pulse input GPIO
+ * @param pulses_per_litre  Meter K-factor (e.g. 450 for YF-S201)
+ * @return ESP_OK on success
+ */
+esp_err_t flow_meter_init(int gpio, uint32_t pulses_per_litre);
+
+/**
+ * @brief Read the counter and convert to flow rate and volume
+ *
+ * Call at a fixed period (the owning control loop's); the rate is computed
+ * from the measured elapsed time so jitter does not skew it. Totals are
+ * checkpointed to NVS every few minutes while flowing and when flow stops.
+ *
+ * @param out Sample, zeroed if the meter is not initialized
+ */
+void flow_meter_sample(flow_meter_reading_t *out);
+
+/**
+ * @brief Write the cumulative count to NVS now if it changed
+ */
+void flow_meter_checkpoint(void);
+
+#ifdef __cplusplus
+}
+#endif
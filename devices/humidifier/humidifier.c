@@ -0,0 +1,574 @@
+/*
+ * Humidifier Device - Closed-loop humidity controller
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Reads humidity from its own BME680 (or the climate monitor's snapshot when
+ * both run in one image) and drives the humidifier with a PID loop. Only the
+ * setpoint and gains arrive over MQTT; the loop itself never waits on the
+ * broker, so actuation continues through broker outages.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include <bme680.h>
+#include <cJSON.h>
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "humidifier.h"
+#include "climate_monitor/sensor_filter.h"
+#include "climate_monitor/climate_monitor.h"
+#include "pid_controller/pid_controller.h"
+#include "mqtt_client_manager.h"
+#include "env_config.h"
+
+#define BME680_I2C_ADDR_1       0x77
+#define BME680_I2C_SDA_PIN      4
+#define BME680_I2C_SCL_PIN      5
+#define BME680_I2C_FREQ_HZ     100000
+
+// Humidifier output
+#define HUMIDIFIER_GPIO             CONFIG_HUMIDIFIER_OUTPUT_GPIO
+#define HUMIDIFIER_LEDC_TIMER       LEDC_TIMER_0
+#define HUMIDIFIER_LEDC_CHANNEL     LEDC_CHANNEL_0
+#define HUMIDIFIER_LEDC_RESOLUTION  LEDC_TIMER_13_BIT
+#define HUMIDIFIER_LEDC_MAX_DUTY    ((1 << 13) - 1)
+#define HUMIDIFIER_RELAY_MIN_ON_MS  2000        // Shorter pulses only wear the relay
+
+// Control loop
+#define CONTROL_PERIOD_MS           CONFIG_HUMIDIFIER_CONTROL_PERIOD_MS
+#define SENSOR_TIMEOUT_MS           10000       // Fail safe (output off) without fresh readings
+#define STATUS_INTERVAL_MS          10000
+#define MAX_CONSECUTIVE_ERRORS      3
+#define FILTER_LAMBDA_HUMIDITY      0.05f       // As the climate monitor; see its trade-off note
+#define SHARED_SAMPLE_MAX_AGE_MS    3000        // Climate monitor samples at 1 Hz
+
+// Default PID gains: output in % per %RH of error
+#define PID_KP_DEFAULT              8.0f
+#define PID_KI_DEFAULT              0.05f
+#define PID_KD_DEFAULT              0.0f
+
+// NVS storage for setpoint and gains
+#define NVS_NAMESPACE               "humidifier"
+#define NVS_KEY_CONFIG              "config"
+#define HUMIDIFIER_CONFIG_VERSION   1
+
+static const char *TAG = "humidifier";
+
+/**
+ * Settings written by the MQTT task and read by the control task
+ */
+typedef struct {
+    uint8_t version;
+    bool enabled;
+    float setpoint;             // %RH
+    float kp;
+    float ki;
+    float kd;
+} humidifier_config_t;
+
+// Global state
+static volatile bool control_running = false;
+static TaskHandle_t control_task_handle = NULL;
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+static mqtt_state_t humidifier_state = MQTT_STATE_INIT("humidifier");
+static bool sensor_initialized = false;
+#if !CONFIG_DEVICE_CLIMATE_MONITOR
+static bme680_t sensor;
+#endif
+static sensor_filter_t filter_humidity;
+static pid_controller_t pid;
+
+static humidifier_config_t config;
+static portMUX_TYPE config_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool gains_changed = false;
+static float humidity_limit;    // Hard cutoff from ALERT_HUMIDITY_HIGH
+
+// Relay time-proportioning window
+static int64_t relay_window_start_ms = 0;
+static int64_t relay_on_ms = 0;
+
+// Forward declarations
+static void control_task(void *pvParameters);
+
+/**
+ * Defaults: setpoint midway between the humidity alert thresholds
+ */
+static void config_set_defaults(humidifier_config_t *cfg)
+{
+    cfg->version = HUMIDIFIER_CONFIG_VERSION;
+    cfg->enabled = true;
+    cfg->setpoint = (atof(ENV_ALERT_HUMIDITY_LOW) + atof(ENV_ALERT_HUMIDITY_HIGH)) / 2.0f;
+    cfg->kp = PID_KP_DEFAULT;
+    cfg->ki = PID_KI_DEFAULT;
+    cfg->kd = PID_KD_DEFAULT;
+}
+
+/**
+ * Load setpoint and gains from NVS
+ */
+static bool load_config(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "[NVS] No config found, using defaults (setpoint=%.1f%%)", config.setpoint);
+        return false;
+    }
+
+    humidifier_config_t stored;
+    size_t len = sizeof(stored);
+    err = nvs_get_blob(nvs_handle, NVS_KEY_CONFIG, &stored, &len);
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK || len != sizeof(stored) || stored.version != HUMIDIFIER_CONFIG_VERSION) {
+        ESP_LOGW(TAG, "[NVS] Stored config missing or outdated, using defaults");
+        return false;
+    }
+
+    config = stored;
+    ESP_LOGI(TAG, "[NVS] Loaded config: setpoint=%.1f%% kp=%.3f ki=%.4f kd=%.3f %s",
+             config.setpoint, config.kp, config.ki, config.kd, config.enabled ? "enabled" : "disabled");
+    return true;
+}
+
+/**
+ * Save setpoint and gains to NVS
+ */
+static esp_err_t save_config(const humidifier_config_t *cfg)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to open NVS for writing: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_set_blob(nvs_handle, NVS_KEY_CONFIG, cfg, sizeof(*cfg));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to save config: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+/**
+ * Configure the humidifier output pin
+ */
+static void output_init(void)
+{
+#if CONFIG_HUMIDIFIER_OUTPUT_RELAY
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << HUMIDIFIER_GPIO,
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&io_conf));
+    gpio_set_level(HUMIDIFIER_GPIO, 0);
+    ESP_LOGI(TAG, "[OUTPUT] Relay on GPIO %d, %ds window", HUMIDIFIER_GPIO, CONFIG_HUMIDIFIER_RELAY_WINDOW_S);
+#else
+    ledc_timer_config_t timer_conf = {
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .duty_resolution = HUMIDIFIER_LEDC_RESOLUTION,
+        .timer_num = HUMIDIFIER_LEDC_TIMER,
+        .freq_hz = CONFIG_HUMIDIFIER_PWM_FREQ_HZ,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+    ESP_ERROR_CHECK(ledc_timer_config(&timer_conf));
+
+    ledc_channel_config_t channel_conf = {
+        .gpio_num = HUMIDIFIER_GPIO,
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .channel = HUMIDIFIER_LEDC_CHANNEL,
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = HUMIDIFIER_LEDC_TIMER,
+        .duty = 0,
+        .hpoint = 0,
+    };
+    ESP_ERROR_CHECK(ledc_channel_config(&channel_conf));
+    ESP_LOGI(TAG, "[OUTPUT] PWM on GPIO %d at %d Hz", HUMIDIFIER_GPIO, CONFIG_HUMIDIFIER_PWM_FREQ_HZ);
+#endif
+}
+
+/**
+ * Drive the humidifier at the given output (0-100 %)
+ */
+static void output_set(float percent, int64_t now_ms)
+{
+#if CONFIG_HUMIDIFIER_OUTPUT_RELAY
+    // Time-proportioning: the on-time is latched at the start of each window
+    int64_t window_ms = CONFIG_HUMIDIFIER_RELAY_WINDOW_S * 1000LL;
+    if (now_ms - relay_window_start_ms >= window_ms) {
+        relay_window_start_ms = now_ms;
+        relay_on_ms = (int64_t)(percent * window_ms / 100.0f);
+        if (relay_on_ms < HUMIDIFIER_RELAY_MIN_ON_MS) {
+            relay_on_ms = 0;
+        }
+    }
+    // Switching off always takes effect immediately
+    if (percent <= 0) {
+        relay_on_ms = 0;
+    }
+    gpio_set_level(HUMIDIFIER_GPIO, now_ms - relay_window_start_ms < relay_on_ms);
+#else
+    uint32_t duty = (uint32_t)(percent * HUMIDIFIER_LEDC_MAX_DUTY / 100.0f);
+    ledc_set_duty(LEDC_LOW_SPEED_MODE, HUMIDIFIER_LEDC_CHANNEL, duty);
+    ledc_update_duty(LEDC_LOW_SPEED_MODE, HUMIDIFIER_LEDC_CHANNEL);
+#endif
+}
+
+#if CONFIG_DEVICE_CLIMATE_MONITOR
+/*
+ * The climate monitor owns the BME680 when both modules are built; read its
+ * already filtered snapshot instead of driving the sensor a second time.
+ */
+static void bme680_init(void)
+{
+    sensor_initialized = true;
+}
+
+static void bme680_cleanup(void)
+{
+    sensor_initialized = false;
+}
+
+/**
+ * Take the climate monitor's latest reading, rejecting stale samples
+ */
+static esp_err_t read_humidity(float *temperature, float *humidity)
+{
+    climate_reading_t reading;
+    if (!climate_monitor_get_latest(&reading) ||
+        esp_timer_get_time() / 1000 - reading.timestamp_ms > SHARED_SAMPLE_MAX_AGE_MS) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    *temperature = reading.temperature;
+    *humidity = reading.humidity;
+    return ESP_OK;
+}
+#else
+/**
+ * Initialize BME680 sensor (humidity only, gas heater off for a short conversion)
+ */
+static void bme680_init(void)
+{
+    memset(&sensor, 0, sizeof(bme680_t));
+
+    esp_err_t err = bme680_init_desc(&sensor, BME680_I2C_ADDR_1, I2C_NUM_0, BME680_I2C_SDA_PIN, BME680_I2C_SCL_PIN);
+    if (err != ESP_OK) {
+        memset(&sensor, 0, sizeof(bme680_t));
+        err = bme680_init_desc(&sensor, 0x76, I2C_NUM_0, BME680_I2C_SDA_PIN, BME680_I2C_SCL_PIN);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "[BME680] Failed to init descriptor: %s", esp_err_to_name(err));
+            return;
+        }
+    }
+
+    sensor.i2c_dev.cfg.scl_pullup_en = 1;
+    sensor.i2c_dev.cfg.sda_pullup_en = 1;
+    sensor.i2c_dev.cfg.master.clk_speed = BME680_I2C_FREQ_HZ;
+
+    err = bme680_init_sensor(&sensor);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[BME680] Failed to init sensor: %s", esp_err_to_name(err));
+        i2c_dev_delete_mutex(&sensor.i2c_dev);
+        return;
+    }
+
+    bme680_set_oversampling_rates(&sensor, BME680_OSR_4X, BME680_OSR_NONE, BME680_OSR_4X);
+    bme680_set_filter_size(&sensor, BME680_IIR_SIZE_0);
+    bme680_use_heater_profile(&sensor, BME680_HEATER_NOT_USED);
+
+    sensor_filter_reset(&filter_humidity);
+    sensor_initialized = true;
+    ESP_LOGI(TAG, "[BME680] Initialization successful");
+}
+
+/**
+ * Cleanup BME680 sensor
+ */
+static void bme680_cleanup(void)
+{
+    if (sensor.i2c_dev.mutex != NULL) {
+        i2c_dev_delete_mutex(&sensor.i2c_dev);
+    }
+    sensor_initialized = false;
+    memset(&sensor, 0, sizeof(bme680_t));
+}
+
+/**
+ * Take one humidity reading
+ */
+static esp_err_t read_humidity(float *temperature, float *humidity)
+{
+    uint32_t duration;
+    bme680_values_float_t values;
+
+    esp_err_t err = bme680_force_measurement(&sensor);
+    if (err != ESP_OK) {
+        return err;
+    }
+    bme680_get_measurement_duration(&sensor, &duration);
+    vTaskDelay(duration);
+
+    err = bme680_get_results_float(&sensor, &values);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    *temperature = values.temperature;
+    *humidity = sensor_filter_update(&filter_humidity, (int32_t)(values.humidity * 100 + 0.5f)) / 100.0f;
+    return ESP_OK;
+}
+#endif
+
+/**
+ * Publish controller state; never blocks the control loop
+ */
+static void publish_status(float temperature, float humidity, float setpoint, float output)
+{
+    if (!mqtt_client_manager_is_connected() || mqtt_client == NULL) {
+        return;
+    }
+
+    char json_payload[256];
+    snprintf(json_payload, sizeof(json_payload),
+             "{\"device_id\":\"%s\",\"temperature\":%.2f,\"humidity\":%.2f,\"humidity_setpoint\":%.1f,\"humidifier_output\":%.1f,\"location_x\":%d,\"location_y\":%d}",
+             CONFIG_DEVICE_ID, temperature, humidity, setpoint, output,
+             CONFIG_DEVICE_LOCATION_X, CONFIG_DEVICE_LOCATION_Y);
+    mqtt_client_manager_publish("sensor/humidifier", json_payload, 0, 0, false);
+    mqtt_client_manager_publish_state(&humidifier_state, json_payload);
+}
+
+/**
+ * Control loop: read humidity, run PID, drive output
+ */
+static void control_loop(void)
+{
+    TickType_t last_wakeup = xTaskGetTickCount();
+    int64_t last_valid_ms = -1;
+    int64_t last_step_ms = esp_timer_get_time() / 1000;
+    int64_t last_status_ms = 0;
+    float temperature = 0;
+    float humidity = 0;
+    float output = 0;
+    int consecutive_errors = 0;
+
+    ESP_LOGI(TAG, "Starting control loop (%d ms period)", CONTROL_PERIOD_MS);
+
+    while (control_running) {
+        int64_t now_ms = esp_timer_get_time() / 1000;
+
+        if (!sensor_initialized) {
+            bme680_init();
+        }
+
+        if (sensor_initialized) {
+            esp_err_t err = read_humidity(&temperature, &humidity);
+            if (err == ESP_OK) {
+                consecutive_errors = 0;
+                last_valid_ms = now_ms;
+            } else if (++consecutive_errors >= MAX_CONSECUTIVE_ERRORS) {
+                ESP_LOGE(TAG, "Too many consecutive sensor errors, reinitializing sensor...");
+                bme680_cleanup();
+                consecutive_errors = 0;
+            }
+        }
+
+        humidifier_config_t cfg;
+        bool update_gains;
+        portENTER_CRITICAL(&config_lock);
+        cfg = config;
+        update_gains = gains_changed;
+        gains_changed = false;
+        portEXIT_CRITICAL(&config_lock);
+
+        if (update_gains) {
+            pid_controller_set_gains(&pid, cfg.kp, cfg.ki, cfg.kd);
+        }
+
+        float dt_s = (now_ms - last_step_ms) / 1000.0f;
+        last_step_ms = now_ms;
+
+        if (!cfg.enabled || last_valid_ms < 0 || now_ms - last_valid_ms > SENSOR_TIMEOUT_MS) {
+            // Fail safe: no control without a trusted reading
+            if (output > 0) {
+                ESP_LOGW(TAG, "Humidifier off (%s)", cfg.enabled ? "sensor timeout" : "disabled");
+            }
+            output = 0;
+            pid_controller_reset(&pid);
+        } else if (humidity >= humidity_limit) {
+            // Hard limit independent of the setpoint
+            output = 0;
+            pid_controller_reset(&pid);
+        } else {
+            output = pid_controller_update(&pid, cfg.setpoint, humidity, dt_s);
+        }
+        output_set(output, now_ms);
+
+        if (now_ms - last_status_ms >= STATUS_INTERVAL_MS) {
+            last_status_ms = now_ms;
+            ESP_LOGI(TAG, "RH %.2f%% -> setpoint %.1f%%, output %.1f%%", humidity, cfg.setpoint, output);
+            publish_status(temperature, humidity, cfg.setpoint, output);
+        }
+
+        vTaskDelayUntil(&last_wakeup, pdMS_TO_TICKS(CONTROL_PERIOD_MS));
+    }
+
+    output_set(0, esp_timer_get_time() / 1000);
+    ESP_LOGI(TAG, "Control loop stopped");
+}
+
+/**
+ * Control task wrapper
+ */
+static void control_task(void *pvParameters)
+{
+    control_loop();
+    control_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * Handle MQTT config message to update setpoint and gains
+ */
+void humidifier_apply_config(const char *data, int data_len)
+{
+    ESP_LOGI(TAG, "[MQTT] Received config message: %.*s", data_len, data);
+
+    // Parse JSON: {"humidity_setpoint": 60, "kp": 8, "ki": 0.05, "kd": 0, "enabled": true}
+    cJSON *json = cJSON_ParseWithLength(data, data_len);
+    if (json == NULL) {
+        ESP_LOGW(TAG, "[MQTT] Failed to parse config JSON");
+        return;
+    }
+
+    humidifier_config_t cfg;
+    portENTER_CRITICAL(&config_lock);
+    cfg = config;
+    portEXIT_CRITICAL(&config_lock);
+
+    bool updated = false;
+    bool gains = false;
+
+    cJSON *item = cJSON_GetObjectItem(json, "humidity_setpoint");
+    if (cJSON_IsNumber(item)) {
+        if (item->valuedouble > 0 && item->valuedouble < 100) {
+            cfg.setpoint = item->valuedouble;
+            updated = true;
+        } else {
+            ESP_LOGW(TAG, "[MQTT] Ignoring out-of-range setpoint %.1f", item->valuedouble);
+        }
+    }
+
+    item = cJSON_GetObjectItem(json, "kp");
+    if (cJSON_IsNumber(item) && item->valuedouble >= 0) {
+        cfg.kp = item->valuedouble;
+        gains = true;
+    }
+    item = cJSON_GetObjectItem(json, "ki");
+    if (cJSON_IsNumber(item) && item->valuedouble >= 0) {
+        cfg.ki = item->valuedouble;
+        gains = true;
+    }
+    item = cJSON_GetObjectItem(json, "kd");
+    if (cJSON_IsNumber(item) && item->valuedouble >= 0) {
+        cfg.kd = item->valuedouble;
+        gains = true;
+    }
+
+    item = cJSON_GetObjectItem(json, "enabled");
+    if (cJSON_IsBool(item)) {
+        cfg.enabled = cJSON_IsTrue(item);
+        updated = true;
+    }
+
+    cJSON_Delete(json);
+
+    if (!updated && !gains) {
+        return;
+    }
+
+    portENTER_CRITICAL(&config_lock);
+    config = cfg;
+    gains_changed |= gains;
+    portEXIT_CRITICAL(&config_lock);
+
+    ESP_LOGI(TAG, "[MQTT] Updated setpoint=%.1f%% kp=%.3f ki=%.4f kd=%.3f %s",
+             cfg.setpoint, cfg.kp, cfg.ki, cfg.kd, cfg.enabled ? "enabled" : "disabled");
+
+    if (save_config(&cfg) == ESP_OK) {
+        ESP_LOGI(TAG, "[MQTT] Config saved to NVS");
+    }
+}
+
+/**
+ * Initialize humidifier controller
+ */
+void humidifier_init(esp_mqtt_client_handle_t client)
+{
+    ESP_LOGI(TAG, "Initializing humidifier device");
+    ESP_LOGI(TAG, "Device ID: %s", CONFIG_DEVICE_ID);
+
+    mqtt_client = client;
+
+    config_set_defaults(&config);
+    load_config();
+    humidity_limit = atof(ENV_ALERT_HUMIDITY_HIGH);
+
+    pid_controller_init(&pid, config.kp, config.ki, config.kd, 0.0f, 100.0f);
+    sensor_filter_init(&filter_humidity, FILTER_LAMBDA_HUMIDITY);
+
+    output_init();
+
+    // I2C device library is initialized once by the device registry
+    bme680_init();
+}
+
+/**
+ * Start control task
+ */
+void humidifier_start(void)
+{
+    if (!control_running && control_task_handle == NULL) {
+        control_running = true;
+        // Above the MQTT task so publishing never delays a control step
+        xTaskCreate(control_task, "humidifier_ctl", 4096, NULL, 6, &control_task_handle);
+        ESP_LOGI(TAG, "Started control task");
+    }
+}
+
+/**
+ * Stop control task
+ */
+void humidifier_stop(void)
+{
+    if (control_running) {
+        control_running = false;
+        ESP_LOGI(TAG, "Stopping control task");
+
+        int wait_count = 0;
+        while (control_task_handle != NULL && wait_count < 20) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            wait_count++;
+        }
+    }
+
+    bme680_cleanup();
+}
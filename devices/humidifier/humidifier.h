@@ -0,0 +1,42 @@
+#pragma once
+
+#include "mqtt_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the humidifier controller
+ *
+ * Initializes the local BME680, the humidifier output (LEDC PWM or relay)
+ * and loads the setpoint and PID gains from NVS.
+ *
+ * @param client MQTT client handle from mqtt_client_manager
+ */
+void humidifier_init(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Apply a config message (same JSON as sensor/config/{device_id})
+ *
+ * Used by the config topics (see fleet_config.h) and the "set_config"
+ * request.
+ */
+void humidifier_apply_config(const char *data, int data_len);
+
+/**
+ * @brief Start the control task
+ *
+ * The control loop runs entirely on local measurements, so it is started
+ * once at boot and keeps actuating while the broker is unreachable.
+ */
+void humidifier_start(void);
+
+/**
+ * @brief Stop the control task and switch the humidifier off
+ */
+void humidifier_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
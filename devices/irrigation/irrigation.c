@@ -0,0 +1,688 @@
+/*
+ * Irrigation Device - Soil moisture driven valve controller
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Samples soil moisture every second and opens the valve (and optional pump)
+ * from a local hysteresis or PI loop, so a dry bed is answered within seconds
+ * without a backend round trip. Max open time, a soak lockout between runs
+ * and watering windows bound every decision; each run is reported as an
+ * event when the valve closes.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include <cJSON.h>
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "irrigation.h"
+#include "soil_moisture/soil_moisture.h"
+#include "climate_monitor/sensor_filter.h"
+#include "pid_controller/pid_controller.h"
+#include "mqtt_client_manager.h"
+#include "time_sync.h"
+#include "flow_meter/flow_meter.h"
+
+// Valve/pump relays
+#define VALVE_GPIO                  CONFIG_IRRIGATION_VALVE_GPIO
+#define PUMP_GPIO                   CONFIG_IRRIGATION_PUMP_GPIO
+#if CONFIG_IRRIGATION_RELAY_ACTIVE_LOW
+    #define RELAY_ON                0
+    #define RELAY_OFF               1
+#else
+    #define RELAY_ON                1
+    #define RELAY_OFF               0
+#endif
+
+// Control loop
+#define CONTROL_PERIOD_MS           1000
+#define MOISTURE_ADC_SAMPLES        16
+#define FILTER_LAMBDA_MOISTURE      0.05f
+#define SENSOR_TIMEOUT_MS           10000       // Close the valve without fresh readings
+#define STATUS_INTERVAL_MS          60000
+#define MIN_PULSE_S                 5           // PI pulses shorter than this are skipped
+#define MAX_WINDOWS                 2
+
+#if CONFIG_IRRIGATION_FLOW_METER
+    #define FLOW_GPIO               CONFIG_IRRIGATION_FLOW_GPIO
+    #define FLOW_PULSES_PER_LITRE   CONFIG_IRRIGATION_FLOW_PULSES_PER_LITRE
+#endif
+
+// NVS storage for the watering configuration
+#define NVS_NAMESPACE               "irrigation"
+#define NVS_KEY_CONFIG              "config"
+#define IRRIGATION_CONFIG_VERSION   1
+
+#define MINUTES_PER_DAY             (24 * 60)
+
+static const char *TAG = "irrigation";
+
+typedef enum {
+    IRRIGATION_MODE_HYSTERESIS = 0,     // Open below start, close at stop
+    IRRIGATION_MODE_PI,                 // Pulse length from a PI loop on the target
+} irrigation_mode_t;
+
+/**
+ * Why a watering run ended (reported as "stop_reason")
+ */
+typedef enum {
+    STOP_TARGET_REACHED = 0,
+    STOP_MAX_OPEN_TIME,
+    STOP_PULSE_COMPLETE,
+    STOP_WINDOW_CLOSED,
+    STOP_MANUAL,
+    STOP_SENSOR_FAULT,
+    STOP_DISABLED,
+} stop_reason_t;
+
+static const char *STOP_REASON_NAMES[] = {
+    "target_reached", "max_open_time", "pulse_complete", "window_closed",
+    "manual", "sensor_fault", "disabled",
+};
+
+/**
+ * Watering configuration, written by the MQTT task and read by the control task
+ */
+typedef struct {
+    uint8_t version;
+    bool enabled;
+    uint8_t mode;                   // irrigation_mode_t
+    float start_pct;                // Hysteresis: open below this
+    float stop_pct;                 // Hysteresis: close at or above this
+    float target_pct;               // PI setpoint
+    float emergency_pct;            // Below this, water outside the windows too
+    float kp;                       // PI: seconds of watering per % of error
+    float ki;                       // PI: per second
+    uint16_t max_open_s;            // Hard cap on a single run
+    uint16_t min_interval_s;        // Soak lockout between runs (PI cycle length)
+    uint8_t window_count;           // 0 = always allowed
+    uint16_t window_start[MAX_WINDOWS];     // Minute of day
+    uint16_t window_end[MAX_WINDOWS];
+} irrigation_config_t;
+
+// Global state
+static volatile bool control_running = false;
+static TaskHandle_t control_task_handle = NULL;
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+static mqtt_state_t irrigation_state = MQTT_STATE_INIT("irrigation");
+static sensor_filter_t filter_moisture;
+static pid_controller_t pid;
+
+static irrigation_config_t config;
+static portMUX_TYPE config_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Commands from the MQTT task, consumed by the control task
+static volatile int manual_request_s = 0;   // Held until the valve is closed
+static volatile bool stop_request = false;
+static volatile bool pid_changed = false;   // Gains or max_open_s, applied by the control task
+
+// Forward declarations
+static void control_task(void *pvParameters);
+
+static void config_set_defaults(irrigation_config_t *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->version = IRRIGATION_CONFIG_VERSION;
+    cfg->enabled = true;
+    cfg->mode = IRRIGATION_MODE_HYSTERESIS;
+    cfg->start_pct = 30;
+    cfg->stop_pct = 45;
+    cfg->target_pct = 40;
+    cfg->emergency_pct = 15;
+    cfg->kp = 10.0f;
+    cfg->ki = 0.01f;
+    cfg->max_open_s = 300;
+    cfg->min_interval_s = 900;
+    cfg->window_count = 0;
+}
+
+/**
+ * Load watering configuration from NVS
+ */
+static bool load_config(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "[NVS] No config found, using defaults");
+        return false;
+    }
+
+    irrigation_config_t stored;
+    size_t len = sizeof(stored);
+    err = nvs_get_blob(nvs_handle, NVS_KEY_CONFIG, &stored, &len);
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK || len != sizeof(stored) || stored.version != IRRIGATION_CONFIG_VERSION) {
+        ESP_LOGW(TAG, "[NVS] Stored config missing or outdated, using defaults");
+        return false;
+    }
+
+    config = stored;
+    return true;
+}
+
+/**
+ * Save watering configuration to NVS
+ */
+static esp_err_t save_config(const irrigation_config_t *cfg)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to open NVS for writing: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_set_blob(nvs_handle, NVS_KEY_CONFIG, cfg, sizeof(*cfg));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to save config: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+/**
+ * Configure valve and pump relay outputs (closed)
+ */
+static void relays_init(void)
+{
+    uint64_t mask = 1ULL << VALVE_GPIO;
+#if PUMP_GPIO >= 0
+    mask |= 1ULL << PUMP_GPIO;
+#endif
+
+    gpio_config_t io_conf = {
+        .pin_bit_mask = mask,
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&io_conf));
+
+    gpio_set_level(VALVE_GPIO, RELAY_OFF);
+#if PUMP_GPIO >= 0
+    gpio_set_level(PUMP_GPIO, RELAY_OFF);
+#endif
+    ESP_LOGI(TAG, "[VALVE] Valve on GPIO %d, pump %s", VALVE_GPIO, PUMP_GPIO >= 0 ? "enabled" : "not used");
+}
+
+/**
+ * Open or close the valve; the pump only runs against an open valve
+ */
+static void valve_set(bool open)
+{
+    if (open) {
+        gpio_set_level(VALVE_GPIO, RELAY_ON);
+#if PUMP_GPIO >= 0
+        gpio_set_level(PUMP_GPIO, RELAY_ON);
+#endif
+    } else {
+#if PUMP_GPIO >= 0
+        gpio_set_level(PUMP_GPIO, RELAY_OFF);
+#endif
+        gpio_set_level(VALVE_GPIO, RELAY_OFF);
+    }
+}
+
+/**
+ * Check the watering windows; an unset clock only allows emergency watering
+ */
+static bool in_watering_window(const irrigation_config_t *cfg)
+{
+    if (cfg->window_count == 0) {
+        return true;
+    }
+    if (!time_sync_is_valid()) {
+        return false;
+    }
+
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    int minute = local.tm_hour * 60 + local.tm_min;
+
+    for (int i = 0; i < cfg->window_count && i < MAX_WINDOWS; i++) {
+        int length = (cfg->window_end[i] - cfg->window_start[i] + MINUTES_PER_DAY) % MINUTES_PER_DAY;
+        int since_start = (minute - cfg->window_start[i] + MINUTES_PER_DAY) % MINUTES_PER_DAY;
+        if (since_start < length) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Report a completed watering run (queued at QoS 1; kept through an outage
+ * for as long as the MQTT outbox keeps it, a day and 32 KB at most)
+ */
+static void publish_event(int duration_s, float moisture_start, float moisture_end,
+                          stop_reason_t reason, bool manual, uint32_t volume_ml)
+{
+    if (mqtt_client == NULL) {
+        return;
+    }
+
+    char json_payload[352];
+    int len = snprintf(json_payload, sizeof(json_payload),
+             "{\"device_id\":\"%s\",\"irrigation_duration_s\":%d,\"moisture_start\":%.1f,\"moisture_end\":%.1f,"
+             "\"stop_reason\":%d,\"stop_reason_name\":\"%s\",\"manual\":%d,",
+             CONFIG_DEVICE_ID, duration_s, moisture_start, moisture_end,
+             reason, STOP_REASON_NAMES[reason], manual ? 1 : 0);
+#if CONFIG_IRRIGATION_FLOW_METER
+    len += snprintf(json_payload + len, sizeof(json_payload) - len, "\"volume_l\":%lu.%03lu,",
+                    (unsigned long)(volume_ml / 1000), (unsigned long)(volume_ml % 1000));
+#endif
+    snprintf(json_payload + len, sizeof(json_payload) - len, "\"location_x\":%d,\"location_y\":%d}",
+             CONFIG_DEVICE_LOCATION_X, CONFIG_DEVICE_LOCATION_Y);
+    mqtt_client_manager_publish("sensor/irrigation/event", json_payload, 0, 1, false);
+}
+
+/**
+ * Publish current moisture and valve state; never blocks the control loop
+ */
+static void publish_status(float moisture, bool valve_open, uint32_t flow_ml_min, uint64_t total_ml)
+{
+    if (!mqtt_client_manager_is_connected() || mqtt_client == NULL) {
+        return;
+    }
+
+    char json_payload[256];
+    int len = snprintf(json_payload, sizeof(json_payload),
+             "{\"device_id\":\"%s\",\"soil_moisture\":%.1f,\"valve_open\":%d,",
+             CONFIG_DEVICE_ID, moisture, valve_open ? 1 : 0);
+#if CONFIG_IRRIGATION_FLOW_METER
+    len += snprintf(json_payload + len, sizeof(json_payload) - len,
+                    "\"flow_rate\":%lu.%03lu,\"water_total\":%llu.%03llu,",
+                    (unsigned long)(flow_ml_min / 1000), (unsigned long)(flow_ml_min % 1000),
+                    (unsigned long long)(total_ml / 1000), (unsigned long long)(total_ml % 1000));
+#endif
+    snprintf(json_payload + len, sizeof(json_payload) - len, "\"location_x\":%d,\"location_y\":%d}",
+             CONFIG_DEVICE_LOCATION_X, CONFIG_DEVICE_LOCATION_Y);
+    mqtt_client_manager_publish("sensor/irrigation", json_payload, 0, 0, false);
+    mqtt_client_manager_publish_state(&irrigation_state, json_payload);
+}
+
+/**
+ * Control loop: read moisture, decide, drive valve
+ */
+static void control_loop(void)
+{
+    TickType_t last_wakeup = xTaskGetTickCount();
+    int64_t last_valid_ms = -1;
+    int64_t last_status_ms = 0;
+    int64_t last_close_ms = -1;
+    int64_t last_pi_ms = -1;
+    float moisture = 0;
+
+    // Current run
+    bool watering = false;
+    bool run_manual = false;
+    int64_t run_start_ms = 0;
+    int run_limit_s = 0;
+    float run_start_moisture = 0;
+
+    // Water metering (stays zero without a flow meter)
+    flow_meter_reading_t flow = {0};
+    uint64_t run_start_ml = 0;
+
+    ESP_LOGI(TAG, "Starting control loop");
+
+    while (control_running) {
+        int64_t now_ms = esp_timer_get_time() / 1000;
+
+#if CONFIG_IRRIGATION_FLOW_METER
+        flow_meter_sample(&flow);
+#endif
+
+        int centi = soil_moisture_read_centi_percent(MOISTURE_ADC_SAMPLES);
+        if (centi >= 0) {
+            moisture = sensor_filter_update(&filter_moisture, centi) / 100.0f;
+            last_valid_ms = now_ms;
+        }
+        bool sensor_ok = last_valid_ms >= 0 && now_ms - last_valid_ms <= SENSOR_TIMEOUT_MS;
+
+        irrigation_config_t cfg;
+        int manual_s = 0;
+        bool stop;
+        bool update_pid;
+        portENTER_CRITICAL(&config_lock);
+        cfg = config;
+        stop = stop_request;
+        stop_request = false;
+        // A manual run asked for during a run waits for the valve to close
+        if (!watering) {
+            manual_s = manual_request_s;
+            manual_request_s = 0;
+        }
+        update_pid = pid_changed;
+        pid_changed = false;
+        portEXIT_CRITICAL(&config_lock);
+
+        if (update_pid) {
+            pid_controller_set_gains(&pid, cfg.kp, cfg.ki, 0);
+            pid_controller_set_limits(&pid, 0, cfg.max_open_s);
+        }
+
+        bool window_ok = in_watering_window(&cfg) || (sensor_ok && moisture < cfg.emergency_pct);
+
+        if (watering) {
+            int elapsed_s = (now_ms - run_start_ms) / 1000;
+            int stop_reason = -1;
+
+            if (stop) {
+                stop_reason = STOP_MANUAL;
+            } else if (!sensor_ok && !run_manual) {
+                stop_reason = STOP_SENSOR_FAULT;
+            } else if (elapsed_s >= cfg.max_open_s) {
+                stop_reason = STOP_MAX_OPEN_TIME;
+            } else if (elapsed_s >= run_limit_s) {
+                stop_reason = STOP_PULSE_COMPLETE;
+            } else if (!run_manual && !cfg.enabled) {
+                stop_reason = STOP_DISABLED;
+            } else if (!run_manual && !window_ok) {
+                stop_reason = STOP_WINDOW_CLOSED;
+            } else if (!run_manual && cfg.mode == IRRIGATION_MODE_HYSTERESIS && moisture >= cfg.stop_pct) {
+                stop_reason = STOP_TARGET_REACHED;
+            }
+
+            if (stop_reason >= 0) {
+                valve_set(false);
+                watering = false;
+                last_close_ms = now_ms;
+                ESP_LOGI(TAG, "[VALVE] Closed after %ds (%s), moisture %.1f%% -> %.1f%%",
+                         elapsed_s, STOP_REASON_NAMES[stop_reason], run_start_moisture, moisture);
+                publish_event(elapsed_s, run_start_moisture, moisture, stop_reason, run_manual,
+                              flow.total_ml - run_start_ml);
+            }
+        } else {
+            bool soaked = last_close_ms < 0 || now_ms - last_close_ms >= cfg.min_interval_s * 1000LL;
+            int open_s = 0;
+
+            if (manual_s > 0) {
+                open_s = manual_s;
+                run_manual = true;
+            } else if (cfg.enabled && sensor_ok && soaked && window_ok) {
+                run_manual = false;
+                if (cfg.mode == IRRIGATION_MODE_HYSTERESIS) {
+                    if (moisture < cfg.start_pct) {
+                        open_s = cfg.max_open_s;
+                    }
+                } else if (last_pi_ms < 0 || now_ms - last_pi_ms >= cfg.min_interval_s * 1000LL) {
+                    // One PI step per cycle: output is the next pulse length
+                    float dt_s = last_pi_ms < 0 ? 0 : (now_ms - last_pi_ms) / 1000.0f;
+                    last_pi_ms = now_ms;
+                    open_s = (int)pid_controller_update(&pid, cfg.target_pct, moisture, dt_s);
+                    if (open_s < MIN_PULSE_S) {
+                        open_s = 0;
+                    }
+                }
+            }
+
+            if (open_s > 0) {
+                run_limit_s = open_s < cfg.max_open_s ? open_s : cfg.max_open_s;
+                run_start_ms = now_ms;
+                run_start_moisture = moisture;
+                run_start_ml = flow.total_ml;
+                watering = true;
+                valve_set(true);
+                ESP_LOGI(TAG, "[VALVE] Opened for up to %ds (%s), moisture %.1f%%",
+                         run_limit_s, run_manual ? "manual" : "auto", moisture);
+            }
+        }
+
+        if (now_ms - last_status_ms >= STATUS_INTERVAL_MS) {
+            last_status_ms = now_ms;
+            publish_status(moisture, watering, flow.flow_ml_min, flow.total_ml);
+        }
+
+        vTaskDelayUntil(&last_wakeup, pdMS_TO_TICKS(CONTROL_PERIOD_MS));
+    }
+
+    valve_set(false);
+    ESP_LOGI(TAG, "Control loop stopped");
+}
+
+/**
+ * Control task wrapper
+ */
+static void control_task(void *pvParameters)
+{
+    control_loop();
+    control_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * Parse "HH:MM" into minute of day
+ */
+static bool parse_time_of_day(const cJSON *item, uint16_t *minute_of_day)
+{
+    int hour, minute;
+    if (!cJSON_IsString(item) || sscanf(item->valuestring, "%d:%d", &hour, &minute) != 2 ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+        return false;
+    }
+    *minute_of_day = hour * 60 + minute;
+    return true;
+}
+
+static bool apply_number(const cJSON *json, const char *key, float min, float max, float *out)
+{
+    cJSON *item = cJSON_GetObjectItem(json, key);
+    if (!cJSON_IsNumber(item)) {
+        return false;
+    }
+    if (item->valuedouble < min || item->valuedouble > max) {
+        ESP_LOGW(TAG, "[MQTT] Ignoring out-of-range %s=%.2f", key, item->valuedouble);
+        return false;
+    }
+    *out = item->valuedouble;
+    return true;
+}
+
+/**
+ * Handle MQTT config message
+ */
+void irrigation_apply_config(const char *data, int data_len)
+{
+    ESP_LOGI(TAG, "[MQTT] Received config message: %.*s", data_len, data);
+
+    // Parse JSON: {"mode": "hysteresis", "moisture_start": 30, "moisture_stop": 45, "max_open_s": 300,
+    //              "min_interval_s": 900, "windows": [["05:00", "09:00"]], "dry_value": 2800, ...}
+    cJSON *json = cJSON_ParseWithLength(data, data_len);
+    if (json == NULL) {
+        ESP_LOGW(TAG, "[MQTT] Failed to parse config JSON");
+        return;
+    }
+
+    // Sensor calibration is persisted by the soil moisture module
+    soil_moisture_apply_config(json);
+
+    irrigation_config_t cfg;
+    portENTER_CRITICAL(&config_lock);
+    cfg = config;
+    portEXIT_CRITICAL(&config_lock);
+
+    bool updated = false;
+    float value;
+
+    cJSON *item = cJSON_GetObjectItem(json, "mode");
+    if (cJSON_IsString(item)) {
+        if (strcmp(item->valuestring, "pi") == 0) {
+            cfg.mode = IRRIGATION_MODE_PI;
+            updated = true;
+        } else if (strcmp(item->valuestring, "hysteresis") == 0) {
+            cfg.mode = IRRIGATION_MODE_HYSTERESIS;
+            updated = true;
+        }
+    }
+
+    updated |= apply_number(json, "moisture_start", 0, 100, &cfg.start_pct);
+    updated |= apply_number(json, "moisture_stop", 0, 100, &cfg.stop_pct);
+    updated |= apply_number(json, "moisture_target", 0, 100, &cfg.target_pct);
+    updated |= apply_number(json, "moisture_emergency", 0, 100, &cfg.emergency_pct);
+    updated |= apply_number(json, "kp", 0, 1000, &cfg.kp);
+    updated |= apply_number(json, "ki", 0, 10, &cfg.ki);
+    if (apply_number(json, "max_open_s", 1, 3600, &value)) {
+        cfg.max_open_s = value;
+        updated = true;
+    }
+    if (apply_number(json, "min_interval_s", 0, 24 * 3600, &value)) {
+        cfg.min_interval_s = value;
+        updated = true;
+    }
+
+    item = cJSON_GetObjectItem(json, "enabled");
+    if (cJSON_IsBool(item)) {
+        cfg.enabled = cJSON_IsTrue(item);
+        updated = true;
+    }
+
+    // "windows": [["05:00", "09:00"], ["18:00", "21:00"]], [] for always
+    item = cJSON_GetObjectItem(json, "windows");
+    if (cJSON_IsArray(item)) {
+        int count = 0;
+        const cJSON *window;
+        cJSON_ArrayForEach(window, item) {
+            if (count >= MAX_WINDOWS) {
+                ESP_LOGW(TAG, "[MQTT] Only %d watering windows supported", MAX_WINDOWS);
+                break;
+            }
+            if (cJSON_GetArraySize(window) == 2 &&
+                parse_time_of_day(cJSON_GetArrayItem(window, 0), &cfg.window_start[count]) &&
+                parse_time_of_day(cJSON_GetArrayItem(window, 1), &cfg.window_end[count])) {
+                count++;
+            }
+        }
+        cfg.window_count = count;
+        updated = true;
+    }
+
+    cJSON_Delete(json);
+
+    if (cfg.stop_pct <= cfg.start_pct) {
+        ESP_LOGW(TAG, "[MQTT] moisture_stop must be above moisture_start, keeping previous config");
+        return;
+    }
+    if (!updated) {
+        return;
+    }
+
+    portENTER_CRITICAL(&config_lock);
+    pid_changed |= cfg.kp != config.kp || cfg.ki != config.ki || cfg.max_open_s != config.max_open_s;
+    config = cfg;
+    portEXIT_CRITICAL(&config_lock);
+
+    ESP_LOGI(TAG, "[MQTT] Config: %s, start %.0f%% stop %.0f%% target %.0f%%, max open %ds, lockout %ds, %d window(s)",
+             cfg.mode == IRRIGATION_MODE_PI ? "PI" : "hysteresis", cfg.start_pct, cfg.stop_pct,
+             cfg.target_pct, cfg.max_open_s, cfg.min_interval_s, cfg.window_count);
+
+    if (save_config(&cfg) == ESP_OK) {
+        ESP_LOGI(TAG, "[MQTT] Config saved to NVS");
+    }
+}
+
+void irrigation_handle_command(const char *data, int data_len)
+{
+    cJSON *json = cJSON_ParseWithLength(data, data_len);
+    if (json == NULL) {
+        ESP_LOGW(TAG, "[CMD] Failed to parse command JSON");
+        return;
+    }
+
+    cJSON *water_item = cJSON_GetObjectItem(json, "water_s");
+    cJSON *stop_item = cJSON_GetObjectItem(json, "stop");
+
+    // A stop also drops a manual run still waiting for the current one to end;
+    // a second water_s while one waits replaces it
+    portENTER_CRITICAL(&config_lock);
+    if (cJSON_IsTrue(stop_item)) {
+        stop_request = true;
+        manual_request_s = 0;
+    } else if (cJSON_IsNumber(water_item) && water_item->valueint > 0) {
+        manual_request_s = water_item->valueint;
+    }
+    portEXIT_CRITICAL(&config_lock);
+
+    cJSON_Delete(json);
+}
+
+/**
+ * Initialize irrigation controller
+ */
+void irrigation_init(esp_mqtt_client_handle_t client)
+{
+    ESP_LOGI(TAG, "Initializing irrigation device");
+    ESP_LOGI(TAG, "Device ID: %s", CONFIG_DEVICE_ID);
+
+    mqtt_client = client;
+
+    // Valves closed before anything else
+    relays_init();
+
+    config_set_defaults(&config);
+    load_config();
+    ESP_LOGI(TAG, "Config: %s, start %.0f%% stop %.0f%%, max open %ds, lockout %ds",
+             config.mode == IRRIGATION_MODE_PI ? "PI" : "hysteresis",
+             config.start_pct, config.stop_pct, config.max_open_s, config.min_interval_s);
+
+    // PI output is the next pulse length in seconds
+    pid_controller_init(&pid, config.kp, config.ki, 0, 0, config.max_open_s);
+    sensor_filter_init(&filter_moisture, FILTER_LAMBDA_MOISTURE);
+
+    soil_moisture_init();
+
+#if CONFIG_IRRIGATION_FLOW_METER
+    if (flow_meter_init(FLOW_GPIO, FLOW_PULSES_PER_LITRE) != ESP_OK) {
+        ESP_LOGW(TAG, "Flow meter unavailable, volumes will not be reported");
+    }
+#endif
+}
+
+/**
+ * Start control task
+ */
+void irrigation_start(void)
+{
+    if (!control_running && control_task_handle == NULL) {
+        control_running = true;
+        xTaskCreate(control_task, "irrigation_ctl", 4096, NULL, 6, &control_task_handle);
+        ESP_LOGI(TAG, "Started control task");
+    }
+}
+
+/**
+ * Stop control task
+ */
+void irrigation_stop(void)
+{
+    if (control_running) {
+        control_running = false;
+        ESP_LOGI(TAG, "Stopping control task");
+
+        int wait_count = 0;
+        while (control_task_handle != NULL && wait_count < 20) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            wait_count++;
+        }
+    }
+
+    valve_set(false);
+#if CONFIG_IRRIGATION_FLOW_METER
+    flow_meter_checkpoint();
+#endif
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "mqtt_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the irrigation controller
+ *
+ * Initializes the soil moisture sensor and valve relay outputs and loads the
+ * watering configuration from NVS.
+ *
+ * @param client MQTT client handle from mqtt_client_manager
+ */
+void irrigation_init(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Apply a config message (same JSON as sensor/config/{device_id})
+ *
+ * Used by the config topics (see fleet_config.h) and the "set_config"
+ * request.
+ */
+void irrigation_apply_config(const char *data, int data_len);
+
+/**
+ * @brief Handle a command from greenhouse/command/{device_id}
+ *
+ *   {"water_s": 60}    open the valve now (still capped by max_open_s), or
+ *                      as soon as a run in progress ends
+ *   {"stop": true}     close the valve now and drop a waiting manual run
+ *
+ * @param data      JSON payload
+ * @param data_len  Payload length
+ */
+void irrigation_handle_command(const char *data, int data_len);
+
+/**
+ * @brief Start the control task
+ *
+ * Runs on the local moisture reading only; started once at boot and keeps
+ * watering decisions local while the broker is unreachable.
+ */
+void irrigation_start(void);
+
+/**
+ * @brief Stop the control task and close the valves
+ */
+void irrigation_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
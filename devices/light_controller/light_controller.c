@@ -0,0 +1,461 @@
+/*
+ * Light Controller Device - Scheduled PWM grow light dimming
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Follows a daily on/off schedule with sunrise/sunset ramps computed from the
+ * local (SNTP-synced) clock. The schedule lives in NVS and is evaluated on the
+ * device, so lights keep cycling while the network is down. Manual overrides
+ * arrive on the manager's command topic and are applied from the MQTT task.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/ledc.h"
+#include <cJSON.h>
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "light_controller.h"
+#include "mqtt_client_manager.h"
+#include "time_sync.h"
+#include "env_config.h"
+
+// PWM output
+#define LIGHT_GPIO                  CONFIG_LIGHT_OUTPUT_GPIO
+#define LIGHT_LEDC_TIMER            LEDC_TIMER_1
+#define LIGHT_LEDC_CHANNEL          LEDC_CHANNEL_1
+#define LIGHT_LEDC_RESOLUTION       LEDC_TIMER_13_BIT
+#define LIGHT_LEDC_MAX_DUTY         ((1 << 13) - 1)
+
+// Schedule task
+#define SCHEDULE_PERIOD_MS          1000
+#define STATUS_INTERVAL_MS          60000
+#define OVERRIDE_DEFAULT_S          3600
+#define RAMP_MINUTES_DEFAULT        30
+
+// NVS storage for the schedule
+#define NVS_NAMESPACE               "lights"
+#define NVS_KEY_SCHEDULE            "schedule"
+#define LIGHT_SCHEDULE_VERSION      1
+
+#define MINUTES_PER_DAY             (24 * 60)
+
+static const char *TAG = "light_controller";
+
+/**
+ * Daily light schedule (local time)
+ */
+typedef struct {
+    uint8_t version;
+    uint16_t on_minute;         // Minute of day the sunrise ramp starts
+    uint16_t off_minute;        // Minute of day the sunset ramp ends
+    uint16_t ramp_minutes;      // Length of each ramp
+    uint8_t max_level;          // Full-day output (%)
+} light_schedule_t;
+
+/**
+ * Manual override set from the command topic
+ */
+typedef struct {
+    bool active;
+    float level;
+    int64_t until_ms;
+} light_override_t;
+
+// Global state
+static volatile bool schedule_running = false;
+static TaskHandle_t schedule_task_handle = NULL;
+static esp_mqtt_client_handle_t mqtt_client = NULL;
+static mqtt_state_t light_state = MQTT_STATE_INIT("lights");
+
+static light_schedule_t schedule;
+static light_override_t override;
+static portMUX_TYPE state_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Forward declarations
+static void schedule_task(void *pvParameters);
+
+/**
+ * Defaults from the ALERT_LIGHTS_* hours in .env
+ */
+static void schedule_set_defaults(light_schedule_t *sched)
+{
+    sched->version = LIGHT_SCHEDULE_VERSION;
+    sched->on_minute = (atoi(ENV_ALERT_LIGHTS_ON_HOUR) % 24) * 60;
+    sched->off_minute = (atoi(ENV_ALERT_LIGHTS_OFF_HOUR) % 24) * 60;
+    sched->ramp_minutes = RAMP_MINUTES_DEFAULT;
+    sched->max_level = 100;
+}
+
+/**
+ * Load schedule from NVS
+ */
+static bool load_schedule(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "[NVS] No schedule found, using defaults");
+        return false;
+    }
+
+    light_schedule_t stored;
+    size_t len = sizeof(stored);
+    err = nvs_get_blob(nvs_handle, NVS_KEY_SCHEDULE, &stored, &len);
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK || len != sizeof(stored) || stored.version != LIGHT_SCHEDULE_VERSION) {
+        ESP_LOGW(TAG, "[NVS] Stored schedule missing or outdated, using defaults");
+        return false;
+    }
+
+    schedule = stored;
+    return true;
+}
+
+/**
+ * Save schedule to NVS
+ */
+static esp_err_t save_schedule(const light_schedule_t *sched)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to open NVS for writing: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_set_blob(nvs_handle, NVS_KEY_SCHEDULE, sched, sizeof(*sched));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to save schedule: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+/**
+ * Configure LEDC for dimming
+ */
+static void output_init(void)
+{
+    ledc_timer_config_t timer_conf = {
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .duty_resolution = LIGHT_LEDC_RESOLUTION,
+        .timer_num = LIGHT_LEDC_TIMER,
+        .freq_hz = CONFIG_LIGHT_PWM_FREQ_HZ,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+    ESP_ERROR_CHECK(ledc_timer_config(&timer_conf));
+
+    ledc_channel_config_t channel_conf = {
+        .gpio_num = LIGHT_GPIO,
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .channel = LIGHT_LEDC_CHANNEL,
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = LIGHT_LEDC_TIMER,
+        .duty = 0,
+        .hpoint = 0,
+    };
+    ESP_ERROR_CHECK(ledc_channel_config(&channel_conf));
+
+    // Required for ledc_set_duty_and_update(), which is part of the fade API
+    ESP_ERROR_CHECK(ledc_fade_func_install(0));
+
+    ESP_LOGI(TAG, "[PWM] Lights on GPIO %d at %d Hz", LIGHT_GPIO, CONFIG_LIGHT_PWM_FREQ_HZ);
+}
+
+/**
+ * Set the light output (0-100 %)
+ */
+static void output_set(float percent)
+{
+    uint32_t duty = (uint32_t)(percent * LIGHT_LEDC_MAX_DUTY / 100.0f + 0.5f);
+    ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE, LIGHT_LEDC_CHANNEL, duty, 0);
+}
+
+/**
+ * Scheduled level at a time of day, with raised-cosine sunrise/sunset ramps
+ */
+static float schedule_level(const light_schedule_t *sched, float minute_of_day)
+{
+    float photoperiod = (sched->off_minute - sched->on_minute + MINUTES_PER_DAY) % MINUTES_PER_DAY;
+    float since_on = fmodf(minute_of_day - sched->on_minute + MINUTES_PER_DAY, MINUTES_PER_DAY);
+
+    if (photoperiod <= 0 || since_on >= photoperiod) {
+        return 0;
+    }
+
+    // Ramps can't be longer than half the photoperiod
+    float ramp = fminf(sched->ramp_minutes, photoperiod / 2);
+    float edge = fminf(since_on, photoperiod - since_on);
+    if (ramp <= 0 || edge >= ramp) {
+        return sched->max_level;
+    }
+    return sched->max_level * (1.0f - cosf((float)M_PI * edge / ramp)) / 2.0f;
+}
+
+/**
+ * Publish light state; never blocks the schedule task
+ */
+static void publish_status(float level, bool overridden)
+{
+    if (!mqtt_client_manager_is_connected() || mqtt_client == NULL) {
+        return;
+    }
+
+    char json_payload[192];
+    snprintf(json_payload, sizeof(json_payload),
+             "{\"device_id\":\"%s\",\"light_level\":%.1f,\"light_override\":%d,\"location_x\":%d,\"location_y\":%d}",
+             CONFIG_DEVICE_ID, level, overridden ? 1 : 0,
+             CONFIG_DEVICE_LOCATION_X, CONFIG_DEVICE_LOCATION_Y);
+    mqtt_client_manager_publish("sensor/lights", json_payload, 0, 0, false);
+    mqtt_client_manager_publish_state(&light_state, json_payload);
+}
+
+/**
+ * Schedule loop: evaluate schedule or override once per second, or as soon
+ * as a command changes the override. The only place that drives the output.
+ */
+static void schedule_loop(void)
+{
+    float applied = -1;
+    float published = -1;
+    int64_t last_status_ms = 0;
+    bool warned_unsynced = false;
+
+    ESP_LOGI(TAG, "Starting schedule loop");
+
+    while (schedule_running) {
+        int64_t now_ms = esp_timer_get_time() / 1000;
+
+        light_schedule_t sched;
+        light_override_t ovr;
+        portENTER_CRITICAL(&state_lock);
+        if (override.active && now_ms >= override.until_ms) {
+            override.active = false;
+        }
+        sched = schedule;
+        ovr = override;
+        portEXIT_CRITICAL(&state_lock);
+
+        float level;
+        if (ovr.active) {
+            level = ovr.level;
+        } else if (time_sync_is_valid()) {
+            time_t now = time(NULL);
+            struct tm local;
+            localtime_r(&now, &local);
+            level = schedule_level(&sched, local.tm_hour * 60 + local.tm_min + local.tm_sec / 60.0f);
+            warned_unsynced = false;
+        } else {
+            if (!warned_unsynced) {
+                ESP_LOGW(TAG, "Clock not set yet, holding fallback level %d%%", CONFIG_LIGHT_UNSYNCED_LEVEL);
+                warned_unsynced = true;
+            }
+            level = CONFIG_LIGHT_UNSYNCED_LEVEL;
+        }
+
+        if (fabsf(level - applied) >= 0.05f) {
+            output_set(level);
+            applied = level;
+        }
+
+        // Report whole-percent steps and the end of a ramp, plus a periodic heartbeat
+        bool settled = level != published && (level == 0 || level == sched.max_level || ovr.active);
+        if (fabsf(level - published) >= 1.0f || settled || now_ms - last_status_ms >= STATUS_INTERVAL_MS) {
+            last_status_ms = now_ms;
+            published = level;
+            publish_status(level, ovr.active);
+        }
+
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SCHEDULE_PERIOD_MS));
+    }
+
+    ESP_LOGI(TAG, "Schedule loop stopped");
+}
+
+/**
+ * Schedule task wrapper
+ */
+static void schedule_task(void *pvParameters)
+{
+    schedule_loop();
+    schedule_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * Parse "HH:MM" into minute of day
+ */
+static bool parse_time_of_day(const cJSON *item, uint16_t *minute_of_day)
+{
+    int hour, minute;
+    if (!cJSON_IsString(item) || sscanf(item->valuestring, "%d:%d", &hour, &minute) != 2 ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+        return false;
+    }
+    *minute_of_day = hour * 60 + minute;
+    return true;
+}
+
+/**
+ * Handle MQTT config message to update the schedule
+ */
+void light_controller_apply_config(const char *data, int data_len)
+{
+    ESP_LOGI(TAG, "[MQTT] Received config message: %.*s", data_len, data);
+
+    // Parse JSON: {"on_time": "06:00", "off_time": "22:00", "ramp_minutes": 30, "max_level": 100}
+    cJSON *json = cJSON_ParseWithLength(data, data_len);
+    if (json == NULL) {
+        ESP_LOGW(TAG, "[MQTT] Failed to parse config JSON");
+        return;
+    }
+
+    light_schedule_t sched;
+    portENTER_CRITICAL(&state_lock);
+    sched = schedule;
+    portEXIT_CRITICAL(&state_lock);
+
+    bool updated = false;
+    updated |= parse_time_of_day(cJSON_GetObjectItem(json, "on_time"), &sched.on_minute);
+    updated |= parse_time_of_day(cJSON_GetObjectItem(json, "off_time"), &sched.off_minute);
+
+    cJSON *item = cJSON_GetObjectItem(json, "ramp_minutes");
+    if (cJSON_IsNumber(item) && item->valueint >= 0 && item->valueint <= 12 * 60) {
+        sched.ramp_minutes = item->valueint;
+        updated = true;
+    }
+
+    item = cJSON_GetObjectItem(json, "max_level");
+    if (cJSON_IsNumber(item) && item->valueint >= 0 && item->valueint <= 100) {
+        sched.max_level = item->valueint;
+        updated = true;
+    }
+
+    cJSON_Delete(json);
+
+    if (!updated) {
+        return;
+    }
+
+    portENTER_CRITICAL(&state_lock);
+    schedule = sched;
+    portEXIT_CRITICAL(&state_lock);
+
+    ESP_LOGI(TAG, "[MQTT] Schedule %02d:%02d-%02d:%02d, %d min ramps, max %d%%",
+             sched.on_minute / 60, sched.on_minute % 60, sched.off_minute / 60, sched.off_minute % 60,
+             sched.ramp_minutes, sched.max_level);
+
+    if (save_schedule(&sched) == ESP_OK) {
+        ESP_LOGI(TAG, "[MQTT] Schedule saved to NVS");
+    }
+}
+
+void light_controller_handle_command(const char *data, int data_len)
+{
+    cJSON *json = cJSON_ParseWithLength(data, data_len);
+    if (json == NULL) {
+        ESP_LOGW(TAG, "[CMD] Failed to parse command JSON");
+        return;
+    }
+
+    cJSON *level_item = cJSON_GetObjectItem(json, "level");
+    cJSON *mode_item = cJSON_GetObjectItem(json, "mode");
+
+    if (cJSON_IsNumber(level_item)) {
+        float level = fminf(fmaxf(level_item->valuedouble, 0.0f), 100.0f);
+        cJSON *duration_item = cJSON_GetObjectItem(json, "duration_s");
+        int duration_s = cJSON_IsNumber(duration_item) && duration_item->valueint > 0
+                         ? duration_item->valueint : OVERRIDE_DEFAULT_S;
+
+        portENTER_CRITICAL(&state_lock);
+        override.active = true;
+        override.level = level;
+        override.until_ms = esp_timer_get_time() / 1000 + duration_s * 1000LL;
+        portEXIT_CRITICAL(&state_lock);
+
+        // The schedule task applies it; a pass already under way re-runs at once
+        if (schedule_task_handle != NULL) {
+            xTaskNotifyGive(schedule_task_handle);
+        }
+
+        ESP_LOGI(TAG, "[CMD] Override %.1f%% for %ds", level, duration_s);
+    } else if (cJSON_IsString(mode_item) && strcmp(mode_item->valuestring, "auto") == 0) {
+        portENTER_CRITICAL(&state_lock);
+        override.active = false;
+        portEXIT_CRITICAL(&state_lock);
+
+        if (schedule_task_handle != NULL) {
+            xTaskNotifyGive(schedule_task_handle);
+        }
+
+        ESP_LOGI(TAG, "[CMD] Override cleared, following schedule");
+    } else {
+        ESP_LOGW(TAG, "[CMD] Unknown command");
+    }
+
+    cJSON_Delete(json);
+}
+
+/**
+ * Initialize light controller
+ */
+void light_controller_init(esp_mqtt_client_handle_t client)
+{
+    ESP_LOGI(TAG, "Initializing light controller device");
+    ESP_LOGI(TAG, "Device ID: %s", CONFIG_DEVICE_ID);
+
+    mqtt_client = client;
+
+    schedule_set_defaults(&schedule);
+    load_schedule();
+    ESP_LOGI(TAG, "Schedule %02d:%02d-%02d:%02d, %d min ramps, max %d%%",
+             schedule.on_minute / 60, schedule.on_minute % 60,
+             schedule.off_minute / 60, schedule.off_minute % 60,
+             schedule.ramp_minutes, schedule.max_level);
+
+    output_init();
+}
+
+/**
+ * Start schedule task
+ */
+void light_controller_start(void)
+{
+    if (!schedule_running && schedule_task_handle == NULL) {
+        schedule_running = true;
+        xTaskCreate(schedule_task, "light_schedule", 4096, NULL, 5, &schedule_task_handle);
+        ESP_LOGI(TAG, "Started schedule task");
+    }
+}
+
+/**
+ * Stop schedule task
+ */
+void light_controller_stop(void)
+{
+    if (schedule_running) {
+        schedule_running = false;
+        ESP_LOGI(TAG, "Stopping schedule task");
+
+        int wait_count = 0;
+        while (schedule_task_handle != NULL && wait_count < 20) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            wait_count++;
+        }
+    }
+}
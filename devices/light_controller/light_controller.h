@@ -0,0 +1,55 @@
+#pragma once
+
+#include "mqtt_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the light controller
+ *
+ * Sets up LEDC PWM dimming and loads the light schedule from NVS, falling
+ * back to ALERT_LIGHTS_ON_HOUR / ALERT_LIGHTS_OFF_HOUR from .env.
+ *
+ * @param client MQTT client handle from mqtt_client_manager
+ */
+void light_controller_init(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Apply a config message (same JSON as sensor/config/{device_id})
+ *
+ * Used by the config topics (see fleet_config.h) and the "set_config"
+ * request.
+ */
+void light_controller_apply_config(const char *data, int data_len);
+
+/**
+ * @brief Handle a command from greenhouse/command/{device_id}
+ *
+ * Registered as the manager's on_command callback. The schedule task
+ * applies an override to the PWM output as soon as it is set:
+ *   {"level": 0-100, "duration_s": 3600}   hold a level (default 1 h)
+ *   {"mode": "auto"}                        return to the schedule
+ *
+ * @param data      JSON payload
+ * @param data_len  Payload length
+ */
+void light_controller_handle_command(const char *data, int data_len);
+
+/**
+ * @brief Start the schedule task
+ *
+ * Runs from the local clock, so it is started once at boot and keeps
+ * following the schedule while the network is down.
+ */
+void light_controller_start(void);
+
+/**
+ * @brief Stop the schedule task
+ */
+void light_controller_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Greenhouse Devices - PID Controller
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ */
+
+#include "pid_controller.h"
+
+#define PID_D_FILTER_TAU_DEFAULT_S  2.0f
+
+static float clampf(float value, float min, float max)
+{
+    if (value < min) {
+        return min;
+    }
+    if (value > max) {
+        return max;
+    }
+    return value;
+}
+
+void pid_controller_init(pid_controller_t *pid, float kp, float ki, float kd,
+                         float out_min, float out_max)
+{
+    pid->kp = kp;
+    pid->ki = ki;
+    pid->kd = kd;
+    pid->out_min = out_min;
+    pid->out_max = out_max;
+    pid->d_filter_tau_s = PID_D_FILTER_TAU_DEFAULT_S;
+    pid_controller_reset(pid);
+}
+
+void pid_controller_set_gains(pid_controller_t *pid, float kp, float ki, float kd)
+{
+    // The integral is stored already multiplied by ki, so changing ki
+    // does not rescale the accumulated history
+    pid->kp = kp;
+    pid->ki = ki;
+    pid->kd = kd;
+}
+
+void pid_controller_set_limits(pid_controller_t *pid, float out_min, float out_max)
+{
+    pid->out_min = out_min;
+    pid->out_max = out_max;
+    pid->integral = clampf(pid->integral, out_min, out_max);
+}
+
+void pid_controller_reset(pid_controller_t *pid)
+{
+    pid->integral = 0;
+    pid->derivative = 0;
+    pid->prev_measurement = 0;
+    pid->primed = false;
+}
+
+float pid_controller_update(pid_controller_t *pid, float setpoint, float measurement, float dt_s)
+{
+    float error = setpoint - measurement;
+
+    if (!pid->primed || dt_s <= 0) {
+        pid->prev_measurement = measurement;
+        pid->primed = true;
+        dt_s = 0;
+    }
+
+    // Derivative on measurement, low-pass filtered
+    if (dt_s > 0) {
+        float raw = -pid->kd * (measurement - pid->prev_measurement) / dt_s;
+        float a = dt_s / (pid->d_filter_tau_s + dt_s);
+        pid->derivative += a * (raw - pid->derivative);
+    }
+    pid->prev_measurement = measurement;
+
+    float proportional = pid->kp * error;
+    float unsaturated = proportional + pid->integral + pid->derivative;
+
+    // Conditional integration: freeze while saturated in the direction of the error
+    bool saturated_high = unsaturated >= pid->out_max && error > 0;
+    bool saturated_low = unsaturated <= pid->out_min && error < 0;
+    if (!saturated_high && !saturated_low) {
+        pid->integral = clampf(pid->integral + pid->ki * error * dt_s, pid->out_min, pid->out_max);
+    }
+
+    return clampf(proportional + pid->integral + pid->derivative, pid->out_min, pid->out_max);
+}
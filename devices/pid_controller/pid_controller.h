@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief PID controller state
+ *
+ * Derivative acts on the measurement (no kick on setpoint changes) through a
+ * first-order low-pass. Anti-windup uses conditional integration: the
+ * integral only moves while the output is unsaturated or the error drives it
+ * back out of saturation, and is itself clamped to the output range.
+ */
+typedef struct {
+    float kp;
+    float ki;                   // Per second
+    float kd;                   // Seconds
+    float out_min;
+    float out_max;
+    float integral;             // Integral term, already scaled by ki
+    float derivative;           // Filtered derivative term
+    float prev_measurement;
+    float d_filter_tau_s;       // Derivative low-pass time constant
+    bool primed;
+} pid_controller_t;
+
+/**
+ * @brief Initialize a controller
+ *
+ * @param pid      Controller state
+ * @param kp       Proportional gain
+ * @param ki       Integral gain (1/s)
+ * @param kd       Derivative gain (s)
+ * @param out_min  Lower output limit
+ * @param out_max  Upper output limit
+ */
+void pid_controller_init(pid_controller_t *pid, float kp, float ki, float kd,
+                         float out_min, float out_max);
+
+/**
+ * @brief Change gains without a bump in the output
+ */
+void pid_controller_set_gains(pid_controller_t *pid, float kp, float ki, float kd);
+
+/**
+ * @brief Change the output range, clamping the integral into it
+ */
+void pid_controller_set_limits(pid_controller_t *pid, float out_min, float out_max);
+
+/**
+ * @brief Clear integral and derivative state (e.g. after a fault)
+ */
+void pid_controller_reset(pid_controller_t *pid);
+
+/**
+ * @brief Run one control step
+ *
+ * @param pid          Controller state
+ * @param setpoint     Target value
+ * @param measurement  Process value
+ * @param dt_s         Time since the previous step in seconds
+ * @return Output clamped to [out_min, out_max]
+ */
+float pid_controller_update(pid_controller_t *pid, float setpoint, float measurement, float dt_s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,83 @@
+/*
+ * Greenhouse Devices - Static dataflow pipeline
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Runs a sample through a const table of stages (filters, aggregators,
+ * sinks). Stage state is owned by the wiring table, so nothing is allocated
+ * at runtime. Each stage is timed with the CPU cycle counter.
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "sdkconfig.h"
+#include "pipeline.h"
+
+static const char *TAG = "pipeline";
+
+static const struct {
+    const char *name;
+    int decimals;
+} FIELD_INFO[PIPELINE_FIELD_COUNT] = {
+    [PIPELINE_FIELD_TEMPERATURE]    = { "temperature", 2 },
+    [PIPELINE_FIELD_HUMIDITY]       = { "humidity", 2 },
+    [PIPELINE_FIELD_PRESSURE]       = { "pressure", 2 },
+    [PIPELINE_FIELD_GAS_RESISTANCE] = { "gas_resistance", 2 },
+    [PIPELINE_FIELD_VPD]            = { "vpd", 3 },
+    [PIPELINE_FIELD_DEW_POINT]      = { "dew_point", 2 },
+    [PIPELINE_FIELD_ABS_HUMIDITY]   = { "abs_humidity", 2 },
+    [PIPELINE_FIELD_IAQ]            = { "iaq", 0 },
+    [PIPELINE_FIELD_IAQ_ACCURACY]   = { "iaq_accuracy", 0 },
+    [PIPELINE_FIELD_SOIL_MOISTURE]  = { "soil_moisture", 0 },
+};
+
+const char *pipeline_field_name(pipeline_field_t field)
+{
+    return field < PIPELINE_FIELD_COUNT ? FIELD_INFO[field].name : "unknown";
+}
+
+int pipeline_field_decimals(pipeline_field_t field)
+{
+    return field < PIPELINE_FIELD_COUNT ? FIELD_INFO[field].decimals : 2;
+}
+
+size_t pipeline_run(pipeline_t *pipeline, pipeline_sample_t *sample)
+{
+    for (size_t i = 0; i < pipeline->stage_count; i++) {
+        const pipeline_stage_t *stage = &pipeline->stages[i];
+
+        uint32_t start = esp_cpu_get_cycle_count();
+        pipeline_result_t result = stage->process(stage->ctx, sample);
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+        pipeline_stage_stats_t *stats = &pipeline->stats[i];
+        stats->calls++;
+        stats->total_cycles += cycles;
+        if (cycles > stats->max_cycles) {
+            stats->max_cycles = cycles;
+        }
+
+        if (result == PIPELINE_STOP) {
+            return i + 1;
+        }
+    }
+    return pipeline->stage_count;
+}
+
+void pipeline_log_stats(pipeline_t *pipeline)
+{
+    const uint32_t mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+
+    ESP_LOGI(TAG, "[%s] Per-stage cost (mean / max us):", pipeline->name);
+    for (size_t i = 0; i < pipeline->stage_count; i++) {
+        pipeline_stage_stats_t *stats = &pipeline->stats[i];
+        if (stats->calls == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "[%s]   %-12s %6lu calls  %8.1f / %8.1f",
+                 pipeline->name, pipeline->stages[i].name, (unsigned long)stats->calls,
+                 (double)stats->total_cycles / stats->calls / mhz, (double)stats->max_cycles / mhz);
+        memset(stats, 0, sizeof(*stats));
+    }
+}
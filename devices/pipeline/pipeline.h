@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Typed fields a sample can carry
+ *
+ * Order is the order fields appear in published JSON.
+ */
+typedef enum {
+    PIPELINE_FIELD_TEMPERATURE = 0,     // °C
+    PIPELINE_FIELD_HUMIDITY,            // %RH
+    PIPELINE_FIELD_PRESSURE,            // hPa
+    PIPELINE_FIELD_GAS_RESISTANCE,      // Ohm
+    PIPELINE_FIELD_VPD,                 // kPa
+    PIPELINE_FIELD_DEW_POINT,           // °C
+    PIPELINE_FIELD_ABS_HUMIDITY,        // g/m³
+    PIPELINE_FIELD_IAQ,                 // 0-500 index
+    PIPELINE_FIELD_IAQ_ACCURACY,        // iaq_accuracy_t
+    PIPELINE_FIELD_SOIL_MOISTURE,       // %
+    PIPELINE_FIELD_COUNT
+} pipeline_field_t;
+
+/**
+ * @brief One sample flowing through a pipeline
+ */
+typedef struct {
+    int64_t timestamp_ms;
+    uint32_t valid;                     // Bit per pipeline_field_t
+    float value[PIPELINE_FIELD_COUNT];
+} pipeline_sample_t;
+
+static inline void pipeline_sample_set(pipeline_sample_t *sample, pipeline_field_t field, float value)
+{
+    sample->value[field] = value;
+    sample->valid |= 1u << field;
+}
+
+static inline bool pipeline_sample_has(const pipeline_sample_t *sample, pipeline_field_t field)
+{
+    return (sample->valid & (1u << field)) != 0;
+}
+
+/**
+ * @brief Stage result: pass the sample on, or end this run here
+ *
+ * Aggregators return PIPELINE_STOP until their window closes, so the
+ * stages after them only see aggregated samples.
+ */
+typedef enum {
+    PIPELINE_PASS = 0,
+    PIPELINE_STOP,
+} pipeline_result_t;
+
+typedef pipeline_result_t (*pipeline_stage_fn_t)(void *ctx, pipeline_sample_t *sample);
+
+/**
+ * @brief One entry of a compile-time wiring table
+ */
+typedef struct {
+    const char *name;
+    pipeline_stage_fn_t process;
+    void *ctx;                          // Statically allocated stage state
+} pipeline_stage_t;
+
+/**
+ * @brief Per-stage cost, in CPU cycles
+ */
+typedef struct {
+    uint32_t calls;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+} pipeline_stage_stats_t;
+
+typedef struct {
+    const char *name;
+    const pipeline_stage_t *stages;
+    size_t stage_count;
+    pipeline_stage_stats_t *stats;
+} pipeline_t;
+
+/**
+ * @brief Define a pipeline over a const stage table, with its stats storage
+ *
+ *   static const pipeline_stage_t STAGES[] = { {...}, {...} };
+ *   PIPELINE_DEFINE(my_pipeline, STAGES);
+ */
+#define PIPELINE_DEFINE(var, stage_table) \
+    static pipeline_stage_stats_t var##_stats[sizeof(stage_table) / sizeof((stage_table)[0])]; \
+    static pipeline_t var = { \
+        .name = #var, \
+        .stages = (stage_table), \
+        .stage_count = sizeof(stage_table) / sizeof((stage_table)[0]), \
+        .stats = var##_stats, \
+    }
+
+/**
+ * @brief Run a sample through every stage in order
+ *
+ * @return Number of stages that ran (stage_count if none stopped early)
+ */
+size_t pipeline_run(pipeline_t *pipeline, pipeline_sample_t *sample);
+
+/**
+ * @brief Log mean/max cost per stage since the last call, then reset
+ */
+void pipeline_log_stats(pipeline_t *pipeline);
+
+/**
+ * @brief JSON key for a field
+ */
+const char *pipeline_field_name(pipeline_field_t field);
+
+/**
+ * @brief Decimal places a field is published with
+ */
+int pipeline_field_decimals(pipeline_field_t field);
+
+#ifdef __cplusplus
+}
+#endif
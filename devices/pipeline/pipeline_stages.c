@@ -0,0 +1,116 @@
+/*
+ * Greenhouse Devices - Reusable pipeline stages
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "pipeline_stages.h"
+#include "mqtt_client_manager.h"
+
+static const char *TAG = "pipeline";
+
+pipeline_result_t pipeline_median_process(void *ctx, pipeline_sample_t *sample)
+{
+    pipeline_median_t *m = ctx;
+    if (!pipeline_sample_has(sample, m->field)) {
+        return PIPELINE_PASS;
+    }
+
+    m->history[m->pos] = sample->value[m->field];
+    m->pos = (m->pos + 1) % m->window;
+    if (m->count < m->window) {
+        m->count++;
+    }
+
+    // Insertion sort of at most PIPELINE_MEDIAN_MAX_WINDOW values
+    float sorted[PIPELINE_MEDIAN_MAX_WINDOW];
+    for (int i = 0; i < m->count; i++) {
+        float v = m->history[i];
+        int j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+
+    sample->value[m->field] = sorted[m->count / 2];
+    return PIPELINE_PASS;
+}
+
+pipeline_result_t pipeline_snapshot_process(void *ctx, pipeline_sample_t *sample)
+{
+    pipeline_snapshot_t *s = ctx;
+
+    unsigned seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s->sample = *sample;
+    atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+    return PIPELINE_PASS;
+}
+
+bool pipeline_snapshot_read(pipeline_snapshot_t *snapshot, pipeline_sample_t *out)
+{
+    unsigned before, after;
+    int retries = 0;
+    for (;;) {
+        before = atomic_load_explicit(&snapshot->seq, memory_order_acquire);
+        *out = snapshot->sample;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&snapshot->seq, memory_order_relaxed);
+        if (before == after && !(before & 1)) {
+            break;
+        }
+        // On a single core a reader that preempted the writer mid-copy would
+        // spin forever; sleeping a tick lets a lower-priority writer finish
+        if (++retries >= PIPELINE_SNAPSHOT_SPIN_RETRIES) {
+            vTaskDelay(1);
+        }
+    }
+
+    return before != 0;
+}
+
+pipeline_result_t pipeline_mqtt_sink_process(void *ctx, pipeline_sample_t *sample)
+{
+    pipeline_mqtt_sink_t *sink = ctx;
+
+    if (!mqtt_client_manager_is_connected() || sink->client == NULL) {
+        ESP_LOGD(TAG, "MQTT not connected, dropping %s sample", sink->topic);
+        return PIPELINE_PASS;
+    }
+
+    char *buf = sink->buf;
+    size_t size = sink->buf_size;
+    int len = snprintf(buf, size, "{\"device_id\":\"%s\",", CONFIG_DEVICE_ID);
+
+    for (int f = 0; f < PIPELINE_FIELD_COUNT && len < (int)size; f++) {
+        if (pipeline_sample_has(sample, f)) {
+            len += snprintf(buf + len, size - len, "\"%s\":%.*f,",
+                            pipeline_field_name(f), pipeline_field_decimals(f), sample->value[f]);
+        }
+    }
+    if (sink->append != NULL && len < (int)size) {
+        len += sink->append(buf + len, size - len);
+    }
+    if (len < (int)size) {
+        len += snprintf(buf + len, size - len, "\"location_x\":%d,\"location_y\":%d}",
+                        CONFIG_DEVICE_LOCATION_X, CONFIG_DEVICE_LOCATION_Y);
+    }
+    if (len >= (int)size) {
+        ESP_LOGW(TAG, "Payload for %s truncated, dropping", sink->topic);
+        return PIPELINE_PASS;
+    }
+
+    int msg_id = mqtt_client_manager_publish(sink->topic, buf, len, sink->qos, false);
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "Failed to publish to %s, will retry on next reading", sink->topic);
+    }
+    return PIPELINE_PASS;
+}
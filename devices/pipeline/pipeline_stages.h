@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdatomic.h>
+#include "mqtt_client.h"
+#include "pipeline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PIPELINE_MEDIAN_MAX_WINDOW  7
+
+/**
+ * @brief Running median over the last `window` values of one field
+ *
+ * Removes single-sample spikes (ADC glitches) without smearing steps.
+ */
+typedef struct {
+    pipeline_field_t field;
+    uint8_t window;                     // Odd, <= PIPELINE_MEDIAN_MAX_WINDOW
+    uint8_t count;
+    uint8_t pos;
+    float history[PIPELINE_MEDIAN_MAX_WINDOW];
+} pipeline_median_t;
+
+#define PIPELINE_MEDIAN_INIT(f, w)  { .field = (f), .window = (w) }
+
+pipeline_result_t pipeline_median_process(void *ctx, pipeline_sample_t *sample);
+
+#define PIPELINE_SNAPSHOT_SPIN_RETRIES  4
+
+/**
+ * @brief Latest sample for readers on other tasks (sequence lock)
+ *
+ * Written only by the pipeline's task. pipeline_snapshot_read() is
+ * lock-free and normally O(1); it retries while a write is in progress and
+ * after PIPELINE_SNAPSHOT_SPIN_RETRIES attempts sleeps a tick between tries
+ * so a writer it preempted can finish.
+ */
+typedef struct {
+    atomic_uint seq;                    // Odd while being written
+    pipeline_sample_t sample;
+} pipeline_snapshot_t;
+
+pipeline_result_t pipeline_snapshot_process(void *ctx, pipeline_sample_t *sample);
+
+/**
+ * @brief Copy the latest sample
+ *
+ * @return false if nothing has been written yet
+ */
+bool pipeline_snapshot_read(pipeline_snapshot_t *snapshot, pipeline_sample_t *out);
+
+/**
+ * @brief Publish valid fields as JSON when MQTT is connected
+ *
+ * The payload is {"device_id", <fields>, <append>, "location_x/y"}; the
+ * caller provides the buffer so the sink owns no memory.
+ */
+typedef struct {
+    const char *topic;
+    int qos;
+    esp_mqtt_client_handle_t client;    // Set by the owner at init
+    char *buf;
+    size_t buf_size;
+    /** Optional extra members ("key":value,...) written at buf; returns length */
+    int (*append)(char *buf, size_t size);
+} pipeline_mqtt_sink_t;
+
+pipeline_result_t pipeline_mqtt_sink_process(void *ctx, pipeline_sample_t *sample);
+
+#ifdef __cplusplus
+}
+#endif
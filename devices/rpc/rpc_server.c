@@ -0,0 +1,333 @@
+/*
+ * Greenhouse Devices - MQTT5 Request/Response Server
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Commands with a reply, on top of the MQTT5 response topic and correlation
+ * data. The MQTT task only copies a request into a bounded queue; worker
+ * tasks parse it, run the registered handler within the request's latency
+ * budget and publish the reply, so a slow handler never stalls telemetry
+ * or actuation commands.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "rpc_server.h"
+#include "mqtt_client_manager.h"
+#include "broker_failover.h"
+#include "link_watchdog.h"
+#include "tls_transport.h"
+
+#define RPC_MAX_HANDLERS        12
+#define RPC_MAX_METHOD          24
+#define RPC_MAX_PAYLOAD         256
+#define RPC_MAX_TOPIC           96
+#define RPC_MAX_CORRELATION     32
+#define RPC_MAX_REPLY           CONFIG_RPC_MAX_REPLY
+
+static const char *TAG = "rpc_server";
+
+typedef struct {
+    int64_t received_us;
+    uint16_t payload_len;
+    uint8_t correlation_len;
+    char response_topic[RPC_MAX_TOPIC];
+    char correlation[RPC_MAX_CORRELATION];
+    char payload[RPC_MAX_PAYLOAD];
+} rpc_request_t;
+
+typedef struct {
+    char method[RPC_MAX_METHOD];
+    rpc_handler_t handler;
+} rpc_method_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t busy;              // Rejected, queue full
+    uint32_t expired;           // Budget spent while queued
+    uint32_t errors;
+    uint32_t late;              // Handler finished after the budget
+    uint32_t max_latency_us;
+    uint64_t total_latency_us;
+} rpc_stats_t;
+
+static QueueHandle_t request_queue = NULL;
+static char default_response_topic[RPC_MAX_TOPIC];
+
+// Registered once at init, read-only afterwards
+static rpc_method_t methods[RPC_MAX_HANDLERS];
+static int method_count = 0;
+
+static rpc_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Publish a reply with the request's correlation data
+ */
+static void send_reply(const rpc_request_t *req, const char *body, int len)
+{
+    if (mqtt_client_manager_publish_reply(req->response_topic, body, len,
+                                          req->correlation, req->correlation_len) < 0) {
+        ESP_LOGW(TAG, "Failed to publish reply to %s", req->response_topic);
+    }
+}
+
+static rpc_handler_t find_handler(const char *method)
+{
+    for (int i = 0; i < method_count; i++) {
+        if (strcmp(methods[i].method, method) == 0) {
+            return methods[i].handler;
+        }
+    }
+    return NULL;
+}
+
+static void handle_request(const rpc_request_t *req, char *body)
+{
+    const char *method = "";
+    int timeout_ms = CONFIG_RPC_DEADLINE_MS;
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+
+    cJSON *json = cJSON_ParseWithLength(req->payload, req->payload_len);
+    cJSON *reply = cJSON_CreateObject();
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddStringToObject(reply, "device_id", CONFIG_DEVICE_ID);
+
+    if (json != NULL) {
+        cJSON *method_item = cJSON_GetObjectItem(json, "method");
+        if (cJSON_IsString(method_item)) {
+            method = method_item->valuestring;
+        }
+        cJSON *timeout_item = cJSON_GetObjectItem(json, "timeout_ms");
+        if (cJSON_IsNumber(timeout_item) && timeout_item->valueint > 0) {
+            timeout_ms = timeout_item->valueint < RPC_MAX_TIMEOUT_MS ? timeout_item->valueint : RPC_MAX_TIMEOUT_MS;
+        }
+        // Echoed for clients that can't read MQTT5 properties
+        cJSON *id_item = cJSON_GetObjectItem(json, "id");
+        if (id_item != NULL) {
+            cJSON_AddItemToObject(reply, "id", cJSON_Duplicate(id_item, true));
+        }
+    }
+    cJSON_AddStringToObject(reply, "method", method);
+
+    int64_t deadline_us = req->received_us + (int64_t)timeout_ms * 1000;
+    bool expired = false;
+
+    if (method[0] != '\0') {
+        rpc_handler_t handler = find_handler(method);
+        if (handler == NULL) {
+            err = ESP_ERR_NOT_FOUND;
+        } else if (esp_timer_get_time() >= deadline_us) {
+            // Stale by the time a worker got to it; the caller has given up
+            err = ESP_ERR_TIMEOUT;
+            expired = true;
+        } else {
+            err = handler(cJSON_GetObjectItem(json, "params"), result, deadline_us);
+        }
+    }
+
+    if (err == ESP_OK) {
+        cJSON_AddItemToObject(reply, "result", result);
+    } else {
+        cJSON_AddStringToObject(reply, "error", esp_err_to_name(err));
+        cJSON_Delete(result);
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    uint32_t latency_us = (uint32_t)(now_us - req->received_us);
+    cJSON_AddNumberToObject(reply, "latency_ms", latency_us / 1000.0);
+
+    if (cJSON_PrintPreallocated(reply, body, RPC_MAX_REPLY, false)) {
+        send_reply(req, body, strlen(body));
+    } else {
+        ESP_LOGW(TAG, "Reply to %s does not fit in %d bytes", method, RPC_MAX_REPLY);
+        int len = snprintf(body, RPC_MAX_REPLY, "{\"device_id\":\"%s\",\"method\":\"%s\",\"error\":\"ESP_ERR_INVALID_SIZE\"}",
+                           CONFIG_DEVICE_ID, method);
+        send_reply(req, body, len);
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.requests++;
+    stats.total_latency_us += latency_us;
+    if (latency_us > stats.max_latency_us) {
+        stats.max_latency_us = latency_us;
+    }
+    if (expired) {
+        stats.expired++;
+    } else if (err != ESP_OK) {
+        stats.errors++;
+    } else if (now_us > deadline_us) {
+        stats.late++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    ESP_LOGI(TAG, "[RPC] %s -> %s in %lu us", method, esp_err_to_name(err), (unsigned long)latency_us);
+
+    cJSON_Delete(reply);
+    cJSON_Delete(json);
+}
+
+static void rpc_worker(void *pvParameters)
+{
+    rpc_request_t req;
+
+    // Replies can be a few KB (history queries); keep them off the stack
+    char *body = malloc(RPC_MAX_REPLY);
+    if (body == NULL) {
+        ESP_LOGE(TAG, "No memory for a %d byte reply buffer", RPC_MAX_REPLY);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    while (1) {
+        if (xQueueReceive(request_queue, &req, portMAX_DELAY) == pdTRUE) {
+            handle_request(&req, body);
+        }
+    }
+}
+
+/**
+ * Built-in "get_stats": uptime, heap, Wi-Fi signal, broker, link, TLS and RPC counters
+ */
+static esp_err_t rpc_get_stats(const cJSON *params, cJSON *result, int64_t deadline_us)
+{
+    rpc_stats_t snapshot;
+    portENTER_CRITICAL(&stats_lock);
+    snapshot = stats;
+    portEXIT_CRITICAL(&stats_lock);
+
+    cJSON_AddNumberToObject(result, "uptime_s", esp_timer_get_time() / 1000000);
+    cJSON_AddNumberToObject(result, "free_heap", esp_get_free_heap_size());
+    cJSON_AddNumberToObject(result, "min_free_heap", esp_get_minimum_free_heap_size());
+
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        cJSON_AddNumberToObject(result, "rssi", ap.rssi);
+    }
+
+    // Too large for the worker stack with every broker configured
+    char *broker = malloc(BROKER_FAILOVER_STATUS_MAX);
+    if (broker != NULL) {
+        if (broker_failover_format_status(broker, BROKER_FAILOVER_STATUS_MAX) < BROKER_FAILOVER_STATUS_MAX) {
+            cJSON_AddRawToObject(result, "broker", broker);
+        }
+        free(broker);
+    }
+
+    char status[512];
+    if (link_watchdog_format_status(status, sizeof(status)) < (int)sizeof(status)) {
+        cJSON_AddRawToObject(result, "link", status);
+    }
+    if (tls_transport_format_status(status, sizeof(status)) < (int)sizeof(status)) {
+        cJSON_AddRawToObject(result, "tls", status);
+    }
+
+    cJSON *rpc = cJSON_AddObjectToObject(result, "rpc");
+    cJSON_AddNumberToObject(rpc, "requests", snapshot.requests);
+    cJSON_AddNumberToObject(rpc, "busy", snapshot.busy);
+    cJSON_AddNumberToObject(rpc, "expired", snapshot.expired);
+    cJSON_AddNumberToObject(rpc, "errors", snapshot.errors);
+    cJSON_AddNumberToObject(rpc, "late", snapshot.late);
+    cJSON_AddNumberToObject(rpc, "mean_latency_ms",
+                            snapshot.requests ? snapshot.total_latency_us / snapshot.requests / 1000.0 : 0);
+    cJSON_AddNumberToObject(rpc, "max_latency_ms", snapshot.max_latency_us / 1000.0);
+    return ESP_OK;
+}
+
+void rpc_server_init(void)
+{
+    if (request_queue != NULL) {
+        return;
+    }
+
+    snprintf(default_response_topic, sizeof(default_response_topic),
+             MQTT_REQUEST_TOPIC_PREFIX "%s/response", CONFIG_DEVICE_ID);
+
+    request_queue = xQueueCreate(CONFIG_RPC_QUEUE_DEPTH, sizeof(rpc_request_t));
+    if (request_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate request queue");
+        return;
+    }
+
+    rpc_server_register("get_stats", rpc_get_stats);
+
+    for (int i = 0; i < CONFIG_RPC_WORKERS; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "rpc_worker%d", i);
+        // Above the sensor and control tasks so replies stay within budget
+        xTaskCreate(rpc_worker, name, 4096, NULL, 7, NULL);
+    }
+
+    ESP_LOGI(TAG, "RPC on " MQTT_REQUEST_TOPIC_PREFIX "%s: %d worker(s), %d pending, %d ms budget",
+             CONFIG_DEVICE_ID, CONFIG_RPC_WORKERS, CONFIG_RPC_QUEUE_DEPTH, CONFIG_RPC_DEADLINE_MS);
+}
+
+esp_err_t rpc_server_register(const char *method, rpc_handler_t handler)
+{
+    if (method_count >= RPC_MAX_HANDLERS || strlen(method) >= RPC_MAX_METHOD) {
+        ESP_LOGE(TAG, "Cannot register method %s", method);
+        return ESP_ERR_NO_MEM;
+    }
+
+    strlcpy(methods[method_count].method, method, RPC_MAX_METHOD);
+    methods[method_count].handler = handler;
+    method_count++;
+    return ESP_OK;
+}
+
+void rpc_server_submit(esp_mqtt_event_handle_t event)
+{
+    if (request_queue == NULL) {
+        return;
+    }
+
+    rpc_request_t req = {
+        .received_us = esp_timer_get_time(),
+    };
+
+    const esp_mqtt5_event_property_t *property = event->property;
+    if (property != NULL && property->response_topic_len > 0 &&
+        property->response_topic_len < RPC_MAX_TOPIC) {
+        memcpy(req.response_topic, property->response_topic, property->response_topic_len);
+    } else {
+        strlcpy(req.response_topic, default_response_topic, sizeof(req.response_topic));
+    }
+    if (property != NULL && property->correlation_data_len > 0 &&
+        property->correlation_data_len <= RPC_MAX_CORRELATION) {
+        memcpy(req.correlation, property->correlation_data, property->correlation_data_len);
+        req.correlation_len = property->correlation_data_len;
+    }
+
+    const char *error = NULL;
+    if (event->data_len != event->total_data_len || event->data_len > RPC_MAX_PAYLOAD) {
+        error = "ESP_ERR_INVALID_SIZE";
+    } else {
+        memcpy(req.payload, event->data, event->data_len);
+        req.payload_len = event->data_len;
+        if (xQueueSend(request_queue, &req, 0) != pdTRUE) {
+            error = "busy";
+            portENTER_CRITICAL(&stats_lock);
+            stats.busy++;
+            portEXIT_CRITICAL(&stats_lock);
+        }
+    }
+
+    if (error != NULL) {
+        // Answer now rather than let the caller wait out its timeout
+        char body[96];
+        int len = snprintf(body, sizeof(body), "{\"device_id\":\"%s\",\"error\":\"%s\"}",
+                           CONFIG_DEVICE_ID, error);
+        if (len >= (int)sizeof(body)) {
+            len = sizeof(body) - 1;
+        }
+        send_reply(&req, body, len);
+    }
+}
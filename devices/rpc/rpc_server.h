@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+#include <cJSON.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Upper bound for a request's "timeout_ms"
+#define RPC_MAX_TIMEOUT_MS      5000
+
+/**
+ * @brief Handler for one method
+ *
+ * Runs on an RPC worker task, never on the MQTT task. Blocking is allowed
+ * but should end by deadline_us (esp_timer time); the reply is sent either
+ * way.
+ *
+ * @param params      "params" object of the request, may be NULL
+ * @param result      Object to fill; sent as "result" on ESP_OK
+ * @param deadline_us Latency budget of this request
+ * @return ESP_OK, or an error sent back as "error"
+ */
+typedef esp_err_t (*rpc_handler_t)(const cJSON *params, cJSON *result, int64_t deadline_us);
+
+/**
+ * @brief Create the request queue and worker tasks
+ *
+ * Registers the built-in "get_stats" method. Replies go out through
+ * mqtt_client_manager_publish_reply().
+ */
+void rpc_server_init(void);
+
+/**
+ * @brief Register a method
+ *
+ * @return ESP_ERR_NO_MEM if the handler table is full
+ */
+esp_err_t rpc_server_register(const char *method, rpc_handler_t handler);
+
+/**
+ * @brief Queue a request received on the request topic
+ *
+ * Called from the MQTT task for greenhouse/rpc/{device_id}; copies the
+ * request and never blocks. The reply goes to the request's MQTT5 response
+ * topic (or greenhouse/rpc/{device_id}/response) with its correlation data.
+ *
+ * Request: {"method": "read_now", "params": {...}, "timeout_ms": 500, "id": ...}
+ */
+void rpc_server_submit(esp_mqtt_event_handle_t event);
+
+#ifdef __cplusplus
+}
+#endif
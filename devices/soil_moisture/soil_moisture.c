@@ -0,0 +1,299 @@
+/*
+ * Greenhouse Devices - LM393 Soil Moisture Sensor
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Shared by the climate monitor (reporting) and the irrigation controller
+ * (closed-loop watering). Calibration is persisted in NVS.
+ */
+
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include <cJSON.h>
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "soil_moisture.h"
+
+// LM393 Soil Moisture Sensor (Analog Output)
+// GPIO mapping is chip-specific due to different ADC channel layouts
+#if CONFIG_IDF_TARGET_ESP32C3
+    // ESP32-C3: ADC1_CHANNEL_1 = GPIO 1
+    #define SOIL_MOISTURE_ADC_CHANNEL   ADC_CHANNEL_1
+    #define SOIL_MOISTURE_GPIO_PIN      1
+#elif CONFIG_IDF_TARGET_ESP32S3
+    // ESP32-S3: ADC1_CHANNEL_0 = GPIO 1 (same physical pin!)
+    #define SOIL_MOISTURE_ADC_CHANNEL   ADC_CHANNEL_0
+    #define SOIL_MOISTURE_GPIO_PIN      1
+#else
+    #error "Unsupported target for soil moisture sensor"
+#endif
+
+#define SOIL_MOISTURE_ADC_ATTEN     ADC_ATTEN_DB_12  // 0-3100mV range
+#define SOIL_MOISTURE_DRY_DEFAULT   2800  // Default ADC value when completely dry
+#define SOIL_MOISTURE_WET_DEFAULT   1200  // Default ADC value when fully wet
+
+static const char *TAG = "soil_moisture";
+
+// ADC for soil moisture
+static adc_oneshot_unit_handle_t adc_handle = NULL;
+static adc_cali_handle_t adc_cali_handle = NULL;
+
+// NVS storage for calibration
+#define NVS_NAMESPACE "soil_cal"
+#define NVS_KEY_DRY_VALUE "dry_value"
+#define NVS_KEY_WET_VALUE "wet_value"
+
+// Soil moisture calibration values (can be updated via MQTT and persisted to NVS)
+static int soil_moisture_dry_value = SOIL_MOISTURE_DRY_DEFAULT;
+static int soil_moisture_wet_value = SOIL_MOISTURE_WET_DEFAULT;
+
+/**
+ * Load soil moisture calibration values from NVS
+ * Returns true if values were loaded, false if defaults are used
+ */
+static bool load_soil_calibration(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err;
+
+    // Open NVS
+    err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "[NVS] No calibration found, using defaults (dry=%d, wet=%d)", 
+                 SOIL_MOISTURE_DRY_DEFAULT, SOIL_MOISTURE_WET_DEFAULT);
+        soil_moisture_dry_value = SOIL_MOISTURE_DRY_DEFAULT;
+        soil_moisture_wet_value = SOIL_MOISTURE_WET_DEFAULT;
+        return false;
+    }
+
+    // Read dry value
+    int32_t dry_val = SOIL_MOISTURE_DRY_DEFAULT;
+    err = nvs_get_i32(nvs_handle, NVS_KEY_DRY_VALUE, &dry_val);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "[NVS] Failed to read dry_value, using default");
+        dry_val = SOIL_MOISTURE_DRY_DEFAULT;
+    }
+
+    // Read wet value
+    int32_t wet_val = SOIL_MOISTURE_WET_DEFAULT;
+    err = nvs_get_i32(nvs_handle, NVS_KEY_WET_VALUE, &wet_val);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "[NVS] Failed to read wet_value, using default");
+        wet_val = SOIL_MOISTURE_WET_DEFAULT;
+    }
+
+    nvs_close(nvs_handle);
+
+    soil_moisture_dry_value = dry_val;
+    soil_moisture_wet_value = wet_val;
+
+    ESP_LOGI(TAG, "[NVS] Loaded calibration from storage (dry=%d, wet=%d)", 
+             soil_moisture_dry_value, soil_moisture_wet_value);
+    return true;
+}
+
+/**
+ * Save soil moisture calibration values to NVS
+ */
+static esp_err_t save_soil_calibration(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err;
+
+    // Open NVS in read-write mode
+    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to open NVS for writing: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Write dry value
+    err = nvs_set_i32(nvs_handle, NVS_KEY_DRY_VALUE, soil_moisture_dry_value);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to write dry_value: %s", esp_err_to_name(err));
+        nvs_close(nvs_handle);
+        return err;
+    }
+
+    // Write wet value
+    err = nvs_set_i32(nvs_handle, NVS_KEY_WET_VALUE, soil_moisture_wet_value);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to write wet_value: %s", esp_err_to_name(err));
+        nvs_close(nvs_handle);
+        return err;
+    }
+
+    // Commit changes
+    err = nvs_commit(nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[NVS] Failed to commit: %s", esp_err_to_name(err));
+        nvs_close(nvs_handle);
+        return err;
+    }
+
+    nvs_close(nvs_handle);
+
+    ESP_LOGI(TAG, "[NVS] Saved calibration to storage (dry=%d, wet=%d)", 
+             soil_moisture_dry_value, soil_moisture_wet_value);
+    return ESP_OK;
+}
+
+/**
+ * Initialize LM393 soil moisture sensor (Analog mode)
+ */
+void soil_moisture_init(void)
+{
+    // Shared by the climate monitor and irrigation; the ADC unit is claimed once
+    if (adc_handle != NULL) {
+        return;
+    }
+    
+    ESP_LOGI(TAG, "[LM393] Initializing soil moisture sensor in ANALOG mode");
+    ESP_LOGI(TAG, "[LM393] Connect sensor A0 pin to GPIO %d", SOIL_MOISTURE_GPIO_PIN);
+    
+    // Configure ADC
+    adc_oneshot_unit_init_cfg_t init_config = {
+        .unit_id = ADC_UNIT_1,
+    };
+    
+    esp_err_t err = adc_oneshot_new_unit(&init_config, &adc_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[LM393] Failed to initialize ADC unit: %s", esp_err_to_name(err));
+        return;
+    }
+    
+    // Configure ADC channel
+    adc_oneshot_chan_cfg_t config = {
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+        .atten = SOIL_MOISTURE_ADC_ATTEN,
+    };
+    
+    err = adc_oneshot_config_channel(adc_handle, SOIL_MOISTURE_ADC_CHANNEL, &config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[LM393] Failed to configure ADC channel: %s", esp_err_to_name(err));
+        return;
+    }
+    
+    // Set up ADC calibration for voltage reading (chip-specific)
+#if CONFIG_IDF_TARGET_ESP32C3
+    adc_cali_curve_fitting_config_t cali_config = {
+        .unit_id = ADC_UNIT_1,
+        .atten = SOIL_MOISTURE_ADC_ATTEN,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    
+    err = adc_cali_create_scheme_curve_fitting(&cali_config, &adc_cali_handle);
+#elif CONFIG_IDF_TARGET_ESP32S3
+    adc_cali_line_fitting_config_t cali_config = {
+        .unit_id = ADC_UNIT_1,
+        .atten = SOIL_MOISTURE_ADC_ATTEN,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    
+    err = adc_cali_create_scheme_line_fitting(&cali_config, &adc_cali_handle);
+#else
+    #error "Unsupported target for ADC calibration"
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "[LM393] ADC calibration failed, will use raw values: %s", esp_err_to_name(err));
+        adc_cali_handle = NULL;
+    }
+    
+    // Load calibration from NVS (or use defaults)
+    load_soil_calibration();
+    
+    ESP_LOGI(TAG, "[LM393] Soil moisture sensor initialized successfully");
+    ESP_LOGI(TAG, "[LM393] Calibration: Dry=%d, Wet=%d", 
+             soil_moisture_dry_value, soil_moisture_wet_value);
+}
+
+/**
+ * Map a raw ADC reading to moisture in 0.01 % (higher ADC = drier soil, so we invert)
+ */
+static int raw_to_centi_percent(int adc_raw)
+{
+    // Clamp values to calibration range
+    if (adc_raw >= soil_moisture_dry_value) {
+        return 0;  // Completely dry
+    }
+    if (adc_raw <= soil_moisture_wet_value) {
+        return 10000;  // Fully wet
+    }
+    
+    // Linear interpolation
+    return 10000 - ((adc_raw - soil_moisture_wet_value) * 10000 /
+                    (soil_moisture_dry_value - soil_moisture_wet_value));
+}
+
+int soil_moisture_read_centi_percent(int samples)
+{
+    if (adc_handle == NULL) {
+        ESP_LOGW(TAG, "[LM393] ADC not initialized");
+        return -1;
+    }
+    if (samples < 1) {
+        samples = 1;
+    }
+    
+    // Average several conversions; a read takes ~tens of µs
+    int sum = 0;
+    for (int i = 0; i < samples; i++) {
+        int adc_raw = 0;
+        esp_err_t err = adc_oneshot_read(adc_handle, SOIL_MOISTURE_ADC_CHANNEL, &adc_raw);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "[LM393] Failed to read ADC: %s", esp_err_to_name(err));
+            return -1;
+        }
+        sum += adc_raw;
+    }
+    int adc_raw = sum / samples;
+    
+    // Convert to voltage if calibration available
+    if (adc_cali_handle != NULL) {
+        int voltage = 0;
+        adc_cali_raw_to_voltage(adc_cali_handle, adc_raw, &voltage);
+        ESP_LOGD(TAG, "[LM393] ADC Raw: %d, Voltage: %d mV", adc_raw, voltage);
+    }
+    
+    return raw_to_centi_percent(adc_raw);
+}
+
+int soil_moisture_read_percent(void)
+{
+    int centi = soil_moisture_read_centi_percent(1);
+    return centi < 0 ? -1 : centi / 100;
+}
+
+bool soil_moisture_apply_config(const cJSON *json)
+{
+    bool updated = false;
+    
+    cJSON *dry_item = cJSON_GetObjectItem(json, "dry_value");
+    if (cJSON_IsNumber(dry_item) && dry_item->valueint != soil_moisture_dry_value) {
+        soil_moisture_dry_value = dry_item->valueint;
+        ESP_LOGI(TAG, "[MQTT] Updated dry_value=%d", soil_moisture_dry_value);
+        updated = true;
+    }
+    
+    cJSON *wet_item = cJSON_GetObjectItem(json, "wet_value");
+    if (cJSON_IsNumber(wet_item) && wet_item->valueint != soil_moisture_wet_value) {
+        soil_moisture_wet_value = wet_item->valueint;
+        ESP_LOGI(TAG, "[MQTT] Updated wet_value=%d", soil_moisture_wet_value);
+        updated = true;
+    }
+    
+    // Save to NVS if values were updated
+    if (updated) {
+        esp_err_t err = save_soil_calibration();
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "[MQTT] Calibration saved to NVS");
+        } else {
+            ESP_LOGE(TAG, "[MQTT] Failed to save calibration to NVS");
+        }
+    }
+    
+    return updated;
+}
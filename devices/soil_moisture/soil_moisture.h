@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct cJSON;
+
+/**
+ * @brief Initialize the LM393 soil moisture sensor (analog mode)
+ *
+ * Configures the ADC channel and loads the dry/wet calibration from NVS.
+ */
+void soil_moisture_init(void);
+
+/**
+ * @brief Read soil moisture as percentage
+ *
+ * @return Moisture percentage (0-100): 0=dry, 100=wet, or -1 on error
+ */
+int soil_moisture_read_percent(void);
+
+/**
+ * @brief Read soil moisture averaged over several conversions
+ *
+ * @param samples Number of ADC conversions to average
+ * @return Moisture in 0.01 % (0-10000), or -1 on error
+ */
+int soil_moisture_read_centi_percent(int samples);
+
+/**
+ * @brief Apply "dry_value" / "wet_value" from a config message
+ *
+ * Updated calibration is persisted to NVS.
+ *
+ * @param json Parsed config document
+ * @return true if the calibration changed
+ */
+bool soil_moisture_apply_config(const struct cJSON *json);
+
+#ifdef __cplusplus
+}
+#endif
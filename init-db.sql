@@ -6,3 +6,22 @@ CREATE SCHEMA IF NOT EXISTS greenhouse;
 
 -- Grant permissions to the user
 GRANT ALL PRIVILEGES ON SCHEMA greenhouse TO CURRENT_USER;
+
+-- 1-minute aggregates recovered from on-device history after an outage
+-- (scripts/backfill_history.py); one row per device and bucket
+CREATE TABLE IF NOT EXISTS greenhouse.climate_history (
+    time            TIMESTAMPTZ NOT NULL,
+    device_id       TEXT NOT NULL,
+    step_s          INTEGER NOT NULL,
+    temperature     DOUBLE PRECISION,
+    temperature_min DOUBLE PRECISION,
+    temperature_max DOUBLE PRECISION,
+    humidity        DOUBLE PRECISION,
+    pressure        DOUBLE PRECISION,
+    vpd             DOUBLE PRECISION,
+    iaq             DOUBLE PRECISION,
+    soil_moisture   DOUBLE PRECISION,
+    samples         INTEGER,
+    PRIMARY KEY (device_id, time)
+);
+SELECT create_hypertable('greenhouse.climate_history', 'time', if_not_exists => TRUE);
@@ -0,0 +1,355 @@
+/*
+ * Greenhouse Devices - MQTT Broker Failover
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ */
+
+#include "broker_failover.h"
+#include "mqtt_client_manager.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "broker_failover";
+
+#define PROBE_TIMEOUT_MS    2000
+#define LATENCY_UNKNOWN     (-1)
+
+typedef struct {
+    char uri[128];
+    char host[64];
+    uint16_t port;
+    int32_t connect_ms;             // Last MQTT connect (TCP, TLS and CONNACK)
+    int32_t probe_ms;               // Last TCP connect probe
+    uint32_t connects;
+    uint32_t failures;
+    int64_t reachable_since_ms;     // Probes succeeding since, 0 after a failure
+} broker_t;
+
+// URIs, hosts and ports are fixed after init; the rest is under broker_mutex
+static broker_t brokers[BROKER_FAILOVER_MAX];
+static int broker_count = 0;
+static int active = 0;
+static int consecutive_failures = 0;
+static int64_t connecting_at_ms = 0;
+static bool switching = false;      // Failback stopping the old session; its disconnect is not a failure
+static uint32_t failovers = 0;
+static uint32_t failbacks = 0;
+static broker_switch_cb_t switch_cb = NULL;
+static SemaphoreHandle_t broker_mutex = NULL;
+
+static mqtt_state_t broker_state = MQTT_STATE_INIT("broker");
+
+/*
+ * Host and port of scheme://[user[:password]@]host[:port][/path]
+ */
+static bool parse_uri(broker_t *b)
+{
+    const char *p = strstr(b->uri, "://");
+    if (p == NULL) {
+        return false;
+    }
+    size_t scheme_len = p - b->uri;
+    p += 3;
+
+    const char *at = strchr(p, '@');
+    const char *slash = strchr(p, '/');
+    if (at != NULL && (slash == NULL || at < slash)) {
+        p = at + 1;
+    }
+
+    size_t host_len = strcspn(p, ":/");
+    if (host_len == 0 || host_len >= sizeof(b->host)) {
+        return false;
+    }
+    memcpy(b->host, p, host_len);
+    b->host[host_len] = '\0';
+
+    if (p[host_len] == ':') {
+        b->port = (uint16_t)atoi(p + host_len + 1);
+    } else if (scheme_len == 5 && strncmp(b->uri, "mqtts", 5) == 0) {
+        b->port = 8883;
+    } else if (scheme_len == 3 && strncmp(b->uri, "wss", 3) == 0) {
+        b->port = 443;
+    } else if (scheme_len == 2 && strncmp(b->uri, "ws", 2) == 0) {
+        b->port = 80;
+    } else {
+        b->port = 1883;
+    }
+    return b->port != 0;
+}
+
+esp_err_t broker_failover_init(const char *uri_list)
+{
+    if (broker_mutex == NULL) {
+        broker_mutex = xSemaphoreCreateMutex();
+        if (broker_mutex == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    broker_count = 0;
+    active = 0;
+
+    const char *p = uri_list;
+    while (*p != '\0' && broker_count < BROKER_FAILOVER_MAX) {
+        size_t segment = strcspn(p, ",");
+        const char *start = p;
+        size_t len = segment;
+        while (len > 0 && *start == ' ') {
+            start++;
+            len--;
+        }
+        while (len > 0 && start[len - 1] == ' ') {
+            len--;
+        }
+
+        broker_t *b = &brokers[broker_count];
+        memset(b, 0, sizeof(*b));
+        b->connect_ms = LATENCY_UNKNOWN;
+        b->probe_ms = LATENCY_UNKNOWN;
+        if (len > 0 && len < sizeof(b->uri)) {
+            memcpy(b->uri, start, len);
+            b->uri[len] = '\0';
+            if (parse_uri(b)) {
+                ESP_LOGI(TAG, "[BROKER] %d: %s:%u%s", broker_count, b->host, b->port,
+                         broker_count == 0 ? " (primary)" : "");
+                broker_count++;
+            } else {
+                ESP_LOGW(TAG, "[BROKER] Ignoring unparsable URI at position %d", broker_count);
+            }
+        }
+
+        p += segment;
+        if (*p == ',') {
+            p++;
+        }
+    }
+
+    return broker_count > 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+int broker_failover_count(void)
+{
+    return broker_count;
+}
+
+const char *broker_failover_active_uri(void)
+{
+    return brokers[active].uri;
+}
+
+void broker_failover_on_connecting(void)
+{
+    xSemaphoreTake(broker_mutex, portMAX_DELAY);
+    connecting_at_ms = esp_timer_get_time() / 1000;
+    // The old session is gone once the new attempt starts; any disconnect
+    // from here on is a real failure of the broker failed back to
+    switching = false;
+    xSemaphoreGive(broker_mutex);
+}
+
+void broker_failover_on_connected(void)
+{
+    int32_t latency_ms = (int32_t)(esp_timer_get_time() / 1000 - connecting_at_ms);
+
+    xSemaphoreTake(broker_mutex, portMAX_DELAY);
+    broker_t *b = &brokers[active];
+    b->connect_ms = latency_ms;
+    b->connects++;
+    consecutive_failures = 0;
+    switching = false;
+    xSemaphoreGive(broker_mutex);
+
+    ESP_LOGI(TAG, "[BROKER] Connected to %s:%u in %ld ms", b->host, b->port, (long)latency_ms);
+}
+
+/*
+ * Reachable broker with the lowest probe latency, else the next in order
+ */
+static int pick_standby(int exclude)
+{
+    int best = -1;
+    for (int i = 0; i < broker_count; i++) {
+        if (i == exclude || brokers[i].reachable_since_ms == 0) {
+            continue;
+        }
+        if (best < 0 || brokers[i].probe_ms < brokers[best].probe_ms) {
+            best = i;
+        }
+    }
+    return best >= 0 ? best : (exclude + 1) % broker_count;
+}
+
+const char *broker_failover_on_disconnected(bool *reconnect_now)
+{
+    const char *uri = NULL;
+    int from = 0;
+    *reconnect_now = false;
+
+    xSemaphoreTake(broker_mutex, portMAX_DELAY);
+    if (switching) {
+        switching = false;
+    } else {
+        broker_t *b = &brokers[active];
+        b->failures++;
+        // Restart the hold-down clock of a broker that just failed us
+        b->reachable_since_ms = 0;
+
+        if (broker_count > 1 && ++consecutive_failures >= CONFIG_MQTT_FAILOVER_ATTEMPTS) {
+            from = active;
+            active = pick_standby(active);
+            consecutive_failures = 0;
+            failovers++;
+            uri = brokers[active].uri;
+            *reconnect_now = brokers[active].reachable_since_ms != 0;
+        }
+    }
+    xSemaphoreGive(broker_mutex);
+
+    if (uri != NULL) {
+        ESP_LOGW(TAG, "[BROKER] Failing over from %s:%u to %s:%u%s", brokers[from].host, brokers[from].port,
+                 brokers[active].host, brokers[active].port, *reconnect_now ? "" : " (not known reachable)");
+    }
+    return uri;
+}
+
+/*
+ * Time a TCP connect to the broker; LATENCY_UNKNOWN if it fails
+ */
+static int32_t probe(const broker_t *b)
+{
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res = NULL;
+    char port[8];
+    snprintf(port, sizeof(port), "%u", b->port);
+
+    if (getaddrinfo(b->host, port, &hints, &res) != 0 || res == NULL) {
+        return LATENCY_UNKNOWN;
+    }
+
+    // Timed from after resolution so DNS does not skew the ranking
+    int64_t start_us = esp_timer_get_time();
+
+    int32_t latency_ms = LATENCY_UNKNOWN;
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        if (connect(fd, res->ai_addr, res->ai_addrlen) == 0 || errno == EINPROGRESS) {
+            fd_set writable;
+            FD_ZERO(&writable);
+            FD_SET(fd, &writable);
+            struct timeval timeout = { .tv_sec = PROBE_TIMEOUT_MS / 1000, .tv_usec = (PROBE_TIMEOUT_MS % 1000) * 1000 };
+            int err = 0;
+            socklen_t err_len = sizeof(err);
+            if (select(fd + 1, NULL, &writable, NULL, &timeout) == 1 &&
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) == 0 && err == 0) {
+                latency_ms = (int32_t)((esp_timer_get_time() - start_us) / 1000);
+            }
+        }
+        close(fd);
+    }
+    freeaddrinfo(res);
+    return latency_ms;
+}
+
+/*
+ * Probe every broker, fail back to the primary once it has been reachable
+ * for the hold-down period, and publish the status as retained state
+ */
+static void probe_task(void *pvParameters)
+{
+    static char status[BROKER_FAILOVER_STATUS_MAX];
+
+    while (1) {
+        int64_t now_ms = 0;
+        for (int i = 0; i < broker_count; i++) {
+            int32_t latency_ms = probe(&brokers[i]);
+            now_ms = esp_timer_get_time() / 1000;
+
+            xSemaphoreTake(broker_mutex, portMAX_DELAY);
+            brokers[i].probe_ms = latency_ms;
+            if (latency_ms == LATENCY_UNKNOWN) {
+                brokers[i].reachable_since_ms = 0;
+            } else if (brokers[i].reachable_since_ms == 0) {
+                brokers[i].reachable_since_ms = now_ms;
+            }
+            xSemaphoreGive(broker_mutex);
+        }
+
+        bool failback = false;
+        xSemaphoreTake(broker_mutex, portMAX_DELAY);
+        if (active != 0 && brokers[0].reachable_since_ms != 0 &&
+            now_ms - brokers[0].reachable_since_ms >= CONFIG_MQTT_FAILBACK_HOLD_S * 1000LL) {
+            active = 0;
+            consecutive_failures = 0;
+            switching = true;
+            failbacks++;
+            failback = true;
+        }
+        xSemaphoreGive(broker_mutex);
+
+        if (failback) {
+            ESP_LOGI(TAG, "[BROKER] Primary %s:%u reachable for %d s, failing back",
+                     brokers[0].host, brokers[0].port, CONFIG_MQTT_FAILBACK_HOLD_S);
+            switch_cb(brokers[0].uri);
+        }
+
+        if (broker_failover_format_status(status, sizeof(status)) < (int)sizeof(status)) {
+            mqtt_client_manager_publish_state(&broker_state, status);
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_MQTT_PROBE_INTERVAL_S * 1000));
+    }
+}
+
+void broker_failover_start(broker_switch_cb_t on_switch)
+{
+    if (broker_count < 2) {
+        return;
+    }
+    switch_cb = on_switch;
+    xTaskCreate(probe_task, "broker_probe", 4096, NULL, 3, NULL);
+}
+
+int broker_failover_format_status(char *buf, size_t size)
+{
+    broker_t snapshot[BROKER_FAILOVER_MAX];
+    int current;
+    uint32_t failover_count;
+    uint32_t failback_count;
+
+    if (broker_count == 0) {
+        return snprintf(buf, size, "{\"brokers\":[]}");
+    }
+
+    xSemaphoreTake(broker_mutex, portMAX_DELAY);
+    memcpy(snapshot, brokers, sizeof(snapshot));
+    current = active;
+    failover_count = failovers;
+    failback_count = failbacks;
+    xSemaphoreGive(broker_mutex);
+
+    int len = snprintf(buf, size, "{\"active\":\"%s:%u\",\"failovers\":%lu,\"failbacks\":%lu,\"brokers\":[",
+                       snapshot[current].host, snapshot[current].port,
+                       (unsigned long)failover_count, (unsigned long)failback_count);
+    for (int i = 0; i < broker_count && len < (int)size; i++) {
+        const broker_t *b = &snapshot[i];
+        len += snprintf(buf + len, size - len,
+                        "%s{\"host\":\"%s:%u\",\"connect_ms\":%ld,\"probe_ms\":%ld,\"connects\":%lu,\"failures\":%lu}",
+                        i > 0 ? "," : "", b->host, b->port, (long)b->connect_ms, (long)b->probe_ms,
+                        (unsigned long)b->connects, (unsigned long)b->failures);
+    }
+    if (len < (int)size) {
+        len += snprintf(buf + len, size - len, "]}");
+    }
+    return len;
+}
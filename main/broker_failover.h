@@ -0,0 +1,80 @@
+/*
+ * Greenhouse Devices - MQTT Broker Failover
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Ordered list of broker URIs for the MQTT client manager. The first one is
+ * the primary. After failed connects the client moves to the standby with
+ * the lowest measured latency, and returns to the primary once it has been
+ * reachable for a hold-down period.
+ */
+
+#ifndef BROKER_FAILOVER_H
+#define BROKER_FAILOVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define BROKER_FAILOVER_MAX 4
+
+// Status JSON with BROKER_FAILOVER_MAX brokers, full-length hosts and
+// 32-bit counters (about 850 bytes)
+#define BROKER_FAILOVER_STATUS_MAX 1024
+
+/**
+ * Called (from the probe task) to move the session to another broker
+ */
+typedef void (*broker_switch_cb_t)(const char *uri);
+
+/**
+ * Parse the broker list
+ *
+ * @param uri_list Comma-separated URIs in priority order; a single URI
+ *                 disables failover
+ * @return ESP_ERR_INVALID_ARG if no URI could be parsed
+ */
+esp_err_t broker_failover_init(const char *uri_list);
+
+/**
+ * Start probing connect latency to every broker (no-op with one broker)
+ *
+ * @param on_switch Moves the client to a broker when failing back
+ */
+void broker_failover_start(broker_switch_cb_t on_switch);
+
+/**
+ * Number of configured brokers
+ */
+int broker_failover_count(void);
+
+/**
+ * URI of the broker the client should use now
+ */
+const char *broker_failover_active_uri(void);
+
+/**
+ * MQTT task hooks: a connect attempt starts / succeeds
+ */
+void broker_failover_on_connecting(void);
+void broker_failover_on_connected(void);
+
+/**
+ * MQTT task hook: the connection failed or dropped
+ *
+ * @param reconnect_now Set true if the returned broker is known reachable,
+ *                      so the client should not wait its reconnect timeout
+ * @return URI to use for the next attempt, or NULL to stay on this broker
+ */
+const char *broker_failover_on_disconnected(bool *reconnect_now);
+
+/**
+ * Status as a JSON object: active broker, failover/failback counts, and per
+ * broker host, last connect and probe latency (ms, -1 if unknown/failed),
+ * connects and failures. Fits in BROKER_FAILOVER_STATUS_MAX.
+ *
+ * @return Length written (snprintf semantics)
+ */
+int broker_failover_format_status(char *buf, size_t size);
+
+#endif // BROKER_FAILOVER_H
@@ -0,0 +1,273 @@
+/*
+ * Greenhouse Devices - MQTT Link Watchdog
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ */
+
+#include "link_watchdog.h"
+#include "mqtt_client_manager.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "link_watchdog";
+
+#define CHECK_PERIOD_MS     1000
+#define EARLY_ACKS          4
+#define STATUS_MAX          384
+
+typedef enum {
+    CAUSE_ACK_COUNT,
+    CAUSE_ACK_TIMEOUT,
+    CAUSE_TRANSPORT,
+    CAUSE_COUNT
+} cause_t;
+
+static const char *CAUSE_NAMES[CAUSE_COUNT] = { "ack_count", "ack_timeout", "transport" };
+
+typedef struct {
+    int msg_id;
+    int64_t sent_ms;
+} pending_t;
+
+typedef struct {
+    uint32_t count;
+    int32_t last_ms;
+    int32_t max_ms;
+} detection_t;
+
+// All under link_lock
+static pending_t pending[LINK_WATCHDOG_MAX_PENDING];
+static int pending_count = 0;
+static int early_acks[EARLY_ACKS];     // Acks that beat the publisher to on_publish()
+static int early_next = 0;
+static int64_t alive_ms = 0;           // Last packet from the broker
+static bool connected = false;
+static bool declared = false;          // Watchdog already dropped this session
+static bool report = true;             // Status changed since last retained publish
+static detection_t detections[CAUSE_COUNT];
+static portMUX_TYPE link_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static link_dead_cb_t dead_cb = NULL;
+static mqtt_state_t link_state = MQTT_STATE_INIT("link");
+
+static int64_t now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+/*
+ * Publishes sent since the broker was last heard from; older ones are
+ * covered by that sign of life (caller holds link_lock)
+ */
+static int unanswered(int64_t *oldest_ms)
+{
+    int n = 0;
+    *oldest_ms = 0;
+    for (int i = 0; i < pending_count; i++) {
+        if (pending[i].sent_ms >= alive_ms) {
+            if (n == 0) {
+                *oldest_ms = pending[i].sent_ms;
+            }
+            n++;
+        }
+    }
+    return n;
+}
+
+/*
+ * Detection latency runs from the first publish left unanswered, or from
+ * the last packet if nothing was waiting (caller holds link_lock)
+ */
+static int32_t record(cause_t cause, int64_t at_ms, int64_t since_ms)
+{
+    int32_t latency_ms = (int32_t)(at_ms - since_ms);
+    detection_t *d = &detections[cause];
+    d->count++;
+    d->last_ms = latency_ms;
+    if (latency_ms > d->max_ms) {
+        d->max_ms = latency_ms;
+    }
+    report = true;
+    return latency_ms;
+}
+
+void link_watchdog_on_publish(int msg_id)
+{
+    // QoS 0 publishes return 0 and are never acked
+    if (msg_id <= 0) {
+        return;
+    }
+
+    portENTER_CRITICAL(&link_lock);
+    bool acked = false;
+    for (int i = 0; i < EARLY_ACKS; i++) {
+        if (early_acks[i] == msg_id) {
+            early_acks[i] = 0;
+            acked = true;
+            break;
+        }
+    }
+    if (connected && !acked && pending_count < LINK_WATCHDOG_MAX_PENDING) {
+        pending[pending_count].msg_id = msg_id;
+        pending[pending_count].sent_ms = now_ms();
+        pending_count++;
+    }
+    portEXIT_CRITICAL(&link_lock);
+}
+
+void link_watchdog_on_ack(int msg_id)
+{
+    portENTER_CRITICAL(&link_lock);
+    alive_ms = now_ms();
+    int i = 0;
+    while (i < pending_count && pending[i].msg_id != msg_id) {
+        i++;
+    }
+    if (i < pending_count) {
+        memmove(&pending[i], &pending[i + 1], (pending_count - i - 1) * sizeof(pending[0]));
+        pending_count--;
+    } else {
+        early_acks[early_next] = msg_id;
+        early_next = (early_next + 1) % EARLY_ACKS;
+    }
+    portEXIT_CRITICAL(&link_lock);
+}
+
+void link_watchdog_on_inbound(void)
+{
+    portENTER_CRITICAL(&link_lock);
+    alive_ms = now_ms();
+    portEXIT_CRITICAL(&link_lock);
+}
+
+void link_watchdog_on_connected(void)
+{
+    portENTER_CRITICAL(&link_lock);
+    connected = true;
+    declared = false;
+    pending_count = 0;
+    memset(early_acks, 0, sizeof(early_acks));
+    alive_ms = now_ms();
+    portEXIT_CRITICAL(&link_lock);
+}
+
+void link_watchdog_on_disconnected(void)
+{
+    int32_t latency_ms = -1;
+
+    portENTER_CRITICAL(&link_lock);
+    if (connected && !declared) {
+        int64_t oldest_ms;
+        int64_t now = now_ms();
+        latency_ms = record(CAUSE_TRANSPORT, now, unanswered(&oldest_ms) > 0 ? oldest_ms : alive_ms);
+    }
+    connected = false;
+    pending_count = 0;
+    portEXIT_CRITICAL(&link_lock);
+
+    if (latency_ms >= 0) {
+        ESP_LOGW(TAG, "[LINK] Connection lost, detected %ld ms after the last sign of life", (long)latency_ms);
+    }
+}
+
+/*
+ * Check the pending acks once a second; after a detection, publish the
+ * counters as retained state once the link is back
+ */
+static void watchdog_task(void *pvParameters)
+{
+    char status[STATUS_MAX];
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(CHECK_PERIOD_MS));
+
+        cause_t cause = CAUSE_COUNT;
+        int n = 0;
+        int32_t latency_ms = 0;
+        bool publish = false;
+
+        portENTER_CRITICAL(&link_lock);
+        int64_t now = now_ms();
+
+        // Drop entries whose ack went missing while others came back
+        int kept = 0;
+        for (int i = 0; i < pending_count; i++) {
+            if (alive_ms - pending[i].sent_ms < CONFIG_MQTT_ACK_WATCHDOG_S * 1000LL) {
+                pending[kept++] = pending[i];
+            }
+        }
+        pending_count = kept;
+
+        if (connected && !declared) {
+            int64_t oldest_ms;
+            n = unanswered(&oldest_ms);
+            if (n >= CONFIG_MQTT_ACK_WATCHDOG_COUNT) {
+                cause = CAUSE_ACK_COUNT;
+            } else if (n > 0 && now - oldest_ms >= CONFIG_MQTT_ACK_WATCHDOG_S * 1000LL) {
+                cause = CAUSE_ACK_TIMEOUT;
+            }
+            if (cause != CAUSE_COUNT) {
+                latency_ms = record(cause, now, oldest_ms);
+                declared = true;
+                connected = false;
+            }
+        }
+        publish = report && connected;
+        portEXIT_CRITICAL(&link_lock);
+
+        if (cause != CAUSE_COUNT) {
+            ESP_LOGW(TAG, "[LINK] %d publishes unacked for %ld ms, dropping the connection",
+                     n, (long)latency_ms);
+            dead_cb();
+        }
+
+        if (publish && link_watchdog_format_status(status, sizeof(status)) < (int)sizeof(status) &&
+            mqtt_client_manager_publish_state(&link_state, status)) {
+            portENTER_CRITICAL(&link_lock);
+            report = false;
+            portEXIT_CRITICAL(&link_lock);
+        }
+    }
+}
+
+void link_watchdog_start(link_dead_cb_t on_dead)
+{
+    dead_cb = on_dead;
+    for (int i = 0; i < CAUSE_COUNT; i++) {
+        detections[i].last_ms = -1;
+        detections[i].max_ms = -1;
+    }
+    xTaskCreate(watchdog_task, "link_watchdog", 3072, NULL, 4, NULL);
+}
+
+int link_watchdog_format_status(char *buf, size_t size)
+{
+    detection_t snapshot[CAUSE_COUNT];
+    int pending_now;
+    int64_t silent_ms;
+
+    portENTER_CRITICAL(&link_lock);
+    memcpy(snapshot, detections, sizeof(snapshot));
+    pending_now = pending_count;
+    silent_ms = now_ms() - alive_ms;
+    portEXIT_CRITICAL(&link_lock);
+
+    int len = snprintf(buf, size, "{\"keepalive_s\":%d,\"ack_limit\":%d,\"ack_timeout_s\":%d,"
+                       "\"pending\":%d,\"silent_ms\":%lld,\"detections\":{",
+                       CONFIG_MQTT_KEEPALIVE_S, CONFIG_MQTT_ACK_WATCHDOG_COUNT, CONFIG_MQTT_ACK_WATCHDOG_S,
+                       pending_now, (long long)silent_ms);
+    for (int i = 0; i < CAUSE_COUNT && len < (int)size; i++) {
+        len += snprintf(buf + len, size - len, "%s\"%s\":{\"count\":%lu,\"last_ms\":%ld,\"max_ms\":%ld}",
+                        i > 0 ? "," : "", CAUSE_NAMES[i], (unsigned long)snapshot[i].count,
+                        (long)snapshot[i].last_ms, (long)snapshot[i].max_ms);
+    }
+    if (len < (int)size) {
+        len += snprintf(buf + len, size - len, "}}");
+    }
+    return len;
+}
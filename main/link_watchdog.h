@@ -0,0 +1,60 @@
+/*
+ * Greenhouse Devices - MQTT Link Watchdog
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * A half-open TCP connection (AP reboot, NAT timeout) looks connected until
+ * the MQTT keepalive or TCP keepalive gives up. The watchdog tracks QoS 1/2
+ * publishes until their ack and declares the link dead after too many
+ * unacked publishes or an ack overdue for too long. Every detection, by the
+ * watchdog or by the transport, is timed from the last sign of life.
+ */
+
+#ifndef LINK_WATCHDOG_H
+#define LINK_WATCHDOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define LINK_WATCHDOG_MAX_PENDING 16
+
+/**
+ * Called (from the watchdog task) once the link is declared dead; must
+ * drop the connection and start a new one
+ */
+typedef void (*link_dead_cb_t)(void);
+
+/**
+ * Start checking pending acks once a second
+ *
+ * @param on_dead Tears the connection down
+ */
+void link_watchdog_start(link_dead_cb_t on_dead);
+
+/**
+ * Publisher hook: a QoS 1/2 message was queued with this msg_id
+ */
+void link_watchdog_on_publish(int msg_id);
+
+/**
+ * MQTT task hooks: PUBACK/PUBCOMP, and any other packet from the broker
+ */
+void link_watchdog_on_ack(int msg_id);
+void link_watchdog_on_inbound(void);
+
+/**
+ * MQTT task hooks: session up / dropped by the transport or keepalive
+ */
+void link_watchdog_on_connected(void);
+void link_watchdog_on_disconnected(void);
+
+/**
+ * Status as a JSON object: keepalive settings, pending publishes and, per
+ * detection cause ("ack_count", "ack_timeout", "transport"), the count and
+ * the last and worst detection latency in ms
+ *
+ * @return Length written (snprintf semantics)
+ */
+int link_watchdog_format_status(char *buf, size_t size);
+
+#endif // LINK_WATCHDOG_H
@@ -5,20 +5,64 @@
  */
 
 #include "mqtt_client_manager.h"
+#include "broker_failover.h"
+#include "link_watchdog.h"
+#include "tls_transport.h"
+#include "mqttsn_client.h"
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_netif.h"
+#include "esp_wifi.h"
+#include "esp_random.h"
 #include "nvs_flash.h"
 #include "protocol_examples_common.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "env_config.h"
+#include "time_sync.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 static const char *TAG = "mqtt_manager";
 
+// Largest state is the broker status with every broker, plus "ts"
+#define STATE_MAX_PAYLOAD (BROKER_FAILOVER_STATUS_MAX + 32)
+#define RECONNECT_TIMEOUT_MS 60000
+// A whole config document (FLEET_CONFIG_MAX_DOC, 2 KB) plus topic and properties
+#define MQTT_BUFFER_SIZE 2560
+// Wi-Fi reconnect backoff, doubled after each failed attempt
+#define WIFI_RETRY_MIN_MS 1000
+#define WIFI_RETRY_MAX_MS 60000
+// QoS 1 messages wait in the outbox through an outage for up to a day
+// (CONFIG_MQTT_OUTBOX_EXPIRED_TIMEOUT_MS); this caps the heap they take
+#define MQTT_OUTBOX_LIMIT (32 * 1024)
+
 // Global state
 static esp_mqtt_client_handle_t mqtt_client = NULL;
 static volatile bool mqtt_connected = false;
+static volatile uint32_t connect_count = 0;
 static mqtt_device_callbacks_t device_callbacks = {0};
+static char command_topic[64];
+static char request_topic[64];
+static TaskHandle_t mqtt_task = NULL;      // Runs the event handler
+static esp_timer_handle_t restart_timer = NULL;     // Delayed start after drop_link()
+static TaskHandle_t link_task_handle = NULL;        // Waits for the first address
+#if CONFIG_EXAMPLE_CONNECT_WIFI
+static esp_timer_handle_t wifi_retry_timer = NULL;
+static uint32_t wifi_retry_ms = WIFI_RETRY_MIN_MS;
+#endif
+
+// A reply handed to the MQTT task, copied into one allocation it frees
+typedef struct {
+    int len;
+    int correlation_len;
+    char *topic;
+    char *data;
+    char *correlation;
+} reply_msg_t;
 
 // MQTT5 user properties
 static esp_mqtt5_user_property_item_t user_property_arr[] = {
@@ -55,6 +99,32 @@ static void log_error_if_nonzero(const char *message, int error_code)
     }
 }
 
+/*
+ * Queue a reply with its correlation data (MQTT task only)
+ *
+ * esp-mqtt's publish properties are per client. The MQTT task holds the
+ * client lock while it handles an event, so setting them, queuing the
+ * reply and clearing them here cannot interleave with another publish.
+ */
+static int publish_reply_now(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                             const char *correlation, int correlation_len)
+{
+    esp_mqtt5_publish_property_config_t property = {
+        .correlation_data = correlation_len > 0 ? correlation : NULL,
+        .correlation_data_len = correlation_len,
+    };
+    esp_mqtt5_client_set_publish_property(client, &property);
+    int msg_id = esp_mqtt_client_enqueue(client, topic, data, len, 0, 0, true);
+    
+    esp_mqtt5_publish_property_config_t none = {0};
+    esp_mqtt5_client_set_publish_property(client, &none);
+    
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "Failed to queue reply to %s", topic);
+    }
+    return msg_id;
+}
+
 /*
  * MQTT event handler - routes events to device-specific callbacks
  */
@@ -63,12 +133,32 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     ESP_LOGD(TAG, "Event dispatched from event loop base=%s, event_id=%" PRIi32, base, event_id);
     esp_mqtt_event_handle_t event = event_data;
     esp_mqtt_client_handle_t client = event->client;
+    mqtt_task = xTaskGetCurrentTaskHandle();
 
     switch ((esp_mqtt_event_id_t)event_id) {
+    case MQTT_EVENT_BEFORE_CONNECT:
+        broker_failover_on_connecting();
+        break;
+        
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
         print_user_property(event->property->user_property);
         mqtt_connected = true;
+        connect_count++;
+        broker_failover_on_connected();
+        link_watchdog_on_connected();
+        
+        // Command topic is subscribed by the manager so every device gets the same path
+        if (device_callbacks.on_command) {
+            esp_mqtt_client_subscribe(client, command_topic, 1);
+            ESP_LOGI(TAG, "Subscribed to command topic: %s", command_topic);
+        }
+        
+        // Requests are QoS 0: the caller retries on timeout, a stale retransmit is useless
+        if (device_callbacks.on_request) {
+            esp_mqtt_client_subscribe(client, request_topic, 0);
+            ESP_LOGI(TAG, "Subscribed to request topic: %s", request_topic);
+        }
         
         // Call device-specific connected callback
         if (device_callbacks.on_connected) {
@@ -80,6 +170,17 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
         print_user_property(event->property->user_property);
         mqtt_connected = false;
+        link_watchdog_on_disconnected();
+        
+        // Next attempt may go to a standby broker
+        bool reconnect_now;
+        const char *next_uri = broker_failover_on_disconnected(&reconnect_now);
+        if (next_uri != NULL) {
+            esp_mqtt_client_set_uri(client, next_uri);
+            if (reconnect_now) {
+                esp_mqtt_client_reconnect(client);
+            }
+        }
         
         // Call device-specific disconnected callback
         if (device_callbacks.on_disconnected) {
@@ -89,6 +190,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         
     case MQTT_EVENT_SUBSCRIBED:
         ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
+        link_watchdog_on_inbound();
         print_user_property(event->property->user_property);
         break;
         
@@ -99,10 +201,35 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         
     case MQTT_EVENT_PUBLISHED:
         ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        link_watchdog_on_ack(event->msg_id);
         print_user_property(event->property->user_property);
         break;
         
+    case MQTT_EVENT_DELETED:
+        // Expired from the outbox unsent; no ack will come
+        ESP_LOGW(TAG, "MQTT_EVENT_DELETED, msg_id=%d", event->msg_id);
+        link_watchdog_on_ack(event->msg_id);
+        break;
+        
     case MQTT_EVENT_DATA:
+        link_watchdog_on_inbound();
+        
+        // Commands are dispatched before any logging to keep actuation latency low
+        if (device_callbacks.on_command &&
+            event->topic_len == (int)strlen(command_topic) &&
+            strncmp(event->topic, command_topic, event->topic_len) == 0) {
+            device_callbacks.on_command(event->data, event->data_len);
+            ESP_LOGI(TAG, "Command: %.*s", event->data_len, event->data);
+            break;
+        }
+        
+        if (device_callbacks.on_request &&
+            event->topic_len == (int)strlen(request_topic) &&
+            strncmp(event->topic, request_topic, event->topic_len) == 0) {
+            device_callbacks.on_request(event);
+            break;
+        }
+        
         ESP_LOGI(TAG, "MQTT_EVENT_DATA");
         print_user_property(event->property->user_property);
         ESP_LOGI(TAG, "TOPIC=%.*s", event->topic_len, event->topic);
@@ -126,24 +253,108 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         }
         break;
         
+    case MQTT_USER_EVENT: {
+        reply_msg_t *reply = (reply_msg_t *)event->data;
+        publish_reply_now(client, reply->topic, reply->data, reply->len, reply->correlation, reply->correlation_len);
+        free(reply);
+        break;
+    }
+        
     default:
         ESP_LOGI(TAG, "Other event id:%d", event->event_id);
         break;
     }
 }
 
+/*
+ * Move the session to another broker (failback, from the probe task).
+ * A stopped client does not report the disconnect, so do its bookkeeping;
+ * it is not a broker failure, so failover is not told.
+ */
+static void switch_broker(const char *uri)
+{
+    mqtt_connected = false;
+    esp_timer_stop(restart_timer);
+    esp_mqtt_client_stop(mqtt_client);
+    link_watchdog_on_disconnected();
+    esp_mqtt_client_set_uri(mqtt_client, uri);
+    
+    if (device_callbacks.on_disconnected) {
+        device_callbacks.on_disconnected();
+    }
+    
+    esp_mqtt_client_start(mqtt_client);
+}
+
+static void restart_client(void *arg)
+{
+    esp_mqtt_client_start(mqtt_client);
+}
+
+/*
+ * Tear down a connection the link watchdog declared dead (from its task).
+ * A stopped client does not report the disconnect, so do its bookkeeping,
+ * and reconnect when auto-reconnect would: at once only toward a standby
+ * known to be up, otherwise after the reconnect timeout.
+ */
+static void drop_link(void)
+{
+    mqtt_connected = false;
+    esp_mqtt_client_stop(mqtt_client);
+    
+    bool reconnect_now;
+    const char *next_uri = broker_failover_on_disconnected(&reconnect_now);
+    if (next_uri != NULL) {
+        esp_mqtt_client_set_uri(mqtt_client, next_uri);
+    }
+    
+    if (device_callbacks.on_disconnected) {
+        device_callbacks.on_disconnected();
+    }
+    
+    if (reconnect_now || esp_timer_start_once(restart_timer, RECONNECT_TIMEOUT_MS * 1000ULL) != ESP_OK) {
+        esp_mqtt_client_start(mqtt_client);
+    }
+}
+
+#if CONFIG_MQTT_TRANSPORT_SN
+/*
+ * MQTT-SN session up/down (from its task); the MQTT client itself never
+ * connects, so device subscriptions fail and only publishing works
+ */
+static void sn_connected(void)
+{
+    mqtt_connected = true;
+    connect_count++;
+    if (device_callbacks.on_connected) {
+        device_callbacks.on_connected(mqtt_client);
+    }
+}
+
+static void sn_disconnected(void)
+{
+    mqtt_connected = false;
+    if (device_callbacks.on_disconnected) {
+        device_callbacks.on_disconnected();
+    }
+}
+#endif
+
 esp_err_t mqtt_client_manager_init_wifi(void)
 {
-    ESP_LOGI(TAG, "Initializing WiFi...");
+    ESP_LOGI(TAG, "Initializing NVS and network stack...");
     
-    ESP_ERROR_CHECK(nvs_flash_init());
+    // Device modules keep their config in NVS, so it comes up whatever the network does
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_LOGW(TAG, "NVS partition unusable (%s), erasing", esp_err_to_name(err));
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     
-    /* This helper function configures Wi-Fi or Ethernet, as selected in menuconfig. */
-    ESP_ERROR_CHECK(example_connect());
-    
-    ESP_LOGI(TAG, "WiFi connected successfully");
     return ESP_OK;
 }
 
@@ -156,14 +367,21 @@ esp_err_t mqtt_client_manager_init(const mqtt_device_callbacks_t *callbacks)
     
     // Store device callbacks
     device_callbacks = *callbacks;
+    snprintf(command_topic, sizeof(command_topic), MQTT_COMMAND_TOPIC_PREFIX "%s", CONFIG_DEVICE_ID);
+    snprintf(request_topic, sizeof(request_topic), MQTT_REQUEST_TOPIC_PREFIX "%s", CONFIG_DEVICE_ID);
     
     ESP_LOGI(TAG, "Initializing MQTT client...");
-    ESP_LOGI(TAG, "Broker URL: %s", ENV_DEVICE_MQTT_BROKER_URL);
+    
+    // Comma-separated, primary first
+    if (broker_failover_init(ENV_DEVICE_MQTT_BROKER_URL) != ESP_OK) {
+        ESP_LOGE(TAG, "No usable broker URL in DEVICE_MQTT_BROKER_URL");
+        return ESP_ERR_INVALID_ARG;
+    }
     
     // MQTT5 connection properties
     esp_mqtt5_connection_property_config_t connect_property = {
         .session_expiry_interval = 10,
-        .maximum_packet_size = 1024,
+        .maximum_packet_size = MQTT_BUFFER_SIZE,
         .receive_maximum = 65535,
         .topic_alias_maximum = 2,
         .request_resp_info = true,
@@ -171,17 +389,26 @@ esp_err_t mqtt_client_manager_init(const mqtt_device_callbacks_t *callbacks)
         .will_delay_interval = 10,
         .payload_format_indicator = true,
         .message_expiry_interval = 10,
-        .response_topic = "/test/response",
-        .correlation_data = "123456",
-        .correlation_data_len = 6,
     };
 
     // MQTT client configuration with auto-reconnect enabled
     esp_mqtt_client_config_t mqtt5_cfg = {
-        .broker.address.uri = ENV_DEVICE_MQTT_BROKER_URL,
+        .broker.address.uri = broker_failover_active_uri(),
         .session.protocol_ver = MQTT_PROTOCOL_V_5,
         .network.disable_auto_reconnect = false,
-        .network.reconnect_timeout_ms = 60000,  // Retry every 60 seconds
+        .network.reconnect_timeout_ms = RECONNECT_TIMEOUT_MS,
+        .session.keepalive = CONFIG_MQTT_KEEPALIVE_S,
+        .buffer.size = MQTT_BUFFER_SIZE,
+        .outbox.limit = MQTT_OUTBOX_LIMIT,
+#if CONFIG_MQTT_TCP_KEEPALIVE
+        // Lets the stack notice a dead peer even while the MQTT session is idle
+        .network.tcp_keep_alive_cfg = {
+            .keep_alive_enable = true,
+            .keep_alive_idle = CONFIG_MQTT_TCP_KEEPALIVE_IDLE_S,
+            .keep_alive_interval = CONFIG_MQTT_TCP_KEEPALIVE_INTERVAL_S,
+            .keep_alive_count = CONFIG_MQTT_TCP_KEEPALIVE_COUNT,
+        },
+#endif
         .session.last_will.topic = "/topic/will",
         .session.last_will.msg = "i will leave",
         .session.last_will.msg_len = 12,
@@ -189,6 +416,16 @@ esp_err_t mqtt_client_manager_init(const mqtt_device_callbacks_t *callbacks)
         .session.last_will.retain = true,
     };
 
+    // mqtts:// goes through our own TLS transport to resume sessions on reconnect;
+    // all brokers in the list are expected to use the primary's scheme
+    if (tls_transport_wanted(broker_failover_active_uri())) {
+        mqtt5_cfg.network.transport = tls_transport_init();
+        if (mqtt5_cfg.network.transport == NULL) {
+            ESP_LOGE(TAG, "Failed to create TLS transport");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
     mqtt_client = esp_mqtt_client_init(&mqtt5_cfg);
     if (mqtt_client == NULL) {
         ESP_LOGE(TAG, "Failed to initialize MQTT client");
@@ -211,6 +448,103 @@ esp_err_t mqtt_client_manager_init(const mqtt_device_callbacks_t *callbacks)
     return ESP_OK;
 }
 
+/*
+ * Start the session once there is a link
+ */
+static void start_session(void)
+{
+#if CONFIG_MQTT_TRANSPORT_SN
+    ESP_LOGI(TAG, "Starting MQTT-SN client (publish only: no commands, RPC or config topics)...");
+    if (mqttsn_client_start(CONFIG_DEVICE_ID, sn_connected, sn_disconnected) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start MQTT-SN client");
+    }
+#else
+    ESP_LOGI(TAG, "Starting MQTT client...");
+    if (esp_mqtt_client_start(mqtt_client) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start MQTT client");
+        return;
+    }
+    const esp_timer_create_args_t restart_args = {
+        .callback = restart_client,
+        .name = "mqtt_restart",
+    };
+    esp_timer_create(&restart_args, &restart_timer);
+    broker_failover_start(switch_broker);
+    link_watchdog_start(drop_link);
+#endif
+}
+
+#if CONFIG_EXAMPLE_CONNECT_WIFI
+static void wifi_retry(void *arg)
+{
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "[WIFI] Reconnect failed to start: %s", esp_err_to_name(err));
+    }
+}
+
+/*
+ * Station dropped or a connect attempt failed: try again after a backoff
+ * with jitter, so a fleet does not hit a rebooting AP all at once. The
+ * examples helper only makes the first attempt (CONFIG_EXAMPLE_WIFI_CONN_MAX_RETRY=0).
+ */
+static void on_wifi_disconnected(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    const wifi_event_sta_disconnected_t *event = event_data;
+    if (event->reason == WIFI_REASON_ROAMING) {
+        return;
+    }
+    
+    uint32_t delay_ms = wifi_retry_ms + esp_random() % (wifi_retry_ms / 4 + 1);
+    ESP_LOGI(TAG, "[WIFI] Disconnected (reason %d), retrying in %lu ms", event->reason, (unsigned long)delay_ms);
+    esp_timer_stop(wifi_retry_timer);
+    esp_timer_start_once(wifi_retry_timer, delay_ms * 1000ULL);
+    wifi_retry_ms = wifi_retry_ms * 2 < WIFI_RETRY_MAX_MS ? wifi_retry_ms * 2 : WIFI_RETRY_MAX_MS;
+}
+
+static void on_got_ip(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    wifi_retry_ms = WIFI_RETRY_MIN_MS;
+    if (link_task_handle != NULL) {
+        xTaskNotifyGive(link_task_handle);
+    }
+}
+#endif
+
+/*
+ * Bring up Wi-Fi (or Ethernet) off the boot path so local control never
+ * waits for it. Over Wi-Fi the first address may come from a later retry,
+ * so the session starts whenever it arrives.
+ */
+static void link_task(void *arg)
+{
+    ESP_LOGI(TAG, "Connecting to the network...");
+#if CONFIG_EXAMPLE_CONNECT_WIFI
+    const esp_timer_create_args_t retry_args = {
+        .callback = wifi_retry,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_args, &wifi_retry_timer));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, on_wifi_disconnected, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, on_got_ip, NULL));
+    
+    if (example_connect() != ESP_OK) {
+        ESP_LOGW(TAG, "Network not up yet, running offline until it is");
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#else
+    if (example_connect() != ESP_OK) {
+        ESP_LOGE(TAG, "Network connection failed, running offline");
+        link_task_handle = NULL;
+        vTaskDelete(NULL);
+    }
+#endif
+    ESP_LOGI(TAG, "Network connected");
+    start_session();
+    link_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
 esp_err_t mqtt_client_manager_start(void)
 {
     if (mqtt_client == NULL) {
@@ -218,8 +552,11 @@ esp_err_t mqtt_client_manager_start(void)
         return ESP_ERR_INVALID_STATE;
     }
     
-    ESP_LOGI(TAG, "Starting MQTT client...");
-    return esp_mqtt_client_start(mqtt_client);
+    if (xTaskCreate(link_task, "net_link", 4096, NULL, 5, &link_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create network task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
 }
 
 esp_err_t mqtt_client_manager_stop(void)
@@ -231,7 +568,12 @@ esp_err_t mqtt_client_manager_stop(void)
     
     ESP_LOGI(TAG, "Stopping MQTT client...");
     mqtt_connected = false;
+#if CONFIG_MQTT_TRANSPORT_SN
+    mqttsn_client_stop();
+    return ESP_OK;
+#else
     return esp_mqtt_client_stop(mqtt_client);
+#endif
 }
 
 esp_mqtt_client_handle_t mqtt_client_manager_get_client(void)
@@ -243,3 +585,125 @@ bool mqtt_client_manager_is_connected(void)
 {
     return mqtt_connected;
 }
+
+uint32_t mqtt_client_manager_get_connect_count(void)
+{
+    return connect_count;
+}
+
+int mqtt_client_manager_publish(const char *topic, const char *data, int len, int qos, bool retain)
+{
+    if (mqtt_client == NULL) {
+        return -1;
+    }
+    
+#if CONFIG_MQTT_TRANSPORT_SN
+    // Acks and retries are handled by the MQTT-SN client
+    return mqttsn_client_publish(topic, data, len, qos, retain);
+#else
+    // QoS 0 is not worth outbox space during an outage
+    if (qos == 0 && !mqtt_connected) {
+        return -1;
+    }
+    int msg_id = esp_mqtt_client_enqueue(mqtt_client, topic, data, len, qos, retain ? 1 : 0, true);
+    if (qos > 0) {
+        link_watchdog_on_publish(msg_id);
+    }
+    return msg_id;
+#endif
+}
+
+int mqtt_client_manager_publish_reply(const char *topic, const char *data, int len,
+                                      const char *correlation, int correlation_len)
+{
+    if (mqtt_client == NULL) {
+        return -1;
+    }
+    if (len == 0) {
+        len = strlen(data);
+    }
+    
+#if CONFIG_MQTT_TRANSPORT_SN
+    // No properties in MQTT-SN; the reply body echoes the request's "id"
+    return mqttsn_client_publish(topic, data, len, 0, false);
+#else
+    if (xTaskGetCurrentTaskHandle() == mqtt_task) {
+        return publish_reply_now(mqtt_client, topic, data, len, correlation, correlation_len);
+    }
+    
+    size_t topic_len = strlen(topic);
+    reply_msg_t *reply = malloc(sizeof(*reply) + topic_len + 1 + len + correlation_len);
+    if (reply == NULL) {
+        return -1;
+    }
+    reply->len = len;
+    reply->correlation_len = correlation_len;
+    reply->topic = (char *)(reply + 1);
+    reply->data = reply->topic + topic_len + 1;
+    reply->correlation = reply->data + len;
+    memcpy(reply->topic, topic, topic_len + 1);
+    memcpy(reply->data, data, len);
+    if (correlation_len > 0) {
+        memcpy(reply->correlation, correlation, correlation_len);
+    }
+    
+    esp_mqtt_event_t event = {
+        .event_id = MQTT_USER_EVENT,
+        .client = mqtt_client,
+        .data = (char *)reply,
+    };
+    if (esp_mqtt_dispatch_custom_event(mqtt_client, &event) != ESP_OK) {
+        free(reply);
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+bool mqtt_client_manager_publish_state(mqtt_state_t *state, const char *json)
+{
+    if (!mqtt_connected || mqtt_client == NULL) {
+        return false;
+    }
+    
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    if (state->last_publish_ms != 0 && now_ms - state->last_publish_ms < CONFIG_STATE_INTERVAL_S * 1000LL) {
+        return false;
+    }
+    
+    // Splice "ts" in before the closing brace
+    size_t len = strlen(json);
+    if (len < 2 || json[len - 1] != '}') {
+        ESP_LOGW(TAG, "State of %s is not a JSON object", state->module);
+        return false;
+    }
+    long long ts = 0;
+    if (time_sync_is_valid()) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        ts = tv.tv_sec;
+    }
+    // On the heap: callers run on small task stacks, and this is at most
+    // once per interval for each module
+    char *payload = malloc(STATE_MAX_PAYLOAD);
+    if (payload == NULL) {
+        return false;
+    }
+    int n = snprintf(payload, STATE_MAX_PAYLOAD, "%.*s,\"ts\":%lld}", (int)(len - 1), json, ts);
+    if (n >= STATE_MAX_PAYLOAD) {
+        ESP_LOGW(TAG, "State of %s does not fit in %d bytes", state->module, STATE_MAX_PAYLOAD);
+        free(payload);
+        return false;
+    }
+    
+    char topic[96];
+    snprintf(topic, sizeof(topic), "%s%s/%s", MQTT_STATE_TOPIC_PREFIX, CONFIG_DEVICE_ID, state->module);
+    bool queued = mqtt_client_manager_publish(topic, payload, n, 1, true) >= 0;
+    free(payload);
+    if (!queued) {
+        ESP_LOGW(TAG, "Failed to queue state of %s", state->module);
+        return false;
+    }
+    state->last_publish_ms = now_ms;
+    return true;
+}
@@ -12,6 +12,7 @@
 
 #include "mqtt_client.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
  * Callback function types for device-specific MQTT handling
@@ -26,6 +27,45 @@ typedef void (*mqtt_disconnected_cb_t)(void);
 // Called when MQTT message is received (for subscriber devices)
 typedef void (*mqtt_data_received_cb_t)(esp_mqtt_event_handle_t event);
 
+// Called for messages on the device command topic, directly from the MQTT task.
+// Must not block: it is on the actuation latency path.
+typedef void (*mqtt_command_cb_t)(const char *data, int data_len);
+
+// Called for messages on the device request topic, directly from the MQTT task.
+// The event (with its MQTT5 response topic and correlation data) is only
+// valid during the call; copy what is needed and hand off to another task.
+typedef void (*mqtt_request_cb_t)(esp_mqtt_event_handle_t event);
+
+/**
+ * Command topic prefix; the manager subscribes to {prefix}{device_id}
+ * when the device registers an on_command callback.
+ * Kept outside sensor/# so commands are not ingested as telemetry.
+ */
+#define MQTT_COMMAND_TOPIC_PREFIX "greenhouse/command/"
+
+/**
+ * Request/response topic prefix; the manager subscribes to
+ * {prefix}{device_id} when the device registers an on_request callback.
+ */
+#define MQTT_REQUEST_TOPIC_PREFIX "greenhouse/rpc/"
+
+/**
+ * Retained last-value topic prefix; each module publishes its state on
+ * {prefix}{device_id}/{module}. Kept outside sensor/# so it is not ingested
+ * twice.
+ */
+#define MQTT_STATE_TOPIC_PREFIX "greenhouse/state/"
+
+/**
+ * Retained state of one module, see mqtt_client_manager_publish_state()
+ */
+typedef struct {
+    const char *module;                         // Topic suffix, e.g. "climate"
+    int64_t last_publish_ms;
+} mqtt_state_t;
+
+#define MQTT_STATE_INIT(m) { .module = (m) }
+
 /**
  * Configuration for device-specific MQTT behavior
  */
@@ -33,11 +73,14 @@ typedef struct {
     mqtt_connected_cb_t on_connected;           // Called when connected
     mqtt_disconnected_cb_t on_disconnected;     // Called when disconnected
     mqtt_data_received_cb_t on_data_received;   // Called when data received (optional)
+    mqtt_command_cb_t on_command;               // Called for command topic messages (optional)
+    mqtt_request_cb_t on_request;               // Called for request topic messages (optional)
 } mqtt_device_callbacks_t;
 
 /**
- * Initialize WiFi and connect to network
- * Must be called before mqtt_client_manager_init()
+ * Initialize NVS, the network interfaces and the default event loop
+ * Does not wait for a link: mqtt_client_manager_start() connects in the
+ * background. Must be called before mqtt_client_manager_init().
  * 
  * @return ESP_OK on success
  */
@@ -45,7 +88,7 @@ esp_err_t mqtt_client_manager_init_wifi(void);
 
 /**
  * Initialize MQTT client with device-specific callbacks
- * WiFi must be connected before calling this function.
+ * Needs no link yet; nothing is sent before mqtt_client_manager_start().
  * 
  * @param callbacks Device-specific callback functions
  * @return ESP_OK on success
@@ -68,10 +111,57 @@ esp_mqtt_client_handle_t mqtt_client_manager_get_client(void);
 bool mqtt_client_manager_is_connected(void);
 
 /**
- * Start the MQTT client
- * This is called automatically by mqtt_client_manager_init()
+ * Number of successful broker connections since boot
+ * A change means the session dropped and came back.
  * 
- * @return ESP_OK on success
+ * @return Connection count
+ */
+uint32_t mqtt_client_manager_get_connect_count(void);
+
+/**
+ * Queue a publish without blocking
+ * QoS 1/2 messages are tracked until their ack by the link watchdog, which
+ * drops a connection that stops acking. With CONFIG_MQTT_TRANSPORT_SN this
+ * is the only way out, so use it rather than esp_mqtt_client_publish().
+ * While disconnected, QoS 1/2 messages wait in the outbox for up to a day
+ * (32 KB at most) and QoS 0 messages are dropped.
+ * 
+ * @param len    Payload length, 0 to use strlen(data)
+ * @return msg_id (0 for QoS 0), or -1 if the message was not queued
+ */
+int mqtt_client_manager_publish(const char *topic, const char *data, int len, int qos, bool retain);
+
+/**
+ * Queue a QoS 0 reply carrying a request's MQTT5 correlation data
+ * The properties only go with this message: unless called from the MQTT
+ * task, the reply is copied and queued there, so it never blocks on the
+ * client. Over MQTT-SN, which has no properties, it is a plain publish.
+ * 
+ * @param len             Payload length, 0 to use strlen(data)
+ * @param correlation     Correlation data, NULL if the request had none
+ * @param correlation_len Its length
+ * @return 0 if the reply was queued, -1 if not
+ */
+int mqtt_client_manager_publish_reply(const char *topic, const char *data, int len,
+                                      const char *correlation, int correlation_len);
+
+/**
+ * Publish a module's compact state as a retained message
+ * Rate-limited to one per CONFIG_STATE_INTERVAL_S for each module, separate
+ * from the telemetry stream. Adds "ts" (Unix seconds, 0 if the clock is not
+ * set) so consumers can tell how old the state is. Never blocks.
+ * 
+ * @param state Module's state record, statically allocated by the caller
+ * @param json  JSON object to publish
+ * @return true if the message was queued
+ */
+bool mqtt_client_manager_publish_state(mqtt_state_t *state, const char *json);
+
+/**
+ * Connect the network in the background, then start the MQTT client
+ * Returns at once; on_connected follows once the broker session is up.
+ * 
+ * @return ESP_OK if the network task was started
  */
 esp_err_t mqtt_client_manager_start(void);
 
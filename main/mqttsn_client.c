@@ -0,0 +1,728 @@
+/*
+ * Greenhouse Devices - MQTT-SN Client
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ */
+
+#include "mqttsn_client.h"
+#include "mqttsn_topics.h"
+#include "mqtt_client_manager.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_vfs_eventfd.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+
+static const char *TAG = "mqttsn_client";
+
+#define QUEUE_DEPTH         16
+#define MAX_PACKET          1024
+#define MAX_TOPIC           96
+#define MAX_REGISTERED      16
+#define RETRY_MS            2000        // Tretry; the gateway is on the LAN
+#define MAX_RETRIES         3           // Nretry
+#define RECONNECT_MS        5000
+#define STATUS_MAX          256
+#define MAX_WARNED          16
+
+// Largest payload that still fits a PUBLISH with a 4-byte header
+#define MAX_PAYLOAD         (MAX_PACKET - 4 - 5)
+
+typedef struct {
+    int qos;
+    bool retain;
+    uint16_t msg_id;
+    bool reregistered;
+    int len;
+    char topic[MAX_TOPIC];
+    uint8_t data[];
+} message_t;
+
+typedef enum {
+    STATE_DISCONNECTED,
+    STATE_CONNECTING,
+    STATE_ACTIVE
+} state_t;
+
+typedef struct {
+    char name[MAX_TOPIC];
+    uint16_t id;
+} registration_t;
+
+typedef struct {
+    uint32_t tx;
+    uint32_t rx;
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+    uint32_t publishes;
+    uint32_t retries;
+    uint32_t dropped;
+} sn_stats_t;
+
+static const struct {
+    uint16_t id;
+    const char *name;
+} predefined[] = {
+#define PREDEFINED_ENTRY(id, name) { id, name },
+    MQTTSN_PREDEFINED_TOPICS(PREDEFINED_ENTRY)
+#undef PREDEFINED_ENTRY
+};
+
+// Shared with publishers
+static QueueHandle_t queue = NULL;
+static int wake_fd = -1;                // Wakes the task out of select()
+static uint16_t next_msg_id = 0;
+static sn_stats_t stats;
+static portMUX_TYPE sn_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool stop_requested = false;
+static char warned[MAX_WARNED][MAX_TOPIC];  // Topics whose drop was already logged
+static int warned_count = 0;
+
+// MQTT-SN task only
+static int sock = -1;
+static const char *sn_client_id;
+static mqttsn_connected_cb_t connected_cb;
+static mqttsn_disconnected_cb_t disconnected_cb;
+static state_t state = STATE_DISCONNECTED;
+static registration_t registered[MAX_REGISTERED];
+static int registered_count = 0;
+static message_t *inflight = NULL;      // Waiting for its REGACK or PUBACK
+static uint8_t inflight_type = 0;
+static uint16_t inflight_topic_id = 0;
+static uint8_t inflight_topic_type = 0;
+static bool inflight_rejected = false;  // Refused by the gateway: retried, then dropped
+static int retries = 0;
+static int64_t sent_ms = 0;
+static int64_t last_tx_ms = 0;
+static int64_t ping_sent_ms = 0;        // 0 when no PINGRESP is pending
+static int64_t next_attempt_ms = 0;
+
+static mqtt_state_t sn_state = MQTT_STATE_INIT("mqttsn");
+
+static int64_t now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+static uint16_t predefined_id(const char *topic)
+{
+    for (size_t i = 0; i < sizeof(predefined) / sizeof(predefined[0]); i++) {
+        if (strcmp(predefined[i].name, topic) == 0) {
+            return predefined[i].id;
+        }
+    }
+    return 0;
+}
+
+static uint16_t registered_id(const char *topic)
+{
+    for (int i = 0; i < registered_count; i++) {
+        if (strcmp(registered[i].name, topic) == 0) {
+            return registered[i].id;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Length and type; the long form is only used past 255 bytes
+ */
+static int put_header(uint8_t *buf, uint8_t type, int body_len)
+{
+    if (body_len + 2 <= 255) {
+        buf[0] = (uint8_t)(body_len + 2);
+        buf[1] = type;
+        return 2;
+    }
+    int total = body_len + 4;
+    buf[0] = 0x01;
+    buf[1] = (uint8_t)(total >> 8);
+    buf[2] = (uint8_t)total;
+    buf[3] = type;
+    return 4;
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+/*
+ * True the first time a topic is dropped, so each one is logged once
+ */
+static bool first_drop(const char *topic)
+{
+    bool first = true;
+    portENTER_CRITICAL(&sn_lock);
+    for (int i = 0; i < warned_count && first; i++) {
+        first = strncmp(warned[i], topic, MAX_TOPIC - 1) != 0;
+    }
+    if (first && warned_count < MAX_WARNED) {
+        strlcpy(warned[warned_count++], topic, MAX_TOPIC);
+    }
+    portEXIT_CRITICAL(&sn_lock);
+    return first;
+}
+
+static void send_packet(const uint8_t *buf, int len)
+{
+    int sent = send(sock, buf, len, 0);
+    last_tx_ms = now_ms();
+
+    portENTER_CRITICAL(&sn_lock);
+    if (sent == len) {
+        stats.tx++;
+        stats.tx_bytes += len;
+    } else {
+        stats.dropped++;
+    }
+    portEXIT_CRITICAL(&sn_lock);
+}
+
+static void send_connect(void)
+{
+    uint8_t buf[64];
+    size_t id_len = strnlen(sn_client_id, sizeof(buf) - 8);
+    int n = put_header(buf, MQTTSN_CONNECT, 4 + (int)id_len);
+    buf[n++] = MQTTSN_FLAG_CLEAN;
+    buf[n++] = MQTTSN_PROTOCOL_ID;
+    put_u16(buf + n, CONFIG_MQTT_SN_KEEPALIVE_S);
+    n += 2;
+    memcpy(buf + n, sn_client_id, id_len);
+    send_packet(buf, n + (int)id_len);
+}
+
+static void send_register(const message_t *m)
+{
+    uint8_t buf[MAX_TOPIC + 8];
+    size_t name_len = strlen(m->topic);
+    int n = put_header(buf, MQTTSN_REGISTER, 4 + (int)name_len);
+    put_u16(buf + n, 0);
+    put_u16(buf + n + 2, m->msg_id);
+    memcpy(buf + n + 4, m->topic, name_len);
+    send_packet(buf, n + 4 + (int)name_len);
+}
+
+static void send_publish(const message_t *m, uint16_t topic_id, uint8_t topic_type, bool dup)
+{
+    static uint8_t buf[MAX_PACKET];
+    uint8_t flags = topic_type | (m->retain ? MQTTSN_FLAG_RETAIN : 0) | (dup ? MQTTSN_FLAG_DUP : 0);
+    flags |= m->qos < 0 ? MQTTSN_FLAG_QOS_M1 : m->qos == 1 ? MQTTSN_FLAG_QOS_1 : MQTTSN_FLAG_QOS_0;
+
+    int n = put_header(buf, MQTTSN_PUBLISH, 5 + m->len);
+    buf[n] = flags;
+    put_u16(buf + n + 1, topic_id);
+    put_u16(buf + n + 3, m->qos == 1 ? m->msg_id : 0);
+    memcpy(buf + n + 5, m->data, m->len);
+    send_packet(buf, n + 5 + m->len);
+}
+
+static void send_empty(uint8_t type)
+{
+    uint8_t buf[2];
+    send_packet(buf, put_header(buf, type, 0));
+}
+
+static void drop(message_t *m)
+{
+    portENTER_CRITICAL(&sn_lock);
+    stats.dropped++;
+    portEXIT_CRITICAL(&sn_lock);
+    free(m);
+}
+
+static void lose_session(const char *why)
+{
+    ESP_LOGW(TAG, "[SN] Session lost: %s", why);
+    if (inflight != NULL) {
+        drop(inflight);
+        inflight = NULL;
+    }
+    state = STATE_DISCONNECTED;
+    ping_sent_ms = 0;
+    next_attempt_ms = now_ms() + RECONNECT_MS;
+    if (disconnected_cb) {
+        disconnected_cb();
+    }
+}
+
+/*
+ * Send a message whose topic ID is known; QoS 1 stays in flight until acked
+ */
+static void publish_now(message_t *m, uint16_t topic_id, uint8_t topic_type)
+{
+    send_publish(m, topic_id, topic_type, false);
+    portENTER_CRITICAL(&sn_lock);
+    stats.publishes++;
+    portEXIT_CRITICAL(&sn_lock);
+
+    if (m->qos == 1) {
+        inflight = m;
+        inflight_type = MQTTSN_PUBLISH;
+        inflight_topic_id = topic_id;
+        inflight_topic_type = topic_type;
+        inflight_rejected = false;
+        retries = 0;
+        sent_ms = now_ms();
+    } else {
+        free(m);
+    }
+}
+
+static void start_message(message_t *m)
+{
+    uint16_t id = predefined_id(m->topic);
+    if (id != 0) {
+        publish_now(m, id, MQTTSN_TOPIC_PREDEFINED);
+        return;
+    }
+    id = registered_id(m->topic);
+    if (id != 0) {
+        publish_now(m, id, MQTTSN_TOPIC_NORMAL);
+        return;
+    }
+
+    // REGISTER reuses the message number; a QoS 0 message borrows one
+    if (m->msg_id == 0) {
+        portENTER_CRITICAL(&sn_lock);
+        next_msg_id = next_msg_id == UINT16_MAX ? 1 : next_msg_id + 1;
+        m->msg_id = next_msg_id;
+        portEXIT_CRITICAL(&sn_lock);
+    }
+    send_register(m);
+    inflight = m;
+    inflight_type = MQTTSN_REGISTER;
+    inflight_rejected = false;
+    retries = 0;
+    sent_ms = now_ms();
+}
+
+static void handle_packet(const uint8_t *buf, int len)
+{
+    int hdr;
+    int total;
+    if (len >= 2 && buf[0] != 0x01) {
+        total = buf[0];
+        hdr = 2;
+    } else if (len >= 4 && buf[0] == 0x01) {
+        total = get_u16(buf + 1);
+        hdr = 4;
+    } else {
+        return;
+    }
+    if (total != len) {
+        return;
+    }
+    uint8_t type = buf[hdr - 1];
+    const uint8_t *body = buf + hdr;
+    int body_len = len - hdr;
+
+    switch (type) {
+    case MQTTSN_CONNACK:
+        if (state != STATE_CONNECTING || body_len < 1) {
+            break;
+        }
+        if (body[0] != MQTTSN_RC_ACCEPTED) {
+            ESP_LOGW(TAG, "[SN] CONNECT refused (%d)", body[0]);
+            state = STATE_DISCONNECTED;
+            next_attempt_ms = now_ms() + RECONNECT_MS;
+            break;
+        }
+        ESP_LOGI(TAG, "[SN] Connected to gateway %s", CONFIG_MQTT_SN_GATEWAY);
+        state = STATE_ACTIVE;
+        registered_count = 0;
+        if (connected_cb) {
+            connected_cb();
+        }
+        break;
+
+    case MQTTSN_REGACK: {
+        if (inflight == NULL || inflight_type != MQTTSN_REGISTER || body_len < 5 ||
+            get_u16(body + 2) != inflight->msg_id) {
+            break;
+        }
+        if (body[4] != MQTTSN_RC_ACCEPTED) {
+            ESP_LOGW(TAG, "[SN] Gateway refused topic %s (%d)", inflight->topic, body[4]);
+            drop(inflight);
+            inflight = NULL;
+            break;
+        }
+        if (registered_count < MAX_REGISTERED) {
+            registration_t *r = &registered[registered_count++];
+            snprintf(r->name, sizeof(r->name), "%s", inflight->topic);
+            r->id = get_u16(body);
+        }
+        message_t *m = inflight;
+        inflight = NULL;
+        publish_now(m, get_u16(body), MQTTSN_TOPIC_NORMAL);
+        break;
+    }
+
+    case MQTTSN_PUBACK: {
+        if (inflight == NULL || inflight_type != MQTTSN_PUBLISH || body_len < 5 ||
+            get_u16(body + 2) != inflight->msg_id) {
+            break;
+        }
+        if (body[4] == MQTTSN_RC_ACCEPTED) {
+            free(inflight);
+            inflight = NULL;
+            break;
+        }
+        if (body[4] == MQTTSN_RC_INVALID_TOPIC && inflight_topic_type == MQTTSN_TOPIC_NORMAL &&
+            !inflight->reregistered) {
+            // Gateway restarted and forgot our registrations
+            ESP_LOGW(TAG, "[SN] Topic ID of %s unknown to the gateway, registering again", inflight->topic);
+            registered_count = 0;
+            message_t *m = inflight;
+            inflight = NULL;
+            m->reregistered = true;
+            start_message(m);
+            break;
+        }
+        // Congestion (the broker is down): resent after RETRY_MS like a lost ack
+        ESP_LOGD(TAG, "[SN] Gateway refused %s (%d), retrying", inflight->topic, body[4]);
+        inflight_rejected = true;
+        sent_ms = now_ms();
+        break;
+    }
+
+    case MQTTSN_PINGRESP:
+        ping_sent_ms = 0;
+        break;
+
+    case MQTTSN_DISCONNECT:
+        if (state != STATE_DISCONNECTED) {
+            lose_session("gateway disconnected us");
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*
+ * Retransmit whatever waits for an ack, keep the session alive with
+ * PINGREQ, and give up on the session after MAX_RETRIES
+ */
+static void check_timers(int64_t now)
+{
+    if (state == STATE_DISCONNECTED && CONFIG_MQTT_SN_QOS >= 0 && now >= next_attempt_ms) {
+        send_connect();
+        state = STATE_CONNECTING;
+        retries = 0;
+        sent_ms = now;
+        return;
+    }
+
+    if (state == STATE_CONNECTING && now - sent_ms >= RETRY_MS) {
+        if (++retries > MAX_RETRIES) {
+            ESP_LOGW(TAG, "[SN] No CONNACK from %s", CONFIG_MQTT_SN_GATEWAY);
+            state = STATE_DISCONNECTED;
+            next_attempt_ms = now + RECONNECT_MS;
+        } else {
+            send_connect();
+            sent_ms = now;
+        }
+        return;
+    }
+
+    if (state != STATE_ACTIVE || CONFIG_MQTT_SN_QOS < 0) {
+        return;
+    }
+
+    if (inflight != NULL && now - sent_ms >= RETRY_MS) {
+        if (++retries > MAX_RETRIES && inflight_rejected) {
+            // The gateway answers, so the session is fine; only this message is lost
+            ESP_LOGW(TAG, "[SN] Gateway kept refusing %s, dropping it", inflight->topic);
+            drop(inflight);
+            inflight = NULL;
+            return;
+        }
+        if (retries > MAX_RETRIES) {
+            lose_session("no ack");
+            return;
+        }
+        portENTER_CRITICAL(&sn_lock);
+        stats.retries++;
+        portEXIT_CRITICAL(&sn_lock);
+        if (inflight_type == MQTTSN_REGISTER) {
+            send_register(inflight);
+        } else {
+            send_publish(inflight, inflight_topic_id, inflight_topic_type, true);
+        }
+        sent_ms = now;
+    }
+
+    if (ping_sent_ms != 0 && now - ping_sent_ms >= RETRY_MS * (MAX_RETRIES + 1)) {
+        lose_session("no PINGRESP");
+    } else if (ping_sent_ms == 0 && now - last_tx_ms >= CONFIG_MQTT_SN_KEEPALIVE_S * 1000LL) {
+        send_empty(MQTTSN_PINGREQ);
+        ping_sent_ms = now;
+    }
+}
+
+/*
+ * When check_timers() next has something to do; the task sleeps until then
+ * unless a packet or a queued message comes first
+ */
+static int64_t next_deadline(int64_t status_due)
+{
+    int64_t deadline = state == STATE_ACTIVE ? status_due : INT64_MAX;
+    if (CONFIG_MQTT_SN_QOS < 0) {
+        return deadline;
+    }
+
+    int64_t due = INT64_MAX;
+    if (state == STATE_DISCONNECTED) {
+        due = next_attempt_ms;
+    } else if (state == STATE_CONNECTING) {
+        due = sent_ms + RETRY_MS;
+    } else {
+        due = ping_sent_ms != 0 ? ping_sent_ms + RETRY_MS * (MAX_RETRIES + 1)
+                                : last_tx_ms + CONFIG_MQTT_SN_KEEPALIVE_S * 1000LL;
+        if (inflight != NULL && sent_ms + RETRY_MS < due) {
+            due = sent_ms + RETRY_MS;
+        }
+    }
+    return due < deadline ? due : deadline;
+}
+
+static void wait_for_work(int64_t deadline)
+{
+    static uint8_t rx[MAX_PACKET];
+    int64_t wait_ms = deadline - now_ms();
+    if (wait_ms < 0) {
+        wait_ms = 0;
+    }
+
+    fd_set ready;
+    FD_ZERO(&ready);
+    FD_SET(sock, &ready);
+    FD_SET(wake_fd, &ready);
+    struct timeval timeout = { .tv_sec = wait_ms / 1000, .tv_usec = (wait_ms % 1000) * 1000 };
+    int max_fd = sock > wake_fd ? sock : wake_fd;
+    if (select(max_fd + 1, &ready, NULL, NULL, deadline == INT64_MAX ? NULL : &timeout) <= 0) {
+        return;
+    }
+
+    if (FD_ISSET(wake_fd, &ready)) {
+        uint64_t count;
+        read(wake_fd, &count, sizeof(count));
+    }
+    if (FD_ISSET(sock, &ready)) {
+        int n = recv(sock, rx, sizeof(rx), 0);
+        if (n > 0) {
+            portENTER_CRITICAL(&sn_lock);
+            stats.rx++;
+            stats.rx_bytes += n;
+            portEXIT_CRITICAL(&sn_lock);
+            handle_packet(rx, n);
+        }
+    }
+}
+
+static void wake_task(void)
+{
+    uint64_t one = 1;
+    if (wake_fd >= 0) {
+        write(wake_fd, &one, sizeof(one));
+    }
+}
+
+static void mqttsn_task(void *pvParameters)
+{
+    char status[STATUS_MAX];
+    int64_t status_ms = now_ms();
+
+    if (CONFIG_MQTT_SN_QOS < 0) {
+        // Nothing to set up: every reading is a single datagram
+        state = STATE_ACTIVE;
+        if (connected_cb) {
+            connected_cb();
+        }
+    }
+
+    while (!stop_requested) {
+        check_timers(now_ms());
+
+        message_t *m;
+        while (state == STATE_ACTIVE && inflight == NULL && xQueueReceive(queue, &m, 0) == pdTRUE) {
+            start_message(m);
+        }
+
+        // QoS -1 cannot carry the state topic, so the counters go to the log
+        if (state == STATE_ACTIVE && now_ms() - status_ms >= CONFIG_STATE_INTERVAL_S * 1000LL &&
+            mqttsn_client_format_status(status, sizeof(status)) < (int)sizeof(status)) {
+            status_ms = now_ms();
+            if (CONFIG_MQTT_SN_QOS >= 0) {
+                mqtt_client_manager_publish_state(&sn_state, status);
+            } else {
+                ESP_LOGI(TAG, "[SN] %s", status);
+            }
+        }
+
+        wait_for_work(next_deadline(status_ms + CONFIG_STATE_INTERVAL_S * 1000LL));
+    }
+
+    if (state == STATE_ACTIVE && CONFIG_MQTT_SN_QOS >= 0) {
+        send_empty(MQTTSN_DISCONNECT);
+    }
+    close(sock);
+    sock = -1;
+    close(wake_fd);
+    wake_fd = -1;
+    vTaskDelete(NULL);
+}
+
+esp_err_t mqttsn_client_start(const char *client_id, mqttsn_connected_cb_t on_connected,
+                              mqttsn_disconnected_cb_t on_disconnected)
+{
+    char host[64];
+    snprintf(host, sizeof(host), "%s", CONFIG_MQTT_SN_GATEWAY);
+    char *port = strrchr(host, ':');
+    if (port == NULL) {
+        ESP_LOGE(TAG, "[SN] CONFIG_MQTT_SN_GATEWAY must be host:port");
+        return ESP_ERR_INVALID_ARG;
+    }
+    *port++ = '\0';
+
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_DGRAM };
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(host, port, &hints, &res) != 0 || res == NULL) {
+        ESP_LOGE(TAG, "[SN] Cannot resolve gateway %s", CONFIG_MQTT_SN_GATEWAY);
+        return ESP_FAIL;
+    }
+
+    // Connected UDP socket: plain send/recv, and only the gateway gets through
+    sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock < 0 || connect(sock, res->ai_addr, res->ai_addrlen) != 0) {
+        ESP_LOGE(TAG, "[SN] Cannot open UDP socket to %s", CONFIG_MQTT_SN_GATEWAY);
+        if (sock >= 0) {
+            close(sock);
+            sock = -1;
+        }
+        freeaddrinfo(res);
+        return ESP_FAIL;
+    }
+    freeaddrinfo(res);
+
+    // Publishers wake the task through an eventfd, so it can sleep in select()
+    esp_vfs_eventfd_config_t eventfd_config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    esp_err_t err = esp_vfs_eventfd_register(&eventfd_config);
+    if (err == ESP_OK || err == ESP_ERR_INVALID_STATE) {
+        wake_fd = eventfd(0, 0);
+    }
+    queue = xQueueCreate(QUEUE_DEPTH, sizeof(message_t *));
+    if (wake_fd < 0 || queue == NULL) {
+        ESP_LOGE(TAG, "[SN] Cannot create the task's queue");
+        if (wake_fd >= 0) {
+            close(wake_fd);
+            wake_fd = -1;
+        }
+        if (queue != NULL) {
+            vQueueDelete(queue);
+            queue = NULL;
+        }
+        close(sock);
+        sock = -1;
+        return ESP_ERR_NO_MEM;
+    }
+
+    sn_client_id = client_id;
+    connected_cb = on_connected;
+    disconnected_cb = on_disconnected;
+    stop_requested = false;
+    ESP_LOGI(TAG, "[SN] Publishing to %s with QoS %d", CONFIG_MQTT_SN_GATEWAY, CONFIG_MQTT_SN_QOS);
+    xTaskCreate(mqttsn_task, "mqttsn", 4096, NULL, 5, NULL);
+    return ESP_OK;
+}
+
+int mqttsn_client_publish(const char *topic, const char *data, int len, int qos, bool retain)
+{
+    if (queue == NULL) {
+        return -1;
+    }
+    if (qos > CONFIG_MQTT_SN_QOS) {
+        qos = CONFIG_MQTT_SN_QOS;
+    }
+    if (len == 0) {
+        len = strlen(data);
+    }
+
+    // Without a session there is no REGISTER
+    if ((qos < 0 && predefined_id(topic) == 0) || len > MAX_PAYLOAD || strlen(topic) >= MAX_TOPIC) {
+        if (first_drop(topic)) {
+            ESP_LOGW(TAG, "[SN] Cannot send %s (%d bytes) with QoS %d, dropping it%s", topic, len, qos,
+                     qos < 0 && predefined_id(topic) == 0 ? ": not a predefined topic" : "");
+        }
+        portENTER_CRITICAL(&sn_lock);
+        stats.dropped++;
+        portEXIT_CRITICAL(&sn_lock);
+        return -1;
+    }
+
+    message_t *m = malloc(sizeof(message_t) + len);
+    if (m == NULL) {
+        return -1;
+    }
+    m->qos = qos;
+    m->retain = retain;
+    m->len = len;
+    m->msg_id = 0;
+    m->reregistered = false;
+    snprintf(m->topic, sizeof(m->topic), "%s", topic);
+    memcpy(m->data, data, len);
+
+    if (qos == 1) {
+        portENTER_CRITICAL(&sn_lock);
+        next_msg_id = next_msg_id == UINT16_MAX ? 1 : next_msg_id + 1;
+        m->msg_id = next_msg_id;
+        portEXIT_CRITICAL(&sn_lock);
+    }
+
+    // The task may free the message as soon as it is queued
+    int msg_id = m->msg_id;
+    if (xQueueSend(queue, &m, 0) != pdTRUE) {
+        drop(m);
+        return -1;
+    }
+    wake_task();
+    return msg_id;
+}
+
+void mqttsn_client_stop(void)
+{
+    stop_requested = true;
+    wake_task();
+}
+
+int mqttsn_client_format_status(char *buf, size_t size)
+{
+    sn_stats_t snapshot;
+    portENTER_CRITICAL(&sn_lock);
+    snapshot = stats;
+    portEXIT_CRITICAL(&sn_lock);
+
+    return snprintf(buf, size, "{\"qos\":%d,\"tx\":%lu,\"rx\":%lu,\"tx_bytes\":%lu,\"rx_bytes\":%lu,"
+                    "\"publishes\":%lu,\"retries\":%lu,\"dropped\":%lu,\"packets_per_publish\":%.2f}",
+                    CONFIG_MQTT_SN_QOS, (unsigned long)snapshot.tx, (unsigned long)snapshot.rx,
+                    (unsigned long)snapshot.tx_bytes, (unsigned long)snapshot.rx_bytes,
+                    (unsigned long)snapshot.publishes, (unsigned long)snapshot.retries,
+                    (unsigned long)snapshot.dropped,
+                    snapshot.publishes ? (double)(snapshot.tx + snapshot.rx) / snapshot.publishes : 0.0);
+}
@@ -0,0 +1,56 @@
+/*
+ * Greenhouse Devices - MQTT-SN Client
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Publish-only MQTT-SN over UDP to the gateway in mqttsn_gateway/, which
+ * republishes on the MQTT broker under the same topics. With QoS -1 a
+ * reading is one datagram and there is no session at all; QoS 0/1 connect
+ * first and can also use topics outside the predefined set.
+ */
+
+#ifndef MQTTSN_CLIENT_H
+#define MQTTSN_CLIENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * Called from the MQTT-SN task when the session comes up / is lost
+ * (right after start with QoS -1, which has no session)
+ */
+typedef void (*mqttsn_connected_cb_t)(void);
+typedef void (*mqttsn_disconnected_cb_t)(void);
+
+/**
+ * Resolve CONFIG_MQTT_SN_GATEWAY and start the client task
+ *
+ * @param client_id Sent in CONNECT (QoS 0/1)
+ */
+esp_err_t mqttsn_client_start(const char *client_id, mqttsn_connected_cb_t on_connected,
+                              mqttsn_disconnected_cb_t on_disconnected);
+
+/**
+ * Queue a publish without blocking
+ *
+ * @param qos Capped at CONFIG_MQTT_SN_QOS
+ * @return Message number (0 unless acked), or -1 if dropped (queue full,
+ *         too large, or a non-predefined topic with QoS -1)
+ */
+int mqttsn_client_publish(const char *topic, const char *data, int len, int qos, bool retain);
+
+/**
+ * Send DISCONNECT and stop the task
+ */
+void mqttsn_client_stop(void);
+
+/**
+ * Status as a JSON object: QoS, datagrams and bytes each way, publishes,
+ * retransmissions and drops, and datagrams per publish
+ *
+ * @return Length written (snprintf semantics)
+ */
+int mqttsn_client_format_status(char *buf, size_t size);
+
+#endif // MQTTSN_CLIENT_H
@@ -0,0 +1,59 @@
+/*
+ * Greenhouse Devices - MQTT-SN Predefined Topics
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Topic IDs known to both the devices and the gateway (mqttsn_gateway/), so
+ * telemetry can be sent without a REGISTER round trip, and with QoS -1
+ * without connecting at all. Append only: IDs are on the wire. bench/mqttsn
+ * is for scripts/benchmark_mqttsn.py and lies outside what Telegraf stores.
+ */
+
+#ifndef MQTTSN_TOPICS_H
+#define MQTTSN_TOPICS_H
+
+#define MQTTSN_PREDEFINED_TOPICS(X)             \
+    X(1, "sensor/climate")                      \
+    X(2, "sensor/heartbeat")                    \
+    X(3, "sensor/climate/burst")                \
+    X(4, "sensor/par")                          \
+    X(5, "sensor/lights")                       \
+    X(6, "sensor/humidifier")                   \
+    X(7, "sensor/irrigation")                   \
+    X(8, "sensor/irrigation/event")             \
+    X(9, "bench/mqttsn")
+
+// Registered (per session) topic IDs start above the predefined range
+#define MQTTSN_FIRST_REGISTERED_ID 0x0100
+
+// Message types and flags used by the devices and the gateway
+#define MQTTSN_CONNECT          0x04
+#define MQTTSN_CONNACK          0x05
+#define MQTTSN_REGISTER         0x0A
+#define MQTTSN_REGACK           0x0B
+#define MQTTSN_PUBLISH          0x0C
+#define MQTTSN_PUBACK           0x0D
+#define MQTTSN_PINGREQ          0x16
+#define MQTTSN_PINGRESP         0x17
+#define MQTTSN_DISCONNECT       0x18
+
+#define MQTTSN_FLAG_DUP         0x80
+#define MQTTSN_FLAG_QOS_0       0x00
+#define MQTTSN_FLAG_QOS_1       0x20
+#define MQTTSN_FLAG_QOS_M1      0x60
+#define MQTTSN_FLAG_QOS_MASK    0x60
+#define MQTTSN_FLAG_RETAIN      0x10
+#define MQTTSN_FLAG_CLEAN       0x04
+#define MQTTSN_TOPIC_NORMAL     0x00
+#define MQTTSN_TOPIC_PREDEFINED 0x01
+#define MQTTSN_TOPIC_SHORT      0x02
+#define MQTTSN_TOPIC_TYPE_MASK  0x03
+
+#define MQTTSN_PROTOCOL_ID      0x01
+
+#define MQTTSN_RC_ACCEPTED      0x00
+#define MQTTSN_RC_CONGESTION    0x01
+#define MQTTSN_RC_INVALID_TOPIC 0x02
+#define MQTTSN_RC_NOT_SUPPORTED 0x03
+
+#endif // MQTTSN_TOPICS_H
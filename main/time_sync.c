@@ -0,0 +1,55 @@
+/*
+ * Greenhouse Devices - SNTP Time Sync
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ */
+
+#include "time_sync.h"
+#include "esp_log.h"
+#include "esp_netif_sntp.h"
+#include "sdkconfig.h"
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+
+static const char *TAG = "time_sync";
+
+// Any clock earlier than this has not been set (2024-01-01T00:00:00Z)
+#define TIME_SYNC_MIN_VALID_EPOCH   1704067200
+
+static void on_time_synced(struct timeval *tv)
+{
+    struct tm local;
+    time_t now = tv->tv_sec;
+    localtime_r(&now, &local);
+
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &local);
+    ESP_LOGI(TAG, "[SNTP] Time synced: %s (%s)", buf, CONFIG_TIMEZONE);
+}
+
+esp_err_t time_sync_init(void)
+{
+    setenv("TZ", CONFIG_TIMEZONE, 1);
+    tzset();
+
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_SNTP_SERVER);
+    config.sync_cb = on_time_synced;
+
+    esp_err_t err = esp_netif_sntp_init(&config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "[SNTP] Failed to start: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG, "[SNTP] Started with server %s", CONFIG_SNTP_SERVER);
+    if (time_sync_is_valid()) {
+        ESP_LOGI(TAG, "[SNTP] Clock already valid from before reset");
+    }
+    return ESP_OK;
+}
+
+bool time_sync_is_valid(void)
+{
+    return time(NULL) >= TIME_SYNC_MIN_VALID_EPOCH;
+}
@@ -0,0 +1,33 @@
+/*
+ * Greenhouse Devices - SNTP Time Sync
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Keeps the system clock synced over SNTP and applies the configured
+ * timezone. Once set, the clock keeps running (and survives software
+ * resets) while the network is down, so schedules continue offline.
+ */
+
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+/**
+ * Start SNTP and set the local timezone
+ * Must be called after the network is up. Does not wait for the first sync.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t time_sync_init(void);
+
+/**
+ * Check whether the system clock holds a real date
+ * True after the first SNTP sync, or after a software reset that kept the RTC.
+ *
+ * @return true if local time can be trusted
+ */
+bool time_sync_is_valid(void);
+
+#endif // TIME_SYNC_H
@@ -0,0 +1,367 @@
+/*
+ * Greenhouse Devices - MQTT TLS Transport
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ */
+
+#include "tls_transport.h"
+#include "broker_failover.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "esp_crt_bundle.h"
+#include "freertos/FreeRTOS.h"
+#include "mbedtls/platform_util.h"
+#include "mbedtls/ssl.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+
+static const char *TAG = "tls_transport";
+
+#define MQTTS_DEFAULT_PORT  8883
+
+#if BROKER_CA_EMBEDDED
+extern const char broker_ca_start[] asm("_binary_ca_crt_start");
+extern const char broker_ca_end[] asm("_binary_ca_crt_end");
+#endif
+
+typedef enum {
+    KIND_FULL,
+    KIND_RESUME,
+    KIND_COUNT
+} kind_t;
+
+static const char *KIND_NAMES[KIND_COUNT] = { "full", "resume" };
+
+typedef struct {
+    uint32_t count;
+    int32_t last_ms;
+    int64_t total_ms;
+} handshake_stats_t;
+
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+// One session per broker, MQTT task only. Plain RAM: kept through light sleep.
+typedef struct {
+    char host[64];
+    int port;
+    esp_tls_client_session_t *session;
+    unsigned char id[32];       // Session ID of the last full handshake, empty with a ticket
+    size_t id_len;
+} session_slot_t;
+
+static session_slot_t sessions[BROKER_FAILOVER_MAX];
+static int next_evict = 0;
+#endif
+
+static handshake_stats_t handshakes[KIND_COUNT];
+static uint32_t failures = 0;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+typedef struct {
+    esp_tls_t *tls;
+} tls_ctx_t;
+
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+// The exported session read through the public mbedtls accessors; esp_tls
+// wraps it as the only member, and it can be exported once per connection
+static const mbedtls_ssl_session *exported_session(const esp_tls_client_session_t *session)
+{
+    return (const mbedtls_ssl_session *)session;
+}
+
+static bool connection_tls12(esp_tls_t *tls)
+{
+    mbedtls_ssl_context *ssl = esp_tls_get_ssl_context(tls);
+    return ssl != NULL && mbedtls_ssl_get_version_number(ssl) == MBEDTLS_SSL_VERSION_TLS1_2;
+}
+
+static void forget_session(session_slot_t *slot)
+{
+    if (slot->session != NULL) {
+        esp_tls_free_client_session(slot->session);
+        slot->session = NULL;
+    }
+    mbedtls_platform_zeroize(slot->id, sizeof(slot->id));
+    slot->id_len = 0;
+}
+
+// A stale session fails the handshake; DNS, TCP and timeout errors say nothing about it
+static bool handshake_failed(esp_tls_t *tls)
+{
+    esp_tls_error_handle_t error = NULL;
+    int code = 0;
+    int flags = 0;
+    if (esp_tls_get_error_handle(tls, &error) != ESP_OK || error == NULL) {
+        return false;
+    }
+    esp_err_t last = esp_tls_get_and_clear_last_error(error, &code, &flags);
+    // flags holds the certificate verification result
+    return last == ESP_ERR_MBEDTLS_SSL_HANDSHAKE_FAILED || flags != 0;
+}
+
+static session_slot_t *session_slot(const char *host, int port)
+{
+    for (int i = 0; i < BROKER_FAILOVER_MAX; i++) {
+        if (sessions[i].port == port && strcmp(sessions[i].host, host) == 0) {
+            return &sessions[i];
+        }
+    }
+
+    session_slot_t *slot = &sessions[next_evict];
+    next_evict = (next_evict + 1) % BROKER_FAILOVER_MAX;
+    forget_session(slot);
+    snprintf(slot->host, sizeof(slot->host), "%s", host);
+    slot->port = port;
+    return slot;
+}
+#endif
+
+static int tls_fd(tls_ctx_t *ctx)
+{
+    int fd = -1;
+    if (ctx->tls == NULL || esp_tls_get_conn_sockfd(ctx->tls, &fd) != ESP_OK) {
+        return -1;
+    }
+    return fd;
+}
+
+static int tls_close(esp_transport_handle_t t)
+{
+    tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->tls != NULL) {
+        esp_tls_conn_destroy(ctx->tls);
+        ctx->tls = NULL;
+    }
+    return 0;
+}
+
+static int tls_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    tls_close(t);
+
+    // The MQTT client only applies its TCP keepalive to its own transports
+    tls_keep_alive_cfg_t keep_alive = {
+#if CONFIG_MQTT_TCP_KEEPALIVE
+        .keep_alive_enable = true,
+        .keep_alive_idle = CONFIG_MQTT_TCP_KEEPALIVE_IDLE_S,
+        .keep_alive_interval = CONFIG_MQTT_TCP_KEEPALIVE_INTERVAL_S,
+        .keep_alive_count = CONFIG_MQTT_TCP_KEEPALIVE_COUNT,
+#endif
+    };
+    esp_tls_cfg_t cfg = {
+        .timeout_ms = timeout_ms,
+        .keep_alive_cfg = &keep_alive,
+#if BROKER_CA_EMBEDDED
+        .cacert_buf = (const unsigned char *)broker_ca_start,
+        .cacert_bytes = broker_ca_end - broker_ca_start,
+#else
+        .crt_bundle_attach = esp_crt_bundle_attach,
+#endif
+    };
+
+    kind_t kind = KIND_FULL;
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    session_slot_t *slot = session_slot(host, port);
+    cfg.client_session = slot->session;
+#endif
+
+    ctx->tls = esp_tls_init();
+    if (ctx->tls == NULL) {
+        return -1;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    if (esp_tls_conn_new_sync(host, strlen(host), port, &cfg, ctx->tls) != 1) {
+        bool drop = false;
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        // The broker may have restarted and lost its ticket key
+        drop = slot->session != NULL && handshake_failed(ctx->tls);
+        if (drop) {
+            forget_session(slot);
+        }
+#endif
+        ESP_LOGW(TAG, "[TLS] Connect to %s:%d failed%s", host, port, drop ? ", dropping its cached session" : "");
+        portENTER_CRITICAL(&stats_lock);
+        failures++;
+        portEXIT_CRITICAL(&stats_lock);
+        tls_close(t);
+        return -1;
+    }
+    int32_t elapsed_ms = (int32_t)((esp_timer_get_time() - start_us) / 1000);
+
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    // The broker may turn the offered session down and do a full handshake.
+    // A resumed session keeps the cached ID; with a ticket the client offers
+    // a fresh random ID, which the broker only echoes when it resumes
+    esp_tls_client_session_t *session = esp_tls_get_client_session(ctx->tls);
+    if (session != NULL) {
+        const mbedtls_ssl_session *live = exported_session(session);
+        const unsigned char *id = mbedtls_ssl_session_get_id(live);
+        size_t id_len = mbedtls_ssl_session_get_id_len(live);
+        if (slot->session != NULL && connection_tls12(ctx->tls) && id_len > 0 &&
+            (slot->id_len == 0 || (id_len == slot->id_len && memcmp(id, slot->id, id_len) == 0))) {
+            kind = KIND_RESUME;
+        }
+
+        // Keep the newest session: it carries the freshest ticket
+        if (slot->session != NULL) {
+            esp_tls_free_client_session(slot->session);
+        }
+        slot->session = session;
+        if (kind == KIND_FULL) {
+            mbedtls_platform_zeroize(slot->id, sizeof(slot->id));
+            slot->id_len = id_len <= sizeof(slot->id) ? id_len : 0;
+            memcpy(slot->id, id, slot->id_len);
+        }
+    }
+#endif
+
+    portENTER_CRITICAL(&stats_lock);
+    handshake_stats_t *h = &handshakes[kind];
+    h->count++;
+    h->last_ms = elapsed_ms;
+    h->total_ms += elapsed_ms;
+    portEXIT_CRITICAL(&stats_lock);
+
+    ESP_LOGI(TAG, "[TLS] Connected to %s:%d in %ld ms (%s handshake)", host, port, (long)elapsed_ms,
+             KIND_NAMES[kind]);
+    return 0;
+}
+
+static int tls_poll(esp_transport_handle_t t, int timeout_ms, bool write)
+{
+    tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    int fd = tls_fd(ctx);
+    if (fd < 0) {
+        return -1;
+    }
+
+    fd_set ready;
+    fd_set errors;
+    FD_ZERO(&ready);
+    FD_ZERO(&errors);
+    FD_SET(fd, &ready);
+    FD_SET(fd, &errors);
+    struct timeval timeout = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    int ret = select(fd + 1, write ? NULL : &ready, write ? &ready : NULL, &errors,
+                     timeout_ms < 0 ? NULL : &timeout);
+    if (ret > 0 && FD_ISSET(fd, &errors)) {
+        return -1;
+    }
+    return ret;
+}
+
+static int tls_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    // Records already decrypted do not show on the socket
+    if (ctx->tls != NULL && esp_tls_get_bytes_avail(ctx->tls) > 0) {
+        return 1;
+    }
+    return tls_poll(t, timeout_ms, false);
+}
+
+static int tls_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    return tls_poll(t, timeout_ms, true);
+}
+
+static int tls_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    if (ctx->tls == NULL) {
+        return -1;
+    }
+    if (timeout_ms > 0 && esp_tls_get_bytes_avail(ctx->tls) <= 0) {
+        int poll = tls_poll(t, timeout_ms, false);
+        if (poll <= 0) {
+            return poll == 0 ? ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT : poll;
+        }
+    }
+
+    int ret = esp_tls_conn_read(ctx->tls, buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_TIMEOUT) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (ret == 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+    return ret < 0 ? -1 : ret;
+}
+
+static int tls_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    int poll = tls_poll(t, timeout_ms, true);
+    if (poll <= 0) {
+        ESP_LOGW(TAG, "[TLS] Socket not writable within %d ms", timeout_ms);
+        return poll;
+    }
+
+    int ret = esp_tls_conn_write(ctx->tls, buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_WRITE || ret == ESP_TLS_ERR_SSL_WANT_READ) {
+        return 0;
+    }
+    return ret < 0 ? -1 : ret;
+}
+
+static int tls_destroy(esp_transport_handle_t t)
+{
+    tls_close(t);
+    free(esp_transport_get_context_data(t));
+    return 0;
+}
+
+bool tls_transport_wanted(const char *uri)
+{
+    return strncmp(uri, "mqtts://", 8) == 0;
+}
+
+esp_transport_handle_t tls_transport_init(void)
+{
+    tls_ctx_t *ctx = calloc(1, sizeof(tls_ctx_t));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    esp_transport_handle_t t = esp_transport_init();
+    if (t == NULL) {
+        free(ctx);
+        return NULL;
+    }
+
+    esp_transport_set_context_data(t, ctx);
+    esp_transport_set_func(t, tls_connect, tls_read, tls_write, tls_close, tls_poll_read, tls_poll_write, tls_destroy);
+    esp_transport_set_default_port(t, MQTTS_DEFAULT_PORT);
+
+#if !CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    ESP_LOGW(TAG, "[TLS] CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS is off, every connect is a full handshake");
+#endif
+    return t;
+}
+
+int tls_transport_format_status(char *buf, size_t size)
+{
+    handshake_stats_t snapshot[KIND_COUNT];
+    uint32_t failed;
+
+    portENTER_CRITICAL(&stats_lock);
+    memcpy(snapshot, handshakes, sizeof(snapshot));
+    failed = failures;
+    portEXIT_CRITICAL(&stats_lock);
+
+    int len = snprintf(buf, size, "{");
+    for (int i = 0; i < KIND_COUNT && len < (int)size; i++) {
+        const handshake_stats_t *h = &snapshot[i];
+        len += snprintf(buf + len, size - len, "\"%s\":{\"count\":%lu,\"last_ms\":%ld,\"mean_ms\":%ld},",
+                        KIND_NAMES[i], (unsigned long)h->count, h->count ? (long)h->last_ms : -1L,
+                        h->count ? (long)(h->total_ms / h->count) : -1L);
+    }
+    if (len < (int)size) {
+        len += snprintf(buf + len, size - len, "\"failures\":%lu}", (unsigned long)failed);
+    }
+    return len;
+}
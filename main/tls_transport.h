@@ -0,0 +1,42 @@
+/*
+ * Greenhouse Devices - MQTT TLS Transport
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * mqtts:// transport for the MQTT client that keeps the TLS session of each
+ * broker (ticket or session ID) and offers it on the next connect, so a
+ * reconnect after a Wi-Fi drop or light sleep skips the full handshake.
+ */
+
+#ifndef TLS_TRANSPORT_H
+#define TLS_TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_transport.h"
+
+/**
+ * True if the URI needs this transport (mqtts://)
+ */
+bool tls_transport_wanted(const char *uri);
+
+/**
+ * Create the transport; owned by the MQTT client once passed in its config
+ *
+ * The broker certificate is checked against certs/ca.crt when it was
+ * present at build time, else against the public CA bundle.
+ */
+esp_transport_handle_t tls_transport_init(void);
+
+/**
+ * Status as a JSON object: for full handshakes ("full") and resumed sessions
+ * ("resume"), the count and the last and mean connect time in ms (DNS, TCP
+ * and TLS), plus failed connects. A session the broker turns down counts as
+ * "full"; resumption is told apart by the session ID the broker returns, which
+ * only works on TLS 1.2.
+ *
+ * @return Length written (snprintf semantics)
+ */
+int tls_transport_format_status(char *buf, size_t size);
+
+#endif // TLS_TRANSPORT_H
@@ -0,0 +1,515 @@
+/*
+ * Greenhouse Devices - MQTT-SN Gateway
+ * Copyright 2025 jamesooo
+ * Dual Licensed under MIT and Apache 2.0
+ *
+ * Transparent MQTT-SN (UDP) to MQTT gateway for devices built with
+ * CONFIG_MQTT_TRANSPORT_SN. Every PUBLISH is republished on the broker under
+ * its MQTT topic, so Telegraf and the other consumers see no difference.
+ * Publish only: CONNECT, REGISTER, PUBLISH (QoS -1/0/1), PINGREQ and
+ * DISCONNECT. QoS 1 is acked to the device once the broker has acked it.
+ *
+ *   cc -O2 -I../main -o mqttsn_gateway mqttsn_gateway.c -lmosquitto -lpthread
+ *
+ * Configuration (environment):
+ *     MQTT_BROKER, MQTT_PORT          Broker to republish on
+ *     MQTT_USERNAME, MQTT_PASSWORD    Optional broker credentials
+ *     MQTTSN_PORT                     UDP port to listen on (default 1884)
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <mosquitto.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mqttsn_topics.h"
+
+#define MAX_CLIENTS         64
+#define MAX_TOPICS          32
+#define MAX_TOPIC_NAME      96
+#define MAX_PENDING         64
+#define EARLY_ACKS          8
+#define MAX_PACKET          1500
+#define STATS_INTERVAL_S    60
+
+typedef struct {
+    char name[MAX_TOPIC_NAME];
+    uint16_t id;
+} topic_t;
+
+typedef struct {
+    bool in_use;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    char client_id[24];
+    uint16_t keepalive_s;
+    time_t last_seen;
+    topic_t topics[MAX_TOPICS];
+    int topic_count;
+    uint16_t next_topic_id;
+} client_t;
+
+// QoS 1 publish waiting for the broker's ack before the device gets its PUBACK
+typedef struct {
+    bool in_use;
+    int mid;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    uint16_t topic_id;
+    uint16_t msg_id;
+} pending_t;
+
+static const struct {
+    uint16_t id;
+    const char *name;
+} predefined[] = {
+#define PREDEFINED_ENTRY(id, name) { id, name },
+    MQTTSN_PREDEFINED_TOPICS(PREDEFINED_ENTRY)
+#undef PREDEFINED_ENTRY
+};
+
+static int sock = -1;
+static struct mosquitto *mosq = NULL;
+static volatile sig_atomic_t running = 1;
+static client_t clients[MAX_CLIENTS];
+
+// Shared with the mosquitto loop thread
+static pending_t pending[MAX_PENDING];
+static int early_acks[EARLY_ACKS];
+static int early_next = 0;
+static pthread_mutex_t pending_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct {
+    unsigned long rx;
+    unsigned long tx;
+    unsigned long forwarded;
+    unsigned long dropped;
+} stats;
+
+static void log_msg(const char *fmt, ...)
+{
+    char when[32];
+    time_t now = time(NULL);
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", gmtime(&now));
+
+    va_list args;
+    va_start(args, fmt);
+    printf("%s ", when);
+    vprintf(fmt, args);
+    printf("\n");
+    fflush(stdout);
+    va_end(args);
+}
+
+static const char *env_or(const char *name, const char *fallback)
+{
+    const char *value = getenv(name);
+    return value != NULL && value[0] != '\0' ? value : fallback;
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void send_to(const struct sockaddr_storage *addr, socklen_t addr_len, uint8_t type,
+                    const uint8_t *body, int body_len)
+{
+    uint8_t buf[16];
+    if (body_len + 2 > (int)sizeof(buf)) {
+        return;
+    }
+    buf[0] = (uint8_t)(body_len + 2);
+    buf[1] = type;
+    if (body_len > 0) {
+        memcpy(buf + 2, body, body_len);
+    }
+    if (sendto(sock, buf, body_len + 2, 0, (const struct sockaddr *)addr, addr_len) == body_len + 2) {
+        stats.tx++;
+    }
+}
+
+static void send_ack(const struct sockaddr_storage *addr, socklen_t addr_len, uint8_t type,
+                     uint16_t topic_id, uint16_t msg_id, uint8_t rc)
+{
+    uint8_t body[5];
+    put_u16(body, topic_id);
+    put_u16(body + 2, msg_id);
+    body[4] = rc;
+    send_to(addr, addr_len, type, body, sizeof(body));
+}
+
+static client_t *find_client(const struct sockaddr_storage *addr, socklen_t addr_len)
+{
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].in_use && clients[i].addr_len == addr_len &&
+            memcmp(&clients[i].addr, addr, addr_len) == 0) {
+            return &clients[i];
+        }
+    }
+    return NULL;
+}
+
+static const char *predefined_name(uint16_t id)
+{
+    for (size_t i = 0; i < sizeof(predefined) / sizeof(predefined[0]); i++) {
+        if (predefined[i].id == id) {
+            return predefined[i].name;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Broker acked a QoS 1 publish (mosquitto loop thread)
+ */
+static void on_publish(struct mosquitto *m, void *obj, int mid)
+{
+    pthread_mutex_lock(&pending_lock);
+    bool found = false;
+    for (int i = 0; i < MAX_PENDING; i++) {
+        if (pending[i].in_use && pending[i].mid == mid) {
+            send_ack(&pending[i].addr, pending[i].addr_len, MQTTSN_PUBACK,
+                     pending[i].topic_id, pending[i].msg_id, MQTTSN_RC_ACCEPTED);
+            pending[i].in_use = false;
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        // Acked before handle_publish() recorded it
+        early_acks[early_next] = mid;
+        early_next = (early_next + 1) % EARLY_ACKS;
+    }
+    pthread_mutex_unlock(&pending_lock);
+}
+
+static void on_connect(struct mosquitto *m, void *obj, int rc)
+{
+    log_msg("Broker connection %s (%d)", rc == 0 ? "up" : "refused", rc);
+}
+
+static void on_disconnect(struct mosquitto *m, void *obj, int rc)
+{
+    log_msg("Broker connection lost (%d), reconnecting", rc);
+}
+
+static void handle_connect(const struct sockaddr_storage *addr, socklen_t addr_len,
+                           const uint8_t *body, int body_len)
+{
+    uint8_t rc = MQTTSN_RC_ACCEPTED;
+    if (body_len < 4 || body[1] != MQTTSN_PROTOCOL_ID) {
+        rc = MQTTSN_RC_NOT_SUPPORTED;
+    }
+
+    client_t *c = find_client(addr, addr_len);
+    for (int i = 0; c == NULL && i < MAX_CLIENTS; i++) {
+        if (!clients[i].in_use) {
+            c = &clients[i];
+        }
+    }
+    if (c == NULL) {
+        rc = MQTTSN_RC_CONGESTION;
+    }
+
+    if (rc == MQTTSN_RC_ACCEPTED) {
+        memset(c, 0, sizeof(*c));
+        c->in_use = true;
+        memcpy(&c->addr, addr, addr_len);
+        c->addr_len = addr_len;
+        c->keepalive_s = get_u16(body + 2);
+        c->last_seen = time(NULL);
+        c->next_topic_id = MQTTSN_FIRST_REGISTERED_ID;
+        int id_len = body_len - 4 < (int)sizeof(c->client_id) - 1 ? body_len - 4 : (int)sizeof(c->client_id) - 1;
+        memcpy(c->client_id, body + 4, id_len);
+        log_msg("CONNECT %s (keepalive %u s)", c->client_id, c->keepalive_s);
+    }
+    send_to(addr, addr_len, MQTTSN_CONNACK, &rc, 1);
+}
+
+static void handle_register(client_t *c, const uint8_t *body, int body_len)
+{
+    if (body_len < 5 || body_len - 4 >= MAX_TOPIC_NAME) {
+        return;
+    }
+    uint16_t msg_id = get_u16(body + 2);
+    char name[MAX_TOPIC_NAME];
+    memcpy(name, body + 4, body_len - 4);
+    name[body_len - 4] = '\0';
+
+    for (int i = 0; i < c->topic_count; i++) {
+        if (strcmp(c->topics[i].name, name) == 0) {
+            send_ack(&c->addr, c->addr_len, MQTTSN_REGACK, c->topics[i].id, msg_id, MQTTSN_RC_ACCEPTED);
+            return;
+        }
+    }
+    if (c->topic_count == MAX_TOPICS) {
+        send_ack(&c->addr, c->addr_len, MQTTSN_REGACK, 0, msg_id, MQTTSN_RC_CONGESTION);
+        return;
+    }
+
+    topic_t *t = &c->topics[c->topic_count++];
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    t->id = c->next_topic_id++;
+    send_ack(&c->addr, c->addr_len, MQTTSN_REGACK, t->id, msg_id, MQTTSN_RC_ACCEPTED);
+}
+
+static void handle_publish(client_t *c, const struct sockaddr_storage *addr, socklen_t addr_len,
+                           const uint8_t *body, int body_len)
+{
+    if (body_len < 5) {
+        return;
+    }
+    uint8_t flags = body[0];
+    uint16_t topic_id = get_u16(body + 1);
+    uint16_t msg_id = get_u16(body + 3);
+    uint8_t qos_bits = flags & MQTTSN_FLAG_QOS_MASK;
+    int qos = qos_bits == MQTTSN_FLAG_QOS_M1 ? -1 : qos_bits == MQTTSN_FLAG_QOS_1 ? 1 : 0;
+
+    if (qos >= 0 && c == NULL) {
+        // Session lost on our side; make the device connect again
+        send_to(addr, addr_len, MQTTSN_DISCONNECT, NULL, 0);
+        stats.dropped++;
+        return;
+    }
+
+    char short_name[3];
+    const char *topic = NULL;
+    switch (flags & MQTTSN_TOPIC_TYPE_MASK) {
+    case MQTTSN_TOPIC_PREDEFINED:
+        topic = predefined_name(topic_id);
+        break;
+    case MQTTSN_TOPIC_SHORT:
+        short_name[0] = (char)body[1];
+        short_name[1] = (char)body[2];
+        short_name[2] = '\0';
+        topic = short_name;
+        break;
+    default:
+        for (int i = 0; c != NULL && i < c->topic_count; i++) {
+            if (c->topics[i].id == topic_id) {
+                topic = c->topics[i].name;
+            }
+        }
+        break;
+    }
+
+    if (topic == NULL) {
+        if (qos == 1) {
+            send_ack(addr, addr_len, MQTTSN_PUBACK, topic_id, msg_id, MQTTSN_RC_INVALID_TOPIC);
+        }
+        stats.dropped++;
+        return;
+    }
+
+    int mid = 0;
+    int rc = mosquitto_publish(mosq, &mid, topic, body_len - 5, body + 5, qos == 1 ? 1 : 0,
+                               (flags & MQTTSN_FLAG_RETAIN) != 0);
+    if (rc != MOSQ_ERR_SUCCESS) {
+        // Broker down: the device retries QoS 1, the rest is lost
+        if (qos == 1) {
+            send_ack(addr, addr_len, MQTTSN_PUBACK, topic_id, msg_id, MQTTSN_RC_CONGESTION);
+        }
+        stats.dropped++;
+        return;
+    }
+    stats.forwarded++;
+
+    if (qos != 1) {
+        return;
+    }
+    pthread_mutex_lock(&pending_lock);
+    bool acked = false;
+    for (int i = 0; i < EARLY_ACKS; i++) {
+        if (early_acks[i] == mid) {
+            early_acks[i] = 0;
+            acked = true;
+        }
+    }
+    int slot = -1;
+    for (int i = 0; !acked && i < MAX_PENDING && slot < 0; i++) {
+        if (!pending[i].in_use) {
+            slot = i;
+        }
+    }
+    if (acked || slot < 0) {
+        // Already acked by the broker, or too many in flight to wait for it
+        send_ack(addr, addr_len, MQTTSN_PUBACK, topic_id, msg_id, MQTTSN_RC_ACCEPTED);
+    } else {
+        pending_t *p = &pending[slot];
+        p->in_use = true;
+        p->mid = mid;
+        memcpy(&p->addr, addr, addr_len);
+        p->addr_len = addr_len;
+        p->topic_id = topic_id;
+        p->msg_id = msg_id;
+    }
+    pthread_mutex_unlock(&pending_lock);
+}
+
+static void handle_packet(const struct sockaddr_storage *addr, socklen_t addr_len, const uint8_t *buf, int len)
+{
+    int hdr;
+    int total;
+    if (len >= 2 && buf[0] != 0x01) {
+        total = buf[0];
+        hdr = 2;
+    } else if (len >= 4 && buf[0] == 0x01) {
+        total = get_u16(buf + 1);
+        hdr = 4;
+    } else {
+        return;
+    }
+    if (total != len) {
+        return;
+    }
+    uint8_t type = buf[hdr - 1];
+    const uint8_t *body = buf + hdr;
+    int body_len = len - hdr;
+
+    client_t *c = find_client(addr, addr_len);
+    if (c != NULL) {
+        c->last_seen = time(NULL);
+    }
+
+    switch (type) {
+    case MQTTSN_CONNECT:
+        handle_connect(addr, addr_len, body, body_len);
+        break;
+
+    case MQTTSN_REGISTER:
+        if (c == NULL) {
+            send_to(addr, addr_len, MQTTSN_DISCONNECT, NULL, 0);
+        } else {
+            handle_register(c, body, body_len);
+        }
+        break;
+
+    case MQTTSN_PUBLISH:
+        handle_publish(c, addr, addr_len, body, body_len);
+        break;
+
+    case MQTTSN_PINGREQ:
+        send_to(addr, addr_len, c != NULL ? MQTTSN_PINGRESP : MQTTSN_DISCONNECT, NULL, 0);
+        break;
+
+    case MQTTSN_DISCONNECT:
+        if (c != NULL) {
+            log_msg("DISCONNECT %s", c->client_id);
+            c->in_use = false;
+        }
+        send_to(addr, addr_len, MQTTSN_DISCONNECT, NULL, 0);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*
+ * Forget clients silent for 1.5 keepalive periods
+ */
+static void expire_clients(time_t now)
+{
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        client_t *c = &clients[i];
+        if (c->in_use && c->keepalive_s > 0 && now - c->last_seen > c->keepalive_s * 3 / 2) {
+            log_msg("Keepalive expired for %s", c->client_id);
+            c->in_use = false;
+        }
+    }
+}
+
+static void on_signal(int sig)
+{
+    running = 0;
+}
+
+int main(void)
+{
+    const char *broker = env_or("MQTT_BROKER", "localhost");
+    int broker_port = atoi(env_or("MQTT_PORT", "1883"));
+    int listen_port = atoi(env_or("MQTTSN_PORT", "1884"));
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    mosquitto_lib_init();
+    mosq = mosquitto_new("mqttsn_gateway", true, NULL);
+    if (mosq == NULL) {
+        fprintf(stderr, "mosquitto_new failed\n");
+        return 1;
+    }
+    const char *username = getenv("MQTT_USERNAME");
+    if (username != NULL && username[0] != '\0') {
+        mosquitto_username_pw_set(mosq, username, getenv("MQTT_PASSWORD"));
+    }
+    mosquitto_connect_callback_set(mosq, on_connect);
+    mosquitto_disconnect_callback_set(mosq, on_disconnect);
+    mosquitto_publish_callback_set(mosq, on_publish);
+    mosquitto_reconnect_delay_set(mosq, 1, 30, true);
+    // Retried by the loop thread if the broker is not up yet
+    if (mosquitto_connect_async(mosq, broker, broker_port, 60) != MOSQ_ERR_SUCCESS) {
+        log_msg("Broker %s:%d not reachable yet", broker, broker_port);
+    }
+    if (mosquitto_loop_start(mosq) != MOSQ_ERR_SUCCESS) {
+        fprintf(stderr, "mosquitto_loop_start failed\n");
+        return 1;
+    }
+
+    sock = socket(AF_INET6, SOCK_DGRAM, 0);
+    int off = 0;
+    setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    struct sockaddr_in6 bind_addr = { .sin6_family = AF_INET6, .sin6_addr = in6addr_any,
+                                      .sin6_port = htons(listen_port) };
+    if (sock < 0 || bind(sock, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) != 0) {
+        fprintf(stderr, "Cannot bind UDP port %d: %s\n", listen_port, strerror(errno));
+        return 1;
+    }
+    struct timeval timeout = { .tv_sec = 1 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    log_msg("MQTT-SN on udp/%d -> mqtt://%s:%d", listen_port, broker, broker_port);
+
+    uint8_t buf[MAX_PACKET];
+    time_t stats_at = time(NULL);
+    while (running) {
+        struct sockaddr_storage addr;
+        socklen_t addr_len = sizeof(addr);
+        int n = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *)&addr, &addr_len);
+        if (n > 0) {
+            stats.rx++;
+            handle_packet(&addr, addr_len, buf, n);
+        }
+
+        time_t now = time(NULL);
+        expire_clients(now);
+        if (now - stats_at >= STATS_INTERVAL_S) {
+            log_msg("rx %lu tx %lu forwarded %lu dropped %lu", stats.rx, stats.tx, stats.forwarded, stats.dropped);
+            stats_at = now;
+        }
+    }
+
+    close(sock);
+    mosquitto_disconnect(mosq);
+    mosquitto_loop_stop(mosq, false);
+    mosquitto_destroy(mosq);
+    mosquitto_lib_cleanup();
+    return 0;
+}
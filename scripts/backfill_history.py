@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""
+Backfill the database from a climate monitor's on-device history.
+
+After a backend outage, asks the node for its 1-minute aggregates over the
+"history" RPC method (greenhouse/rpc/{device_id}, MQTT5 request/response),
+follows "next" until the range is covered, and upserts the rows into
+greenhouse.climate_history (see init-db.sql).
+
+  python backfill_history.py --device climate-01 --since "2025-01-01T08:00:00Z"
+
+Defaults come from the same environment as the stack (.env):
+    MQTT_BROKER / MQTT_PORT, MQTT_USERNAME / MQTT_PASSWORD
+    POSTGRES_HOST / POSTGRES_PORT, POSTGRES_USER / POSTGRES_PASSWORD / POSTGRES_DB
+
+Use --dry-run to print CSV instead of writing to the database.
+"""
+
+import argparse
+import csv
+import json
+import os
+import queue
+import sys
+import time
+import uuid
+from datetime import datetime, timezone
+
+import paho.mqtt.client as mqtt
+from paho.mqtt.packettypes import PacketTypes
+from paho.mqtt.properties import Properties
+
+COLUMNS = ("temperature", "temperature_min", "temperature_max", "humidity",
+           "pressure", "vpd", "iaq", "soil_moisture", "samples")
+
+
+def parse_time(value: str) -> int:
+    if value.isdigit():
+        return int(value)
+    return int(datetime.fromisoformat(value.replace("Z", "+00:00")).timestamp())
+
+
+class RpcClient:
+    """Minimal MQTT5 request/response client for greenhouse/rpc/{device_id}."""
+
+    def __init__(self, host: str, port: int, username: str, password: str):
+        self.responses = queue.Queue()
+        self.response_topic = f"greenhouse/rpc/backfill-{uuid.uuid4().hex[:8]}/response"
+        self.client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, protocol=mqtt.MQTTv5)
+        if username:
+            self.client.username_pw_set(username, password)
+        self.client.on_message = lambda c, u, msg: self.responses.put(msg)
+        self.client.connect(host, port)
+        self.client.subscribe(self.response_topic, qos=0)
+        self.client.loop_start()
+
+    def call(self, device_id: str, method: str, params: dict, timeout_s: float = 10.0) -> dict:
+        correlation = uuid.uuid4().bytes[:8]
+        props = Properties(PacketTypes.PUBLISH)
+        props.ResponseTopic = self.response_topic
+        props.CorrelationData = correlation
+        request = {"method": method, "params": params, "timeout_ms": 2000}
+        self.client.publish(f"greenhouse/rpc/{device_id}", json.dumps(request), qos=0, properties=props)
+
+        deadline = time.monotonic() + timeout_s
+        while True:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                raise TimeoutError(f"no reply from {device_id} to {method}")
+            try:
+                msg = self.responses.get(timeout=remaining)
+            except queue.Empty:
+                continue
+            if getattr(msg.properties, "CorrelationData", None) != correlation:
+                continue
+            reply = json.loads(msg.payload)
+            if "error" in reply:
+                raise RuntimeError(f"{device_id} {method}: {reply['error']}")
+            return reply["result"]
+
+    def close(self):
+        self.client.loop_stop()
+        self.client.disconnect()
+
+
+def fetch(rpc: RpcClient, device_id: str, since: int, until: int, step_min: int):
+    """Yield (epoch_s, step_s, {column: value}) until the range is covered."""
+    start = since
+    while start < until:
+        result = rpc.call(device_id, "history", {"from": start, "to": until, "step_min": step_min})
+        columns = result["columns"]
+        for row in result["rows"]:
+            values = dict(zip(columns, row))
+            yield result["from"] + values.pop("minute") * 60, result["step_s"], values
+        if "next" not in result:
+            break
+        start = int(result["next"])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--device", required=True, help="device_id of the climate monitor")
+    parser.add_argument("--since", required=True, help="start, Unix seconds or ISO 8601")
+    parser.add_argument("--until", help="end, Unix seconds or ISO 8601 (default: now)")
+    parser.add_argument("--step-min", type=int, default=1, help="bucket size in minutes (default 1)")
+    parser.add_argument("--broker", default=os.getenv("MQTT_BROKER", "localhost"))
+    parser.add_argument("--port", type=int, default=int(os.getenv("MQTT_PORT", "1883")))
+    parser.add_argument("--dry-run", action="store_true", help="print CSV instead of writing")
+    args = parser.parse_args()
+
+    since = parse_time(args.since)
+    until = parse_time(args.until) if args.until else int(time.time())
+
+    rpc = RpcClient(args.broker, args.port, os.getenv("MQTT_USERNAME", ""), os.getenv("MQTT_PASSWORD", ""))
+    try:
+        rows = [
+            {"time": datetime.fromtimestamp(t, timezone.utc), "device_id": args.device, "step_s": step, **values}
+            for t, step, values in fetch(rpc, args.device, since, until, args.step_min)
+        ]
+    finally:
+        rpc.close()
+
+    if args.dry_run:
+        writer = csv.DictWriter(sys.stdout, fieldnames=["time", "device_id", "step_s", *COLUMNS])
+        writer.writeheader()
+        writer.writerows(rows)
+        return
+
+    from sqlalchemy import create_engine, text
+
+    engine = create_engine(
+        f"postgresql://{os.getenv('POSTGRES_USER', 'postgres')}:{os.getenv('POSTGRES_PASSWORD', 'postgres')}"
+        f"@{os.getenv('POSTGRES_HOST', 'localhost')}:{os.getenv('POSTGRES_PORT', '5432')}"
+        f"/{os.getenv('POSTGRES_DB', 'greenhouse')}"
+    )
+    columns = ["time", "device_id", "step_s", *COLUMNS]
+    statement = text(
+        f"INSERT INTO greenhouse.climate_history ({', '.join(columns)}) "
+        f"VALUES ({', '.join(':' + c for c in columns)}) "
+        f"ON CONFLICT (device_id, time) DO UPDATE SET "
+        + ", ".join(f"{c} = EXCLUDED.{c}" for c in columns[2:])
+    )
+    with engine.begin() as conn:
+        if rows:
+            conn.execute(statement, rows)
+    print(f"Backfilled {len(rows)} rows for {args.device}", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""
+Compare packets and radio-on time per sample for TCP + MQTT and MQTT-SN.
+
+Plays a duty-cycled sensor against the running stack: each wake connects,
+publishes one climate reading and disconnects, the way a node that sleeps
+between samples has to. Paths compared:
+
+  - TCP + MQTT 3.1.1 at QoS 0 and 1 (mosquitto, port 1883)
+  - MQTT-SN QoS -1: one PUBLISH datagram on a predefined topic, no session
+  - MQTT-SN QoS 0 and 1: CONNECT, PUBLISH (predefined topic), DISCONNECT
+    (mqttsn_gateway, port 1884)
+
+Packets are what the node sends and receives: exact for UDP, and for TCP read
+from TCP_INFO (segs_out/segs_in) after the close handshake, so SYNs, FINs
+and bare ACKs are included. Radio-on time is modelled from the exchange
+rather than timed on loopback: every round trip the node has to wait for
+costs --rtt-ms, and every packet --packet-ms of airtime. The measured
+loopback time is reported too, as a check that each path completed.
+
+Usage: python benchmark_mqttsn.py [--host HOST] [--wakes N] [--rtt-ms MS]
+"""
+
+import argparse
+import re
+import socket
+import struct
+import time
+from pathlib import Path
+
+REPO_ROOT = Path(__file__).resolve().parent.parent
+TOPICS_HEADER = REPO_ROOT / "main" / "mqttsn_topics.h"
+
+# Predefined for the benchmark, outside sensor/# so the readings stay out of InfluxDB
+TOPIC = "bench/mqttsn"
+PAYLOAD = (b'{"device":"bench","temperature":23.41,"humidity":61.2,'
+           b'"pressure":101325,"vpd":1.12,"dew_point":15.4}')
+
+# struct tcp_info offsets of tcpi_segs_out / tcpi_segs_in (Linux >= 4.2)
+TCP_INFO_SEGS_OFFSET = 136
+
+# MQTT-SN message types and flags (main/mqttsn_topics.h)
+SN_CONNECT, SN_CONNACK = 0x04, 0x05
+SN_PUBLISH, SN_PUBACK = 0x0C, 0x0D
+SN_DISCONNECT = 0x18
+SN_QOS_FLAGS = {-1: 0x60, 0: 0x00, 1: 0x20}
+SN_CLEAN, SN_PREDEFINED = 0x04, 0x01
+
+
+def predefined_topic_id(topic: str) -> int:
+    # Same table the firmware and the gateway are built with
+    for topic_id, name in re.findall(r'X\((\d+),\s*"([^"]+)"\)', TOPICS_HEADER.read_text()):
+        if name == topic:
+            return int(topic_id)
+    raise SystemExit(f"{topic} is not a predefined MQTT-SN topic in {TOPICS_HEADER}")
+
+
+class Result:
+    def __init__(self):
+        self.sent = 0
+        self.received = 0
+        self.round_trips = 0
+        self.elapsed = 0.0
+
+
+# ---------------------------------------------------------------------------
+# TCP + MQTT 3.1.1
+# ---------------------------------------------------------------------------
+
+def mqtt_packet(packet_type: int, body: bytes) -> bytes:
+    length = len(body)
+    encoded = bytearray()
+    while True:
+        byte = length % 128
+        length //= 128
+        encoded.append(byte | 0x80 if length else byte)
+        if not length:
+            break
+    return bytes([packet_type]) + bytes(encoded) + body
+
+
+def mqtt_string(value: bytes) -> bytes:
+    return struct.pack("!H", len(value)) + value
+
+
+def recv_exact(sock: socket.socket, size: int) -> bytes:
+    data = b""
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            raise ConnectionError("broker closed the connection")
+        data += chunk
+    return data
+
+
+def tcp_wake(host: str, port: int, qos: int, client_id: str) -> Result:
+    result = Result()
+    start = time.perf_counter()
+    sock = socket.create_connection((host, port), timeout=5)
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    result.round_trips += 1  # SYN / SYN-ACK
+
+    connect = (mqtt_string(b"MQTT") + bytes([4, 0x02]) + struct.pack("!H", 60)
+               + mqtt_string(client_id.encode()))
+    sock.sendall(mqtt_packet(0x10, connect))
+    if recv_exact(sock, 4)[3] != 0:
+        raise ConnectionError("CONNACK refused")
+    result.round_trips += 1
+
+    body = mqtt_string(TOPIC.encode()) + (struct.pack("!H", 1) if qos else b"") + PAYLOAD
+    sock.sendall(mqtt_packet(0x30 | (qos << 1), body))
+    if qos:
+        recv_exact(sock, 4)
+        result.round_trips += 1
+
+    # DISCONNECT, then wait for the broker's FIN so the close is counted
+    sock.sendall(mqtt_packet(0xE0, b""))
+    sock.shutdown(socket.SHUT_WR)
+    while sock.recv(64):
+        pass
+    result.round_trips += 1
+    result.elapsed = time.perf_counter() - start
+
+    time.sleep(0.01)  # let the final ACK go out
+    info = sock.getsockopt(socket.IPPROTO_TCP, socket.TCP_INFO, 256)
+    result.sent, result.received = struct.unpack_from("=II", info, TCP_INFO_SEGS_OFFSET)
+    sock.close()
+    return result
+
+
+# ---------------------------------------------------------------------------
+# MQTT-SN over UDP
+# ---------------------------------------------------------------------------
+
+def sn_packet(msg_type: int, body: bytes) -> bytes:
+    return bytes([len(body) + 2, msg_type]) + body
+
+
+def sn_expect(sock: socket.socket, result: Result, msg_type: int) -> bytes:
+    while True:
+        data = sock.recv(256)
+        result.received += 1
+        if len(data) >= 2 and data[1] == msg_type:
+            return data
+
+
+def sn_wake(host: str, port: int, qos: int, client_id: str, topic_id: int) -> Result:
+    result = Result()
+    start = time.perf_counter()
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(2)
+    sock.connect((host, port))
+
+    def send(msg_type: int, body: bytes):
+        sock.send(sn_packet(msg_type, body))
+        result.sent += 1
+
+    if qos >= 0:
+        send(SN_CONNECT, bytes([SN_CLEAN, 0x01]) + struct.pack("!H", 60) + client_id.encode())
+        connack = sn_expect(sock, result, SN_CONNACK)
+        if connack[2] != 0:
+            raise ConnectionError(f"CONNACK rc {connack[2]}")
+        result.round_trips += 1
+
+    flags = SN_QOS_FLAGS[qos] | SN_PREDEFINED
+    send(SN_PUBLISH, bytes([flags]) + struct.pack("!HH", topic_id, 1 if qos == 1 else 0) + PAYLOAD)
+    if qos == 1:
+        puback = sn_expect(sock, result, SN_PUBACK)
+        if puback[-1] != 0:
+            raise ConnectionError(f"PUBACK rc {puback[-1]}")
+        result.round_trips += 1
+
+    if qos >= 0:
+        send(SN_DISCONNECT, b"")
+        sn_expect(sock, result, SN_DISCONNECT)
+        result.round_trips += 1
+
+    result.elapsed = time.perf_counter() - start
+    sock.close()
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--host", default="127.0.0.1", help="Host running mosquitto and mqttsn-gateway")
+    parser.add_argument("--mqtt-port", type=int, default=1883)
+    parser.add_argument("--sn-port", type=int, default=1884)
+    parser.add_argument("--wakes", type=int, default=50, help="Wake cycles per path")
+    parser.add_argument("--rtt-ms", type=float, default=8.0,
+                        help="Wi-Fi round trip to the gateway/broker for the radio-on model")
+    parser.add_argument("--packet-ms", type=float, default=0.4,
+                        help="Airtime per packet for the radio-on model")
+    args = parser.parse_args()
+
+    topic_id = predefined_topic_id(TOPIC)
+    paths = [
+        ("TCP + MQTT QoS 0", lambda i: tcp_wake(args.host, args.mqtt_port, 0, f"bench-tcp-{i}")),
+        ("TCP + MQTT QoS 1", lambda i: tcp_wake(args.host, args.mqtt_port, 1, f"bench-tcp-{i}")),
+        ("MQTT-SN QoS -1", lambda i: sn_wake(args.host, args.sn_port, -1, f"bench-sn-{i}", topic_id)),
+        ("MQTT-SN QoS 0", lambda i: sn_wake(args.host, args.sn_port, 0, f"bench-sn-{i}", topic_id)),
+        ("MQTT-SN QoS 1", lambda i: sn_wake(args.host, args.sn_port, 1, f"bench-sn-{i}", topic_id)),
+    ]
+
+    print(f"{args.wakes} wakes per path, {len(PAYLOAD)} byte payload, "
+          f"model: {args.rtt_ms:g} ms per round trip + {args.packet_ms:g} ms per packet\n")
+    print(f"{'Path':<18} {'Sent':>6} {'Recv':>6} {'Total':>6} {'RTTs':>5} {'Radio-on ms':>15} {'Loopback ms':>12}")
+
+    baseline = None
+    for name, wake in paths:
+        try:
+            results = [wake(i) for i in range(args.wakes)]
+        except (OSError, ConnectionError) as e:
+            print(f"{name:<18} failed: {e}")
+            continue
+
+        sent = sum(r.sent for r in results) / len(results)
+        received = sum(r.received for r in results) / len(results)
+        round_trips = sum(r.round_trips for r in results) / len(results)
+        elapsed_ms = sum(r.elapsed for r in results) / len(results) * 1000
+        radio_ms = round_trips * args.rtt_ms + (sent + received) * args.packet_ms
+        if baseline is None:
+            baseline = radio_ms
+        print(f"{name:<18} {sent:6.1f} {received:6.1f} {sent + received:6.1f} {round_trips:5.1f} "
+              f"{radio_ms:8.1f} ({radio_ms / baseline:4.0%}) {elapsed_ms:12.2f}")
+
+
+if __name__ == "__main__":
+    main()
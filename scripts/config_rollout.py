@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""
+Publish a versioned config document and track its rollout.
+
+Publishes a retained document on sensor/config/all, sensor/config/zone/{zone}
+or sensor/config/{device_id} with the next "version" of that topic, then
+watches the acknowledgements nodes publish on greenhouse/state/+/config until
+every targeted node has applied it (or the timeout expires).
+
+  python config_rollout.py --all '{"setpoint": 65}'
+  python config_rollout.py --zone north-bench '{"start_pct": 30, "stop_pct": 45}'
+  python config_rollout.py --device irrigation-03 '{"max_open_s": 240}'
+  python config_rollout.py --all --status
+
+The document replaces the whole layer: a key left out falls back to the
+layer below on every node. Nodes are the ones that have acknowledged config
+before (their state is retained), so a node that never came online is not
+waited for.
+
+Broker settings come from the same environment as the stack (.env):
+    MQTT_BROKER / MQTT_PORT, MQTT_USERNAME / MQTT_PASSWORD
+"""
+
+import argparse
+import json
+import os
+import sys
+import threading
+import time
+
+import paho.mqtt.client as mqtt
+
+STATE_TOPIC = "greenhouse/state/+/config"
+
+
+class Rollout:
+    def __init__(self, host: str, port: int, username: str, password: str, config_topic: str):
+        self.config_topic = config_topic
+        self.current = None
+        self.acks = {}
+        self.lock = threading.Lock()
+
+        self.client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, protocol=mqtt.MQTTv5)
+        if username:
+            self.client.username_pw_set(username, password)
+        self.client.on_message = self.on_message
+        self.client.connect(host, port)
+        self.client.subscribe([(config_topic, 1), (STATE_TOPIC, 1)])
+        self.client.loop_start()
+
+        # Retained messages arrive right after the subscription
+        time.sleep(1.0)
+
+    def on_message(self, client, userdata, msg):
+        try:
+            payload = json.loads(msg.payload) if msg.payload else None
+        except ValueError:
+            return
+        with self.lock:
+            if msg.topic == self.config_topic:
+                self.current = payload
+            elif isinstance(payload, dict):
+                device_id = msg.topic.split("/")[2]
+                self.acks[device_id] = payload
+
+    def current_version(self) -> int:
+        with self.lock:
+            if isinstance(self.current, dict) and isinstance(self.current.get("version"), int):
+                return self.current["version"]
+        return 0
+
+    def publish(self, document: dict):
+        info = self.client.publish(self.config_topic, json.dumps(document), qos=1, retain=True)
+        info.wait_for_publish(timeout=10)
+
+    def close(self):
+        self.client.loop_stop()
+        self.client.disconnect()
+
+
+def applied_version(ack: dict, scope: str, target: str) -> int:
+    """Version of the scope's layer a node reports, -1 if the layer does not apply to it."""
+    if scope == "all":
+        return ack.get("fleet", 0)
+    if scope == "zone":
+        return ack.get("zone_version", 0) if ack.get("zone") == target else -1
+    return ack.get("device", 0)
+
+
+def report(rollout: Rollout, scope: str, target: str, version: int) -> tuple:
+    with rollout.lock:
+        acks = dict(rollout.acks)
+    done, pending = [], []
+    for device_id, ack in sorted(acks.items()):
+        if scope == "device" and device_id != target:
+            continue
+        applied = applied_version(ack, scope, target)
+        if applied < 0:
+            continue
+        (done if applied >= version else pending).append((device_id, applied, ack.get("rejected", 0)))
+    return done, pending
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    scope = parser.add_mutually_exclusive_group(required=True)
+    scope.add_argument("--all", action="store_true", help="every node (sensor/config/all)")
+    scope.add_argument("--zone", help="nodes in a zone (sensor/config/zone/ZONE)")
+    scope.add_argument("--device", help="one node (sensor/config/DEVICE)")
+    parser.add_argument("document", nargs="?", help="JSON object to publish (replaces the layer)")
+    parser.add_argument("--version", type=int, help="version to publish (default: current + 1)")
+    parser.add_argument("--status", action="store_true", help="only report the current rollout")
+    parser.add_argument("--timeout", type=float, default=120, help="seconds to wait for acks (default 120)")
+    parser.add_argument("--broker", default=os.getenv("MQTT_BROKER", "localhost"))
+    parser.add_argument("--port", type=int, default=int(os.getenv("MQTT_PORT", "1883")))
+    args = parser.parse_args()
+
+    if args.all:
+        scope_name, target, topic = "all", "", "sensor/config/all"
+    elif args.zone:
+        scope_name, target, topic = "zone", args.zone, f"sensor/config/zone/{args.zone}"
+    else:
+        scope_name, target, topic = "device", args.device, f"sensor/config/{args.device}"
+
+    if not args.status:
+        if args.document is None:
+            parser.error("a document is required unless --status is given")
+        document = json.loads(args.document)
+        if not isinstance(document, dict):
+            parser.error("the document must be a JSON object")
+
+    rollout = Rollout(args.broker, args.port, os.getenv("MQTT_USERNAME", ""), os.getenv("MQTT_PASSWORD", ""),
+                      topic)
+    try:
+        version = rollout.current_version()
+        if not args.status:
+            version = args.version if args.version is not None else version + 1
+            if version <= rollout.current_version():
+                print(f"{topic} is already at v{rollout.current_version()}; nodes skip v{version}",
+                      file=sys.stderr)
+                sys.exit(1)
+            document["version"] = version
+            rollout.publish(document)
+            print(f"Published v{version} on {topic}")
+
+        deadline = time.monotonic() + (0 if args.status else args.timeout)
+        while True:
+            done, pending = report(rollout, scope_name, target, version)
+            if not pending or time.monotonic() >= deadline:
+                break
+            time.sleep(1.0)
+
+        print(f"v{version} on {topic}: {len(done)}/{len(done) + len(pending)} node(s) applied")
+        for device_id, applied, rejected in pending:
+            note = f", {rejected} rejected" if rejected else ""
+            print(f"  {device_id}: at v{applied}{note}")
+        sys.exit(1 if pending else 0)
+    finally:
+        rollout.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""
+Decode climate monitor flight recorder dumps to CSV.
+
+Dumps are published as binary batches on greenhouse/recorder/{device_id}
+(see devices/climate_monitor/flight_recorder.c). Capture them as hex, one
+message per line, and decode:
+
+  mosquitto_sub -h BROKER -t 'greenhouse/recorder/#' -F '%x' > dump.hex
+  python decode_flight_recorder.py dump.hex > dump.csv
+
+Batch layout (little endian): a 38-byte header
+  "FR", version u8, flags u8 (1 = last batch), dump_id u16, batch u16,
+  records u16, trigger_ms u32, trigger_epoch_ms i64, reason char[16]
+followed by `records` records of 7 LEB128 varints, each the delta from the
+previous record in the batch (the first is absolute):
+  time_ms, temperature (zigzag, 0.01 C), humidity (zigzag, 0.01 %RH),
+  pressure (zigzag, Pa above 50 kPa), gas (zigzag, 100 Ohm), channel (zigzag),
+  flags (1 = I2C error, 2 = no gas reading)
+
+Usage: python decode_flight_recorder.py [FILE]   (stdin if omitted)
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+HEADER = struct.Struct("<2sBBHHHIq16s")
+FLAG_ERROR = 0x01
+FLAG_NO_GAS = 0x02
+PRESSURE_OFFSET_PA = 50000
+
+
+def read_varint(buf: bytes, pos: int):
+    value = 0
+    shift = 0
+    while True:
+        byte = buf[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            return value, pos
+        shift += 7
+
+
+def unzigzag(v: int) -> int:
+    return (v >> 1) ^ -(v & 1)
+
+
+def decode_batch(buf: bytes):
+    magic, version, flags, dump_id, batch, count, trigger_ms, trigger_epoch_ms, reason = HEADER.unpack_from(buf)
+    if magic != b"FR" or version != 1:
+        raise ValueError(f"not a version 1 recorder batch (magic {magic!r}, version {version})")
+
+    header = {
+        "dump_id": dump_id,
+        "batch": batch,
+        "last": bool(flags & 1),
+        "trigger_ms": trigger_ms,
+        "trigger_epoch_ms": trigger_epoch_ms,
+        "reason": reason.rstrip(b"\0").decode(errors="replace"),
+    }
+
+    pos = HEADER.size
+    prev = [0] * 7
+    records = []
+    for _ in range(count):
+        fields = []
+        for i in range(7):
+            raw, pos = read_varint(buf, pos)
+            delta = raw if i in (0, 6) else unzigzag(raw)
+            fields.append(delta if i == 6 else prev[i] + delta)
+        fields[0] &= 0xFFFFFFFF
+        prev = fields
+        records.append(fields)
+    return header, records
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("file", nargs="?", type=argparse.FileType("r"), default=sys.stdin,
+                        help="hex dump, one MQTT message per line")
+    args = parser.parse_args()
+
+    writer = csv.writer(sys.stdout)
+    writer.writerow(["dump_id", "reason", "t_rel_s", "epoch_ms", "channel",
+                     "temperature", "humidity", "pressure", "gas_resistance", "error"])
+
+    for line in args.file:
+        line = line.strip()
+        if not line:
+            continue
+        header, records = decode_batch(bytes.fromhex(line))
+        for time_ms, temp, rh, pressure, gas, channel, flags in records:
+            # Offset from the trigger, tolerant of the 32-bit ms wrap
+            rel_ms = (time_ms - header["trigger_ms"] + 2**31) % 2**32 - 2**31
+            epoch_ms = header["trigger_epoch_ms"] + rel_ms if header["trigger_epoch_ms"] else ""
+            error = bool(flags & FLAG_ERROR)
+            writer.writerow([
+                header["dump_id"], header["reason"], f"{rel_ms / 1000:.3f}", epoch_ms, channel,
+                "" if error else f"{temp / 100:.2f}",
+                "" if error else f"{rh / 100:.2f}",
+                "" if error else f"{(pressure + PRESSURE_OFFSET_PA) / 100:.2f}",
+                "" if error or flags & FLAG_NO_GAS else gas * 100,
+                int(error),
+            ])
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,245 @@
+#!/usr/bin/env python3
+"""
+Evaluate the climate monitor's alpha-beta filter against the BME680 oversampling/IIR settings.
+
+Builds devices/climate_monitor/sensor_filter.c as host shared libraries (float
+and fixed-point), replays a recorded trace through a noise model of each
+BME680 configuration, and reports published noise, lag and conversion time
+for the current configuration (OSR 16X + IIR 127) and the low-OSR candidates.
+
+Traces can be:
+  - a CSV with time, temperature, humidity and pressure columns (for example
+    exported from the sensor_data table), resampled to 1 Hz
+  - a serial log from the device ("BME680 Sensor: ..." lines, 1 Hz)
+  - omitted, in which case a synthetic 6 h greenhouse trace is used
+
+The trace is treated as the true signal and sensor noise is added per
+configuration, scaled by 1/sqrt(OSR) from the 1X figures (override with
+--noise-*). A trace recorded with the current settings is already smoothed,
+so it slightly favours configurations with more lag.
+
+Usage: python evaluate_sensor_filter.py [--trace FILE] [--cc gcc]
+"""
+
+import argparse
+import ctypes
+import csv
+import os
+import re
+import subprocess
+import tempfile
+from datetime import datetime
+from pathlib import Path
+
+import numpy as np
+
+REPO_ROOT = Path(__file__).resolve().parent.parent
+SOURCE = REPO_ROOT / "devices" / "climate_monitor" / "sensor_filter.c"
+INCLUDE = REPO_ROOT / "devices" / "climate_monitor"
+FIRMWARE = REPO_ROOT / "devices" / "climate_monitor" / "climate_monitor.c"
+
+CHANNELS = ("temperature", "humidity", "pressure")
+UNITS = {"temperature": "°C", "humidity": "%RH", "pressure": "Pa"}
+# Fixed units fed to sensor_filter_update(), matching climate_monitor.c
+SCALE = {"temperature": 100.0, "humidity": 100.0, "pressure": 1.0}
+
+# Configurations compared: (label, OSR, on-chip IIR size, alpha-beta filter)
+CONFIGS = [
+    ("OSR16 + IIR127 (current)", 16, 127, False),
+    ("OSR16 + IIR15", 16, 15, False),
+    ("OSR2 + IIR3 + filter", 2, 3, True),
+    ("OSR4 + IIR3 + filter", 4, 3, True),
+    ("OSR4 + IIR0 + filter", 4, 0, True),
+]
+
+HEATER_MS = 100  # bme680_set_heater_profile(&sensor, 0, 200, 100)
+SAMPLE_PERIOD_S = 1.0
+
+
+def build_library(cc: str, out_dir: str, fixed_point: bool) -> ctypes.CDLL:
+    # sensor_filter.h includes sdkconfig.h; provide an empty one for the host
+    Path(out_dir, "sdkconfig.h").write_text("")
+    name = "fixed" if fixed_point else "float"
+    lib_path = os.path.join(out_dir, f"libsensor_filter_{name}.so")
+    subprocess.run([cc, "-O2", "-shared", "-fPIC", "-Wall", "-Wextra", "-Werror",
+                    f"-DCONFIG_CLIMATE_SENSOR_FILTER_FIXED_POINT={int(fixed_point)}",
+                    "-I", out_dir, "-I", str(INCLUDE), str(SOURCE), "-lm", "-o", lib_path],
+                   check=True)
+    lib = ctypes.CDLL(lib_path)
+    lib.sensor_filter_init.argtypes = [ctypes.c_void_p, ctypes.c_float]
+    lib.sensor_filter_init.restype = None
+    lib.sensor_filter_update.argtypes = [ctypes.c_void_p, ctypes.c_int32]
+    lib.sensor_filter_update.restype = ctypes.c_int32
+    return lib
+
+
+def firmware_lambdas() -> dict:
+    """Read the tracking indices compiled into the firmware."""
+    text = FIRMWARE.read_text()
+    lambdas = {}
+    for channel in CHANNELS:
+        m = re.search(rf"#define FILTER_LAMBDA_{channel.upper()}\s+([0-9.eE+-]+)f?", text)
+        lambdas[channel] = float(m.group(1)) if m else 0.02
+    return lambdas
+
+
+def run_filter(lib, tracking_index: float, values: np.ndarray, scale: float) -> np.ndarray:
+    state = ctypes.create_string_buffer(64)
+    lib.sensor_filter_init(state, tracking_index)
+    raw = np.rint(values * scale).astype(np.int64)
+    out = np.empty(len(raw))
+    for i, z in enumerate(raw):
+        out[i] = lib.sensor_filter_update(state, int(z))
+    return out / scale
+
+
+def onchip_iir(values: np.ndarray, size: int) -> np.ndarray:
+    """BME680 IIR: y += (x - y) / (size + 1), applied to temperature and pressure only."""
+    if size == 0:
+        return values.copy()
+    out = np.empty_like(values)
+    y = values[0]
+    for i, x in enumerate(values):
+        y += (x - y) / (size + 1)
+        out[i] = y
+    return out
+
+
+def conversion_ms(osr: int) -> float:
+    """TPH conversion time as computed by the BME680 driver, before the heater phase."""
+    cycles = 3 * osr
+    return (cycles * 1963 + 477 * 4 + 477 * 5 + 500) / 1000.0
+
+
+def simulate(truth: np.ndarray, channel: str, osr: int, iir: int, lib, tracking_index,
+             noise_1x: float, rng) -> np.ndarray:
+    measured = truth + rng.normal(0.0, noise_1x / np.sqrt(osr), len(truth))
+    if channel != "humidity":
+        measured = onchip_iir(measured, iir)
+    # The driver reports floats with 0.01 resolution (1 Pa for pressure)
+    measured = np.round(measured * SCALE[channel]) / SCALE[channel]
+    if lib is not None:
+        measured = run_filter(lib, tracking_index, measured, SCALE[channel])
+    return measured
+
+
+def step_metrics(channel, osr, iir, lib, tracking_index, noise_1x, rng, n=600):
+    """Noise on a flat signal, 90 % rise time of a step, and lag behind a ramp (samples)."""
+    level = {"temperature": 22.0, "humidity": 60.0, "pressure": 101325.0}[channel]
+    step = {"temperature": 2.0, "humidity": 10.0, "pressure": 100.0}[channel]
+
+    flat = simulate(np.full(n, level), channel, osr, iir, lib, tracking_index, noise_1x, rng)
+    noise = float(np.std(flat[n // 2:]))
+
+    truth = np.full(n, level)
+    truth[n // 4:] += step
+    clean = simulate(truth, channel, osr, iir, lib, tracking_index, 0.0, rng)
+    after = clean[n // 4:]
+    reached = np.nonzero(after >= level + 0.9 * step)[0]
+    rise = int(reached[0]) if len(reached) else n
+
+    slope = step / 600.0  # a humidifier-scale ramp
+    ramp_truth = level + slope * np.arange(n)
+    ramp = simulate(ramp_truth, channel, osr, iir, lib, tracking_index, 0.0, rng)
+    lag = float(np.mean(ramp_truth[n // 2:] - ramp[n // 2:]) / slope)
+    return noise, rise, lag
+
+
+def load_trace(path: str) -> dict:
+    text = Path(path).read_text(errors="replace")
+    serial = re.findall(r"BME680 Sensor: ([-0-9.]+) °C, ([-0-9.]+) %, ([-0-9.]+) hPa", text)
+    if serial:
+        arr = np.array(serial, dtype=float)
+        return {"temperature": arr[:, 0], "humidity": arr[:, 1], "pressure": arr[:, 2] * 100.0}
+
+    rows = list(csv.DictReader(text.splitlines()))
+    times = []
+    for row in rows:
+        t = row.get("time") or row.get("timestamp")
+        try:
+            times.append(float(t))
+        except ValueError:
+            times.append(datetime.fromisoformat(t.replace("Z", "+00:00")).timestamp())
+    times = np.array(times)
+    order = np.argsort(times)
+    times = times[order]
+    grid = np.arange(times[0], times[-1], SAMPLE_PERIOD_S)
+    trace = {}
+    for channel in CHANNELS:
+        values = np.array([float(r[channel]) for r in rows])[order]
+        if channel == "pressure" and np.median(values) < 2000:
+            values = values * 100.0  # hPa -> Pa
+        trace[channel] = np.interp(grid, times, values)
+    return trace
+
+
+def synthetic_trace(hours: float, rng) -> dict:
+    """Diurnal drift plus humidifier on/off cycles, the dynamics the filters must follow."""
+    t = np.arange(int(hours * 3600)) * SAMPLE_PERIOD_S
+    day = 2 * np.pi * t / 86400.0
+    humidifier = (np.sin(2 * np.pi * t / 1800.0) > 0).astype(float)
+    humidifier = onchip_iir(humidifier, 120)  # room-scale response
+    return {
+        "temperature": 22.0 + 3.0 * np.sin(day) - 0.4 * humidifier,
+        "humidity": 55.0 - 8.0 * np.sin(day) + 12.0 * humidifier,
+        "pressure": 101325.0 + 150.0 * np.sin(day / 2) + np.cumsum(rng.normal(0, 0.05, len(t))),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--trace", help="CSV export or device serial log (default: synthetic)")
+    parser.add_argument("--hours", type=float, default=6.0, help="synthetic trace length")
+    parser.add_argument("--cc", default=os.environ.get("CC", "cc"), help="host C compiler")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--noise-temperature", type=float, default=0.02, help="RMS at OSR 1X (°C)")
+    parser.add_argument("--noise-humidity", type=float, default=0.08, help="RMS at OSR 1X (%%RH)")
+    parser.add_argument("--noise-pressure", type=float, default=2.5, help="RMS at OSR 1X (Pa)")
+    for channel in CHANNELS:
+        parser.add_argument(f"--lambda-{channel}", type=float,
+                            help=f"tracking index for {channel} (default: firmware value)")
+    args = parser.parse_args()
+
+    rng = np.random.default_rng(args.seed)
+    trace = load_trace(args.trace) if args.trace else synthetic_trace(args.hours, rng)
+    noise_1x = {c: getattr(args, f"noise_{c}") for c in CHANNELS}
+    lambdas = firmware_lambdas()
+    for channel in CHANNELS:
+        override = getattr(args, f"lambda_{channel}")
+        if override is not None:
+            lambdas[channel] = override
+
+    source = args.trace or f"synthetic, {args.hours:g} h"
+    print(f"Trace: {source} ({len(trace['temperature'])} samples at 1 Hz)")
+    print("Tracking index: " + ", ".join(f"{c} {lambdas[c]:g}" for c in CHANNELS))
+
+    with tempfile.TemporaryDirectory() as tmp:
+        libs = {"float": build_library(args.cc, tmp, False),
+                "fixed": build_library(args.cc, tmp, True)}
+
+        for channel in CHANNELS:
+            unit = UNITS[channel]
+            print(f"\n{channel.capitalize()}")
+            print(f"  {'configuration':<30} {'TPH ms':>7} {'noise':>10} {'rms err':>10} "
+                  f"{'rise90 s':>9} {'ramp lag s':>11}")
+            for label, osr, iir, use_filter in CONFIGS:
+                variants = [("float", libs["float"]), ("fixed", libs["fixed"])] if use_filter else [("", None)]
+                for variant, lib in variants:
+                    name = f"{label} [{variant}]" if variant else label
+                    noise, rise, lag = step_metrics(channel, osr, iir, lib, lambdas[channel],
+                                                    noise_1x[channel], rng)
+                    out = simulate(trace[channel], channel, osr, iir, lib, lambdas[channel],
+                                   noise_1x[channel], rng)
+                    err = out - trace[channel]
+                    warm = min(600, len(err) // 10)  # exclude filter settling at the start
+                    rms = float(np.sqrt(np.mean(err[warm:] ** 2)))
+                    print(f"  {name:<30} {conversion_ms(osr):>7.1f} {noise:>7.3f} {unit:<3}"
+                          f"{rms:>7.3f} {unit:<3}{rise:>8d} {lag:>11.1f}")
+
+    print(f"\nTPH ms excludes the {HEATER_MS} ms gas heater phase, which is the same for every configuration.")
+    print("noise: std on a flat signal; rms err: against the trace; rise90: 90 % of a step;")
+    print("ramp lag: steady-state delay behind a linear ramp (0 for the alpha-beta filter).")
+
+
+if __name__ == "__main__":
+    main()
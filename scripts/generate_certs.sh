@@ -0,0 +1,52 @@
+#!/bin/bash
+#
+# Broker TLS Certificate Script
+#
+# Creates a private CA and a broker certificate in certs/ for the mosquitto
+# TLS listener (see mosquitto.conf). The firmware embeds certs/ca.crt at
+# build time and checks the broker against it; without it, mqtts:// brokers
+# are checked against the public CA bundle.
+#
+# Usage: ./generate_certs.sh <broker_host_or_ip> [days]
+#
+
+set -e
+
+BROKER="$1"
+DAYS="${2:-3650}"
+CERT_DIR="$(cd "$(dirname "$0")/.." && pwd)/certs"
+
+if [ -z "$BROKER" ]; then
+    echo "Usage: $0 <broker_host_or_ip> [days]"
+    exit 1
+fi
+
+# Devices verify the name they connect to, so it goes in subjectAltName
+if [[ "$BROKER" =~ ^[0-9.]+$ ]]; then
+    SAN="IP:$BROKER"
+else
+    SAN="DNS:$BROKER"
+fi
+
+mkdir -p "$CERT_DIR"
+cd "$CERT_DIR"
+
+if [ ! -f ca.key ]; then
+    openssl ecparam -name prime256v1 -genkey -noout -out ca.key
+    openssl req -x509 -new -key ca.key -sha256 -days "$DAYS" -subj "/CN=Greenhouse MQTT CA" -out ca.crt
+    echo "Created CA: $CERT_DIR/ca.crt"
+fi
+
+# P-256 keeps the handshake cheap on the ESP32 (hardware MPI)
+openssl ecparam -name prime256v1 -genkey -noout -out server.key
+openssl req -new -key server.key -subj "/CN=$BROKER" -out server.csr
+openssl x509 -req -in server.csr -CA ca.crt -CAkey ca.key -CAcreateserial -sha256 -days "$DAYS" \
+    -extfile <(printf "subjectAltName=%s" "$SAN") -out server.crt
+rm -f server.csr
+
+# mosquitto runs as its own user inside the container
+chmod 644 server.key
+
+echo "Created broker certificate for $BROKER: $CERT_DIR/server.crt"
+echo "Uncomment the 8883 listener in mosquitto.conf, set DEVICE_MQTT_BROKER_URL=mqtts://$BROKER"
+echo "and rebuild the firmware to embed ca.crt."
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+Validate the on-device fixed-point psychrometrics against the reference formulas.
+
+Builds devices/climate_monitor/psychrometrics.c as a host shared library, sweeps
+temperature and relative humidity over the valid range, and compares SVP, VPD,
+dew point and absolute humidity with the floating-point Tetens/Magnus reference
+used by the analysis code.
+
+Usage: python validate_psychrometrics.py [--cc gcc]
+Exits non-zero if any error bound documented in psychrometrics.h is exceeded.
+"""
+
+import argparse
+import ctypes
+import math
+import os
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+REPO_ROOT = Path(__file__).resolve().parent.parent
+SOURCE = REPO_ROOT / "devices" / "climate_monitor" / "psychrometrics.c"
+
+# Bounds from psychrometrics.h
+SVP_REL_BOUND = 0.001
+SVP_ABS_SLACK_PA = 1.0
+DEW_POINT_BOUND_C = 0.02
+AH_REL_BOUND = 0.001
+AH_ABS_SLACK_MG = 1.0
+
+
+class PsychroValues(ctypes.Structure):
+    _fields_ = [
+        ("svp_pa", ctypes.c_int32),
+        ("vapour_pressure_pa", ctypes.c_int32),
+        ("vpd_pa", ctypes.c_int32),
+        ("dew_point_centi_c", ctypes.c_int32),
+        ("abs_humidity_mg_m3", ctypes.c_int32),
+    ]
+
+
+def build_library(cc: str, out_dir: str) -> ctypes.CDLL:
+    lib_path = os.path.join(out_dir, "libpsychrometrics.so")
+    subprocess.run([cc, "-O2", "-shared", "-fPIC", "-Wall", "-Wextra", "-Werror",
+                    str(SOURCE), "-o", lib_path], check=True)
+    lib = ctypes.CDLL(lib_path)
+    lib.psychro_compute.argtypes = [ctypes.c_int32, ctypes.c_int32, ctypes.POINTER(PsychroValues)]
+    lib.psychro_compute.restype = None
+    return lib
+
+
+def svp_ref_pa(t: float) -> float:
+    return 610.8 * math.exp(17.27 * t / (t + 237.3))
+
+
+def dew_point_ref_c(t: float, rh: float) -> float:
+    gamma = math.log(rh / 100.0) + 17.27 * t / (t + 237.3)
+    return 237.3 * gamma / (17.27 - gamma)
+
+
+def abs_humidity_ref_mg(t: float, rh: float) -> float:
+    e = svp_ref_pa(t) * rh / 100.0
+    return e / (461.5 * (t + 273.15)) * 1e6
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--cc", default=os.environ.get("CC", "cc"), help="host C compiler")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        lib = build_library(args.cc, tmp)
+        out = PsychroValues()
+
+        worst = {"svp": (0.0, None), "vpd": (0.0, None), "dew": (0.0, None), "ah": (0.0, None)}
+        failures = 0
+
+        def track(key, excess, err, point):
+            nonlocal failures
+            if excess > 0:
+                failures += 1
+            if err > worst[key][0]:
+                worst[key] = (err, point)
+
+        # -40..60 °C in 0.05 °C steps, 1..100 %RH in 0.5 % steps
+        for ti in range(-4000, 6001, 5):
+            t = ti / 100.0
+            svp = svp_ref_pa(t)
+            for hi in range(100, 10001, 50):
+                rh = hi / 100.0
+                lib.psychro_compute(ti, hi, ctypes.byref(out))
+                point = (t, rh)
+
+                # Relative errors are reported net of the 1-unit output rounding
+                svp_err = abs(out.svp_pa - svp)
+                track("svp", svp_err - (SVP_REL_BOUND * svp + SVP_ABS_SLACK_PA),
+                      max(svp_err - SVP_ABS_SLACK_PA, 0.0) / svp, point)
+
+                vpd = svp * (1 - rh / 100.0)
+                vpd_err = abs(out.vpd_pa - vpd)
+                track("vpd", vpd_err - (SVP_REL_BOUND * svp + SVP_ABS_SLACK_PA), vpd_err, point)
+
+                dew = dew_point_ref_c(t, rh)
+                if dew >= -40.0:  # below the table the device clamps
+                    dew_err = abs(out.dew_point_centi_c / 100.0 - dew)
+                    track("dew", dew_err - DEW_POINT_BOUND_C, dew_err, point)
+
+                ah = abs_humidity_ref_mg(t, rh)
+                ah_err = abs(out.abs_humidity_mg_m3 - ah)
+                track("ah", ah_err - (AH_REL_BOUND * ah + AH_ABS_SLACK_MG),
+                      max(ah_err - AH_ABS_SLACK_MG, 0.0) / ah, point)
+
+    print("Worst-case error vs. reference (T = -40..60 °C, RH = 1..100 %;")
+    print("relative errors exclude the 1 Pa / 1 mg/m³ output rounding):")
+    print(f"  SVP            {worst['svp'][0] * 100:.4f} % at T={worst['svp'][1][0]:.2f} °C")
+    print(f"  VPD            {worst['vpd'][0]:.2f} Pa at T={worst['vpd'][1][0]:.2f} °C, RH={worst['vpd'][1][1]:.1f} %")
+    print(f"  Dew point      {worst['dew'][0]:.4f} °C at T={worst['dew'][1][0]:.2f} °C, RH={worst['dew'][1][1]:.1f} %")
+    print(f"  Abs. humidity  {worst['ah'][0] * 100:.4f} % at T={worst['ah'][1][0]:.2f} °C, RH={worst['ah'][1][1]:.1f} %")
+
+    if failures:
+        print(f"FAIL: {failures} point(s) outside the documented bounds", file=sys.stderr)
+        sys.exit(1)
+    print("PASS: all points within the bounds documented in psychrometrics.h")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,290 @@
+#!/usr/bin/env python3
+"""
+Streaming Alert Evaluator for Greenhouse Telemetry
+
+Consumes the MQTT telemetry stream next to ingest (Telegraf), keeps per-device,
+per-zone and greenhouse-wide rolling windows in memory, and fires alerts as
+soon as a sample arrives instead of re-scanning the hypertable on a timer.
+
+Alerts are published to the same topics the Grafana contact points used
+(greenhouse/alerts/<metric>/<high|low>), so existing consumers keep working.
+
+Configuration (environment):
+    MQTT_BROKER, MQTT_PORT          Broker to consume from / publish to
+    TELEMETRY_TOPIC                 Default: sensor/climate
+    ALERT_TEMP_HIGH, ALERT_TEMP_LOW, ALERT_HUMIDITY_HIGH, ALERT_HUMIDITY_LOW
+    ZONE_SIZE_CM                    Square zone grid over location_x/location_y
+    RULES_FILE                      Optional JSON file overriding the rules and
+                                    mapping devices to named zones
+"""
+
+import json
+import logging
+import math
+import os
+import signal
+import sys
+import time
+from collections import deque
+from dataclasses import dataclass, field
+from typing import Callable, Deque, Dict, List, Optional, Tuple
+
+import paho.mqtt.client as mqtt
+
+log = logging.getLogger("stream_alerts")
+
+METRICS = ("temperature", "humidity", "pressure", "gas_resistance", "soil_moisture",
+           "vpd", "dew_point", "abs_humidity", "iaq")
+SCOPES = ("device", "zone", "greenhouse")
+GREENHOUSE_KEY = "greenhouse"
+
+
+class RollingWindow:
+    """
+    Time-based rolling window with O(1) amortized updates.
+
+    Keeps a running sum and sum of squares so mean/std never rescan samples.
+    """
+
+    def __init__(self, span_s: float):
+        self.span_s = span_s
+        self.samples: Deque[Tuple[float, float]] = deque()
+        self.total = 0.0
+        self.total_sq = 0.0
+
+    def add(self, t: float, value: float):
+        self.samples.append((t, value))
+        self.total += value
+        self.total_sq += value * value
+        self.expire(t)
+
+    def expire(self, now: float):
+        cutoff = now - self.span_s
+        while self.samples and self.samples[0][0] < cutoff:
+            _, old = self.samples.popleft()
+            self.total -= old
+            self.total_sq -= old * old
+
+    def __len__(self) -> int:
+        return len(self.samples)
+
+    @property
+    def mean(self) -> float:
+        return self.total / len(self.samples) if self.samples else math.nan
+
+    @property
+    def std(self) -> float:
+        n = len(self.samples)
+        if n < 2:
+            return 0.0
+        var = (self.total_sq - self.total * self.total / n) / (n - 1)
+        return math.sqrt(max(var, 0.0))
+
+    @property
+    def last(self) -> float:
+        return self.samples[-1][1] if self.samples else math.nan
+
+
+@dataclass
+class Rule:
+    """Threshold rule on the rolling mean of a metric within a scope."""
+
+    name: str
+    metric: str
+    op: str                     # 'above' or 'below'
+    threshold: float
+    scope: str = "greenhouse"   # 'device', 'zone' or 'greenhouse'
+    window_s: float = 60.0
+    hysteresis: float = 0.0
+    for_s: float = 0.0
+    min_samples: int = 1
+    topic: Optional[str] = None
+
+    def __post_init__(self):
+        if self.metric not in METRICS:
+            raise ValueError(f"rule {self.name}: unknown metric {self.metric!r}")
+        if self.scope not in SCOPES:
+            raise ValueError(f"rule {self.name}: unknown scope {self.scope!r}")
+        if self.op not in ("above", "below"):
+            raise ValueError(f"rule {self.name}: op must be 'above' or 'below'")
+        if self.topic is None:
+            direction = "high" if self.op == "above" else "low"
+            self.topic = f"greenhouse/alerts/{self.metric}/{direction}"
+
+    def active(self, value: float) -> bool:
+        return value > self.threshold if self.op == "above" else value < self.threshold
+
+    def cleared(self, value: float) -> bool:
+        if self.op == "above":
+            return value < self.threshold - self.hysteresis
+        return value > self.threshold + self.hysteresis
+
+
+@dataclass
+class RuleState:
+    firing: bool = False
+    pending_since: Optional[float] = None
+
+
+@dataclass
+class Evaluator:
+    """Stateful evaluator; feed it samples with `process()`."""
+
+    rules: List[Rule]
+    publish: Callable[[str, dict], None]
+    zone_size_cm: float = 250.0
+    device_zones: Dict[str, str] = field(default_factory=dict)
+
+    def __post_init__(self):
+        # (rule index, scope key) -> window / state
+        self.windows: Dict[Tuple[int, str], RollingWindow] = {}
+        self.states: Dict[Tuple[int, str], RuleState] = {}
+        self.samples_processed = 0
+
+    def zone_of(self, device_id: str, sample: dict) -> str:
+        if device_id in self.device_zones:
+            return self.device_zones[device_id]
+        try:
+            x = float(sample.get("location_x", 0))
+            y = float(sample.get("location_y", 0))
+        except (TypeError, ValueError):
+            return "unassigned"
+        return f"{int(x // self.zone_size_cm)}-{int(y // self.zone_size_cm)}"
+
+    def process(self, sample: dict, now: Optional[float] = None):
+        """Update windows with one telemetry message and evaluate affected rules."""
+        now = time.monotonic() if now is None else now
+        device_id = str(sample.get("device_id", "unknown"))
+        keys = {
+            "device": device_id,
+            "zone": self.zone_of(device_id, sample),
+            "greenhouse": GREENHOUSE_KEY,
+        }
+        self.samples_processed += 1
+
+        for idx, rule in enumerate(self.rules):
+            value = sample.get(rule.metric)
+            if not isinstance(value, (int, float)) or isinstance(value, bool):
+                continue
+            if rule.metric == "soil_moisture" and value < 0:
+                continue  # -1 means the ADC read failed
+
+            key = (idx, keys[rule.scope])
+            window = self.windows.get(key)
+            if window is None:
+                window = self.windows[key] = RollingWindow(rule.window_s)
+                self.states[key] = RuleState()
+            window.add(now, float(value))
+            self._evaluate(rule, key, window, now)
+
+    def _evaluate(self, rule: Rule, key: Tuple[int, str], window: RollingWindow, now: float):
+        if len(window) < rule.min_samples:
+            return
+        state = self.states[key]
+        mean = window.mean
+
+        if not state.firing:
+            if not rule.active(mean):
+                state.pending_since = None
+                return
+            if state.pending_since is None:
+                state.pending_since = now
+            if now - state.pending_since >= rule.for_s:
+                state.firing = True
+                self._emit(rule, key[1], "firing", window)
+        elif rule.cleared(mean):
+            state.firing = False
+            state.pending_since = None
+            self._emit(rule, key[1], "resolved", window)
+
+    def _emit(self, rule: Rule, scope_key: str, status: str, window: RollingWindow):
+        event = {
+            "rule": rule.name,
+            "status": status,
+            "scope": rule.scope,
+            "scope_key": scope_key,
+            "metric": rule.metric,
+            "value": round(window.mean, 3),
+            "std": round(window.std, 3),
+            "samples": len(window),
+            "window_s": rule.window_s,
+            "threshold": rule.threshold,
+            "timestamp": time.time(),
+        }
+        log.warning("%s %s [%s=%s] %s mean=%.2f", rule.name, status, rule.scope,
+                    scope_key, rule.metric, window.mean)
+        self.publish(rule.topic, event)
+
+
+def default_rules() -> List[Rule]:
+    """Greenhouse-wide rules equivalent to the provisioned Grafana alert rules."""
+    env = os.environ.get
+    return [
+        Rule("Temperature Too High", "temperature", "above",
+             float(env("ALERT_TEMP_HIGH", "28")), hysteresis=0.5, for_s=120),
+        Rule("Temperature Too Low", "temperature", "below",
+             float(env("ALERT_TEMP_LOW", "18")), hysteresis=0.5, for_s=120),
+        Rule("Humidity Too High", "humidity", "above",
+             float(env("ALERT_HUMIDITY_HIGH", "70")), hysteresis=2.0, for_s=120),
+        Rule("Humidity Too Low", "humidity", "below",
+             float(env("ALERT_HUMIDITY_LOW", "40")), hysteresis=2.0, for_s=120),
+    ]
+
+
+def load_config(path: Optional[str]) -> Tuple[List[Rule], Dict[str, str]]:
+    """Load rules and device->zone mapping from a JSON file, if given."""
+    if not path:
+        return default_rules(), {}
+    with open(path) as f:
+        config = json.load(f)
+    rules = [Rule(**r) for r in config.get("rules", [])] or default_rules()
+    return rules, dict(config.get("device_zones", {}))
+
+
+def main():
+    logging.basicConfig(level=os.environ.get("LOG_LEVEL", "INFO"),
+                        format="%(asctime)s %(levelname)s %(name)s: %(message)s")
+
+    broker = os.environ.get("MQTT_BROKER", "localhost")
+    port = int(os.environ.get("MQTT_PORT", "1883"))
+    topic = os.environ.get("TELEMETRY_TOPIC", "sensor/climate")
+    rules, device_zones = load_config(os.environ.get("RULES_FILE"))
+
+    client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, client_id="stream-alerts")
+
+    def publish(alert_topic: str, event: dict):
+        client.publish(alert_topic, json.dumps(event), qos=1)
+
+    evaluator = Evaluator(rules, publish,
+                          zone_size_cm=float(os.environ.get("ZONE_SIZE_CM", "250")),
+                          device_zones=device_zones)
+
+    def on_connect(client, userdata, flags, reason_code, properties):
+        log.info("Connected to %s:%d (%s), subscribing to %s", broker, port, reason_code, topic)
+        client.subscribe(topic, qos=0)
+
+    def on_message(client, userdata, msg):
+        try:
+            sample = json.loads(msg.payload)
+        except (UnicodeDecodeError, json.JSONDecodeError):
+            log.debug("Ignoring non-JSON message on %s", msg.topic)
+            return
+        if isinstance(sample, dict):
+            evaluator.process(sample)
+
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.reconnect_delay_set(min_delay=1, max_delay=30)
+
+    signal.signal(signal.SIGTERM, lambda *_: sys.exit(0))
+    for rule in rules:
+        log.info("Rule %r: %s %s %s %.2f over %.0fs (for %.0fs) -> %s", rule.name,
+                 rule.scope, rule.metric, rule.op, rule.threshold, rule.window_s,
+                 rule.for_s, rule.topic)
+
+    client.connect_async(broker, port, keepalive=30)
+    client.loop_forever(retry_first_connection=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,298 @@
+"""
+Bulk Synthetic Data Generator for Database and Dashboard Benchmarking
+
+Streams months of high-rate sensor data for hundreds of devices straight into
+PostgreSQL COPY format, using the same VPD-gradient model as data_generator.py:
+- VPD rises linearly with distance from the humidifier (0.55-1.05 kPa)
+- Temperature follows a diurnal cycle, humidity is solved from VPD via Tetens
+- Pressure and gas resistance drift slowly around realistic operating points
+
+Everything is vectorized over (time x device) blocks, and rows are packed into
+PostgreSQL's binary COPY format with a NumPy structured dtype, so no Python
+code runs per row. Output is fully determined by the seed and the block size.
+
+Examples
+--------
+Load 30 days of 1 Hz data for 200 devices into the sensor_data table::
+
+    python bulk_generator.py --devices 200 --days 30 | \\
+        psql -c "COPY sensor_data (time, device_id, temperature, humidity, pressure, gas_resistance) FROM STDIN WITH (FORMAT binary)"
+
+Measure raw generator throughput without a database::
+
+    python bulk_generator.py --devices 500 --days 7 > /dev/null
+"""
+
+import argparse
+import sys
+import time
+from datetime import datetime, timezone
+from typing import BinaryIO, Iterator, Optional, Tuple
+
+import numpy as np
+from scipy.signal import lfilter
+
+
+# Model constants (kept in sync with GreenhouseDataGenerator)
+HUMIDIFIER_POS = (18.0, 18.0)
+BENCH_SIZE_CM = (130.0, 130.0)
+MIN_VPD_KPA = 0.55
+MAX_VPD_KPA = 1.05
+VPD_CLIP_KPA = (0.5, 1.1)
+HUMIDITY_CLIP = (40.0, 85.0)
+
+# Column order written to COPY (matches setup_database.create_sensor_data_table)
+COPY_COLUMNS = ("time", "device_id", "temperature", "humidity", "pressure", "gas_resistance")
+
+# PostgreSQL binary COPY framing
+PGCOPY_SIGNATURE = b"PGCOPY\n\xff\r\n\x00"
+PGCOPY_HEADER = PGCOPY_SIGNATURE + np.array([0, 0], dtype=">i4").tobytes()
+PGCOPY_TRAILER = np.array([-1], dtype=">i2").tobytes()
+PG_EPOCH = datetime(2000, 1, 1, tzinfo=timezone.utc)
+
+
+def _svp_kpa(temp_c: np.ndarray) -> np.ndarray:
+    """Saturation vapour pressure (kPa), Tetens formula."""
+    return 0.6108 * np.exp((17.27 * temp_c) / (temp_c + 237.3))
+
+
+class BulkDataGenerator:
+    """Vectorized generator for large benchmark datasets."""
+
+    def __init__(self, n_devices: int = 200, rate_hz: float = 1.0,
+                 start: Optional[datetime] = None, seed: int = 42,
+                 device_prefix: str = "bench"):
+        """
+        Initialize bulk generator.
+
+        Parameters
+        ----------
+        n_devices : int
+            Number of simulated devices
+        rate_hz : float
+            Samples per second per device
+        start : datetime, optional
+            First timestamp (UTC); defaults to the experiment start date
+        seed : int
+            Random seed for reproducibility
+        device_prefix : str
+            Device IDs are '<prefix>-NNNN', zero padded to a fixed width
+        """
+        if n_devices < 1:
+            raise ValueError("n_devices must be >= 1")
+        if rate_hz <= 0:
+            raise ValueError("rate_hz must be > 0")
+
+        self.n_devices = n_devices
+        self.rate_hz = rate_hz
+        self.start = start or datetime(2025, 10, 15, tzinfo=timezone.utc)
+        if self.start.tzinfo is None:
+            self.start = self.start.replace(tzinfo=timezone.utc)
+        self.seed = seed
+
+        # Fixed-width IDs keep every COPY row the same size
+        width = max(4, len(str(n_devices - 1)))
+        self.device_ids = np.array(
+            [f"{device_prefix}-{i:0{width}d}".encode("ascii") for i in range(n_devices)])
+        self.id_len = len(self.device_ids[0])
+
+        # Static per-device properties drawn from a dedicated stream so they
+        # do not depend on how many rows are generated afterwards
+        rng = np.random.default_rng(np.random.SeedSequence(seed, spawn_key=(0,)))
+
+        self.position_x = rng.uniform(0, BENCH_SIZE_CM[0], n_devices)
+        self.position_y = rng.uniform(0, BENCH_SIZE_CM[1], n_devices)
+        hx, hy = HUMIDIFIER_POS
+        distance = np.hypot(self.position_x - hx, self.position_y - hy)
+        max_distance = np.hypot(BENCH_SIZE_CM[0] - hx, BENCH_SIZE_CM[1] - hy)
+        self.base_vpd = MIN_VPD_KPA + (MAX_VPD_KPA - MIN_VPD_KPA) * (distance / max_distance)
+
+        self.temp_offset = rng.normal(0, 0.5, n_devices)
+        self.pressure_offset = rng.normal(0, 0.8, n_devices)
+        self.gas_base = rng.lognormal(np.log(50000.0), 0.25, n_devices)
+
+        # AR(1) noise state, carried across blocks so series are continuous
+        self._ar_coeff = 0.999 ** (1.0 / rate_hz)
+        self._ar_state = np.zeros((3, n_devices))
+
+        self.row_dtype = np.dtype([
+            ("nfields", ">i2"),
+            ("time_len", ">i4"), ("time", ">i8"),
+            ("id_len", ">i4"), ("device_id", f"S{self.id_len}"),
+            ("temp_len", ">i4"), ("temperature", ">f8"),
+            ("hum_len", ">i4"), ("humidity", ">f8"),
+            ("pres_len", ">i4"), ("pressure", ">f8"),
+            ("gas_len", ">i4"), ("gas_resistance", ">f8"),
+        ])
+
+    def _ar_noise(self, rng: np.random.Generator, channel: int, n_steps: int,
+                  sigma: float) -> np.ndarray:
+        """Stationary AR(1) noise with std `sigma`, continuous across blocks."""
+        a = self._ar_coeff
+        innovations = rng.normal(0, sigma * np.sqrt(1 - a * a), (n_steps, self.n_devices))
+        out, zf = lfilter([1.0], [1.0, -a], innovations, axis=0,
+                          zi=(a * self._ar_state[channel])[np.newaxis, :])
+        self._ar_state[channel] = zf[0] / a
+        return out
+
+    def generate_block(self, first_step: int, n_steps: int,
+                       rng: np.random.Generator) -> Tuple[np.ndarray, ...]:
+        """
+        Generate one (n_steps x n_devices) block of readings.
+
+        Returns
+        -------
+        tuple
+            (timestamps_s, temperature, humidity, pressure, gas_resistance),
+            each of shape (n_steps, n_devices) except timestamps (n_steps,)
+        """
+        steps = np.arange(first_step, first_step + n_steps)
+        t_s = steps / self.rate_hz
+        hour_of_day = ((self.start.hour * 3600 + self.start.minute * 60 + t_s) / 3600.0) % 24
+
+        # Diurnal temperature: peak mid-afternoon, +/-3 °C around 23 °C
+        diurnal = 3.0 * np.sin(2 * np.pi * (hour_of_day - 9.0) / 24.0)
+        temp = (23.0 + diurnal[:, np.newaxis] + self.temp_offset
+                + self._ar_noise(rng, 0, n_steps, 0.3))
+
+        vpd = np.clip(self.base_vpd + self._ar_noise(rng, 1, n_steps, 0.03), *VPD_CLIP_KPA)
+        humidity = np.clip(100.0 * (1.0 - vpd / _svp_kpa(temp)), *HUMIDITY_CLIP)
+
+        weather = 2.0 * np.sin(2 * np.pi * t_s / (3.5 * 86400.0))
+        pressure = (1013.0 + weather[:, np.newaxis] + self.pressure_offset
+                    + self._ar_noise(rng, 2, n_steps, 0.3))
+
+        # Gas resistance drops when humidity rises (typical MOX behaviour)
+        gas = self.gas_base * np.exp(-0.01 * (humidity - 60.0))
+
+        return t_s, temp, humidity, pressure, gas
+
+    def iter_blocks(self, n_samples: int, block_steps: int = 3600) -> Iterator[np.ndarray]:
+        """
+        Yield packed binary COPY rows, one block at a time.
+
+        Parameters
+        ----------
+        n_samples : int
+            Number of time steps per device
+        block_steps : int
+            Time steps per block; memory use is block_steps x n_devices rows
+        """
+        n_blocks = (n_samples + block_steps - 1) // block_steps
+        block_seeds = np.random.SeedSequence(self.seed, spawn_key=(1,)).spawn(n_blocks)
+        self._ar_state[:] = 0.0
+        start_us = int((self.start - PG_EPOCH).total_seconds() * 1_000_000)
+
+        for b in range(n_blocks):
+            first = b * block_steps
+            n_steps = min(block_steps, n_samples - first)
+            rng = np.random.default_rng(block_seeds[b])
+            t_s, temp, hum, pres, gas = self.generate_block(first, n_steps, rng)
+
+            rows = np.empty(n_steps * self.n_devices, dtype=self.row_dtype)
+            rows["nfields"] = len(COPY_COLUMNS)
+            rows["time_len"] = 8
+            rows["time"] = np.repeat(start_us + np.round(t_s * 1e6).astype(np.int64),
+                                     self.n_devices)
+            rows["id_len"] = self.id_len
+            rows["device_id"] = np.tile(self.device_ids, n_steps)
+            for len_field, field, values in (("temp_len", "temperature", temp),
+                                             ("hum_len", "humidity", hum),
+                                             ("pres_len", "pressure", pres),
+                                             ("gas_len", "gas_resistance", gas)):
+                rows[len_field] = 8
+                rows[field] = values.ravel()
+            yield rows
+
+    def write_copy(self, out: BinaryIO, n_samples: int, block_steps: int = 3600) -> int:
+        """
+        Write a complete binary COPY stream.
+
+        Returns
+        -------
+        int
+            Number of rows written
+        """
+        total = 0
+        out.write(PGCOPY_HEADER)
+        for rows in self.iter_blocks(n_samples, block_steps):
+            out.write(rows.tobytes())
+            total += len(rows)
+        out.write(PGCOPY_TRAILER)
+        return total
+
+    def write_csv(self, out: BinaryIO, n_samples: int, block_steps: int = 3600) -> int:
+        """
+        Write a CSV COPY stream (slower; for inspection and non-binary loaders).
+
+        Returns
+        -------
+        int
+            Number of rows written
+        """
+        total = 0
+        for rows in self.iter_blocks(n_samples, block_steps):
+            ts = (np.datetime64(PG_EPOCH.replace(tzinfo=None), "us")
+                  + rows["time"].astype(np.int64).astype("timedelta64[us]"))
+            columns = [np.char.add(np.datetime_as_string(ts, unit="ms"), "+00"),
+                       rows["device_id"].astype(str)]
+            columns += [np.char.mod("%.2f", rows[f]) for f in COPY_COLUMNS[2:]]
+            lines = columns[0]
+            for column in columns[1:]:
+                lines = np.char.add(np.char.add(lines, ","), column)
+            out.write(("\n".join(lines.tolist()) + "\n").encode("ascii"))
+            total += len(rows)
+        return total
+
+
+def copy_statement(table_name: str = "sensor_data", fmt: str = "binary") -> str:
+    """Return the COPY statement matching the generator's output."""
+    options = "FORMAT binary" if fmt == "binary" else "FORMAT csv"
+    return f"COPY {table_name} ({', '.join(COPY_COLUMNS)}) FROM STDIN WITH ({options})"
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Stream synthetic greenhouse telemetry in PostgreSQL COPY format")
+    parser.add_argument("--devices", type=int, default=200, help="number of devices")
+    parser.add_argument("--days", type=float, default=30.0, help="duration in days")
+    parser.add_argument("--rate", type=float, default=1.0, help="samples per second per device")
+    parser.add_argument("--seed", type=int, default=42, help="random seed")
+    parser.add_argument("--start", type=str, default=None,
+                        help="start time, ISO 8601 (UTC), default 2025-10-15")
+    parser.add_argument("--block", type=int, default=3600, help="time steps per block")
+    parser.add_argument("--format", choices=["binary", "csv"], default="binary")
+    parser.add_argument("--table", type=str, default="sensor_data",
+                        help="table name used by --print-sql")
+    parser.add_argument("--output", type=str, default="-", help="output file ('-' = stdout)")
+    parser.add_argument("--print-sql", action="store_true",
+                        help="print the matching COPY statement and exit")
+    args = parser.parse_args()
+
+    if args.print_sql:
+        print(copy_statement(args.table, args.format))
+        return
+
+    start = datetime.fromisoformat(args.start) if args.start else None
+    generator = BulkDataGenerator(n_devices=args.devices, rate_hz=args.rate,
+                                  start=start, seed=args.seed)
+    n_samples = int(round(args.days * 86400 * args.rate))
+
+    out = sys.stdout.buffer if args.output == "-" else open(args.output, "wb")
+    t0 = time.perf_counter()
+    try:
+        if args.format == "binary":
+            rows = generator.write_copy(out, n_samples, args.block)
+        else:
+            rows = generator.write_csv(out, n_samples, args.block)
+    finally:
+        if out is not sys.stdout.buffer:
+            out.close()
+    elapsed = time.perf_counter() - t0
+
+    print(f"Wrote {rows:,} rows in {elapsed:.1f} s ({rows / elapsed:,.0f} rows/s)",
+          file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
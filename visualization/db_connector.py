@@ -2,12 +2,110 @@
 TimescaleDB Connector for Greenhouse Sensor Data
 
 Provides methods to query sensor data from TimescaleDB for visualization.
+Latest readings come from the devices' retained state topics on the broker
+instead (greenhouse/state/{device_id}/climate), with the database as fallback.
 """
 
+import json
+import os
+import threading
 import pandas as pd
 from sqlalchemy import create_engine, text
 from typing import Optional, List, Dict
-from datetime import datetime, timedelta
+from datetime import datetime, timedelta, timezone
+
+STATE_TOPIC = "greenhouse/state/+/climate"
+
+
+def read_retained_state(host: str, port: int = 1883, topic: str = STATE_TOPIC,
+                        username: str = '', password: str = '',
+                        settle_s: float = 0.5, timeout_s: float = 3.0) -> List[Dict]:
+    """
+    Collect the retained state messages on a topic filter.
+
+    The broker sends retained messages right after the subscription is
+    acknowledged; collection ends once none arrived for settle_s.
+
+    Returns:
+        List of decoded state payloads
+    """
+    import paho.mqtt.client as mqtt
+
+    states = []
+    lock = threading.Lock()
+    last_message = threading.Event()
+    subscribed = threading.Event()
+
+    def on_connect(client, userdata, flags, reason_code, properties):
+        client.subscribe(topic, qos=1)
+
+    def on_subscribe(client, userdata, mid, reason_codes, properties):
+        subscribed.set()
+
+    def on_message(client, userdata, msg):
+        if not msg.retain:
+            return
+        try:
+            payload = json.loads(msg.payload)
+        except ValueError:
+            return
+        with lock:
+            states.append(payload)
+        last_message.set()
+
+    client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    if username:
+        client.username_pw_set(username, password)
+    client.on_connect = on_connect
+    client.on_subscribe = on_subscribe
+    client.on_message = on_message
+    client.connect(host, port)
+    client.loop_start()
+    try:
+        if not subscribed.wait(timeout_s):
+            raise TimeoutError(f"no SUBACK from {host}:{port}")
+        while last_message.wait(settle_s):
+            last_message.clear()
+    finally:
+        client.loop_stop()
+        client.disconnect()
+
+    with lock:
+        return list(states)
+
+
+LATEST_COLUMNS = ['timestamp', 'sensor_id', 'temperature', 'humidity', 'pressure', 'resistance']
+
+
+def _split_retained_state(states: List[Dict], sensor_ids: Optional[List[str]],
+                          max_age_s: float, now: Optional[float] = None):
+    """
+    Split retained state payloads into current readings and stale devices.
+
+    A state without a timestamp (clock not synced yet) counts as stale.
+
+    Returns:
+        (rows keyed by device_id, set of device_ids whose state is stale)
+    """
+    now = now if now is not None else datetime.now(timezone.utc).timestamp()
+    fresh, stale = {}, set()
+    for state in states:
+        device_id = state.get('device_id')
+        if not device_id or (sensor_ids and device_id not in sensor_ids):
+            continue
+        ts = state.get('ts')
+        if not ts or now - ts > max_age_s:
+            stale.add(device_id)
+            continue
+        fresh[device_id] = {
+            'timestamp': datetime.fromtimestamp(ts, timezone.utc),
+            'sensor_id': device_id,
+            'temperature': state.get('temperature'),
+            'humidity': state.get('humidity'),
+            'pressure': state.get('pressure'),
+            'resistance': state.get('gas_resistance'),
+        }
+    return fresh, stale - fresh.keys()
 
 
 class TimescaleDBConnector:
@@ -17,7 +115,8 @@ class TimescaleDBConnector:
     
     def __init__(self, host: str = 'localhost', port: int = 5432,
                  database: str = 'greenhouse', user: str = 'postgres',
-                 password: str = 'postgres'):
+                 password: str = 'postgres',
+                 mqtt_host: Optional[str] = None, mqtt_port: Optional[int] = None):
         """
         Initialize database connection.
         
@@ -27,11 +126,16 @@ class TimescaleDBConnector:
             database: Database name
             user: Database user
             password: Database password
+            mqtt_host: Broker with the retained device state (default:
+                MQTT_BROKER, else the database host)
+            mqtt_port: Broker port (default: MQTT_PORT, else 1883)
         """
         self.connection_string = (
             f"postgresql://{user}:{password}@{host}:{port}/{database}"
         )
         self.engine = None
+        self.mqtt_host = mqtt_host or os.getenv('MQTT_BROKER', host)
+        self.mqtt_port = mqtt_port or int(os.getenv('MQTT_PORT', '1883'))
         
     def connect(self):
         """Establish database connection."""
@@ -112,17 +216,52 @@ class TimescaleDBConnector:
     
     def query_latest_readings(self, 
                              sensor_ids: Optional[List[str]] = None,
-                             table_name: str = 'sensor_data') -> pd.DataFrame:
+                             table_name: str = 'sensor_data',
+                             source: str = 'mqtt',
+                             max_age_s: float = 300) -> pd.DataFrame:
         """
         Get the latest reading from each sensor.
         
+        Read from the retained state each device keeps on the broker, so no
+        database query is needed. Sensors without a fresh retained state
+        (MQTT-SN nodes, devices that have not published state yet, or state
+        older than max_age_s) are read from the database, as is everything
+        when the broker is unreachable, holds no fresh state, or source='db'.
+        
         Args:
             sensor_ids: List of sensor IDs (default: all)
-            table_name: Name of the sensor data table
+            table_name: Name of the sensor data table (database fallback)
+            source: 'mqtt' (default) or 'db'
+            max_age_s: Oldest retained state still taken as current
             
         Returns:
             DataFrame with latest reading for each sensor
         """
+        if source == 'mqtt':
+            try:
+                states = read_retained_state(
+                    self.mqtt_host, self.mqtt_port,
+                    username=os.getenv('MQTT_USERNAME', ''),
+                    password=os.getenv('MQTT_PASSWORD', ''))
+            except Exception as e:
+                print(f"Retained state unavailable ({e}), querying the database")
+            else:
+                fresh, stale = _split_retained_state(states, sensor_ids, max_age_s)
+                if fresh:
+                    missing = [s for s in sensor_ids if s not in fresh] if sensor_ids else sorted(stale)
+                    df = pd.DataFrame(list(fresh.values()), columns=LATEST_COLUMNS)
+                    if missing:
+                        df = pd.concat([df, self._query_latest_readings_db(missing, table_name)],
+                                       ignore_index=True)
+                    return df.sort_values('sensor_id', ignore_index=True)
+                print("No current retained state on the broker, querying the database")
+        
+        return self._query_latest_readings_db(sensor_ids, table_name)
+    
+    def _query_latest_readings_db(self,
+                                  sensor_ids: Optional[List[str]] = None,
+                                  table_name: str = 'sensor_data') -> pd.DataFrame:
+        """Latest reading per sensor from the database."""
         if not self.engine:
             self.connect()
         
@@ -0,0 +1,87 @@
+"""
+Tests for the retained-state path of TimescaleDBConnector.query_latest_readings
+
+The broker and the database are replaced by stubs, so no services are needed:
+    pytest visualization/test_db_connector.py
+"""
+
+from datetime import datetime, timezone
+
+import pandas as pd
+import pytest
+
+from visualization import db_connector
+from visualization.db_connector import LATEST_COLUMNS, TimescaleDBConnector
+
+
+def state(device_id, age_s, temperature=21.0):
+    """Retained climate state as the firmware publishes it."""
+    ts = int(datetime.now(timezone.utc).timestamp() - age_s) if age_s is not None else 0
+    return {'device_id': device_id, 'temperature': temperature, 'humidity': 50.0,
+            'pressure': 1013.0, 'gas_resistance': 50000.0, 'ts': ts}
+
+
+@pytest.fixture
+def connector(monkeypatch):
+    """Connector whose database returns one row per requested sensor (all if None)."""
+    conn = TimescaleDBConnector(mqtt_host='broker')
+    conn.db_queries = []
+
+    def query_db(sensor_ids=None, table_name='sensor_data'):
+        conn.db_queries.append(sensor_ids)
+        ids = sensor_ids if sensor_ids else ['db-1', 'db-2']
+        return pd.DataFrame([{'timestamp': datetime.now(timezone.utc), 'sensor_id': s,
+                              'temperature': 10.0, 'humidity': 40.0, 'pressure': 1000.0,
+                              'resistance': 1.0} for s in ids], columns=LATEST_COLUMNS)
+
+    monkeypatch.setattr(conn, '_query_latest_readings_db', query_db)
+    return conn
+
+
+def retained(monkeypatch, states):
+    monkeypatch.setattr(db_connector, 'read_retained_state', lambda *args, **kwargs: states)
+
+
+def test_empty_snapshot_falls_back_to_database(connector, monkeypatch):
+    retained(monkeypatch, [])
+    df = connector.query_latest_readings()
+    assert connector.db_queries == [None]
+    assert list(df['sensor_id']) == ['db-1', 'db-2']
+
+
+def test_stale_snapshot_falls_back_to_database(connector, monkeypatch):
+    retained(monkeypatch, [state('node-1', age_s=3600), state('node-2', age_s=None)])
+    df = connector.query_latest_readings()
+    assert connector.db_queries == [None]
+    assert list(df['sensor_id']) == ['db-1', 'db-2']
+
+
+def test_broker_unreachable_falls_back_to_database(connector, monkeypatch):
+    def unreachable(*args, **kwargs):
+        raise ConnectionRefusedError()
+    monkeypatch.setattr(db_connector, 'read_retained_state', unreachable)
+    connector.query_latest_readings()
+    assert connector.db_queries == [None]
+
+
+def test_fresh_snapshot_skips_database(connector, monkeypatch):
+    retained(monkeypatch, [state('node-2', age_s=5, temperature=23.5), state('node-1', age_s=5)])
+    df = connector.query_latest_readings()
+    assert connector.db_queries == []
+    assert list(df['sensor_id']) == ['node-1', 'node-2']
+    assert df.loc[1, 'temperature'] == 23.5
+
+
+def test_sensors_without_fresh_state_read_from_database(connector, monkeypatch):
+    # node-2 has stale state, sn-node publishes over MQTT-SN and has none
+    retained(monkeypatch, [state('node-1', age_s=5), state('node-2', age_s=3600)])
+    df = connector.query_latest_readings(sensor_ids=['node-1', 'node-2', 'sn-node'])
+    assert connector.db_queries == [['node-2', 'sn-node']]
+    assert list(df['sensor_id']) == ['node-1', 'node-2', 'sn-node']
+    assert list(df['temperature']) == [21.0, 10.0, 10.0]
+
+
+def test_stale_devices_refreshed_from_database_without_filter(connector, monkeypatch):
+    retained(monkeypatch, [state('node-1', age_s=5), state('node-2', age_s=3600)])
+    connector.query_latest_readings()
+    assert connector.db_queries == [['node-2']]